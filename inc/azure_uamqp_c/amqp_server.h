@@ -0,0 +1,50 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef AMQP_SERVER_H
+#define AMQP_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/event_loop.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+    typedef struct AMQP_SERVER_INSTANCE_TAG* AMQP_SERVER_HANDLE;
+
+    /* Called for each link attached by a peer; the application creates its link on the given session and returns true to keep it */
+    typedef bool(*ON_AMQP_SERVER_LINK_ATTACHED)(void* context, CONNECTION_HANDLE connection, SESSION_HANDLE session, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target);
+    /* Called before the server destroys a closed connection and its sessions, the application has to destroy the links it created on them */
+    typedef void(*ON_AMQP_SERVER_CONNECTION_CLOSED)(void* context, CONNECTION_HANDLE connection);
+    typedef void(*ON_AMQP_SERVER_COMMAND)(void* context);
+
+    MOCKABLE_FUNCTION(, AMQP_SERVER_HANDLE, amqp_server_create, int, port, const char*, container_id, ON_AMQP_SERVER_LINK_ATTACHED, on_link_attached, ON_AMQP_SERVER_CONNECTION_CLOSED, on_connection_closed, void*, callback_context);
+    MOCKABLE_FUNCTION(, void, amqp_server_destroy, AMQP_SERVER_HANDLE, amqp_server);
+    MOCKABLE_FUNCTION(, int, amqp_server_set_max_connections, AMQP_SERVER_HANDLE, amqp_server, size_t, max_connections);
+    MOCKABLE_FUNCTION(, int, amqp_server_set_session_incoming_window, AMQP_SERVER_HANDLE, amqp_server, uint32_t, incoming_window);
+    MOCKABLE_FUNCTION(, int, amqp_server_set_output_buffer_size, AMQP_SERVER_HANDLE, amqp_server, size_t, output_buffer_size);
+    MOCKABLE_FUNCTION(, int, amqp_server_set_listener_option, AMQP_SERVER_HANDLE, amqp_server, const char*, option_name, const void*, value);
+    MOCKABLE_FUNCTION(, int, amqp_server_set_shard_count, AMQP_SERVER_HANDLE, amqp_server, size_t, shard_count);
+    MOCKABLE_FUNCTION(, int, amqp_server_get_shard_count, AMQP_SERVER_HANDLE, amqp_server, size_t*, shard_count);
+    MOCKABLE_FUNCTION(, int, amqp_server_get_current_shard, AMQP_SERVER_HANDLE, amqp_server, size_t*, shard_index);
+    MOCKABLE_FUNCTION(, int, amqp_server_submit, AMQP_SERVER_HANDLE, amqp_server, size_t, shard_index, ON_AMQP_SERVER_COMMAND, on_command, void*, context);
+    MOCKABLE_FUNCTION(, int, amqp_server_get_connection_count, AMQP_SERVER_HANDLE, amqp_server, size_t*, connection_count);
+    MOCKABLE_FUNCTION(, EVENT_LOOP_HANDLE, amqp_server_get_event_loop, AMQP_SERVER_HANDLE, amqp_server);
+    MOCKABLE_FUNCTION(, int, amqp_server_start, AMQP_SERVER_HANDLE, amqp_server);
+    MOCKABLE_FUNCTION(, int, amqp_server_run_once, AMQP_SERVER_HANDLE, amqp_server);
+    MOCKABLE_FUNCTION(, int, amqp_server_run, AMQP_SERVER_HANDLE, amqp_server);
+    MOCKABLE_FUNCTION(, int, amqp_server_stop, AMQP_SERVER_HANDLE, amqp_server);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* AMQP_SERVER_H */
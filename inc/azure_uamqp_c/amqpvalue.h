@@ -95,6 +95,8 @@ extern "C" {
 
 	MOCKABLE_FUNCTION(, AMQPVALUE_DECODER_HANDLE, amqpvalue_decoder_create, ON_VALUE_DECODED, on_value_decoded, void*, callback_context);
 	MOCKABLE_FUNCTION(, void, amqpvalue_decoder_destroy, AMQPVALUE_DECODER_HANDLE, handle);
+	MOCKABLE_FUNCTION(, int, amqpvalue_decoder_reset, AMQPVALUE_DECODER_HANDLE, handle);
+	MOCKABLE_FUNCTION(, int, amqpvalue_get_encoded_value_length, const unsigned char*, bytes, size_t, length, size_t*, value_length);
 	MOCKABLE_FUNCTION(, int, amqpvalue_decode_bytes, AMQPVALUE_DECODER_HANDLE, handle, const unsigned char*, buffer, size_t, size);
 
 	/* misc for now */
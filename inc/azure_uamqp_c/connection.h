@@ -70,6 +70,9 @@ extern "C" {
     typedef void(*ON_ENDPOINT_FRAME_RECEIVED)(void* context, AMQP_VALUE performative, uint32_t frame_payload_size, const unsigned char* payload_bytes);
     typedef void(*ON_CONNECTION_STATE_CHANGED)(void* context, CONNECTION_STATE new_connection_state, CONNECTION_STATE previous_connection_state);
     typedef bool(*ON_NEW_ENDPOINT)(void* context, ENDPOINT_HANDLE new_endpoint);
+    /* returns the time in ms until the endpoint needs its next dowork, or (uint64_t)-1 when it has no timer running */
+    typedef uint64_t(*ON_ENDPOINT_DOWORK)(void* context, uint64_t current_ms);
+    typedef void(*ON_ENDPOINT_SEND_BLOCKED_CHANGED)(void* context, bool is_send_blocked);
 
     MOCKABLE_FUNCTION(, CONNECTION_HANDLE, connection_create, XIO_HANDLE, io, const char*, hostname, const char*, container_id, ON_NEW_ENDPOINT, on_new_endpoint, void*, callback_context);
     MOCKABLE_FUNCTION(, CONNECTION_HANDLE, connection_create2, XIO_HANDLE, xio, const char*, hostname, const char*, container_id, ON_NEW_ENDPOINT, on_new_endpoint, void*, callback_context, ON_CONNECTION_STATE_CHANGED, on_connection_state_changed, void*, on_connection_state_changed_context, ON_IO_ERROR, on_io_error, void*, on_io_error_context);
@@ -84,13 +87,22 @@ extern "C" {
     MOCKABLE_FUNCTION(, int, connection_set_idle_timeout, CONNECTION_HANDLE, connection, milliseconds, idle_timeout);
     MOCKABLE_FUNCTION(, int, connection_get_idle_timeout, CONNECTION_HANDLE, connection, milliseconds*, idle_timeout);
     MOCKABLE_FUNCTION(, int, connection_get_remote_max_frame_size, CONNECTION_HANDLE, connection, uint32_t*, remote_max_frame_size);
+    MOCKABLE_FUNCTION(, int, connection_set_output_buffer_size, CONNECTION_HANDLE, connection, size_t, output_high_watermark);
+    MOCKABLE_FUNCTION(, int, connection_set_send_watermarks, CONNECTION_HANDLE, connection, size_t, high_watermark, size_t, low_watermark);
+    MOCKABLE_FUNCTION(, int, connection_cork, CONNECTION_HANDLE, connection);
+    MOCKABLE_FUNCTION(, int, connection_uncork, CONNECTION_HANDLE, connection);
+    MOCKABLE_FUNCTION(, int, connection_request_dowork, CONNECTION_HANDLE, connection);
+    MOCKABLE_FUNCTION(, bool, connection_is_dowork_requested, CONNECTION_HANDLE, connection);
     MOCKABLE_FUNCTION(, uint64_t, connection_handle_deadlines, CONNECTION_HANDLE, connection);
     MOCKABLE_FUNCTION(, void, connection_dowork, CONNECTION_HANDLE, connection);
     MOCKABLE_FUNCTION(, ENDPOINT_HANDLE, connection_create_endpoint, CONNECTION_HANDLE, connection);
     MOCKABLE_FUNCTION(, int, connection_start_endpoint, ENDPOINT_HANDLE, endpoint, ON_ENDPOINT_FRAME_RECEIVED, on_frame_received, ON_CONNECTION_STATE_CHANGED, on_connection_state_changed, void*, context);
+    MOCKABLE_FUNCTION(, int, connection_endpoint_set_on_dowork, ENDPOINT_HANDLE, endpoint, ON_ENDPOINT_DOWORK, on_endpoint_dowork);
+    MOCKABLE_FUNCTION(, int, connection_endpoint_set_on_send_blocked_changed, ENDPOINT_HANDLE, endpoint, ON_ENDPOINT_SEND_BLOCKED_CHANGED, on_endpoint_send_blocked_changed);
     MOCKABLE_FUNCTION(, int, connection_endpoint_get_incoming_channel, ENDPOINT_HANDLE, endpoint, uint16_t*, incoming_channel);
     MOCKABLE_FUNCTION(, void, connection_destroy_endpoint, ENDPOINT_HANDLE, endpoint);
     MOCKABLE_FUNCTION(, int, connection_encode_frame, ENDPOINT_HANDLE, endpoint, const AMQP_VALUE, performative, PAYLOAD*, payloads, size_t, payload_count, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
+    MOCKABLE_FUNCTION(, int, connection_encode_preencoded_frame, ENDPOINT_HANDLE, endpoint, const PAYLOAD*, payloads, size_t, payload_count, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
     MOCKABLE_FUNCTION(, void, connection_set_trace, CONNECTION_HANDLE, connection, bool, traceOn);
 
 #ifdef __cplusplus
@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/socket_listener.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+    typedef struct EVENT_LOOP_INSTANCE_TAG* EVENT_LOOP_HANDLE;
+    typedef void(*ON_EVENT_LOOP_IO_READY)(void* context);
+
+    MOCKABLE_FUNCTION(, EVENT_LOOP_HANDLE, event_loop_create);
+    MOCKABLE_FUNCTION(, void, event_loop_destroy, EVENT_LOOP_HANDLE, event_loop);
+    MOCKABLE_FUNCTION(, int, event_loop_add_connection, EVENT_LOOP_HANDLE, event_loop, CONNECTION_HANDLE, connection, int, socket);
+    MOCKABLE_FUNCTION(, int, event_loop_remove_connection, EVENT_LOOP_HANDLE, event_loop, CONNECTION_HANDLE, connection);
+    MOCKABLE_FUNCTION(, int, event_loop_add_socket_listener, EVENT_LOOP_HANDLE, event_loop, SOCKET_LISTENER_HANDLE, socket_listener);
+    MOCKABLE_FUNCTION(, int, event_loop_remove_socket_listener, EVENT_LOOP_HANDLE, event_loop, SOCKET_LISTENER_HANDLE, socket_listener);
+    MOCKABLE_FUNCTION(, int, event_loop_add_io, EVENT_LOOP_HANDLE, event_loop, int, fd, ON_EVENT_LOOP_IO_READY, on_io_ready, void*, context);
+    MOCKABLE_FUNCTION(, int, event_loop_remove_io, EVENT_LOOP_HANDLE, event_loop, int, fd);
+    MOCKABLE_FUNCTION(, int, event_loop_set_max_wait, EVENT_LOOP_HANDLE, event_loop, uint64_t, max_wait_ms);
+    MOCKABLE_FUNCTION(, int, event_loop_run_once, EVENT_LOOP_HANDLE, event_loop);
+    MOCKABLE_FUNCTION(, int, event_loop_run, EVENT_LOOP_HANDLE, event_loop);
+    MOCKABLE_FUNCTION(, int, event_loop_stop, EVENT_LOOP_HANDLE, event_loop);
+    MOCKABLE_FUNCTION(, int, event_loop_wake, EVENT_LOOP_HANDLE, event_loop);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* EVENT_LOOP_H */
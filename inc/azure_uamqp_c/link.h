@@ -32,10 +32,19 @@ typedef enum LINK_TRANSFER_RESULT_TAG
 	LINK_TRANSFER_BUSY
 } LINK_TRANSFER_RESULT;
 
+typedef enum LINK_CREDIT_MODE_TAG
+{
+	LINK_CREDIT_MODE_FIXED,
+	LINK_CREDIT_MODE_ADAPTIVE
+} LINK_CREDIT_MODE;
+
 typedef void(*ON_DELIVERY_SETTLED)(void* context, delivery_number delivery_no, AMQP_VALUE delivery_state);
 typedef AMQP_VALUE(*ON_TRANSFER_RECEIVED)(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes);
+typedef AMQP_VALUE(*ON_TRANSFER_SEGMENTS_RECEIVED)(void* context, TRANSFER_HANDLE transfer, const PAYLOAD* segments, size_t segment_count);
+typedef AMQP_VALUE(*ON_TRANSFER_FRAME_RECEIVED)(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes, bool more);
 typedef void(*ON_LINK_STATE_CHANGED)(void* context, LINK_STATE new_link_state, LINK_STATE previous_link_state);
 typedef void(*ON_LINK_FLOW_ON)(void* context);
+typedef void(*ON_LINK_DOWORK)(void* context);
 
 MOCKABLE_FUNCTION(, LINK_HANDLE, link_create, SESSION_HANDLE, session, const char*, name, role, role, AMQP_VALUE, source, AMQP_VALUE, target);
 MOCKABLE_FUNCTION(, LINK_HANDLE, link_create_from_endpoint, SESSION_HANDLE, session, LINK_ENDPOINT_HANDLE, link_endpoint, const char*, name, role, role, AMQP_VALUE, source, AMQP_VALUE, target);
@@ -48,6 +57,16 @@ MOCKABLE_FUNCTION(, int,  link_set_initial_delivery_count, LINK_HANDLE, link, se
 MOCKABLE_FUNCTION(, int,  link_get_initial_delivery_count, LINK_HANDLE, link, sequence_no*, initial_delivery_count);
 MOCKABLE_FUNCTION(, int,  link_set_max_message_size, LINK_HANDLE, link, uint64_t, max_message_size);
 MOCKABLE_FUNCTION(, int,  link_get_max_message_size, LINK_HANDLE, link, uint64_t*, max_message_size);
+MOCKABLE_FUNCTION(, int,  link_set_max_link_credit, LINK_HANDLE, link, uint32_t, max_link_credit);
+MOCKABLE_FUNCTION(, int,  link_get_max_link_credit, LINK_HANDLE, link, uint32_t*, max_link_credit);
+MOCKABLE_FUNCTION(, int,  link_set_link_credit_refill_threshold, LINK_HANDLE, link, uint32_t, refill_threshold);
+MOCKABLE_FUNCTION(, int,  link_set_link_credit_mode, LINK_HANDLE, link, LINK_CREDIT_MODE, link_credit_mode);
+MOCKABLE_FUNCTION(, int,  link_set_max_disposition_batch_size, LINK_HANDLE, link, uint32_t, max_disposition_batch_size);
+MOCKABLE_FUNCTION(, int,  link_set_disposition_batch_timeout, LINK_HANDLE, link, milliseconds, disposition_batch_timeout);
+MOCKABLE_FUNCTION(, int,  link_set_on_transfer_segments_received, LINK_HANDLE, link, ON_TRANSFER_SEGMENTS_RECEIVED, on_transfer_segments_received);
+MOCKABLE_FUNCTION(, int,  link_set_on_transfer_frame_received, LINK_HANDLE, link, ON_TRANSFER_FRAME_RECEIVED, on_transfer_frame_received);
+MOCKABLE_FUNCTION(, int,  link_set_on_dowork, LINK_HANDLE, link, ON_LINK_DOWORK, on_link_dowork);
+MOCKABLE_FUNCTION(, int,  link_request_dowork, LINK_HANDLE, link);
 MOCKABLE_FUNCTION(, int,  link_set_attach_properties, LINK_HANDLE, link, fields, attach_properties);
 MOCKABLE_FUNCTION(, int,  link_get_name, LINK_HANDLE, link, const char**, link_name);
 MOCKABLE_FUNCTION(, int,  link_get_received_message_id, LINK_HANDLE, link, delivery_number*, message_id);
@@ -55,6 +74,8 @@ MOCKABLE_FUNCTION(, int,  link_send_disposition, LINK_HANDLE, link, delivery_num
 MOCKABLE_FUNCTION(, int,  link_attach, LINK_HANDLE, link, ON_TRANSFER_RECEIVED, on_transfer_received, ON_LINK_STATE_CHANGED, on_link_state_changed, ON_LINK_FLOW_ON, on_link_flow_on, void*, callback_context);
 MOCKABLE_FUNCTION(, int,  link_detach, LINK_HANDLE, link, bool, close);
 MOCKABLE_FUNCTION(, LINK_TRANSFER_RESULT, link_transfer, LINK_HANDLE, handle, message_format, message_format, PAYLOAD*, payloads, size_t, payload_count, ON_DELIVERY_SETTLED, on_delivery_settled, void*, callback_context);
+MOCKABLE_FUNCTION(, LINK_TRANSFER_RESULT, link_transfer_chunk, LINK_HANDLE, link, message_format, message_format, PAYLOAD*, payloads, size_t, payload_count, bool, more, ON_DELIVERY_SETTLED, on_delivery_settled, void*, callback_context, ON_SEND_COMPLETE, on_chunk_sent, void*, on_chunk_sent_context);
+MOCKABLE_FUNCTION(, int,  link_abort_chunked_transfer, LINK_HANDLE, link);
 
 #ifdef __cplusplus
 }
@@ -25,6 +25,11 @@ extern "C" {
 	} MESSAGE_BODY_TYPE;
 
 	typedef struct MESSAGE_INSTANCE_TAG* MESSAGE_HANDLE;
+	typedef struct MESSAGE_ENCODED_INSTANCE_TAG* MESSAGE_ENCODED_HANDLE;
+	typedef struct MESSAGE_TEMPLATE_INSTANCE_TAG* MESSAGE_TEMPLATE_HANDLE;
+
+#define MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID		0x01
+#define MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME	0x02
 	typedef struct BINARY_DATA_TAG
 	{
 		const unsigned char* bytes;
@@ -34,6 +39,8 @@ extern "C" {
 	MOCKABLE_FUNCTION(, MESSAGE_HANDLE, message_create);
 	MOCKABLE_FUNCTION(, MESSAGE_HANDLE, message_clone, MESSAGE_HANDLE, source_message);
 	MOCKABLE_FUNCTION(, void, message_destroy, MESSAGE_HANDLE, message);
+	MOCKABLE_FUNCTION(, int, message_reset, MESSAGE_HANDLE, message);
+	MOCKABLE_FUNCTION(, int, message_set_lazy_payload, MESSAGE_HANDLE, message, const unsigned char*, payload_bytes, size_t, payload_size);
 	MOCKABLE_FUNCTION(, int, message_set_header, MESSAGE_HANDLE, message, HEADER_HANDLE, message_header);
 	MOCKABLE_FUNCTION(, int, message_get_header, MESSAGE_HANDLE, message, HEADER_HANDLE*, message_header);
 	MOCKABLE_FUNCTION(, int, message_set_delivery_annotations, MESSAGE_HANDLE, message, annotations, delivery_annotations);
@@ -47,6 +54,8 @@ extern "C" {
 	MOCKABLE_FUNCTION(, int, message_set_footer, MESSAGE_HANDLE, message, annotations, footer);
 	MOCKABLE_FUNCTION(, int, message_get_footer, MESSAGE_HANDLE, message, annotations*, footer);
 	MOCKABLE_FUNCTION(, int, message_add_body_amqp_data, MESSAGE_HANDLE, message, BINARY_DATA, binary_data);
+	MOCKABLE_FUNCTION(, int, message_add_body_amqp_data_borrowed, MESSAGE_HANDLE, message, BINARY_DATA, binary_data);
+	MOCKABLE_FUNCTION(, int, message_retain_body_amqp_data, MESSAGE_HANDLE, message);
 	MOCKABLE_FUNCTION(, int, message_get_body_amqp_data, MESSAGE_HANDLE, message, size_t, index, BINARY_DATA*, binary_data);
 	MOCKABLE_FUNCTION(, int, message_get_body_amqp_data_count, MESSAGE_HANDLE, message, size_t*, count);
 	MOCKABLE_FUNCTION(, int, message_set_body_amqp_value, MESSAGE_HANDLE, message, AMQP_VALUE, body_amqp_value);
@@ -57,6 +66,15 @@ extern "C" {
 	MOCKABLE_FUNCTION(, int, message_get_body_amqp_sequence_count, MESSAGE_HANDLE, message, size_t*, count);
     MOCKABLE_FUNCTION(, int, message_set_message_format, MESSAGE_HANDLE, message, uint32_t, message_format);
     MOCKABLE_FUNCTION(, int, message_get_message_format, MESSAGE_HANDLE, message, uint32_t*, message_format);
+    MOCKABLE_FUNCTION(, MESSAGE_ENCODED_HANDLE, message_encode, MESSAGE_HANDLE, message);
+    MOCKABLE_FUNCTION(, int, message_encode_append, MESSAGE_HANDLE, message, unsigned char**, buffer, size_t*, buffer_size, size_t*, buffer_length);
+    MOCKABLE_FUNCTION(, MESSAGE_ENCODED_HANDLE, message_encoded_clone, MESSAGE_ENCODED_HANDLE, message_encoded);
+    MOCKABLE_FUNCTION(, void, message_encoded_destroy, MESSAGE_ENCODED_HANDLE, message_encoded);
+    MOCKABLE_FUNCTION(, int, message_encoded_get_bytes, MESSAGE_ENCODED_HANDLE, message_encoded, const unsigned char**, bytes, size_t*, length);
+    MOCKABLE_FUNCTION(, int, message_encoded_get_message_format, MESSAGE_ENCODED_HANDLE, message_encoded, uint32_t*, message_format);
+    MOCKABLE_FUNCTION(, MESSAGE_TEMPLATE_HANDLE, message_template_create, MESSAGE_HANDLE, message, unsigned int, variable_fields);
+    MOCKABLE_FUNCTION(, void, message_template_destroy, MESSAGE_TEMPLATE_HANDLE, message_template);
+    MOCKABLE_FUNCTION(, MESSAGE_ENCODED_HANDLE, message_template_encode, MESSAGE_TEMPLATE_HANDLE, message_template, uint64_t, message_id, timestamp, creation_time, const BINARY_DATA*, body_data_items, size_t, body_data_count);
 
 #ifdef __cplusplus
 }
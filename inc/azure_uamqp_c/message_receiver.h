@@ -25,6 +25,8 @@ extern "C" {
 
 	typedef struct MESSAGE_RECEIVER_INSTANCE_TAG* MESSAGE_RECEIVER_HANDLE;
 	typedef AMQP_VALUE (*ON_MESSAGE_RECEIVED)(const void* context, MESSAGE_HANDLE message);
+	typedef void(*ON_MESSAGE_SECTIONS_RECEIVED)(const void* context, MESSAGE_HANDLE message);
+	typedef void(*ON_MESSAGE_BODY_CHUNK_RECEIVED)(const void* context, const unsigned char* bytes, size_t length);
 	typedef void(*ON_MESSAGE_RECEIVER_STATE_CHANGED)(const void* context, MESSAGE_RECEIVER_STATE new_state, MESSAGE_RECEIVER_STATE previous_state);
 
 	MOCKABLE_FUNCTION(, MESSAGE_RECEIVER_HANDLE, messagereceiver_create, LINK_HANDLE, link, ON_MESSAGE_RECEIVER_STATE_CHANGED, on_message_receiver_state_changed, void*, context);
@@ -34,6 +36,8 @@ extern "C" {
     MOCKABLE_FUNCTION(, int, messagereceiver_get_link_name, MESSAGE_RECEIVER_HANDLE, message_receiver, const char**, link_name);
     MOCKABLE_FUNCTION(, int, messagereceiver_get_received_message_id, MESSAGE_RECEIVER_HANDLE, message_receiver, delivery_number*, message_number);
     MOCKABLE_FUNCTION(, int, messagereceiver_send_message_disposition, MESSAGE_RECEIVER_HANDLE, message_receiver, const char*, link_name, delivery_number, message_number, AMQP_VALUE, delivery_state);
+    MOCKABLE_FUNCTION(, int, messagereceiver_set_lazy_decode, MESSAGE_RECEIVER_HANDLE, message_receiver, bool, lazy_decode);
+    MOCKABLE_FUNCTION(, int, messagereceiver_set_streaming, MESSAGE_RECEIVER_HANDLE, message_receiver, ON_MESSAGE_SECTIONS_RECEIVED, on_message_sections_received, ON_MESSAGE_BODY_CHUNK_RECEIVED, on_message_body_chunk_received);
 
 #ifdef __cplusplus
 }
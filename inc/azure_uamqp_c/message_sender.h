@@ -30,15 +30,34 @@ extern "C" {
         MESSAGE_SENDER_STATE_ERROR
     } MESSAGE_SENDER_STATE;
 
+    typedef enum MESSAGE_ENQUEUE_RESULT_TAG
+    {
+        MESSAGE_ENQUEUE_OK,
+        MESSAGE_ENQUEUE_FULL,
+        MESSAGE_ENQUEUE_ERROR
+    } MESSAGE_ENQUEUE_RESULT;
+
     typedef struct MESSAGE_SENDER_INSTANCE_TAG* MESSAGE_SENDER_HANDLE;
     typedef void(*ON_MESSAGE_SEND_COMPLETE)(void* context, MESSAGE_SEND_RESULT send_result);
+    typedef void(*ON_MESSAGE_BATCH_SEND_COMPLETE)(void* context, const MESSAGE_SEND_RESULT* send_results, size_t message_count);
+    typedef int(*ON_MESSAGE_BODY_CHUNK_REQUESTED)(void* context, unsigned char* buffer, size_t buffer_size, size_t* bytes_written, bool* is_last_chunk);
     typedef void(*ON_MESSAGE_SENDER_STATE_CHANGED)(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state);
+    typedef void(*ON_MESSAGE_SENDER_WORK_QUEUED)(void* context);
+    typedef void(*MESSAGE_SENDER_COMPLETION_EXECUTOR)(void* executor_context, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context, MESSAGE_SEND_RESULT send_result);
 
     MOCKABLE_FUNCTION(, MESSAGE_SENDER_HANDLE, messagesender_create, LINK_HANDLE, link, ON_MESSAGE_SENDER_STATE_CHANGED, on_message_sender_state_changed, void*, context);
     MOCKABLE_FUNCTION(, void, messagesender_destroy, MESSAGE_SENDER_HANDLE, message_sender);
     MOCKABLE_FUNCTION(, int, messagesender_open, MESSAGE_SENDER_HANDLE, message_sender);
     MOCKABLE_FUNCTION(, int, messagesender_close, MESSAGE_SENDER_HANDLE, message_sender);
     MOCKABLE_FUNCTION(, int, messagesender_send, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+    MOCKABLE_FUNCTION(, int, messagesender_send_encoded, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_ENCODED_HANDLE, message_encoded, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+    MOCKABLE_FUNCTION(, int, messagesender_send_batch, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE*, messages, size_t, message_count, ON_MESSAGE_BATCH_SEND_COMPLETE, on_message_batch_send_complete, void*, callback_context);
+    MOCKABLE_FUNCTION(, int, messagesender_send_streamed, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message, ON_MESSAGE_BODY_CHUNK_REQUESTED, on_message_body_chunk_requested, void*, body_context, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+    MOCKABLE_FUNCTION(, int, messagesender_set_max_stream_chunk_size, MESSAGE_SENDER_HANDLE, message_sender, size_t, max_stream_chunk_size);
+    MOCKABLE_FUNCTION(, int, messagesender_enable_send_queue, MESSAGE_SENDER_HANDLE, message_sender, size_t, capacity, ON_MESSAGE_SENDER_WORK_QUEUED, on_work_queued, void*, on_work_queued_context);
+    MOCKABLE_FUNCTION(, int, messagesender_set_completion_executor, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_SENDER_COMPLETION_EXECUTOR, executor, void*, executor_context);
+    MOCKABLE_FUNCTION(, MESSAGE_ENQUEUE_RESULT, messagesender_enqueue, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+    MOCKABLE_FUNCTION(, int, messagesender_drain_send_queue, MESSAGE_SENDER_HANDLE, message_sender);
     MOCKABLE_FUNCTION(, void, messagesender_set_trace, MESSAGE_SENDER_HANDLE, message_sender, bool, traceOn);
 
 #ifdef __cplusplus
@@ -12,6 +12,17 @@ extern "C" {
 
 #include "azure_c_shared_utility/umock_c_prod.h"
 
+/* Listener options, set before socketlistener_start */
+#define SOCKET_LISTENER_OPTION_BACKLOG "backlog"
+#define SOCKET_LISTENER_OPTION_IPV6 "ipv6"
+#define SOCKET_LISTENER_OPTION_IPV6_ONLY "ipv6_only"
+#define SOCKET_LISTENER_OPTION_REUSE_PORT "reuse_port"
+#define SOCKET_LISTENER_OPTION_MAX_ACCEPTS_PER_DOWORK "max_accepts_per_dowork"
+/* Applied to every accepted socket */
+#define SOCKET_LISTENER_OPTION_TCP_NODELAY "tcp_nodelay"
+#define SOCKET_LISTENER_OPTION_SEND_BUFFER_SIZE "send_buffer_size"
+#define SOCKET_LISTENER_OPTION_RECEIVE_BUFFER_SIZE "receive_buffer_size"
+
 	typedef struct SOCKET_LISTENER_INSTANCE_TAG* SOCKET_LISTENER_HANDLE;
 	typedef void(*ON_SOCKET_ACCEPTED)(void* context, XIO_HANDLE socket_io);
 
@@ -20,6 +31,9 @@ extern "C" {
 	MOCKABLE_FUNCTION(, int, socketlistener_start, SOCKET_LISTENER_HANDLE, socket_listener, ON_SOCKET_ACCEPTED, on_socket_accepted, void*, callback_context);
 	MOCKABLE_FUNCTION(, int, socketlistener_stop, SOCKET_LISTENER_HANDLE, socket_listener);
 	MOCKABLE_FUNCTION(, void, socketlistener_dowork, SOCKET_LISTENER_HANDLE, socket_listener);
+	MOCKABLE_FUNCTION(, int, socketlistener_setoption, SOCKET_LISTENER_HANDLE, socket_listener, const char*, optionName, const void*, value);
+	MOCKABLE_FUNCTION(, int, socketlistener_get_socket, SOCKET_LISTENER_HANDLE, socket_listener, int*, listening_socket);
+	MOCKABLE_FUNCTION(, int, socketlistener_get_accepted_socket, SOCKET_LISTENER_HANDLE, socket_listener, int*, accepted_socket);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+    typedef struct TIMER_WHEEL_INSTANCE_TAG* TIMER_WHEEL_HANDLE;
+    typedef struct TIMER_WHEEL_TIMER_INSTANCE_TAG* TIMER_WHEEL_TIMER_HANDLE;
+    typedef void(*ON_TIMER_EXPIRED)(void* context);
+
+    MOCKABLE_FUNCTION(, TIMER_WHEEL_HANDLE, timer_wheel_create, uint64_t, current_ms);
+    MOCKABLE_FUNCTION(, void, timer_wheel_destroy, TIMER_WHEEL_HANDLE, timer_wheel);
+    MOCKABLE_FUNCTION(, TIMER_WHEEL_TIMER_HANDLE, timer_wheel_create_timer, TIMER_WHEEL_HANDLE, timer_wheel, ON_TIMER_EXPIRED, on_timer_expired, void*, context);
+    MOCKABLE_FUNCTION(, void, timer_wheel_destroy_timer, TIMER_WHEEL_TIMER_HANDLE, timer);
+    MOCKABLE_FUNCTION(, int, timer_wheel_schedule, TIMER_WHEEL_TIMER_HANDLE, timer, uint64_t, deadline_ms);
+    MOCKABLE_FUNCTION(, int, timer_wheel_cancel, TIMER_WHEEL_TIMER_HANDLE, timer);
+    MOCKABLE_FUNCTION(, int, timer_wheel_get_next_expiry, TIMER_WHEEL_HANDLE, timer_wheel, uint64_t*, next_expiry_ms);
+    MOCKABLE_FUNCTION(, int, timer_wheel_advance, TIMER_WHEEL_HANDLE, timer_wheel, uint64_t, current_ms);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* TIMER_WHEEL_H */
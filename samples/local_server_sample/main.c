@@ -15,6 +15,9 @@
 #include "azure_uamqp_c/connection.h"
 #include "azure_uamqp_c/session.h"
 #include "azure_uamqp_c/link.h"
+#ifdef __linux__
+#include "azure_uamqp_c/event_loop.h"
+#endif
 
 static unsigned int sent_messages = 0;
 static const size_t msg_count = 1;
@@ -22,6 +25,10 @@ static CONNECTION_HANDLE connection;
 static SESSION_HANDLE session;
 static LINK_HANDLE link;
 static MESSAGE_RECEIVER_HANDLE message_receiver;
+static SOCKET_LISTENER_HANDLE socket_listener;
+#ifdef __linux__
+static EVENT_LOOP_HANDLE event_loop;
+#endif
 
 static void on_message_receiver_state_changed(const void* context, MESSAGE_RECEIVER_STATE new_state, MESSAGE_RECEIVER_STATE previous_state)
 {
@@ -65,6 +72,19 @@ static void on_socket_accepted(void* context, XIO_HANDLE io)
 	XIO_HANDLE header_detect_io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config);
 	connection = connection_create(header_detect_io, NULL, "1", on_new_session_endpoint, NULL);
 	connection_listen(connection);
+
+#ifdef __linux__
+	{
+		int accepted_socket;
+
+		/* the connection is only worked on when its socket is ready or one of its deadlines is due */
+		if ((socketlistener_get_accepted_socket(socket_listener, &accepted_socket) != 0) ||
+			(event_loop_add_connection(event_loop, connection, accepted_socket) != 0))
+		{
+			printf("Cannot add the connection to the event loop\r\n");
+		}
+	}
+#endif
 }
 
 int main(int argc, char** argv)
@@ -79,17 +99,31 @@ int main(int argc, char** argv)
 	}
 	else
 	{
-		size_t last_memory_used = 0;
-
         gballoc_init();
 
-		SOCKET_LISTENER_HANDLE socket_listener = socketlistener_create(5672);
+		socket_listener = socketlistener_create(5672);
 		if (socketlistener_start(socket_listener, on_socket_accepted, NULL) != 0)
 		{
 			result = -1;
 		}
+#ifdef __linux__
+		else if (((event_loop = event_loop_create()) == NULL) ||
+			(event_loop_add_socket_listener(event_loop, socket_listener) != 0))
+		{
+			result = -1;
+		}
 		else
 		{
+			/* sleeps until the listener or the connection has something to do */
+			result = event_loop_run(event_loop);
+		}
+
+		event_loop_destroy(event_loop);
+#else
+		else
+		{
+			size_t last_memory_used = 0;
+
 			while (true)
 			{
 				size_t current_memory_used;
@@ -118,6 +152,7 @@ int main(int argc, char** argv)
 
 			result = 0;
 		}
+#endif
 
 		socketlistener_destroy(socket_listener);
 		platform_deinit();
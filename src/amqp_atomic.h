@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef AMQP_ATOMIC_H
+#define AMQP_ATOMIC_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+/* Minimal atomic operations on size_t and int shared between threads, Interlocked* on MSVC and the __atomic builtins elsewhere */
+
+#ifdef _MSC_VER
+
+#include <windows.h>
+
+#define AMQP_ATOMIC_INLINE __inline
+
+#ifdef _WIN64
+#define AMQP_INTERLOCKED_SIZE_COMPARE_EXCHANGE(target, exchange, comparand) (size_t)InterlockedCompareExchange64((volatile LONG64*)(target), (LONG64)(exchange), (LONG64)(comparand))
+#define AMQP_INTERLOCKED_SIZE_EXCHANGE(target, value) (size_t)InterlockedExchange64((volatile LONG64*)(target), (LONG64)(value))
+#define AMQP_INTERLOCKED_SIZE_INCREMENT(target) (size_t)InterlockedIncrement64((volatile LONG64*)(target))
+#define AMQP_INTERLOCKED_SIZE_DECREMENT(target) (size_t)InterlockedDecrement64((volatile LONG64*)(target))
+#else
+#define AMQP_INTERLOCKED_SIZE_COMPARE_EXCHANGE(target, exchange, comparand) (size_t)InterlockedCompareExchange((volatile LONG*)(target), (LONG)(exchange), (LONG)(comparand))
+#define AMQP_INTERLOCKED_SIZE_EXCHANGE(target, value) (size_t)InterlockedExchange((volatile LONG*)(target), (LONG)(value))
+#define AMQP_INTERLOCKED_SIZE_INCREMENT(target) (size_t)InterlockedIncrement((volatile LONG*)(target))
+#define AMQP_INTERLOCKED_SIZE_DECREMENT(target) (size_t)InterlockedDecrement((volatile LONG*)(target))
+#endif
+
+static AMQP_ATOMIC_INLINE size_t amqp_atomic_load_size(volatile size_t* target)
+{
+    /* a compare exchange that never matches is a full barrier read */
+    return AMQP_INTERLOCKED_SIZE_COMPARE_EXCHANGE(target, 0, 0);
+}
+
+static AMQP_ATOMIC_INLINE void amqp_atomic_store_size(volatile size_t* target, size_t value)
+{
+    (void)AMQP_INTERLOCKED_SIZE_EXCHANGE(target, value);
+}
+
+static AMQP_ATOMIC_INLINE bool amqp_atomic_compare_exchange_size(volatile size_t* target, size_t* expected, size_t desired)
+{
+    size_t previous = AMQP_INTERLOCKED_SIZE_COMPARE_EXCHANGE(target, desired, *expected);
+    bool result = (previous == *expected);
+    *expected = previous;
+    return result;
+}
+
+static AMQP_ATOMIC_INLINE size_t amqp_atomic_increment_size(volatile size_t* target)
+{
+    return AMQP_INTERLOCKED_SIZE_INCREMENT(target);
+}
+
+static AMQP_ATOMIC_INLINE size_t amqp_atomic_decrement_size(volatile size_t* target)
+{
+    return AMQP_INTERLOCKED_SIZE_DECREMENT(target);
+}
+
+static AMQP_ATOMIC_INLINE int amqp_atomic_load_int(volatile int* target)
+{
+    return (int)InterlockedCompareExchange((volatile LONG*)target, 0, 0);
+}
+
+static AMQP_ATOMIC_INLINE void amqp_atomic_store_int(volatile int* target, int value)
+{
+    (void)InterlockedExchange((volatile LONG*)target, (LONG)value);
+}
+
+static AMQP_ATOMIC_INLINE int amqp_atomic_exchange_int(volatile int* target, int value)
+{
+    return (int)InterlockedExchange((volatile LONG*)target, (LONG)value);
+}
+
+#else
+
+#define AMQP_ATOMIC_INLINE inline
+
+static AMQP_ATOMIC_INLINE size_t amqp_atomic_load_size(volatile size_t* target)
+{
+    return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+static AMQP_ATOMIC_INLINE void amqp_atomic_store_size(volatile size_t* target, size_t value)
+{
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+}
+
+static AMQP_ATOMIC_INLINE bool amqp_atomic_compare_exchange_size(volatile size_t* target, size_t* expected, size_t desired)
+{
+    /* on failure expected receives the current value */
+    return __atomic_compare_exchange_n(target, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static AMQP_ATOMIC_INLINE size_t amqp_atomic_increment_size(volatile size_t* target)
+{
+    return __atomic_add_fetch(target, 1, __ATOMIC_ACQ_REL);
+}
+
+static AMQP_ATOMIC_INLINE size_t amqp_atomic_decrement_size(volatile size_t* target)
+{
+    return __atomic_sub_fetch(target, 1, __ATOMIC_ACQ_REL);
+}
+
+static AMQP_ATOMIC_INLINE int amqp_atomic_load_int(volatile int* target)
+{
+    return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+}
+
+static AMQP_ATOMIC_INLINE void amqp_atomic_store_int(volatile int* target, int value)
+{
+    __atomic_store_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+static AMQP_ATOMIC_INLINE int amqp_atomic_exchange_int(volatile int* target, int value)
+{
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+#endif /* _MSC_VER */
+
+#endif /* AMQP_ATOMIC_H */
@@ -298,6 +298,40 @@ int amqp_frame_codec_encode_frame(AMQP_FRAME_CODEC_HANDLE amqp_frame_codec, uint
 	return result;
 }
 
+/* payloads[0] carries an already encoded performative, which lets callers that send the same performative
+   over and over (such as the continuation transfers of a multi-frame delivery) encode it only once */
+int amqp_frame_codec_encode_preencoded_frame(AMQP_FRAME_CODEC_HANDLE amqp_frame_codec, uint16_t channel, const PAYLOAD* payloads, size_t payload_count, ON_BYTES_ENCODED on_bytes_encoded, void* callback_context)
+{
+	int result;
+
+	if ((amqp_frame_codec == NULL) ||
+		(payloads == NULL) ||
+		(payload_count == 0) ||
+		(payloads[0].length == 0) ||
+		(on_bytes_encoded == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		unsigned char channel_bytes[2];
+
+		channel_bytes[0] = channel >> 8;
+		channel_bytes[1] = channel & 0xFF;
+
+		if (frame_codec_encode_frame(amqp_frame_codec->frame_codec, FRAME_TYPE_AMQP, payloads, payload_count, channel_bytes, sizeof(channel_bytes), on_bytes_encoded, callback_context) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
 /* Codes_SRS_AMQP_FRAME_CODEC_01_042: [amqp_frame_codec_encode_empty_frame shall encode a frame with no payload.] */
 /* Codes_SRS_AMQP_FRAME_CODEC_01_010: [An AMQP frame with no body MAY be used to generate artificial traffic as needed to satisfy any negotiated idle timeout interval ] */
 int amqp_frame_codec_encode_empty_frame(AMQP_FRAME_CODEC_HANDLE amqp_frame_codec, uint16_t channel, ON_BYTES_ENCODED on_bytes_encoded, void* callback_context)
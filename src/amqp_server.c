@@ -0,0 +1,1093 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_uamqp_c/amqp_server.h"
+#include "azure_uamqp_c/socket_listener.h"
+#include "azure_uamqp_c/header_detect_io.h"
+
+#define DEFAULT_SESSION_INCOMING_WINDOW 10000
+
+struct SERVER_CONNECTION_TAG;
+struct SERVER_SHARD_TAG;
+
+typedef struct SERVER_SESSION_TAG
+{
+    struct SERVER_CONNECTION_TAG* server_connection;
+    SESSION_HANDLE session;
+} SERVER_SESSION;
+
+typedef struct SERVER_CONNECTION_TAG
+{
+    struct SERVER_SHARD_TAG* shard;
+    XIO_HANDLE header_detect_io;
+    CONNECTION_HANDLE connection;
+    SERVER_SESSION** sessions;
+    size_t session_count;
+    size_t index;
+    bool is_in_event_loop;
+    bool is_closing;
+    struct SERVER_CONNECTION_TAG* next_closing;
+} SERVER_CONNECTION;
+
+typedef enum SERVER_COMMAND_TYPE_TAG
+{
+    SERVER_COMMAND_TYPE_ACCEPT,
+    SERVER_COMMAND_TYPE_USER
+} SERVER_COMMAND_TYPE;
+
+typedef struct SERVER_COMMAND_TAG
+{
+    SERVER_COMMAND_TYPE type;
+    XIO_HANDLE socket_io;
+    int socket;
+    ON_AMQP_SERVER_COMMAND on_command;
+    void* context;
+    struct SERVER_COMMAND_TAG* next;
+} SERVER_COMMAND;
+
+typedef struct SERVER_SHARD_TAG
+{
+    struct AMQP_SERVER_INSTANCE_TAG* amqp_server;
+    size_t index;
+    EVENT_LOOP_HANDLE event_loop;
+    THREAD_HANDLE thread;
+    int command_fd;
+    /* pushed to by any thread, only ever taken as a whole by the shard itself */
+    SERVER_COMMAND* pending_commands;
+    SERVER_CONNECTION** connections;
+    size_t connection_count;
+    size_t connection_capacity;
+    /* connections cannot be destroyed from their own callbacks, they are reaped once the dispatch pass is over */
+    SERVER_CONNECTION* closing_connections;
+} SERVER_SHARD;
+
+typedef struct AMQP_SERVER_INSTANCE_TAG
+{
+    SOCKET_LISTENER_HANDLE socket_listener;
+    char* container_id;
+    ON_AMQP_SERVER_LINK_ATTACHED on_link_attached;
+    ON_AMQP_SERVER_CONNECTION_CLOSED on_connection_closed;
+    void* callback_context;
+    /* shard 0 owns the listener and is run by the caller of amqp_server_run, the others each have a worker thread */
+    SERVER_SHARD** shards;
+    size_t shard_count;
+    size_t connection_count;
+    size_t max_connections;
+    uint32_t session_incoming_window;
+    size_t output_buffer_size;
+    bool is_started;
+    int stop_requested;
+    int is_shutting_down;
+} AMQP_SERVER_INSTANCE;
+
+static __thread SERVER_SHARD* current_shard;
+
+static void destroy_server_connection(SERVER_CONNECTION* server_connection)
+{
+    SERVER_SHARD* shard = server_connection->shard;
+    AMQP_SERVER_INSTANCE* amqp_server_instance = shard->amqp_server;
+    size_t i;
+
+    /* closing the connection below reports a state change that must not schedule it again */
+    server_connection->is_closing = true;
+
+    if (server_connection->is_in_event_loop)
+    {
+        (void)event_loop_remove_connection(shard->event_loop, server_connection->connection);
+
+        if (amqp_server_instance->on_connection_closed != NULL)
+        {
+            amqp_server_instance->on_connection_closed(amqp_server_instance->callback_context, server_connection->connection);
+        }
+    }
+
+    for (i = 0; i < server_connection->session_count; i++)
+    {
+        session_destroy(server_connection->sessions[i]->session);
+        free(server_connection->sessions[i]);
+    }
+
+    free(server_connection->sessions);
+    connection_destroy(server_connection->connection);
+
+    /* the header detect IO owns the accepted socket IO */
+    xio_destroy(server_connection->header_detect_io);
+    free(server_connection);
+}
+
+static void remove_server_connection(SERVER_SHARD* shard, SERVER_CONNECTION* server_connection)
+{
+    SERVER_CONNECTION* last_connection = shard->connections[shard->connection_count - 1];
+
+    last_connection->index = server_connection->index;
+    shard->connections[server_connection->index] = last_connection;
+    shard->connection_count--;
+    (void)__atomic_sub_fetch(&shard->amqp_server->connection_count, 1, __ATOMIC_RELAXED);
+}
+
+static void reap_closing_connections(SERVER_SHARD* shard)
+{
+    while (shard->closing_connections != NULL)
+    {
+        SERVER_CONNECTION* server_connection = shard->closing_connections;
+        shard->closing_connections = server_connection->next_closing;
+
+        remove_server_connection(shard, server_connection);
+        destroy_server_connection(server_connection);
+    }
+}
+
+static void schedule_close(SERVER_CONNECTION* server_connection)
+{
+    if (!server_connection->is_closing)
+    {
+        SERVER_SHARD* shard = server_connection->shard;
+
+        server_connection->is_closing = true;
+        server_connection->next_closing = shard->closing_connections;
+        shard->closing_connections = server_connection;
+    }
+}
+
+static bool on_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+    SERVER_SESSION* server_session = (SERVER_SESSION*)context;
+    AMQP_SERVER_INSTANCE* amqp_server_instance = server_session->server_connection->shard->amqp_server;
+    bool result;
+
+    if (amqp_server_instance->on_link_attached == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        result = amqp_server_instance->on_link_attached(amqp_server_instance->callback_context, server_session->server_connection->connection, server_session->session, new_link_endpoint, name, role, source, target);
+    }
+
+    return result;
+}
+
+static bool on_new_session_endpoint(void* context, ENDPOINT_HANDLE new_endpoint)
+{
+    SERVER_CONNECTION* server_connection = (SERVER_CONNECTION*)context;
+    bool result;
+    SERVER_SESSION** new_sessions = (SERVER_SESSION**)realloc(server_connection->sessions, sizeof(SERVER_SESSION*) * (server_connection->session_count + 1));
+
+    if (new_sessions == NULL)
+    {
+        LogError("Could not grow the session array");
+        result = false;
+    }
+    else
+    {
+        SERVER_SESSION* server_session;
+
+        server_connection->sessions = new_sessions;
+        server_session = (SERVER_SESSION*)malloc(sizeof(SERVER_SESSION));
+        if (server_session == NULL)
+        {
+            LogError("Could not allocate server session");
+            result = false;
+        }
+        else
+        {
+            server_session->server_connection = server_connection;
+            server_session->session = session_create_from_endpoint(server_connection->connection, new_endpoint, on_link_attached, server_session);
+            if (server_session->session == NULL)
+            {
+                LogError("Could not create session");
+                free(server_session);
+                result = false;
+            }
+            else if ((session_set_incoming_window(server_session->session, server_connection->shard->amqp_server->session_incoming_window) != 0) ||
+                (session_begin(server_session->session) != 0))
+            {
+                LogError("Could not begin session");
+                session_destroy(server_session->session);
+                free(server_session);
+                result = false;
+            }
+            else
+            {
+                server_connection->sessions[server_connection->session_count++] = server_session;
+                result = true;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void on_connection_state_changed(void* context, CONNECTION_STATE new_connection_state, CONNECTION_STATE previous_connection_state)
+{
+    (void)previous_connection_state;
+
+    if ((new_connection_state == CONNECTION_STATE_END) ||
+        (new_connection_state == CONNECTION_STATE_ERROR))
+    {
+        schedule_close((SERVER_CONNECTION*)context);
+    }
+}
+
+static void on_connection_io_error(void* context)
+{
+    schedule_close((SERVER_CONNECTION*)context);
+}
+
+static int add_server_connection(SERVER_SHARD* shard, SERVER_CONNECTION* server_connection)
+{
+    int result;
+
+    if (shard->connection_count == shard->connection_capacity)
+    {
+        size_t new_capacity = (shard->connection_capacity == 0) ? 16 : shard->connection_capacity * 2;
+        SERVER_CONNECTION** new_connections = (SERVER_CONNECTION**)realloc(shard->connections, sizeof(SERVER_CONNECTION*) * new_capacity);
+        if (new_connections != NULL)
+        {
+            shard->connections = new_connections;
+            shard->connection_capacity = new_capacity;
+        }
+    }
+
+    if (shard->connection_count == shard->connection_capacity)
+    {
+        LogError("Could not grow the connection array");
+        result = __FAILURE__;
+    }
+    else
+    {
+        server_connection->index = shard->connection_count;
+        shard->connections[shard->connection_count++] = server_connection;
+        (void)__atomic_add_fetch(&shard->amqp_server->connection_count, 1, __ATOMIC_RELAXED);
+        result = 0;
+    }
+
+    return result;
+}
+
+static void create_server_connection(SERVER_SHARD* shard, XIO_HANDLE socket_io, int accepted_socket)
+{
+    SERVER_CONNECTION* server_connection = (SERVER_CONNECTION*)malloc(sizeof(SERVER_CONNECTION));
+    if (server_connection == NULL)
+    {
+        LogError("Could not allocate server connection");
+        xio_destroy(socket_io);
+    }
+    else
+    {
+        HEADERDETECTIO_CONFIG header_detect_io_config;
+
+        server_connection->shard = shard;
+        server_connection->connection = NULL;
+        server_connection->sessions = NULL;
+        server_connection->session_count = 0;
+        server_connection->index = 0;
+        server_connection->is_in_event_loop = false;
+        server_connection->is_closing = false;
+        server_connection->next_closing = NULL;
+
+        header_detect_io_config.underlying_io = socket_io;
+        server_connection->header_detect_io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config);
+        if (server_connection->header_detect_io == NULL)
+        {
+            LogError("Could not create header detect IO");
+            xio_destroy(socket_io);
+            free(server_connection);
+        }
+        else
+        {
+            server_connection->connection = connection_create2(server_connection->header_detect_io, NULL, shard->amqp_server->container_id,
+                on_new_session_endpoint, server_connection,
+                on_connection_state_changed, server_connection,
+                on_connection_io_error, server_connection);
+            if (server_connection->connection == NULL)
+            {
+                LogError("Could not create connection");
+                destroy_server_connection(server_connection);
+            }
+            else if (connection_set_output_buffer_size(server_connection->connection, shard->amqp_server->output_buffer_size) != 0)
+            {
+                LogError("Could not set the connection output buffer size");
+                destroy_server_connection(server_connection);
+            }
+            else if (add_server_connection(shard, server_connection) != 0)
+            {
+                destroy_server_connection(server_connection);
+            }
+            else if (event_loop_add_connection(shard->event_loop, server_connection->connection, accepted_socket) != 0)
+            {
+                LogError("Could not add the connection to the event loop");
+                remove_server_connection(shard, server_connection);
+                destroy_server_connection(server_connection);
+            }
+            else
+            {
+                server_connection->is_in_event_loop = true;
+
+                if (connection_listen(server_connection->connection) != 0)
+                {
+                    LogError("Could not listen on the connection");
+                    schedule_close(server_connection);
+                }
+            }
+        }
+    }
+}
+
+static int push_command(SERVER_SHARD* shard, SERVER_COMMAND* command)
+{
+    int result;
+    uint64_t one = 1;
+    SERVER_COMMAND* head = __atomic_load_n(&shard->pending_commands, __ATOMIC_RELAXED);
+
+    do
+    {
+        command->next = head;
+    } while (!__atomic_compare_exchange_n(&shard->pending_commands, &head, command, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    /* EAGAIN means the counter is saturated, the shard is already due to wake up */
+    if ((write(shard->command_fd, &one, sizeof(one)) != sizeof(one)) &&
+        (errno != EAGAIN))
+    {
+        LogError("Could not signal shard %lu, errno = %d", (unsigned long)shard->index, errno);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static SERVER_COMMAND* take_commands(SERVER_SHARD* shard)
+{
+    SERVER_COMMAND* commands = __atomic_exchange_n(&shard->pending_commands, NULL, __ATOMIC_ACQUIRE);
+    SERVER_COMMAND* result = NULL;
+
+    /* the commands were pushed as a stack, reverse them to run in submission order */
+    while (commands != NULL)
+    {
+        SERVER_COMMAND* next = commands->next;
+        commands->next = result;
+        result = commands;
+        commands = next;
+    }
+
+    return result;
+}
+
+static void on_commands_ready(void* context)
+{
+    SERVER_SHARD* shard = (SERVER_SHARD*)context;
+    SERVER_COMMAND* commands;
+    uint64_t signal_count;
+
+    (void)read(shard->command_fd, &signal_count, sizeof(signal_count));
+
+    commands = take_commands(shard);
+    while (commands != NULL)
+    {
+        SERVER_COMMAND* command = commands;
+        commands = command->next;
+
+        switch (command->type)
+        {
+        default:
+            break;
+        case SERVER_COMMAND_TYPE_ACCEPT:
+            create_server_connection(shard, command->socket_io, command->socket);
+            break;
+        case SERVER_COMMAND_TYPE_USER:
+            command->on_command(command->context);
+            break;
+        }
+
+        free(command);
+    }
+}
+
+static size_t get_shard_index(AMQP_SERVER_INSTANCE* amqp_server_instance, int accepted_socket)
+{
+    /* socket numbers are handed out sequentially, spread them before picking the shard */
+    uint32_t hash = (uint32_t)accepted_socket * 2654435761U;
+    return (size_t)(hash >> 16) % amqp_server_instance->shard_count;
+}
+
+static void on_socket_accepted(void* context, XIO_HANDLE socket_io)
+{
+    AMQP_SERVER_INSTANCE* amqp_server_instance = (AMQP_SERVER_INSTANCE*)context;
+    int accepted_socket;
+
+    /* connections on their way to another shard are not counted yet, so a burst can briefly exceed the limit */
+    if ((amqp_server_instance->max_connections != 0) &&
+        (__atomic_load_n(&amqp_server_instance->connection_count, __ATOMIC_RELAXED) >= amqp_server_instance->max_connections))
+    {
+        LogError("Connection limit of %lu reached, refusing connection", (unsigned long)amqp_server_instance->max_connections);
+        xio_destroy(socket_io);
+    }
+    else if (socketlistener_get_accepted_socket(amqp_server_instance->socket_listener, &accepted_socket) != 0)
+    {
+        LogError("Could not get the accepted socket");
+        xio_destroy(socket_io);
+    }
+    else
+    {
+        size_t shard_index = get_shard_index(amqp_server_instance, accepted_socket);
+
+        if (shard_index == 0)
+        {
+            create_server_connection(amqp_server_instance->shards[0], socket_io, accepted_socket);
+        }
+        else
+        {
+            SERVER_COMMAND* command = (SERVER_COMMAND*)malloc(sizeof(SERVER_COMMAND));
+            if (command == NULL)
+            {
+                LogError("Could not allocate accept command");
+                xio_destroy(socket_io);
+            }
+            else
+            {
+                command->type = SERVER_COMMAND_TYPE_ACCEPT;
+                command->socket_io = socket_io;
+                command->socket = accepted_socket;
+                command->on_command = NULL;
+                command->context = NULL;
+
+                /* once pushed the command belongs to the shard, even if it could not be woken up */
+                (void)push_command(amqp_server_instance->shards[shard_index], command);
+            }
+        }
+    }
+}
+
+static void destroy_shard(SERVER_SHARD* shard)
+{
+    SERVER_COMMAND* commands = take_commands(shard);
+
+    while (commands != NULL)
+    {
+        SERVER_COMMAND* command = commands;
+        commands = command->next;
+
+        if (command->type == SERVER_COMMAND_TYPE_ACCEPT)
+        {
+            xio_destroy(command->socket_io);
+        }
+
+        free(command);
+    }
+
+    reap_closing_connections(shard);
+    while (shard->connection_count > 0)
+    {
+        SERVER_CONNECTION* server_connection = shard->connections[shard->connection_count - 1];
+        remove_server_connection(shard, server_connection);
+        destroy_server_connection(server_connection);
+    }
+
+    free(shard->connections);
+    (void)event_loop_remove_io(shard->event_loop, shard->command_fd);
+    (void)close(shard->command_fd);
+    event_loop_destroy(shard->event_loop);
+    free(shard);
+}
+
+static SERVER_SHARD* create_shard(AMQP_SERVER_INSTANCE* amqp_server_instance, size_t index)
+{
+    SERVER_SHARD* result = (SERVER_SHARD*)malloc(sizeof(SERVER_SHARD));
+    if (result == NULL)
+    {
+        LogError("Could not allocate shard");
+    }
+    else
+    {
+        result->amqp_server = amqp_server_instance;
+        result->index = index;
+        result->thread = NULL;
+        result->pending_commands = NULL;
+        result->connections = NULL;
+        result->connection_count = 0;
+        result->connection_capacity = 0;
+        result->closing_connections = NULL;
+
+        result->event_loop = event_loop_create();
+        if (result->event_loop == NULL)
+        {
+            LogError("Could not create event loop");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->command_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (result->command_fd == -1)
+            {
+                LogError("eventfd failed, errno = %d", errno);
+                event_loop_destroy(result->event_loop);
+                free(result);
+                result = NULL;
+            }
+            else if (event_loop_add_io(result->event_loop, result->command_fd, on_commands_ready, result) != 0)
+            {
+                LogError("Could not add the command fd to the event loop");
+                (void)close(result->command_fd);
+                event_loop_destroy(result->event_loop);
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int run_shard_once(SERVER_SHARD* shard)
+{
+    int result;
+
+    current_shard = shard;
+    result = event_loop_run_once(shard->event_loop);
+    reap_closing_connections(shard);
+
+    return result;
+}
+
+static int shard_worker(void* context)
+{
+    SERVER_SHARD* shard = (SERVER_SHARD*)context;
+    int result = 0;
+
+    while (__atomic_load_n(&shard->amqp_server->is_shutting_down, __ATOMIC_ACQUIRE) == 0)
+    {
+        if (run_shard_once(shard) != 0)
+        {
+            LogError("Shard %lu stopped on an event loop failure", (unsigned long)shard->index);
+            result = __FAILURE__;
+            break;
+        }
+    }
+
+    return result;
+}
+
+static void stop_shard_workers(AMQP_SERVER_INSTANCE* amqp_server_instance)
+{
+    size_t i;
+
+    __atomic_store_n(&amqp_server_instance->is_shutting_down, 1, __ATOMIC_RELEASE);
+
+    for (i = 1; i < amqp_server_instance->shard_count; i++)
+    {
+        SERVER_SHARD* shard = amqp_server_instance->shards[i];
+        if (shard->thread != NULL)
+        {
+            int thread_result;
+
+            (void)event_loop_wake(shard->event_loop);
+            if (ThreadAPI_Join(shard->thread, &thread_result) != THREADAPI_OK)
+            {
+                LogError("Could not join the worker of shard %lu", (unsigned long)i);
+            }
+
+            shard->thread = NULL;
+        }
+    }
+}
+
+AMQP_SERVER_HANDLE amqp_server_create(int port, const char* container_id, ON_AMQP_SERVER_LINK_ATTACHED on_link_attached, ON_AMQP_SERVER_CONNECTION_CLOSED on_connection_closed, void* callback_context)
+{
+    AMQP_SERVER_INSTANCE* result;
+
+    if (container_id == NULL)
+    {
+        LogError("NULL container_id");
+        result = NULL;
+    }
+    else
+    {
+        result = (AMQP_SERVER_INSTANCE*)malloc(sizeof(AMQP_SERVER_INSTANCE));
+        if (result == NULL)
+        {
+            LogError("Could not allocate AMQP server");
+        }
+        else
+        {
+            size_t container_id_length = strlen(container_id);
+
+            result->on_link_attached = on_link_attached;
+            result->on_connection_closed = on_connection_closed;
+            result->callback_context = callback_context;
+            result->shard_count = 0;
+            result->connection_count = 0;
+            result->max_connections = 0;
+            result->session_incoming_window = DEFAULT_SESSION_INCOMING_WINDOW;
+            result->output_buffer_size = 0;
+            result->is_started = false;
+            result->stop_requested = 0;
+            result->is_shutting_down = 0;
+
+            result->container_id = (char*)malloc(container_id_length + 1);
+            if (result->container_id == NULL)
+            {
+                LogError("Could not allocate container id");
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                (void)memcpy(result->container_id, container_id, container_id_length + 1);
+
+                result->socket_listener = socketlistener_create(port);
+                if (result->socket_listener == NULL)
+                {
+                    LogError("Could not create socket listener");
+                    free(result->container_id);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    result->shards = (SERVER_SHARD**)malloc(sizeof(SERVER_SHARD*));
+                    if (result->shards == NULL)
+                    {
+                        LogError("Could not allocate shard array");
+                        socketlistener_destroy(result->socket_listener);
+                        free(result->container_id);
+                        free(result);
+                        result = NULL;
+                    }
+                    else if ((result->shards[0] = create_shard(result, 0)) == NULL)
+                    {
+                        free(result->shards);
+                        socketlistener_destroy(result->socket_listener);
+                        free(result->container_id);
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        result->shard_count = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+void amqp_server_destroy(AMQP_SERVER_HANDLE amqp_server)
+{
+    if (amqp_server != NULL)
+    {
+        size_t i;
+
+        if (amqp_server->is_started)
+        {
+            stop_shard_workers(amqp_server);
+            (void)event_loop_remove_socket_listener(amqp_server->shards[0]->event_loop, amqp_server->socket_listener);
+            (void)socketlistener_stop(amqp_server->socket_listener);
+        }
+
+        for (i = 0; i < amqp_server->shard_count; i++)
+        {
+            destroy_shard(amqp_server->shards[i]);
+        }
+
+        free(amqp_server->shards);
+        socketlistener_destroy(amqp_server->socket_listener);
+        free(amqp_server->container_id);
+        free(amqp_server);
+    }
+}
+
+/* 0 means no limit, connections accepted over the limit are closed right away */
+int amqp_server_set_max_connections(AMQP_SERVER_HANDLE amqp_server, size_t max_connections)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        amqp_server->max_connections = max_connections;
+        result = 0;
+    }
+
+    return result;
+}
+
+/* Applies to the sessions begun after the call */
+int amqp_server_set_session_incoming_window(AMQP_SERVER_HANDLE amqp_server, uint32_t incoming_window)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        amqp_server->session_incoming_window = incoming_window;
+        result = 0;
+    }
+
+    return result;
+}
+
+/* Applies to the connections accepted after the call, see connection_set_output_buffer_size */
+int amqp_server_set_output_buffer_size(AMQP_SERVER_HANDLE amqp_server, size_t output_buffer_size)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        amqp_server->output_buffer_size = output_buffer_size;
+        result = 0;
+    }
+
+    return result;
+}
+
+/* Takes the SOCKET_LISTENER_OPTION_* options, e.g. to drain bursts of connections or set TCP_NODELAY on every accepted socket */
+int amqp_server_set_listener_option(AMQP_SERVER_HANDLE amqp_server, const char* option_name, const void* value)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = socketlistener_setoption(amqp_server->socket_listener, option_name, value);
+    }
+
+    return result;
+}
+
+/* Can only be changed before the server is started, typically to the number of cores */
+int amqp_server_set_shard_count(AMQP_SERVER_HANDLE amqp_server, size_t shard_count)
+{
+    int result;
+
+    if ((amqp_server == NULL) ||
+        (shard_count == 0))
+    {
+        LogError("Bad arguments: amqp_server = %p, shard_count = %lu", amqp_server, (unsigned long)shard_count);
+        result = __FAILURE__;
+    }
+    else if (amqp_server->is_started)
+    {
+        LogError("Cannot change the shard count of a started server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        while (amqp_server->shard_count > shard_count)
+        {
+            amqp_server->shard_count--;
+            destroy_shard(amqp_server->shards[amqp_server->shard_count]);
+        }
+
+        if (amqp_server->shard_count == shard_count)
+        {
+            result = 0;
+        }
+        else
+        {
+            SERVER_SHARD** new_shards = (SERVER_SHARD**)realloc(amqp_server->shards, sizeof(SERVER_SHARD*) * shard_count);
+            if (new_shards == NULL)
+            {
+                LogError("Could not grow the shard array");
+                result = __FAILURE__;
+            }
+            else
+            {
+                amqp_server->shards = new_shards;
+                result = 0;
+
+                while (amqp_server->shard_count < shard_count)
+                {
+                    SERVER_SHARD* shard = create_shard(amqp_server, amqp_server->shard_count);
+                    if (shard == NULL)
+                    {
+                        result = __FAILURE__;
+                        break;
+                    }
+
+                    amqp_server->shards[amqp_server->shard_count++] = shard;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+int amqp_server_get_shard_count(AMQP_SERVER_HANDLE amqp_server, size_t* shard_count)
+{
+    int result;
+
+    if ((amqp_server == NULL) ||
+        (shard_count == NULL))
+    {
+        LogError("Bad arguments: amqp_server = %p, shard_count = %p", amqp_server, shard_count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        *shard_count = amqp_server->shard_count;
+        result = 0;
+    }
+
+    return result;
+}
+
+/* Only succeeds on a shard thread, e.g. in the server callbacks, to learn where later work for that connection has to be submitted */
+int amqp_server_get_current_shard(AMQP_SERVER_HANDLE amqp_server, size_t* shard_index)
+{
+    int result;
+
+    if ((amqp_server == NULL) ||
+        (shard_index == NULL))
+    {
+        LogError("Bad arguments: amqp_server = %p, shard_index = %p", amqp_server, shard_index);
+        result = __FAILURE__;
+    }
+    else if ((current_shard == NULL) ||
+        (current_shard->amqp_server != amqp_server))
+    {
+        LogError("Not called from a shard of this server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        *shard_index = current_shard->index;
+        result = 0;
+    }
+
+    return result;
+}
+
+/* Can be called from any thread, on_command runs on the shard's thread where its connections, sessions and links can be used */
+int amqp_server_submit(AMQP_SERVER_HANDLE amqp_server, size_t shard_index, ON_AMQP_SERVER_COMMAND on_command, void* context)
+{
+    int result;
+
+    if ((amqp_server == NULL) ||
+        (on_command == NULL))
+    {
+        LogError("Bad arguments: amqp_server = %p, on_command = %p", amqp_server, on_command);
+        result = __FAILURE__;
+    }
+    else if (shard_index >= amqp_server->shard_count)
+    {
+        LogError("Invalid shard index %lu", (unsigned long)shard_index);
+        result = __FAILURE__;
+    }
+    else
+    {
+        SERVER_COMMAND* command = (SERVER_COMMAND*)malloc(sizeof(SERVER_COMMAND));
+        if (command == NULL)
+        {
+            LogError("Could not allocate command");
+            result = __FAILURE__;
+        }
+        else
+        {
+            command->type = SERVER_COMMAND_TYPE_USER;
+            command->socket_io = NULL;
+            command->socket = -1;
+            command->on_command = on_command;
+            command->context = context;
+
+            result = push_command(amqp_server->shards[shard_index], command);
+        }
+    }
+
+    return result;
+}
+
+int amqp_server_get_connection_count(AMQP_SERVER_HANDLE amqp_server, size_t* connection_count)
+{
+    int result;
+
+    if ((amqp_server == NULL) ||
+        (connection_count == NULL))
+    {
+        LogError("Bad arguments: amqp_server = %p, connection_count = %p", amqp_server, connection_count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        *connection_count = __atomic_load_n(&amqp_server->connection_count, __ATOMIC_RELAXED);
+        result = 0;
+    }
+
+    return result;
+}
+
+/* The event loop of shard 0 can be used to add application IO sources that are dispatched along with its connections */
+EVENT_LOOP_HANDLE amqp_server_get_event_loop(AMQP_SERVER_HANDLE amqp_server)
+{
+    EVENT_LOOP_HANDLE result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = NULL;
+    }
+    else
+    {
+        result = amqp_server->shards[0]->event_loop;
+    }
+
+    return result;
+}
+
+/* Starts the worker threads of shards 1 and up, they run until amqp_server_destroy */
+int amqp_server_start(AMQP_SERVER_HANDLE amqp_server)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else if (amqp_server->is_started)
+    {
+        LogError("AMQP server already started");
+        result = __FAILURE__;
+    }
+    else if (socketlistener_start(amqp_server->socket_listener, on_socket_accepted, amqp_server) != 0)
+    {
+        LogError("Could not start the socket listener");
+        result = __FAILURE__;
+    }
+    else if (event_loop_add_socket_listener(amqp_server->shards[0]->event_loop, amqp_server->socket_listener) != 0)
+    {
+        LogError("Could not add the socket listener to the event loop");
+        (void)socketlistener_stop(amqp_server->socket_listener);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        result = 0;
+        amqp_server->is_shutting_down = 0;
+
+        for (i = 1; i < amqp_server->shard_count; i++)
+        {
+            if (ThreadAPI_Create(&amqp_server->shards[i]->thread, shard_worker, amqp_server->shards[i]) != THREADAPI_OK)
+            {
+                LogError("Could not start the worker of shard %lu", (unsigned long)i);
+                amqp_server->shards[i]->thread = NULL;
+                result = __FAILURE__;
+                break;
+            }
+        }
+
+        if (result != 0)
+        {
+            stop_shard_workers(amqp_server);
+            (void)event_loop_remove_socket_listener(amqp_server->shards[0]->event_loop, amqp_server->socket_listener);
+            (void)socketlistener_stop(amqp_server->socket_listener);
+        }
+        else
+        {
+            amqp_server->is_started = true;
+        }
+    }
+
+    return result;
+}
+
+/* Runs shard 0, which also accepts the connections for all shards */
+int amqp_server_run_once(AMQP_SERVER_HANDLE amqp_server)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = run_shard_once(amqp_server->shards[0]);
+    }
+
+    return result;
+}
+
+int amqp_server_run(AMQP_SERVER_HANDLE amqp_server)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+
+        while (__atomic_exchange_n(&amqp_server->stop_requested, 0, __ATOMIC_ACQ_REL) == 0)
+        {
+            if (amqp_server_run_once(amqp_server) != 0)
+            {
+                result = __FAILURE__;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/* Can be called from any thread, makes amqp_server_run return */
+int amqp_server_stop(AMQP_SERVER_HANDLE amqp_server)
+{
+    int result;
+
+    if (amqp_server == NULL)
+    {
+        LogError("NULL amqp_server");
+        result = __FAILURE__;
+    }
+    else
+    {
+        __atomic_store_n(&amqp_server->stop_requested, 1, __ATOMIC_RELEASE);
+        result = event_loop_wake(amqp_server->shards[0]->event_loop);
+    }
+
+    return result;
+}
@@ -5306,6 +5306,166 @@ void amqpvalue_decoder_destroy(AMQPVALUE_DECODER_HANDLE handle)
 	}
 }
 
+/* Drops any partially decoded value, so that the next bytes are decoded as the start of a new value.
+   A decoder sitting between values is left untouched, which makes resetting it after every complete payload cheap. */
+int amqpvalue_decoder_reset(AMQPVALUE_DECODER_HANDLE handle)
+{
+	int result;
+
+	AMQPVALUE_DECODER_HANDLE_DATA* decoder_instance = (AMQPVALUE_DECODER_HANDLE_DATA*)handle;
+	if (decoder_instance == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else if (decoder_instance->internal_decoder->decoder_state == DECODER_STATE_CONSTRUCTOR)
+	{
+		/* between values, only drop the last decoded value so an idle decoder does not hold on to it */
+		amqpvalue_clear(decoder_instance->decode_to_value);
+		result = 0;
+	}
+	else
+	{
+		AMQP_VALUE_DATA* decode_to_value = (AMQP_VALUE_DATA*)malloc(sizeof(AMQP_VALUE_DATA));
+		if (decode_to_value == NULL)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			INTERNAL_DECODER_DATA* internal_decoder;
+
+			decode_to_value->type = AMQP_TYPE_UNKNOWN;
+			internal_decoder = internal_decoder_create(decoder_instance->internal_decoder->on_value_decoded, decoder_instance->internal_decoder->on_value_decoded_context, decode_to_value);
+			if (internal_decoder == NULL)
+			{
+				free(decode_to_value);
+				result = __FAILURE__;
+			}
+			else
+			{
+				amqpvalue_destroy(decoder_instance->decode_to_value);
+				internal_decoder_destroy(decoder_instance->internal_decoder);
+				decoder_instance->decode_to_value = decode_to_value;
+				decoder_instance->internal_decoder = internal_decoder;
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+/* Computes the length of the first encoded value in bytes by only looking at constructors and size fields, without decoding it.
+   A described value is a descriptor followed by a value, so each 0x00 constructor adds one more value to skip. */
+int amqpvalue_get_encoded_value_length(const unsigned char* bytes, size_t length, size_t* value_length)
+{
+	int result;
+
+	if ((bytes == NULL) ||
+		(value_length == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		size_t position = 0;
+		size_t values_to_skip = 1;
+
+		result = 0;
+
+		while (values_to_skip > 0)
+		{
+			unsigned char constructor;
+			size_t size_length = 0;
+			size_t data_length = 0;
+
+			if (position >= length)
+			{
+				result = __FAILURE__;
+				break;
+			}
+
+			constructor = bytes[position++];
+			if (constructor == 0x00)
+			{
+				values_to_skip++;
+				continue;
+			}
+
+			switch (constructor & 0xF0)
+			{
+			default:
+				result = __FAILURE__;
+				break;
+			case 0x40:
+				break;
+			case 0x50:
+				data_length = 1;
+				break;
+			case 0x60:
+				data_length = 2;
+				break;
+			case 0x70:
+				data_length = 4;
+				break;
+			case 0x80:
+				data_length = 8;
+				break;
+			case 0x90:
+				data_length = 16;
+				break;
+			case 0xA0:
+			case 0xC0:
+			case 0xE0:
+				size_length = 1;
+				break;
+			case 0xB0:
+			case 0xD0:
+			case 0xF0:
+				size_length = 4;
+				break;
+			}
+
+			if (result != 0)
+			{
+				break;
+			}
+
+			if (size_length > 0)
+			{
+				size_t i;
+
+				if (length - position < size_length)
+				{
+					result = __FAILURE__;
+					break;
+				}
+
+				for (i = 0; i < size_length; i++)
+				{
+					data_length = (data_length << 8) + bytes[position++];
+				}
+			}
+
+			if (length - position < data_length)
+			{
+				result = __FAILURE__;
+				break;
+			}
+
+			position += data_length;
+			values_to_skip--;
+		}
+
+		if (result == 0)
+		{
+			*value_length = position;
+		}
+	}
+
+	return result;
+}
+
 /* Codes_SRS_AMQPVALUE_01_318: [amqpvalue_decode_bytes shall decode size bytes that are passed in the buffer argument.] */
 int amqpvalue_decode_bytes(AMQPVALUE_DECODER_HANDLE handle, const unsigned char* buffer, size_t size)
 {
@@ -15,6 +15,7 @@
 #include "azure_uamqp_c/amqp_frame_codec.h"
 #include "azure_uamqp_c/amqp_definitions.h"
 #include "azure_uamqp_c/amqpvalue_to_string.h"
+#include "amqp_atomic.h"
 
 /* Requirements satisfied by the virtue of implementing the ISO:*/
 /* Codes_SRS_CONNECTION_01_088: [Any data appearing beyond the protocol header MUST match the version indicated by the protocol header.] */
@@ -35,10 +36,68 @@ typedef struct ENDPOINT_INSTANCE_TAG
     uint16_t outgoing_channel;
     ON_ENDPOINT_FRAME_RECEIVED on_endpoint_frame_received;
     ON_CONNECTION_STATE_CHANGED on_connection_state_changed;
+    ON_ENDPOINT_DOWORK on_endpoint_dowork;
+    ON_ENDPOINT_SEND_BLOCKED_CHANGED on_endpoint_send_blocked_changed;
     void* callback_context;
     CONNECTION_HANDLE connection;
+    /* buffered or in flight send completion records of this endpoint, the endpoint is freed with the last one once destroyed */
+    size_t outstanding_send_count;
+    bool is_destroyed;
+    /* flush_count of the data lane when this endpoint last queued a frame there */
+    uint32_t data_lane_flush_count;
 } ENDPOINT_INSTANCE;
 
+/* Completion record of one buffered frame, chained with the other frames of the same flush */
+typedef struct SEND_COMPLETION_TAG
+{
+    ON_SEND_COMPLETE on_send_complete;
+    void* callback_context;
+    /* bytes counted against the send watermarks until the IO completes them */
+    size_t byte_count;
+    /* NULL for the connection's own frames */
+    ENDPOINT_INSTANCE* endpoint;
+    struct SEND_COMPLETION_POOL_TAG* pool;
+    struct SEND_COMPLETION_TAG* next;
+} SEND_COMPLETION;
+
+/* Outlives the connection while records are still out with the IO */
+typedef struct SEND_COMPLETION_POOL_TAG
+{
+    SEND_COMPLETION* free_records;
+    size_t free_count;
+    size_t outstanding_count;
+    /* NULL once the connection is gone */
+    struct CONNECTION_INSTANCE_TAG* connection;
+} SEND_COMPLETION_POOL;
+
+typedef enum OUTPUT_LANE_INDEX_TAG
+{
+    OUTPUT_LANE_CONTROL,
+    OUTPUT_LANE_DATA,
+    OUTPUT_LANE_COUNT
+} OUTPUT_LANE_INDEX;
+
+typedef struct OUTPUT_LANE_TAG
+{
+    unsigned char* buffer;
+    size_t size;
+    size_t capacity;
+    SEND_COMPLETION* completions_head;
+    SEND_COMPLETION* completions_tail;
+    /* bumped whenever the buffered bytes are handed to the IO */
+    uint32_t flush_count;
+} OUTPUT_LANE;
+
+/* The encoder callback context of one frame */
+typedef struct FRAME_SEND_CONTEXT_TAG
+{
+    struct CONNECTION_INSTANCE_TAG* connection;
+    ENDPOINT_INSTANCE* endpoint;
+    OUTPUT_LANE_INDEX lane;
+    ON_SEND_COMPLETE on_send_complete;
+    void* callback_context;
+} FRAME_SEND_CONTEXT;
+
 typedef struct CONNECTION_INSTANCE_TAG
 {
     XIO_HANDLE io;
@@ -53,8 +112,16 @@ typedef struct CONNECTION_INSTANCE_TAG
     TICK_COUNTER_HANDLE tick_counter;
     uint32_t remote_max_frame_size;
 
-    ON_SEND_COMPLETE on_send_complete;
-    void* on_send_complete_callback_context;
+    /* output coalescing, encoded frames go straight to xio_send while output_high_watermark is 0 */
+    OUTPUT_LANE output_lanes[OUTPUT_LANE_COUNT];
+    size_t output_high_watermark;
+    SEND_COMPLETION_POOL* send_completion_pool;
+    uint32_t cork_count;
+
+    /* send backpressure, off while send_high_watermark is 0 */
+    size_t send_high_watermark;
+    size_t send_low_watermark;
+    size_t pending_send_bytes;
 
     ON_NEW_ENDPOINT on_new_endpoint;
     void* on_new_endpoint_callback_context;
@@ -71,13 +138,37 @@ typedef struct CONNECTION_INSTANCE_TAG
     milliseconds remote_idle_timeout;
     tickcounter_ms_t last_frame_received_time;
     tickcounter_ms_t last_frame_sent_time;
+    /* earliest time an endpoint asked to be called for dowork again, (uint64_t)-1 when none did */
+    uint64_t endpoint_dowork_time;
+    /* set from any thread by connection_request_dowork, cleared by connection_dowork */
+    volatile int is_dowork_requested;
 
     unsigned int is_underlying_io_open : 1;
     unsigned int idle_timeout_specified : 1;
     unsigned int is_remote_frame_received : 1;
     unsigned int is_trace_on : 1;
+    unsigned int is_send_blocked : 1;
 } CONNECTION_INSTANCE;
 
+/* Endpoint callbacks may create or destroy endpoints, which moves the others around in the array.
+   The array is sorted by outgoing channel, so loops that call back endpoints look the next one up by channel instead of by index. */
+static ENDPOINT_INSTANCE* get_next_endpoint(CONNECTION_INSTANCE* connection_instance, uint32_t first_outgoing_channel)
+{
+    ENDPOINT_INSTANCE* result = NULL;
+    uint32_t i;
+
+    for (i = 0; i < connection_instance->endpoint_count; i++)
+    {
+        if (connection_instance->endpoints[i]->outgoing_channel >= first_outgoing_channel)
+        {
+            result = connection_instance->endpoints[i];
+            break;
+        }
+    }
+
+    return result;
+}
+
 /* Codes_SRS_CONNECTION_01_258: [on_connection_state_changed shall be invoked whenever the connection state changes.]*/
 static void connection_set_state(CONNECTION_INSTANCE* connection_instance, CONNECTION_STATE connection_state)
 {
@@ -220,16 +311,502 @@ static void log_outgoing_frame(AMQP_VALUE performative)
 #endif
 }
 
+#define SEND_COMPLETION_POOL_MAX_FREE 256
+
+static SEND_COMPLETION_POOL* create_send_completion_pool(CONNECTION_INSTANCE* connection_instance)
+{
+    SEND_COMPLETION_POOL* result = (SEND_COMPLETION_POOL*)malloc(sizeof(SEND_COMPLETION_POOL));
+    if (result == NULL)
+    {
+        LogError("Could not allocate send completion pool");
+    }
+    else
+    {
+        result->free_records = NULL;
+        result->free_count = 0;
+        result->outstanding_count = 0;
+        result->connection = connection_instance;
+    }
+
+    return result;
+}
+
+static void free_send_completion_pool(SEND_COMPLETION_POOL* pool)
+{
+    while (pool->free_records != NULL)
+    {
+        SEND_COMPLETION* send_completion = pool->free_records;
+        pool->free_records = send_completion->next;
+        free(send_completion);
+    }
+
+    free(pool);
+}
+
+/* Called by the connection when it goes away, the pool is freed with the last record that comes back */
+static void release_send_completion_pool(SEND_COMPLETION_POOL* pool)
+{
+    if (pool->outstanding_count == 0)
+    {
+        free_send_completion_pool(pool);
+    }
+    else
+    {
+        pool->connection = NULL;
+    }
+}
+
+static SEND_COMPLETION* acquire_send_completion(SEND_COMPLETION_POOL* pool, ENDPOINT_INSTANCE* endpoint, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    SEND_COMPLETION* result;
+
+    if (pool->free_records != NULL)
+    {
+        result = pool->free_records;
+        pool->free_records = result->next;
+        pool->free_count--;
+    }
+    else
+    {
+        result = (SEND_COMPLETION*)malloc(sizeof(SEND_COMPLETION));
+    }
+
+    if (result == NULL)
+    {
+        LogError("Could not allocate send completion");
+    }
+    else
+    {
+        result->on_send_complete = on_send_complete;
+        result->callback_context = callback_context;
+        result->byte_count = 0;
+        result->endpoint = endpoint;
+        result->pool = pool;
+        result->next = NULL;
+        pool->outstanding_count++;
+
+        if (endpoint != NULL)
+        {
+            endpoint->outstanding_send_count++;
+        }
+    }
+
+    return result;
+}
+
+static void release_send_completion(SEND_COMPLETION* send_completion)
+{
+    SEND_COMPLETION_POOL* pool = send_completion->pool;
+    ENDPOINT_INSTANCE* endpoint = send_completion->endpoint;
+
+    if (endpoint != NULL)
+    {
+        endpoint->outstanding_send_count--;
+        if (endpoint->is_destroyed && (endpoint->outstanding_send_count == 0))
+        {
+            free(endpoint);
+        }
+    }
+
+    pool->outstanding_count--;
+    if ((pool->connection == NULL) || (pool->free_count == SEND_COMPLETION_POOL_MAX_FREE))
+    {
+        free(send_completion);
+        if ((pool->connection == NULL) && (pool->outstanding_count == 0))
+        {
+            free_send_completion_pool(pool);
+        }
+    }
+    else
+    {
+        send_completion->next = pool->free_records;
+        pool->free_records = send_completion;
+        pool->free_count++;
+    }
+}
+
+static void notify_send_blocked_changed(CONNECTION_INSTANCE* connection_instance)
+{
+    ENDPOINT_INSTANCE* endpoint = get_next_endpoint(connection_instance, 0);
+
+    while (endpoint != NULL)
+    {
+        uint16_t outgoing_channel = endpoint->outgoing_channel;
+
+        if (endpoint->on_endpoint_send_blocked_changed != NULL)
+        {
+            endpoint->on_endpoint_send_blocked_changed(endpoint->callback_context, connection_instance->is_send_blocked ? true : false);
+        }
+
+        endpoint = get_next_endpoint(connection_instance, (uint32_t)outgoing_channel + 1);
+    }
+}
+
+static void add_pending_send_bytes(CONNECTION_INSTANCE* connection_instance, size_t byte_count)
+{
+    connection_instance->pending_send_bytes += byte_count;
+    if ((!connection_instance->is_send_blocked) &&
+        (connection_instance->pending_send_bytes >= connection_instance->send_high_watermark))
+    {
+        connection_instance->is_send_blocked = 1;
+        notify_send_blocked_changed(connection_instance);
+    }
+}
+
+static void remove_pending_send_bytes(CONNECTION_INSTANCE* connection_instance, size_t byte_count)
+{
+    connection_instance->pending_send_bytes -= byte_count;
+    if (connection_instance->is_send_blocked &&
+        (connection_instance->pending_send_bytes <= connection_instance->send_low_watermark))
+    {
+        connection_instance->is_send_blocked = 0;
+        notify_send_blocked_changed(connection_instance);
+    }
+}
+
+/* Completes a chain of frames in the order they were encoded */
+static void complete_output_sends(SEND_COMPLETION* send_completions, IO_SEND_RESULT send_result)
+{
+    while (send_completions != NULL)
+    {
+        SEND_COMPLETION* send_completion = send_completions;
+        send_completions = send_completion->next;
+
+        if ((send_completion->byte_count > 0) &&
+            (send_completion->pool->connection != NULL))
+        {
+            remove_pending_send_bytes(send_completion->pool->connection, send_completion->byte_count);
+        }
+
+        /* the session or link behind a destroyed endpoint is gone, so its frames complete silently */
+        if ((send_completion->on_send_complete != NULL) &&
+            ((send_completion->endpoint == NULL) || !send_completion->endpoint->is_destroyed))
+        {
+            send_completion->on_send_complete(send_completion->callback_context, send_result);
+        }
+
+        release_send_completion(send_completion);
+    }
+}
+
+/* Gives back the records of a send the IO never took, without calling them */
+static void release_output_sends(SEND_COMPLETION* send_completions)
+{
+    while (send_completions != NULL)
+    {
+        SEND_COMPLETION* send_completion = send_completions;
+        send_completions = send_completion->next;
+        release_send_completion(send_completion);
+    }
+}
+
+static void on_output_flush_complete(void* context, IO_SEND_RESULT send_result)
+{
+    complete_output_sends((SEND_COMPLETION*)context, send_result);
+}
+
+/* xio_send, with the bytes counted as pending until the IO completes them when send watermarks are set */
+static int send_to_io(CONNECTION_INSTANCE* connection_instance, const unsigned char* bytes, size_t length, SEND_COMPLETION* send_completions)
+{
+    int result;
+
+    if (connection_instance->send_high_watermark == 0)
+    {
+        result = xio_send(connection_instance->io, bytes, length, (send_completions == NULL) ? NULL : on_output_flush_complete, send_completions);
+    }
+    else
+    {
+        SEND_COMPLETION* pending_bytes = acquire_send_completion(connection_instance->send_completion_pool, NULL, NULL, NULL);
+        if (pending_bytes == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            pending_bytes->byte_count = length;
+            pending_bytes->next = send_completions;
+            add_pending_send_bytes(connection_instance, length);
+
+            if (xio_send(connection_instance->io, bytes, length, on_output_flush_complete, pending_bytes) != 0)
+            {
+                remove_pending_send_bytes(connection_instance, length);
+                pending_bytes->next = NULL;
+                release_send_completion(pending_bytes);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+/* Sends bytes that are not buffered, keeping the plain xio_send path when neither buffering nor watermarks need a record */
+static int send_unbuffered(CONNECTION_INSTANCE* connection_instance, ENDPOINT_INSTANCE* endpoint, const unsigned char* bytes, size_t length, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+
+    if (connection_instance->send_high_watermark == 0)
+    {
+        result = xio_send(connection_instance->io, bytes, length, on_send_complete, callback_context);
+    }
+    else
+    {
+        SEND_COMPLETION* send_completion;
+
+        if (on_send_complete == NULL)
+        {
+            send_completion = NULL;
+        }
+        else
+        {
+            send_completion = acquire_send_completion(connection_instance->send_completion_pool, endpoint, on_send_complete, callback_context);
+        }
+
+        if ((on_send_complete != NULL) &&
+            (send_completion == NULL))
+        {
+            result = __FAILURE__;
+        }
+        else if (send_to_io(connection_instance, bytes, length, send_completion) != 0)
+        {
+            release_output_sends(send_completion);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Hands the bytes buffered in a lane to the IO in one xio_send, the frames completed in them carry their records along with it */
+static int flush_output_lane(CONNECTION_INSTANCE* connection_instance, OUTPUT_LANE* output_lane)
+{
+    int result;
+
+    if (output_lane->size == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        unsigned char* buffer = output_lane->buffer;
+        size_t size = output_lane->size;
+        size_t capacity = output_lane->capacity;
+        SEND_COMPLETION* send_completions = output_lane->completions_head;
+
+        /* frames encoded from within xio_send (by a send complete callback) must not land in the buffer being sent */
+        output_lane->buffer = NULL;
+        output_lane->size = 0;
+        output_lane->capacity = 0;
+        output_lane->completions_head = NULL;
+        output_lane->completions_tail = NULL;
+        output_lane->flush_count++;
+
+        if (send_to_io(connection_instance, buffer, size, send_completions) != 0)
+        {
+            LogError("Could not send the buffered output");
+
+            /* the frames were reported as encoded, so their callbacks are still owed */
+            complete_output_sends(send_completions, IO_SEND_ERROR);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+
+        if (output_lane->buffer == NULL)
+        {
+            output_lane->buffer = buffer;
+            output_lane->capacity = capacity;
+        }
+        else
+        {
+            free(buffer);
+        }
+    }
+
+    return result;
+}
+
+/* The control lane always goes first, so that flow, disposition and heartbeat frames do not wait behind bulk transfers.
+   get_output_lane only puts frames there that cannot overtake anything of their own endpoint. */
+static int flush_output(CONNECTION_INSTANCE* connection_instance)
+{
+    int result;
+
+    if ((flush_output_lane(connection_instance, &connection_instance->output_lanes[OUTPUT_LANE_CONTROL]) != 0) ||
+        (flush_output_lane(connection_instance, &connection_instance->output_lanes[OUTPUT_LANE_DATA]) != 0))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static int buffer_output(CONNECTION_INSTANCE* connection_instance, OUTPUT_LANE* output_lane, const unsigned char* bytes, size_t length)
+{
+    int result;
+
+    if (output_lane->size + length > output_lane->capacity)
+    {
+        size_t new_capacity = (output_lane->capacity == 0) ? connection_instance->output_high_watermark : output_lane->capacity * 2;
+        unsigned char* new_buffer;
+
+        while (new_capacity < output_lane->size + length)
+        {
+            new_capacity *= 2;
+        }
+
+        new_buffer = (unsigned char*)realloc(output_lane->buffer, new_capacity);
+        if (new_buffer == NULL)
+        {
+            LogError("Could not grow the output buffer");
+        }
+        else
+        {
+            output_lane->buffer = new_buffer;
+            output_lane->capacity = new_capacity;
+        }
+    }
+
+    if (output_lane->size + length > output_lane->capacity)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(output_lane->buffer + output_lane->size, bytes, length);
+        output_lane->size += length;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int buffer_output_completion(CONNECTION_INSTANCE* connection_instance, OUTPUT_LANE* output_lane, ENDPOINT_INSTANCE* endpoint, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    SEND_COMPLETION* send_completion = acquire_send_completion(connection_instance->send_completion_pool, endpoint, on_send_complete, callback_context);
+
+    if (send_completion == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (output_lane->completions_tail == NULL)
+        {
+            output_lane->completions_head = send_completion;
+        }
+        else
+        {
+            output_lane->completions_tail->next = send_completion;
+        }
+
+        output_lane->completions_tail = send_completion;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int send_encoded_bytes(CONNECTION_INSTANCE* connection_instance, ENDPOINT_INSTANCE* endpoint, OUTPUT_LANE_INDEX lane, const unsigned char* bytes, size_t length, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    OUTPUT_LANE* output_lane = &connection_instance->output_lanes[lane];
+
+    if (connection_instance->output_high_watermark == 0)
+    {
+        result = send_unbuffered(connection_instance, endpoint, bytes, length, on_send_complete, callback_context);
+    }
+    else if (connection_instance->output_lanes[OUTPUT_LANE_CONTROL].size + connection_instance->output_lanes[OUTPUT_LANE_DATA].size + length > connection_instance->output_high_watermark)
+    {
+        if (flush_output(connection_instance) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else if (length >= connection_instance->output_high_watermark)
+        {
+            /* no point copying what would be flushed right away on its own */
+            result = send_unbuffered(connection_instance, endpoint, bytes, length, on_send_complete, callback_context);
+        }
+        else if (buffer_output(connection_instance, output_lane, bytes, length) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = (on_send_complete == NULL) ? 0 : buffer_output_completion(connection_instance, output_lane, endpoint, on_send_complete, callback_context);
+        }
+    }
+    else if (buffer_output(connection_instance, output_lane, bytes, length) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = (on_send_complete == NULL) ? 0 : buffer_output_completion(connection_instance, output_lane, endpoint, on_send_complete, callback_context);
+    }
+
+    return result;
+}
+
+/* context is the FRAME_SEND_CONTEXT of the frame being encoded */
 static void on_bytes_encoded(void* context, const unsigned char* bytes, size_t length, bool encode_complete)
 {
-    CONNECTION_INSTANCE* connection_instance = (CONNECTION_INSTANCE*)context;
-    if (xio_send(connection_instance->io, bytes, length, encode_complete ? connection_instance->on_send_complete : NULL, connection_instance->on_send_complete_callback_context) != 0)
+    FRAME_SEND_CONTEXT* frame_send_context = (FRAME_SEND_CONTEXT*)context;
+    CONNECTION_INSTANCE* connection_instance = frame_send_context->connection;
+    if ((send_encoded_bytes(connection_instance, frame_send_context->endpoint, frame_send_context->lane, bytes, length, encode_complete ? frame_send_context->on_send_complete : NULL, frame_send_context->callback_context) != 0) ||
+        /* an uncorked connection still gets all the pieces of one frame out in a single send */
+        (encode_complete && (connection_instance->cork_count == 0) && (flush_output(connection_instance) != 0)))
     {
         xio_close(connection_instance->io, NULL, NULL);
         connection_set_state(connection_instance, CONNECTION_STATE_END);
     }
 }
 
+/* Only flow and disposition may jump ahead of the data lane, and only while their endpoint has nothing queued there:
+   a sender's flow or disposition has to stay behind its transfers, and begin and attach behind the end or detach that freed their channel or handle */
+static OUTPUT_LANE_INDEX get_output_lane(CONNECTION_INSTANCE* connection_instance, ENDPOINT_INSTANCE* endpoint, AMQP_VALUE performative)
+{
+    OUTPUT_LANE_INDEX result;
+
+    /* lanes only exist in the output buffer */
+    if (connection_instance->output_high_watermark == 0)
+    {
+        result = OUTPUT_LANE_DATA;
+    }
+    else
+    {
+        OUTPUT_LANE* data_lane = &connection_instance->output_lanes[OUTPUT_LANE_DATA];
+        AMQP_VALUE descriptor = amqpvalue_get_inplace_descriptor(performative);
+        if ((descriptor == NULL) ||
+            (!is_flow_type_by_descriptor(descriptor) && !is_disposition_type_by_descriptor(descriptor)) ||
+            ((data_lane->size > 0) && (endpoint->data_lane_flush_count == data_lane->flush_count)))
+        {
+            result = OUTPUT_LANE_DATA;
+        }
+        else
+        {
+            result = OUTPUT_LANE_CONTROL;
+        }
+    }
+
+    return result;
+}
+
 static int send_open_frame(CONNECTION_INSTANCE* connection_instance)
 {
     int result;
@@ -308,9 +885,13 @@ static int send_open_frame(CONNECTION_INSTANCE* connection_instance)
                     /* Codes_SRS_CONNECTION_01_005: [The open frame describes the capabilities and limits of that peer.] */
                     /* Codes_SRS_CONNECTION_01_205: [Sending the AMQP OPEN frame shall be done by calling amqp_frame_codec_begin_encode_frame with channel number 0, the actual performative payload and 0 as payload_size.] */
                     /* Codes_SRS_CONNECTION_01_006: [The open frame can only be sent on channel 0.] */
-                    connection_instance->on_send_complete = NULL;
-                    connection_instance->on_send_complete_callback_context = NULL;
-                    if (amqp_frame_codec_encode_frame(connection_instance->amqp_frame_codec, 0, open_performative_value, NULL, 0, on_bytes_encoded, connection_instance) != 0)
+                    FRAME_SEND_CONTEXT frame_send_context;
+                    frame_send_context.connection = connection_instance;
+                    frame_send_context.endpoint = NULL;
+                    frame_send_context.lane = OUTPUT_LANE_CONTROL;
+                    frame_send_context.on_send_complete = NULL;
+                    frame_send_context.callback_context = NULL;
+                    if (amqp_frame_codec_encode_frame(connection_instance->amqp_frame_codec, 0, open_performative_value, NULL, 0, on_bytes_encoded, &frame_send_context) != 0)
                     {
                         /* Codes_SRS_CONNECTION_01_206: [If sending the frame fails, the connection shall be closed and state set to END.] */
                         xio_close(connection_instance->io, NULL, NULL);
@@ -370,9 +951,18 @@ static int send_close_frame(CONNECTION_INSTANCE* connection_instance, ERROR_HAND
             {
                 /* Codes_SRS_CONNECTION_01_215: [Sending the AMQP CLOSE frame shall be done by calling amqp_frame_codec_begin_encode_frame with channel number 0, the actual performative payload and 0 as payload_size.] */
                 /* Codes_SRS_CONNECTION_01_013: [However, implementations SHOULD send it on channel 0] */
-                connection_instance->on_send_complete = NULL;
-                connection_instance->on_send_complete_callback_context = NULL;
-                if (amqp_frame_codec_encode_frame(connection_instance->amqp_frame_codec, 0, close_performative_value, NULL, 0, on_bytes_encoded, connection_instance) != 0)
+                FRAME_SEND_CONTEXT frame_send_context;
+                frame_send_context.connection = connection_instance;
+                frame_send_context.endpoint = NULL;
+                frame_send_context.lane = OUTPUT_LANE_DATA;
+                frame_send_context.on_send_complete = NULL;
+                frame_send_context.callback_context = NULL;
+                if (amqp_frame_codec_encode_frame(connection_instance->amqp_frame_codec, 0, close_performative_value, NULL, 0, on_bytes_encoded, &frame_send_context) != 0)
+                {
+                    result = __FAILURE__;
+                }
+                /* the IO is closed right after the close frame, nothing may stay buffered */
+                else if (flush_output(connection_instance) != 0)
                 {
                     result = __FAILURE__;
                 }
@@ -920,6 +1510,7 @@ CONNECTION_HANDLE connection_create(XIO_HANDLE xio, const char* hostname, const
 CONNECTION_HANDLE connection_create2(XIO_HANDLE xio, const char* hostname, const char* container_id, ON_NEW_ENDPOINT on_new_endpoint, void* callback_context, ON_CONNECTION_STATE_CHANGED on_connection_state_changed, void* on_connection_state_changed_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
 {
     CONNECTION_INSTANCE* result;
+    size_t i;
 
     if ((xio == NULL) ||
         (container_id == NULL))
@@ -1022,6 +1613,24 @@ CONNECTION_HANDLE connection_create2(XIO_HANDLE xio, const char* hostname, const
                                 result->is_underlying_io_open = 0;
                                 result->remote_max_frame_size = 512;
                                 result->is_trace_on = 0;
+                                result->is_send_blocked = 0;
+                                result->send_high_watermark = 0;
+                                result->send_low_watermark = 0;
+                                result->pending_send_bytes = 0;
+
+                                for (i = 0; i < OUTPUT_LANE_COUNT; i++)
+                                {
+                                    result->output_lanes[i].buffer = NULL;
+                                    result->output_lanes[i].size = 0;
+                                    result->output_lanes[i].capacity = 0;
+                                    result->output_lanes[i].completions_head = NULL;
+                                    result->output_lanes[i].completions_tail = NULL;
+                                    result->output_lanes[i].flush_count = 0;
+                                }
+
+                                result->output_high_watermark = 0;
+                                result->send_completion_pool = NULL;
+                                result->cork_count = 0;
 
                                 /* Mark that settings have not yet been set by the user */
                                 result->idle_timeout_specified = 0;
@@ -1048,6 +1657,8 @@ CONNECTION_HANDLE connection_create2(XIO_HANDLE xio, const char* hostname, const
                                 else
                                 {
                                     result->last_frame_sent_time = result->last_frame_received_time;
+                                    result->endpoint_dowork_time = (uint64_t)-1;
+                                    result->is_dowork_requested = 0;
 
                                     /* Codes_SRS_CONNECTION_01_072: [When connection_create succeeds, the state of the connection shall be CONNECTION_STATE_START.] */
                                     connection_set_state(result, CONNECTION_STATE_START);
@@ -1068,6 +1679,8 @@ void connection_destroy(CONNECTION_HANDLE connection)
     /* Codes_SRS_CONNECTION_01_079: [If handle is NULL, connection_destroy shall do nothing.] */
     if (connection != NULL)
     {
+        size_t i;
+
         /* Codes_SRS_CONNECTION_01_073: [connection_destroy shall free all resources associated with a connection.] */
         if (connection->is_underlying_io_open)
         {
@@ -1078,6 +1691,21 @@ void connection_destroy(CONNECTION_HANDLE connection)
         frame_codec_destroy(connection->frame_codec);
         tickcounter_destroy(connection->tick_counter);
 
+        /* only the frames of endpoints that are still alive get called back */
+        for (i = 0; i < OUTPUT_LANE_COUNT; i++)
+        {
+            complete_output_sends(connection->output_lanes[i].completions_head, IO_SEND_CANCELLED);
+            if (connection->output_lanes[i].buffer != NULL)
+            {
+                free(connection->output_lanes[i].buffer);
+            }
+        }
+
+        if (connection->send_completion_pool != NULL)
+        {
+            release_send_completion_pool(connection->send_completion_pool);
+        }
+
         free(connection->host_name);
         free(connection->container_id);
 
@@ -1364,10 +1992,194 @@ int connection_get_remote_max_frame_size(CONNECTION_HANDLE connection, uint32_t*
     return result;
 }
 
+/* Buffers encoded frames and sends them in batches once output_high_watermark bytes are queued, when uncorked or at the end of connection_dowork; 0 sends every frame as it is encoded */
+int connection_set_output_buffer_size(CONNECTION_HANDLE connection, size_t output_high_watermark)
+{
+    int result;
+
+    if (connection == NULL)
+    {
+        LogError("NULL connection");
+        result = __FAILURE__;
+    }
+    else if (flush_output(connection) != 0)
+    {
+        LogError("Could not flush the buffered output");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((output_high_watermark > 0) &&
+            (connection->send_completion_pool == NULL))
+        {
+            connection->send_completion_pool = create_send_completion_pool(connection);
+        }
+
+        if ((output_high_watermark > 0) &&
+            (connection->send_completion_pool == NULL))
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+
+            connection->output_high_watermark = output_high_watermark;
+            for (i = 0; i < OUTPUT_LANE_COUNT; i++)
+            {
+                if (connection->output_lanes[i].buffer != NULL)
+                {
+                    free(connection->output_lanes[i].buffer);
+                    connection->output_lanes[i].buffer = NULL;
+                    connection->output_lanes[i].capacity = 0;
+                }
+            }
+
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Once high_watermark bytes handed to the IO are not completed yet, endpoints are told to stop sending until they drop to low_watermark; 0 turns it off */
+int connection_set_send_watermarks(CONNECTION_HANDLE connection, size_t high_watermark, size_t low_watermark)
+{
+    int result;
+
+    if ((connection == NULL) ||
+        ((high_watermark > 0) && (low_watermark >= high_watermark)))
+    {
+        LogError("Bad arguments: connection = %p, high_watermark = %lu, low_watermark = %lu", connection, (unsigned long)high_watermark, (unsigned long)low_watermark);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((high_watermark > 0) &&
+            (connection->send_completion_pool == NULL))
+        {
+            connection->send_completion_pool = create_send_completion_pool(connection);
+        }
+
+        if ((high_watermark > 0) &&
+            (connection->send_completion_pool == NULL))
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            connection->send_high_watermark = high_watermark;
+            connection->send_low_watermark = low_watermark;
+
+            if (connection->is_send_blocked &&
+                ((high_watermark == 0) || (connection->pending_send_bytes <= low_watermark)))
+            {
+                connection->is_send_blocked = 0;
+                notify_send_blocked_changed(connection);
+            }
+
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Can be called from any thread, for work queued from outside of the connection callbacks. Whoever runs
+   the connection picks the request up with connection_is_dowork_requested, the request does not wake it */
+int connection_request_dowork(CONNECTION_HANDLE connection)
+{
+    int result;
+
+    if (connection == NULL)
+    {
+        LogError("NULL connection");
+        result = __FAILURE__;
+    }
+    else
+    {
+        amqp_atomic_store_int(&connection->is_dowork_requested, 1);
+        result = 0;
+    }
+
+    return result;
+}
+
+bool connection_is_dowork_requested(CONNECTION_HANDLE connection)
+{
+    bool result;
+
+    if (connection == NULL)
+    {
+        LogError("NULL connection");
+        result = false;
+    }
+    else
+    {
+        result = (amqp_atomic_load_int(&connection->is_dowork_requested) != 0);
+    }
+
+    return result;
+}
+
+/* Holds back the buffered output until the matching connection_uncork, corks nest */
+int connection_cork(CONNECTION_HANDLE connection)
+{
+    int result;
+
+    if (connection == NULL)
+    {
+        LogError("NULL connection");
+        result = __FAILURE__;
+    }
+    else
+    {
+        connection->cork_count++;
+        result = 0;
+    }
+
+    return result;
+}
+
+int connection_uncork(CONNECTION_HANDLE connection)
+{
+    int result;
+
+    if (connection == NULL)
+    {
+        LogError("NULL connection");
+        result = __FAILURE__;
+    }
+    else if (connection->cork_count == 0)
+    {
+        LogError("Connection is not corked");
+        result = __FAILURE__;
+    }
+    else
+    {
+        connection->cork_count--;
+        if ((connection->cork_count == 0) &&
+            (flush_output(connection) != 0))
+        {
+            LogError("Could not flush the buffered output");
+            xio_close(connection->io, NULL, NULL);
+            connection_set_state(connection, CONNECTION_STATE_END);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
 uint64_t connection_handle_deadlines(CONNECTION_HANDLE connection)
 {
     uint64_t local_deadline = (uint64_t )-1;
     uint64_t remote_deadline = (uint64_t)-1;
+    uint64_t endpoint_deadline = (uint64_t)-1;
 
     if (connection != NULL)
     {
@@ -1410,8 +2222,15 @@ uint64_t connection_handle_deadlines(CONNECTION_HANDLE connection)
                 }
                 else
                 {
-                    connection->on_send_complete = NULL;
-                    if (amqp_frame_codec_encode_empty_frame(connection->amqp_frame_codec, 0, on_bytes_encoded, connection) != 0)
+                    FRAME_SEND_CONTEXT frame_send_context;
+                    frame_send_context.connection = connection;
+                    frame_send_context.endpoint = NULL;
+                    frame_send_context.lane = OUTPUT_LANE_CONTROL;
+                    frame_send_context.on_send_complete = NULL;
+                    frame_send_context.callback_context = NULL;
+                    if ((amqp_frame_codec_encode_empty_frame(connection->amqp_frame_codec, 0, on_bytes_encoded, &frame_send_context) != 0) ||
+                        /* a late heartbeat gets the connection closed by the peer, it does not wait for the end of the dowork */
+                        (flush_output_lane(connection, &connection->output_lanes[OUTPUT_LANE_CONTROL]) != 0))
                     {
                         /* close connection */
                         close_connection_with_error(connection, "amqp:internal-error", "Cannot send empty frame");
@@ -1429,23 +2248,74 @@ uint64_t connection_handle_deadlines(CONNECTION_HANDLE connection)
                     }
                 }
             }
+
+            if (connection->endpoint_dowork_time != (uint64_t)-1)
+            {
+                /* an endpoint timer that is already due still needs a dowork, 0 is reserved for a closed connection */
+                endpoint_deadline = (connection->endpoint_dowork_time > current_ms) ? (connection->endpoint_dowork_time - current_ms) : 1;
+            }
         }
     }
 
+    if (endpoint_deadline < remote_deadline)
+    {
+        remote_deadline = endpoint_deadline;
+    }
+
     /* Return the shorter of each deadline, or 0 to indicate connection closed */
     return local_deadline > remote_deadline ? remote_deadline : local_deadline;
 }
 
+static void notify_endpoints_dowork(CONNECTION_INSTANCE* connection)
+{
+    tickcounter_ms_t current_ms;
+    ENDPOINT_INSTANCE* endpoint = get_next_endpoint(connection, 0);
+
+    connection->endpoint_dowork_time = (uint64_t)-1;
+
+    if ((endpoint != NULL) &&
+        (tickcounter_get_current_ms(connection->tick_counter, &current_ms) == 0))
+    {
+        while (endpoint != NULL)
+        {
+            uint16_t outgoing_channel = endpoint->outgoing_channel;
+
+            if (endpoint->on_endpoint_dowork != NULL)
+            {
+                /* the endpoint reports how long until it needs the next dowork, so that connection_handle_deadlines can include it */
+                uint64_t time_to_dowork = endpoint->on_endpoint_dowork(endpoint->callback_context, (uint64_t)current_ms);
+                if ((time_to_dowork != (uint64_t)-1) &&
+                    ((uint64_t)current_ms + time_to_dowork < connection->endpoint_dowork_time))
+                {
+                    connection->endpoint_dowork_time = (uint64_t)current_ms + time_to_dowork;
+                }
+            }
+
+            endpoint = get_next_endpoint(connection, (uint32_t)outgoing_channel + 1);
+        }
+    }
+}
+
 void connection_dowork(CONNECTION_HANDLE connection)
 {
     /* Codes_SRS_CONNECTION_01_078: [If handle is NULL, connection_dowork shall do nothing.] */
     if (connection != NULL)
     {
+        /* cleared first so that a request made while the endpoints do their work is not lost */
+        amqp_atomic_store_int(&connection->is_dowork_requested, 0);
+
+        /* everything sent during one dowork goes out together */
+        connection->cork_count++;
+
         if (connection_handle_deadlines(connection) > 0)
         {
             /* Codes_SRS_CONNECTION_01_076: [connection_dowork shall schedule the underlying IO interface to do its work by calling xio_dowork.] */
             xio_dowork(connection->io);
+
+            notify_endpoints_dowork(connection);
         }
+
+        (void)connection_uncork(connection);
     }
 }
 
@@ -1489,9 +2359,15 @@ ENDPOINT_HANDLE connection_create_endpoint(CONNECTION_HANDLE connection)
 
                 result->on_endpoint_frame_received = NULL;
                 result->on_connection_state_changed = NULL;
+                result->on_endpoint_dowork = NULL;
+                result->on_endpoint_send_blocked_changed = NULL;
                 result->callback_context = NULL;
                 result->outgoing_channel = (uint16_t)i;
                 result->connection = connection;
+                result->outstanding_send_count = 0;
+                result->is_destroyed = false;
+                /* anything but the current flush count, nothing is queued yet */
+                result->data_lane_flush_count = connection->output_lanes[OUTPUT_LANE_DATA].flush_count - 1;
 
                 /* Codes_SRS_CONNECTION_01_197: [The newly created endpoint shall be added to the endpoints list, so that it can be tracked.] */
                 new_endpoints = (ENDPOINT_INSTANCE**)realloc(connection->endpoints, sizeof(ENDPOINT_INSTANCE*) * (connection->endpoint_count + 1));
@@ -1544,6 +2420,47 @@ int connection_start_endpoint(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_FRAME_RECEIV
     return result;
 }
 
+/* The callback gets the current state right away when the connection is already blocked */
+int connection_endpoint_set_on_send_blocked_changed(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_SEND_BLOCKED_CHANGED on_endpoint_send_blocked_changed)
+{
+    int result;
+
+    if (endpoint == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        endpoint->on_endpoint_send_blocked_changed = on_endpoint_send_blocked_changed;
+        if ((on_endpoint_send_blocked_changed != NULL) &&
+            endpoint->connection->is_send_blocked)
+        {
+            on_endpoint_send_blocked_changed(endpoint->callback_context, true);
+        }
+
+        result = 0;
+    }
+
+    return result;
+}
+
+int connection_endpoint_set_on_dowork(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_DOWORK on_endpoint_dowork)
+{
+    int result;
+
+    if (endpoint == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        endpoint->on_endpoint_dowork = on_endpoint_dowork;
+        result = 0;
+    }
+
+    return result;
+}
+
 int connection_endpoint_get_incoming_channel(ENDPOINT_HANDLE endpoint, uint16_t* incoming_channel)
 {
     int result;
@@ -1580,7 +2497,7 @@ void connection_destroy_endpoint(ENDPOINT_HANDLE endpoint)
 
         /* Codes_SRS_CONNECTION_01_130: [The outgoing channel associated with the endpoint shall be released by removing the endpoint from the endpoint list.] */
         /* Codes_SRS_CONNECTION_01_131: [Any incoming channel number associated with the endpoint shall be released.] */
-		if (i < connection->endpoint_count && i > 0)
+		if ((i < connection->endpoint_count) && (connection->endpoint_count > 1))
 		{
 			(void)memmove(connection->endpoints + i, connection->endpoints + i + 1, sizeof(ENDPOINT_INSTANCE*) * (connection->endpoint_count - i - 1));
 
@@ -1599,7 +2516,15 @@ void connection_destroy_endpoint(ENDPOINT_HANDLE endpoint)
 			connection->endpoint_count = 0;
 		}
 
-        free(endpoint);
+        /* records still buffered or with the IO refer to the endpoint, the last of them frees it without calling back */
+        if (endpoint->outstanding_send_count == 0)
+        {
+            free(endpoint);
+        }
+        else
+        {
+            endpoint->is_destroyed = true;
+        }
     }
 }
 
@@ -1630,15 +2555,24 @@ int connection_encode_frame(ENDPOINT_HANDLE endpoint, const AMQP_VALUE performat
             /* Codes_SRS_CONNECTION_01_250: [connection_encode_frame shall initiate the frame send by calling amqp_frame_codec_begin_encode_frame.] */
             /* Codes_SRS_CONNECTION_01_251: [The channel number passed to amqp_frame_codec_begin_encode_frame shall be the outgoing channel number associated with the endpoint by connection_create_endpoint.] */
             /* Codes_SRS_CONNECTION_01_252: [The performative passed to amqp_frame_codec_begin_encode_frame shall be the performative argument of connection_encode_frame.] */
-            connection->on_send_complete = on_send_complete;
-            connection->on_send_complete_callback_context = callback_context;
-            if (amqp_frame_codec_encode_frame(amqp_frame_codec, endpoint->outgoing_channel, performative, payloads, payload_count, on_bytes_encoded, connection) != 0)
+            FRAME_SEND_CONTEXT frame_send_context;
+            frame_send_context.connection = connection;
+            frame_send_context.endpoint = endpoint;
+            frame_send_context.lane = get_output_lane(connection, endpoint, performative);
+            frame_send_context.on_send_complete = on_send_complete;
+            frame_send_context.callback_context = callback_context;
+            if (amqp_frame_codec_encode_frame(amqp_frame_codec, endpoint->outgoing_channel, performative, payloads, payload_count, on_bytes_encoded, &frame_send_context) != 0)
             {
                 /* Codes_SRS_CONNECTION_01_253: [If amqp_frame_codec_begin_encode_frame or amqp_frame_codec_encode_payload_bytes fails, then connection_encode_frame shall fail and return a non-zero value.] */
                 result = __FAILURE__;
             }
             else
             {
+                if (frame_send_context.lane == OUTPUT_LANE_DATA)
+                {
+                    endpoint->data_lane_flush_count = connection->output_lanes[OUTPUT_LANE_DATA].flush_count;
+                }
+
                 if (connection->is_trace_on == 1)
                 {
                     log_outgoing_frame(performative);
@@ -1660,6 +2594,60 @@ int connection_encode_frame(ENDPOINT_HANDLE endpoint, const AMQP_VALUE performat
     return result;
 }
 
+int connection_encode_preencoded_frame(ENDPOINT_HANDLE endpoint, const PAYLOAD* payloads, size_t payload_count, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+
+    if ((endpoint == NULL) ||
+        (payloads == NULL) ||
+        (payload_count == 0))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        CONNECTION_INSTANCE* connection = (CONNECTION_INSTANCE*)endpoint->connection;
+
+        if (connection->connection_state != CONNECTION_STATE_OPENED)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            FRAME_SEND_CONTEXT frame_send_context;
+            frame_send_context.connection = connection;
+            frame_send_context.endpoint = endpoint;
+            frame_send_context.lane = OUTPUT_LANE_DATA;
+            frame_send_context.on_send_complete = on_send_complete;
+            frame_send_context.callback_context = callback_context;
+            if (amqp_frame_codec_encode_preencoded_frame(connection->amqp_frame_codec, endpoint->outgoing_channel, payloads, payload_count, on_bytes_encoded, &frame_send_context) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                endpoint->data_lane_flush_count = connection->output_lanes[OUTPUT_LANE_DATA].flush_count;
+
+                if (connection->is_trace_on == 1)
+                {
+                    LOG(AZ_LOG_TRACE, LOG_LINE, "-> [pre-encoded frame]");
+                }
+
+                if (tickcounter_get_current_ms(connection->tick_counter, &connection->last_frame_sent_time) != 0)
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    result = 0;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 void connection_set_trace(CONNECTION_HANDLE connection, bool traceOn)
 {
     /* Codes_SRS_CONNECTION_07_002: [If connection is NULL then connection_set_trace shall do nothing.] */
@@ -0,0 +1,854 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/event_loop.h"
+#include "azure_uamqp_c/timer_wheel.h"
+
+#define EVENT_LOOP_MAX_EVENTS 64
+#define NO_DEADLINE ((uint64_t)-1)
+
+typedef enum EVENT_SOURCE_TYPE_TAG
+{
+    EVENT_SOURCE_TYPE_CONNECTION,
+    EVENT_SOURCE_TYPE_SOCKET_LISTENER,
+    EVENT_SOURCE_TYPE_IO
+} EVENT_SOURCE_TYPE;
+
+typedef struct EVENT_SOURCE_TAG
+{
+    EVENT_SOURCE_TYPE type;
+    int fd;
+    size_t index;
+    CONNECTION_HANDLE connection;
+    SOCKET_LISTENER_HANDLE socket_listener;
+    ON_EVENT_LOOP_IO_READY on_io_ready;
+    void* on_io_ready_context;
+    uint64_t deadline;
+    struct EVENT_LOOP_INSTANCE_TAG* event_loop;
+    TIMER_WHEEL_TIMER_HANDLE timer;
+    struct EVENT_SOURCE_TAG* next_removed;
+    struct EVENT_SOURCE_TAG* next_dowork_requested;
+} EVENT_SOURCE;
+
+typedef struct EVENT_LOOP_INSTANCE_TAG
+{
+    int epoll_fd;
+    int timer_fd;
+    int wake_fd;
+    EVENT_SOURCE** sources;
+    size_t source_count;
+    size_t source_capacity;
+    /* sources removed while dispatching are only freed once the dispatch pass is over */
+    EVENT_SOURCE* removed_sources;
+    /* connection deadlines, so that a timer tick only costs the connections that are due */
+    TIMER_WHEEL_HANDLE timer_wheel;
+    uint64_t armed_deadline;
+    uint64_t max_wait;
+    int stop_requested;
+} EVENT_LOOP_INSTANCE;
+
+static uint64_t get_time_ms(void)
+{
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000);
+}
+
+static void schedule_connection_timer(EVENT_SOURCE* source)
+{
+    if (source->deadline == NO_DEADLINE)
+    {
+        (void)timer_wheel_cancel(source->timer);
+    }
+    else if (timer_wheel_schedule(source->timer, source->deadline) != 0)
+    {
+        LogError("Could not schedule the connection deadline");
+    }
+}
+
+static void update_connection_deadline(EVENT_LOOP_INSTANCE* event_loop_instance, EVENT_SOURCE* source, uint64_t now)
+{
+    uint64_t time_to_deadline = connection_handle_deadlines(source->connection);
+
+    /* 0 means that the connection has been closed, it has nothing left to time out */
+    if ((time_to_deadline == 0) ||
+        (time_to_deadline == NO_DEADLINE))
+    {
+        source->deadline = NO_DEADLINE;
+    }
+    else
+    {
+        source->deadline = now + time_to_deadline;
+    }
+
+    if ((event_loop_instance->max_wait != NO_DEADLINE) &&
+        (now + event_loop_instance->max_wait < source->deadline))
+    {
+        source->deadline = now + event_loop_instance->max_wait;
+    }
+
+    schedule_connection_timer(source);
+}
+
+static int add_source(EVENT_LOOP_INSTANCE* event_loop_instance, EVENT_SOURCE* source, uint32_t events)
+{
+    int result;
+
+    if (event_loop_instance->source_count == event_loop_instance->source_capacity)
+    {
+        size_t new_capacity = (event_loop_instance->source_capacity == 0) ? 16 : event_loop_instance->source_capacity * 2;
+        EVENT_SOURCE** new_sources = (EVENT_SOURCE**)realloc(event_loop_instance->sources, sizeof(EVENT_SOURCE*) * new_capacity);
+        if (new_sources != NULL)
+        {
+            event_loop_instance->sources = new_sources;
+            event_loop_instance->source_capacity = new_capacity;
+        }
+    }
+
+    if (event_loop_instance->source_count == event_loop_instance->source_capacity)
+    {
+        LogError("Could not grow the event source array");
+        result = __FAILURE__;
+    }
+    else
+    {
+        struct epoll_event event;
+
+        event.events = events;
+        event.data.ptr = source;
+        if (epoll_ctl(event_loop_instance->epoll_fd, EPOLL_CTL_ADD, source->fd, &event) != 0)
+        {
+            LogError("epoll_ctl failed adding fd %d, errno = %d", source->fd, errno);
+            result = __FAILURE__;
+        }
+        else
+        {
+            source->index = event_loop_instance->source_count;
+            source->next_removed = NULL;
+            event_loop_instance->sources[event_loop_instance->source_count++] = source;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void remove_source(EVENT_LOOP_INSTANCE* event_loop_instance, EVENT_SOURCE* source)
+{
+    EVENT_SOURCE* last_source = event_loop_instance->sources[event_loop_instance->source_count - 1];
+
+    (void)epoll_ctl(event_loop_instance->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+
+    if (source->timer != NULL)
+    {
+        timer_wheel_destroy_timer(source->timer);
+        source->timer = NULL;
+    }
+
+    last_source->index = source->index;
+    event_loop_instance->sources[source->index] = last_source;
+    event_loop_instance->source_count--;
+
+    /* an event for this source may still be waiting in the current batch */
+    source->connection = NULL;
+    source->socket_listener = NULL;
+    source->on_io_ready = NULL;
+    source->next_removed = event_loop_instance->removed_sources;
+    event_loop_instance->removed_sources = source;
+}
+
+static void free_removed_sources(EVENT_LOOP_INSTANCE* event_loop_instance)
+{
+    while (event_loop_instance->removed_sources != NULL)
+    {
+        EVENT_SOURCE* source = event_loop_instance->removed_sources;
+        event_loop_instance->removed_sources = source->next_removed;
+        free(source);
+    }
+}
+
+static EVENT_SOURCE* create_source(EVENT_SOURCE_TYPE type, int fd)
+{
+    EVENT_SOURCE* result = (EVENT_SOURCE*)malloc(sizeof(EVENT_SOURCE));
+    if (result == NULL)
+    {
+        LogError("Could not allocate event source");
+    }
+    else
+    {
+        result->type = type;
+        result->fd = fd;
+        result->index = 0;
+        result->connection = NULL;
+        result->socket_listener = NULL;
+        result->on_io_ready = NULL;
+        result->on_io_ready_context = NULL;
+        result->deadline = NO_DEADLINE;
+        result->event_loop = NULL;
+        result->timer = NULL;
+        result->next_removed = NULL;
+        result->next_dowork_requested = NULL;
+    }
+
+    return result;
+}
+
+static EVENT_SOURCE* find_source(EVENT_LOOP_INSTANCE* event_loop_instance, EVENT_SOURCE_TYPE type, const void* handle, int fd)
+{
+    EVENT_SOURCE* result = NULL;
+    size_t i;
+
+    for (i = 0; i < event_loop_instance->source_count; i++)
+    {
+        EVENT_SOURCE* source = event_loop_instance->sources[i];
+        if ((source->type == type) &&
+            (((type == EVENT_SOURCE_TYPE_CONNECTION) && (source->connection == handle)) ||
+             ((type == EVENT_SOURCE_TYPE_SOCKET_LISTENER) && (source->socket_listener == handle)) ||
+             ((type == EVENT_SOURCE_TYPE_IO) && (source->fd == fd))))
+        {
+            result = source;
+            break;
+        }
+    }
+
+    return result;
+}
+
+static int arm_timer(EVENT_LOOP_INSTANCE* event_loop_instance)
+{
+    int result;
+    uint64_t earliest_deadline;
+
+    if (timer_wheel_get_next_expiry(event_loop_instance->timer_wheel, &earliest_deadline) != 0)
+    {
+        LogError("Could not get the next connection deadline");
+        result = __FAILURE__;
+    }
+    else if (earliest_deadline == event_loop_instance->armed_deadline)
+    {
+        result = 0;
+    }
+    else
+    {
+        struct itimerspec timer_value;
+
+        timer_value.it_interval.tv_sec = 0;
+        timer_value.it_interval.tv_nsec = 0;
+        if (earliest_deadline == NO_DEADLINE)
+        {
+            /* all zero disarms the timer */
+            timer_value.it_value.tv_sec = 0;
+            timer_value.it_value.tv_nsec = 0;
+        }
+        else
+        {
+            /* a deadline of 0 would disarm the timer instead of firing it right away */
+            uint64_t deadline = (earliest_deadline == 0) ? 1 : earliest_deadline;
+            timer_value.it_value.tv_sec = (time_t)(deadline / 1000);
+            timer_value.it_value.tv_nsec = (long)((deadline % 1000) * 1000000);
+        }
+
+        if (timerfd_settime(event_loop_instance->timer_fd, TFD_TIMER_ABSTIME, &timer_value, NULL) != 0)
+        {
+            LogError("timerfd_settime failed, errno = %d", errno);
+            result = __FAILURE__;
+        }
+        else
+        {
+            event_loop_instance->armed_deadline = earliest_deadline;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void dowork_connection(EVENT_LOOP_INSTANCE* event_loop_instance, EVENT_SOURCE* source)
+{
+    connection_dowork(source->connection);
+
+    /* the connection may have been removed from one of its own callbacks */
+    if (source->connection != NULL)
+    {
+        update_connection_deadline(event_loop_instance, source, get_time_ms());
+    }
+}
+
+/* Wakes are how other threads get connection_request_dowork picked up */
+static void dowork_requested_connections(EVENT_LOOP_INSTANCE* event_loop_instance)
+{
+    EVENT_SOURCE* requested_sources = NULL;
+    size_t i;
+
+    /* collected before any dowork, as the doworks can add and remove sources */
+    for (i = 0; i < event_loop_instance->source_count; i++)
+    {
+        EVENT_SOURCE* source = event_loop_instance->sources[i];
+        if ((source->type == EVENT_SOURCE_TYPE_CONNECTION) &&
+            connection_is_dowork_requested(source->connection))
+        {
+            source->next_dowork_requested = requested_sources;
+            requested_sources = source;
+        }
+    }
+
+    while (requested_sources != NULL)
+    {
+        EVENT_SOURCE* source = requested_sources;
+        requested_sources = source->next_dowork_requested;
+
+        /* removed sources are only freed once the dispatch pass is over */
+        if (source->connection != NULL)
+        {
+            dowork_connection(event_loop_instance, source);
+        }
+    }
+}
+
+static void on_connection_timer_expired(void* context)
+{
+    EVENT_SOURCE* source = (EVENT_SOURCE*)context;
+    source->deadline = NO_DEADLINE;
+    dowork_connection(source->event_loop, source);
+}
+
+static void on_timer_expired(EVENT_LOOP_INSTANCE* event_loop_instance)
+{
+    uint64_t expirations;
+
+    (void)read(event_loop_instance->timer_fd, &expirations, sizeof(expirations));
+    event_loop_instance->armed_deadline = NO_DEADLINE;
+
+    if (timer_wheel_advance(event_loop_instance->timer_wheel, get_time_ms()) != 0)
+    {
+        LogError("Could not advance the connection timers");
+    }
+}
+
+EVENT_LOOP_HANDLE event_loop_create(void)
+{
+    EVENT_LOOP_INSTANCE* result = (EVENT_LOOP_INSTANCE*)malloc(sizeof(EVENT_LOOP_INSTANCE));
+    if (result == NULL)
+    {
+        LogError("Could not allocate event loop");
+    }
+    else
+    {
+        result->sources = NULL;
+        result->source_count = 0;
+        result->source_capacity = 0;
+        result->removed_sources = NULL;
+        result->armed_deadline = NO_DEADLINE;
+        result->max_wait = NO_DEADLINE;
+        result->stop_requested = 0;
+
+        result->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (result->epoll_fd == -1)
+        {
+            LogError("epoll_create1 failed, errno = %d", errno);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (result->timer_fd == -1)
+            {
+                LogError("timerfd_create failed, errno = %d", errno);
+                (void)close(result->epoll_fd);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                result->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if (result->wake_fd == -1)
+                {
+                    LogError("eventfd failed, errno = %d", errno);
+                    (void)close(result->timer_fd);
+                    (void)close(result->epoll_fd);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    struct epoll_event timer_event;
+                    struct epoll_event wake_event;
+
+                    /* the timer and wake fds are told apart from the sources by their data pointer */
+                    timer_event.events = EPOLLIN;
+                    timer_event.data.ptr = &result->timer_fd;
+                    wake_event.events = EPOLLIN;
+                    wake_event.data.ptr = &result->wake_fd;
+
+                    if ((epoll_ctl(result->epoll_fd, EPOLL_CTL_ADD, result->timer_fd, &timer_event) != 0) ||
+                        (epoll_ctl(result->epoll_fd, EPOLL_CTL_ADD, result->wake_fd, &wake_event) != 0))
+                    {
+                        LogError("epoll_ctl failed, errno = %d", errno);
+                        (void)close(result->wake_fd);
+                        (void)close(result->timer_fd);
+                        (void)close(result->epoll_fd);
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        result->timer_wheel = timer_wheel_create(get_time_ms());
+                        if (result->timer_wheel == NULL)
+                        {
+                            LogError("Could not create the timer wheel");
+                            (void)close(result->wake_fd);
+                            (void)close(result->timer_fd);
+                            (void)close(result->epoll_fd);
+                            free(result);
+                            result = NULL;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+void event_loop_destroy(EVENT_LOOP_HANDLE event_loop)
+{
+    if (event_loop != NULL)
+    {
+        size_t i;
+
+        /* the connections, listeners and fds themselves still belong to whoever added them */
+        for (i = 0; i < event_loop->source_count; i++)
+        {
+            if (event_loop->sources[i]->timer != NULL)
+            {
+                timer_wheel_destroy_timer(event_loop->sources[i]->timer);
+            }
+
+            free(event_loop->sources[i]);
+        }
+
+        free_removed_sources(event_loop);
+        timer_wheel_destroy(event_loop->timer_wheel);
+        free(event_loop->sources);
+        (void)close(event_loop->wake_fd);
+        (void)close(event_loop->timer_fd);
+        (void)close(event_loop->epoll_fd);
+        free(event_loop);
+    }
+}
+
+int event_loop_add_connection(EVENT_LOOP_HANDLE event_loop, CONNECTION_HANDLE connection, int socket)
+{
+    int result;
+
+    if ((event_loop == NULL) ||
+        (connection == NULL) ||
+        (socket < 0))
+    {
+        LogError("Bad arguments: event_loop = %p, connection = %p, socket = %d", event_loop, connection, socket);
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_SOURCE* source = create_source(EVENT_SOURCE_TYPE_CONNECTION, socket);
+        if (source == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            source->connection = connection;
+            source->event_loop = event_loop;
+            source->timer = timer_wheel_create_timer(event_loop->timer_wheel, on_connection_timer_expired, source);
+            if (source->timer == NULL)
+            {
+                LogError("Could not create the connection timer");
+                free(source);
+                result = __FAILURE__;
+            }
+            /* edge triggered: the IO reads until the socket is drained, and a writable edge after a full send buffer gets queued bytes flushed */
+            else if (add_source(event_loop, source, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET) != 0)
+            {
+                timer_wheel_destroy_timer(source->timer);
+                free(source);
+                result = __FAILURE__;
+            }
+            else
+            {
+                update_connection_deadline(event_loop, source, get_time_ms());
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+int event_loop_remove_connection(EVENT_LOOP_HANDLE event_loop, CONNECTION_HANDLE connection)
+{
+    int result;
+
+    if ((event_loop == NULL) ||
+        (connection == NULL))
+    {
+        LogError("Bad arguments: event_loop = %p, connection = %p", event_loop, connection);
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_SOURCE* source = find_source(event_loop, EVENT_SOURCE_TYPE_CONNECTION, connection, -1);
+        if (source == NULL)
+        {
+            LogError("Connection is not in the event loop");
+            result = __FAILURE__;
+        }
+        else
+        {
+            remove_source(event_loop, source);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int event_loop_add_socket_listener(EVENT_LOOP_HANDLE event_loop, SOCKET_LISTENER_HANDLE socket_listener)
+{
+    int result;
+    int listening_socket;
+
+    if ((event_loop == NULL) ||
+        (socket_listener == NULL))
+    {
+        LogError("Bad arguments: event_loop = %p, socket_listener = %p", event_loop, socket_listener);
+        result = __FAILURE__;
+    }
+    else if (socketlistener_get_socket(socket_listener, &listening_socket) != 0)
+    {
+        LogError("Could not get the listening socket");
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_SOURCE* source = create_source(EVENT_SOURCE_TYPE_SOCKET_LISTENER, listening_socket);
+        if (source == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            source->socket_listener = socket_listener;
+
+            /* level triggered, pending connections keep waking the loop until they are all accepted */
+            if (add_source(event_loop, source, EPOLLIN) != 0)
+            {
+                free(source);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+int event_loop_remove_socket_listener(EVENT_LOOP_HANDLE event_loop, SOCKET_LISTENER_HANDLE socket_listener)
+{
+    int result;
+
+    if ((event_loop == NULL) ||
+        (socket_listener == NULL))
+    {
+        LogError("Bad arguments: event_loop = %p, socket_listener = %p", event_loop, socket_listener);
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_SOURCE* source = find_source(event_loop, EVENT_SOURCE_TYPE_SOCKET_LISTENER, socket_listener, -1);
+        if (source == NULL)
+        {
+            LogError("Socket listener is not in the event loop");
+            result = __FAILURE__;
+        }
+        else
+        {
+            remove_source(event_loop, source);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int event_loop_add_io(EVENT_LOOP_HANDLE event_loop, int fd, ON_EVENT_LOOP_IO_READY on_io_ready, void* context)
+{
+    int result;
+
+    if ((event_loop == NULL) ||
+        (fd < 0) ||
+        (on_io_ready == NULL))
+    {
+        LogError("Bad arguments: event_loop = %p, fd = %d, on_io_ready = %p", event_loop, fd, on_io_ready);
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_SOURCE* source = create_source(EVENT_SOURCE_TYPE_IO, fd);
+        if (source == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            source->on_io_ready = on_io_ready;
+            source->on_io_ready_context = context;
+
+            if (add_source(event_loop, source, EPOLLIN) != 0)
+            {
+                free(source);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+int event_loop_remove_io(EVENT_LOOP_HANDLE event_loop, int fd)
+{
+    int result;
+
+    if (event_loop == NULL)
+    {
+        LogError("NULL event_loop");
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_SOURCE* source = find_source(event_loop, EVENT_SOURCE_TYPE_IO, NULL, fd);
+        if (source == NULL)
+        {
+            LogError("fd %d is not in the event loop", fd);
+            result = __FAILURE__;
+        }
+        else
+        {
+            remove_source(event_loop, source);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Caps the time a connection goes without dowork, for work queued from outside of its callbacks without connection_request_dowork and event_loop_wake */
+int event_loop_set_max_wait(EVENT_LOOP_HANDLE event_loop, uint64_t max_wait_ms)
+{
+    int result;
+
+    if (event_loop == NULL)
+    {
+        LogError("NULL event_loop");
+        result = __FAILURE__;
+    }
+    else
+    {
+        uint64_t now = get_time_ms();
+        size_t i;
+
+        event_loop->max_wait = max_wait_ms;
+        for (i = 0; i < event_loop->source_count; i++)
+        {
+            if ((event_loop->sources[i]->type == EVENT_SOURCE_TYPE_CONNECTION) &&
+                (max_wait_ms != NO_DEADLINE) &&
+                (now + max_wait_ms < event_loop->sources[i]->deadline))
+            {
+                event_loop->sources[i]->deadline = now + max_wait_ms;
+                schedule_connection_timer(event_loop->sources[i]);
+            }
+        }
+
+        result = 0;
+    }
+
+    return result;
+}
+
+int event_loop_run_once(EVENT_LOOP_HANDLE event_loop)
+{
+    int result;
+
+    if (event_loop == NULL)
+    {
+        LogError("NULL event_loop");
+        result = __FAILURE__;
+    }
+    else if (arm_timer(event_loop) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+        int event_count = epoll_wait(event_loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, -1);
+
+        if (event_count < 0)
+        {
+            if (errno == EINTR)
+            {
+                result = 0;
+            }
+            else
+            {
+                LogError("epoll_wait failed, errno = %d", errno);
+                result = __FAILURE__;
+            }
+        }
+        else
+        {
+            int i;
+
+            for (i = 0; i < event_count; i++)
+            {
+                if (events[i].data.ptr == &event_loop->timer_fd)
+                {
+                    on_timer_expired(event_loop);
+                }
+                else if (events[i].data.ptr == &event_loop->wake_fd)
+                {
+                    uint64_t wake_count;
+                    (void)read(event_loop->wake_fd, &wake_count, sizeof(wake_count));
+                    dowork_requested_connections(event_loop);
+                }
+                else
+                {
+                    EVENT_SOURCE* source = (EVENT_SOURCE*)events[i].data.ptr;
+
+                    switch (source->type)
+                    {
+                    default:
+                        break;
+                    case EVENT_SOURCE_TYPE_CONNECTION:
+                        if (source->connection != NULL)
+                        {
+                            dowork_connection(event_loop, source);
+                        }
+                        break;
+                    case EVENT_SOURCE_TYPE_SOCKET_LISTENER:
+                        if (source->socket_listener != NULL)
+                        {
+                            socketlistener_dowork(source->socket_listener);
+                        }
+                        break;
+                    case EVENT_SOURCE_TYPE_IO:
+                        if (source->on_io_ready != NULL)
+                        {
+                            source->on_io_ready(source->on_io_ready_context);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            result = 0;
+        }
+
+        free_removed_sources(event_loop);
+    }
+
+    return result;
+}
+
+int event_loop_run(EVENT_LOOP_HANDLE event_loop)
+{
+    int result;
+
+    if (event_loop == NULL)
+    {
+        LogError("NULL event_loop");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+
+        while (__atomic_exchange_n(&event_loop->stop_requested, 0, __ATOMIC_ACQ_REL) == 0)
+        {
+            if (event_loop_run_once(event_loop) != 0)
+            {
+                result = __FAILURE__;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/* Can be called from any thread */
+int event_loop_stop(EVENT_LOOP_HANDLE event_loop)
+{
+    int result;
+
+    if (event_loop == NULL)
+    {
+        LogError("NULL event_loop");
+        result = __FAILURE__;
+    }
+    else
+    {
+        __atomic_store_n(&event_loop->stop_requested, 1, __ATOMIC_RELEASE);
+        result = event_loop_wake(event_loop);
+    }
+
+    return result;
+}
+
+/* Can be called from any thread, makes a blocked event_loop_run_once return after the dowork of the connections that had one requested */
+int event_loop_wake(EVENT_LOOP_HANDLE event_loop)
+{
+    int result;
+
+    if (event_loop == NULL)
+    {
+        LogError("NULL event_loop");
+        result = __FAILURE__;
+    }
+    else
+    {
+        uint64_t one = 1;
+        if ((write(event_loop->wake_fd, &one, sizeof(one)) != sizeof(one)) &&
+            (errno != EAGAIN))
+        {
+            LogError("Could not signal the event loop, errno = %d", errno);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
@@ -13,9 +13,10 @@
 #include "azure_uamqp_c/amqp_frame_codec.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
 
 #define DEFAULT_LINK_CREDIT 10000
+#define INITIAL_PENDING_DELIVERY_CAPACITY 16
+#define DELIVERY_POOL_CHUNK_SIZE 64
 
 typedef struct DELIVERY_INSTANCE_TAG
 {
@@ -23,8 +24,24 @@ typedef struct DELIVERY_INSTANCE_TAG
 	ON_DELIVERY_SETTLED on_delivery_settled;
 	void* callback_context;
 	void* link;
+	uint32_t pending_delivery_index;
+	struct DELIVERY_INSTANCE_TAG* next_free;
 } DELIVERY_INSTANCE;
 
+/* Slots of the pending delivery ring; a slot whose delivery is NULL has already been settled */
+typedef struct PENDING_DELIVERY_SLOT_TAG
+{
+	delivery_number delivery_id;
+	DELIVERY_INSTANCE* delivery;
+} PENDING_DELIVERY_SLOT;
+
+/* Buffer holding one frame of a multi-frame transfer in segmented receive mode, reused across transfers */
+typedef struct RECEIVED_SEGMENT_TAG
+{
+	unsigned char* bytes;
+	uint32_t capacity;
+} RECEIVED_SEGMENT;
+
 typedef struct LINK_INSTANCE_TAG
 {
 	SESSION_HANDLE session;
@@ -35,7 +52,14 @@ typedef struct LINK_INSTANCE_TAG
 	handle handle;
 	LINK_ENDPOINT_HANDLE link_endpoint;
 	char* name;
-	SINGLYLINKEDLIST_HANDLE pending_deliveries;
+	PENDING_DELIVERY_SLOT* pending_deliveries;
+	uint32_t pending_delivery_capacity;
+	uint32_t pending_delivery_head;
+	uint32_t pending_delivery_tail;
+	DELIVERY_INSTANCE* free_deliveries;
+	DELIVERY_INSTANCE** delivery_chunks;
+	size_t delivery_chunk_count;
+	DELIVERY_INSTANCE* streaming_delivery;
 	sequence_no delivery_count;
 	role role;
 	ON_LINK_STATE_CHANGED on_link_state_changed;
@@ -48,12 +72,37 @@ typedef struct LINK_INSTANCE_TAG
 	uint64_t max_message_size;
 	uint32_t link_credit;
 	uint32_t available;
+	uint32_t max_link_credit;
+	uint32_t link_credit_refill_threshold;
+	LINK_CREDIT_MODE link_credit_mode;
+	/* ids of the received deliveries the application still has to dispose, in the order they arrived */
+	delivery_number* undisposed_delivery_ids;
+	uint32_t undisposed_delivery_count;
+	uint32_t undisposed_delivery_capacity;
+	uint32_t max_disposition_batch_size;
+	milliseconds disposition_batch_timeout;
+	AMQP_VALUE pending_disposition_state;
+	delivery_number pending_disposition_first;
+	delivery_number pending_disposition_last;
+	uint32_t pending_disposition_count;
+	uint64_t pending_disposition_start_time;
+	bool is_pending_disposition_timer_started;
     fields attach_properties;
     bool is_underlying_session_begun;
     bool is_closed;
     unsigned char* received_payload;
     uint32_t received_payload_size;
+    uint32_t received_payload_capacity;
+    ON_TRANSFER_SEGMENTS_RECEIVED on_transfer_segments_received;
+    ON_TRANSFER_FRAME_RECEIVED on_transfer_frame_received;
+    ON_LINK_DOWORK on_link_dowork;
+    bool is_receiving_streamed_transfer;
+    RECEIVED_SEGMENT* received_segment_buffers;
+    PAYLOAD* received_segments;
+    size_t received_segment_buffer_count;
+    size_t received_segment_count;
     delivery_number received_delivery_id;
+    bool is_received_delivery_settled;
 } LINK_INSTANCE;
 
 static void set_link_state(LINK_INSTANCE* link_instance, LINK_STATE link_state)
@@ -67,52 +116,245 @@ static void set_link_state(LINK_INSTANCE* link_instance, LINK_STATE link_state)
 	}
 }
 
+static DELIVERY_INSTANCE* allocate_delivery(LINK_INSTANCE* link)
+{
+	DELIVERY_INSTANCE* result;
+
+	if (link->free_deliveries == NULL)
+	{
+		DELIVERY_INSTANCE** new_delivery_chunks = (DELIVERY_INSTANCE**)realloc(link->delivery_chunks, sizeof(DELIVERY_INSTANCE*) * (link->delivery_chunk_count + 1));
+		if (new_delivery_chunks == NULL)
+		{
+			LogError("Could not grow the delivery chunk array");
+		}
+		else
+		{
+			DELIVERY_INSTANCE* new_chunk;
+
+			link->delivery_chunks = new_delivery_chunks;
+			new_chunk = (DELIVERY_INSTANCE*)malloc(sizeof(DELIVERY_INSTANCE) * DELIVERY_POOL_CHUNK_SIZE);
+			if (new_chunk == NULL)
+			{
+				LogError("Could not allocate a delivery chunk");
+			}
+			else
+			{
+				size_t i;
+
+				for (i = 0; i < DELIVERY_POOL_CHUNK_SIZE - 1; i++)
+				{
+					new_chunk[i].next_free = &new_chunk[i + 1];
+				}
+
+				new_chunk[DELIVERY_POOL_CHUNK_SIZE - 1].next_free = NULL;
+				link->delivery_chunks[link->delivery_chunk_count] = new_chunk;
+				link->delivery_chunk_count++;
+				link->free_deliveries = new_chunk;
+			}
+		}
+	}
+
+	result = link->free_deliveries;
+	if (result != NULL)
+	{
+		link->free_deliveries = result->next_free;
+		result->next_free = NULL;
+	}
+
+	return result;
+}
+
+static void release_delivery(LINK_INSTANCE* link, DELIVERY_INSTANCE* delivery_instance)
+{
+	delivery_instance->next_free = link->free_deliveries;
+	link->free_deliveries = delivery_instance;
+}
+
+static PENDING_DELIVERY_SLOT* get_pending_delivery_slot(LINK_INSTANCE* link, uint32_t index)
+{
+	return &link->pending_deliveries[index & (link->pending_delivery_capacity - 1)];
+}
+
+static int add_pending_delivery(LINK_INSTANCE* link, DELIVERY_INSTANCE* delivery_instance)
+{
+	int result;
+
+	if (link->pending_delivery_tail - link->pending_delivery_head == link->pending_delivery_capacity)
+	{
+		uint32_t new_capacity = (link->pending_delivery_capacity == 0) ? INITIAL_PENDING_DELIVERY_CAPACITY : link->pending_delivery_capacity * 2;
+		PENDING_DELIVERY_SLOT* new_pending_deliveries = (PENDING_DELIVERY_SLOT*)malloc(sizeof(PENDING_DELIVERY_SLOT) * new_capacity);
+		if (new_pending_deliveries == NULL)
+		{
+			LogError("Could not grow the pending delivery ring");
+			result = __FAILURE__;
+		}
+		else
+		{
+			uint32_t i;
+
+			/* slots are addressed by their absolute index, so re-home them for the new mask */
+			for (i = link->pending_delivery_head; i != link->pending_delivery_tail; i++)
+			{
+				new_pending_deliveries[i & (new_capacity - 1)] = *get_pending_delivery_slot(link, i);
+			}
+
+			free(link->pending_deliveries);
+			link->pending_deliveries = new_pending_deliveries;
+			link->pending_delivery_capacity = new_capacity;
+			result = 0;
+		}
+	}
+	else
+	{
+		result = 0;
+	}
+
+	if (result == 0)
+	{
+		PENDING_DELIVERY_SLOT* slot = get_pending_delivery_slot(link, link->pending_delivery_tail);
+		slot->delivery_id = delivery_instance->delivery_id;
+		slot->delivery = delivery_instance;
+		delivery_instance->pending_delivery_index = link->pending_delivery_tail;
+		link->pending_delivery_tail++;
+	}
+
+	return result;
+}
+
+static void remove_pending_delivery(LINK_INSTANCE* link, DELIVERY_INSTANCE* delivery_instance)
+{
+	PENDING_DELIVERY_SLOT* slot = get_pending_delivery_slot(link, delivery_instance->pending_delivery_index);
+
+	slot->delivery_id = delivery_instance->delivery_id;
+	slot->delivery = NULL;
+	if (link->streaming_delivery == delivery_instance)
+	{
+		link->streaming_delivery = NULL;
+	}
+
+	release_delivery(link, delivery_instance);
+
+	/* settled slots are reclaimed once nothing older is outstanding */
+	while ((link->pending_delivery_head != link->pending_delivery_tail) &&
+		(get_pending_delivery_slot(link, link->pending_delivery_head)->delivery == NULL))
+	{
+		link->pending_delivery_head++;
+	}
+
+	while ((link->pending_delivery_tail != link->pending_delivery_head) &&
+		(get_pending_delivery_slot(link, link->pending_delivery_tail - 1)->delivery == NULL))
+	{
+		link->pending_delivery_tail--;
+	}
+}
+
+/* Delivery ids are handed out in increasing order, so the ring is sorted by delivery id. With a single link
+   on the session the ids are contiguous and the slot is found directly, otherwise fall back to a binary search */
+static uint32_t find_first_pending_delivery_index(LINK_INSTANCE* link, delivery_number delivery_id)
+{
+	uint32_t result;
+	delivery_number head_delivery_id = get_pending_delivery_slot(link, link->pending_delivery_head)->delivery_id;
+	uint32_t offset = delivery_id - head_delivery_id;
+	uint32_t count = link->pending_delivery_tail - link->pending_delivery_head;
+
+	if ((int32_t)offset <= 0)
+	{
+		result = link->pending_delivery_head;
+	}
+	else if ((offset < count) &&
+		(get_pending_delivery_slot(link, link->pending_delivery_head + offset)->delivery_id == delivery_id))
+	{
+		result = link->pending_delivery_head + offset;
+	}
+	else
+	{
+		uint32_t low = 0;
+		uint32_t high = count;
+
+		while (low < high)
+		{
+			uint32_t middle = low + ((high - low) / 2);
+			if ((uint32_t)(get_pending_delivery_slot(link, link->pending_delivery_head + middle)->delivery_id - head_delivery_id) < offset)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		result = link->pending_delivery_head + low;
+	}
+
+	return result;
+}
+
 static void remove_all_pending_deliveries(LINK_INSTANCE* link, bool indicate_settled)
 {
-    if (link->pending_deliveries != NULL)
-    {
-        LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(link->pending_deliveries);
-        while (item != NULL)
-        {
-            LIST_ITEM_HANDLE next_item = singlylinkedlist_get_next_item(item);
-            DELIVERY_INSTANCE* delivery_instance = (DELIVERY_INSTANCE*)singlylinkedlist_item_get_value(item);
-            if (delivery_instance != NULL)
-            {
-                if (indicate_settled && (delivery_instance->on_delivery_settled != NULL))
-                {
-                    delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, NULL);
-                }
-                free(delivery_instance);
-            }
+	/* the head slot always holds an unsettled delivery, settled ones are reclaimed as the head moves */
+	while (link->pending_delivery_head != link->pending_delivery_tail)
+	{
+		DELIVERY_INSTANCE* delivery_instance = get_pending_delivery_slot(link, link->pending_delivery_head)->delivery;
+		if (indicate_settled && (delivery_instance->on_delivery_settled != NULL))
+		{
+			delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, NULL);
+		}
 
-            item = next_item;
-        }
+		remove_pending_delivery(link, delivery_instance);
+	}
+}
 
-        singlylinkedlist_destroy(link->pending_deliveries);
-        link->pending_deliveries = NULL;
-    }
+static void free_pending_deliveries(LINK_INSTANCE* link)
+{
+	size_t i;
+
+	remove_all_pending_deliveries(link, false);
+
+	for (i = 0; i < link->delivery_chunk_count; i++)
+	{
+		free(link->delivery_chunks[i]);
+	}
+
+	if (link->delivery_chunks != NULL)
+	{
+		free(link->delivery_chunks);
+		link->delivery_chunks = NULL;
+	}
+
+	if (link->pending_deliveries != NULL)
+	{
+		free(link->pending_deliveries);
+		link->pending_deliveries = NULL;
+	}
+
+	link->delivery_chunk_count = 0;
+	link->free_deliveries = NULL;
+	link->pending_delivery_capacity = 0;
+	link->pending_delivery_head = 0;
+	link->pending_delivery_tail = 0;
 }
 
-static int send_flow(LINK_INSTANCE* link)
+static int send_disposition(LINK_INSTANCE* link_instance, delivery_number first, delivery_number last, AMQP_VALUE delivery_state)
 {
 	int result;
-	FLOW_HANDLE flow = flow_create(0, 0, 0);
 
-	if (flow == NULL)
+	DISPOSITION_HANDLE disposition = disposition_create(link_instance->role, first);
+	if (disposition == NULL)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		if ((flow_set_link_credit(flow, link->link_credit) != 0) ||
-			(flow_set_handle(flow, link->handle) != 0) ||
-			(flow_set_delivery_count(flow, link->delivery_count) != 0))
+		if ((disposition_set_last(disposition, last) != 0) ||
+			(disposition_set_settled(disposition, true) != 0) ||
+			((delivery_state != NULL) && (disposition_set_state(disposition, delivery_state) != 0)))
 		{
 			result = __FAILURE__;
 		}
 		else
 		{
-			if (session_send_flow(link->link_endpoint, flow) != 0)
+			if (session_send_disposition(link_instance->link_endpoint, disposition) != 0)
 			{
 				result = __FAILURE__;
 			}
@@ -122,32 +364,122 @@ static int send_flow(LINK_INSTANCE* link)
 			}
 		}
 
-		flow_destroy(flow);
+		disposition_destroy(disposition);
 	}
 
 	return result;
 }
 
-static int send_disposition(LINK_INSTANCE* link_instance, delivery_number delivery_number, AMQP_VALUE delivery_state)
+static void discard_pending_disposition(LINK_INSTANCE* link_instance)
+{
+	if (link_instance->pending_disposition_state != NULL)
+	{
+		amqpvalue_destroy(link_instance->pending_disposition_state);
+		link_instance->pending_disposition_state = NULL;
+	}
+
+	link_instance->pending_disposition_count = 0;
+	link_instance->is_pending_disposition_timer_started = false;
+}
+
+static int flush_pending_disposition(LINK_INSTANCE* link_instance)
 {
 	int result;
 
-	DISPOSITION_HANDLE disposition = disposition_create(link_instance->role, delivery_number);
-	if (disposition == NULL)
+	if (link_instance->pending_disposition_count == 0)
+	{
+		result = 0;
+	}
+	else
+	{
+		if (send_disposition(link_instance, link_instance->pending_disposition_first, link_instance->pending_disposition_last, link_instance->pending_disposition_state) != 0)
+		{
+			LogError("Cannot send disposition frame");
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+
+		discard_pending_disposition(link_instance);
+	}
+
+	return result;
+}
+
+/* Contiguous delivery ids settled with the same outcome are coalesced into a single ranged disposition */
+static int queue_disposition(LINK_INSTANCE* link_instance, delivery_number delivery_id, AMQP_VALUE delivery_state)
+{
+	int result;
+
+	if (link_instance->max_disposition_batch_size <= 1)
+	{
+		result = send_disposition(link_instance, delivery_id, delivery_id, delivery_state);
+	}
+	else
+	{
+		if ((link_instance->pending_disposition_count > 0) &&
+			(delivery_id == link_instance->pending_disposition_last + 1) &&
+			amqpvalue_are_equal(delivery_state, link_instance->pending_disposition_state))
+		{
+			link_instance->pending_disposition_last = delivery_id;
+			link_instance->pending_disposition_count++;
+			result = 0;
+		}
+		else
+		{
+			(void)flush_pending_disposition(link_instance);
+
+			link_instance->pending_disposition_state = amqpvalue_clone(delivery_state);
+			if (link_instance->pending_disposition_state == NULL)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				link_instance->pending_disposition_first = delivery_id;
+				link_instance->pending_disposition_last = delivery_id;
+				link_instance->pending_disposition_count = 1;
+				result = 0;
+			}
+		}
+
+		if ((result == 0) &&
+			(link_instance->pending_disposition_count >= link_instance->max_disposition_batch_size))
+		{
+			result = flush_pending_disposition(link_instance);
+		}
+	}
+
+	return result;
+}
+
+static int send_flow(LINK_INSTANCE* link)
+{
+	int result;
+	FLOW_HANDLE flow;
+
+	/* Settlements must reach the peer before the credit they free up */
+	(void)flush_pending_disposition(link);
+
+	flow = flow_create(0, 0, 0);
+
+	if (flow == NULL)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		if ((disposition_set_last(disposition, delivery_number) != 0) ||
-			(disposition_set_settled(disposition, true) != 0) ||
-			((delivery_state != NULL) && (disposition_set_state(disposition, delivery_state) != 0)))
+		if ((flow_set_link_credit(flow, link->link_credit) != 0) ||
+			(flow_set_handle(flow, link->handle) != 0) ||
+			(flow_set_delivery_count(flow, link->delivery_count) != 0))
 		{
 			result = __FAILURE__;
 		}
 		else
 		{
-			if (session_send_disposition(link_instance->link_endpoint, disposition) != 0)
+			if (session_send_flow(link->link_endpoint, flow) != 0)
 			{
 				result = __FAILURE__;
 			}
@@ -157,12 +489,106 @@ static int send_disposition(LINK_INSTANCE* link_instance, delivery_number delive
 			}
 		}
 
-		disposition_destroy(disposition);
+		flow_destroy(flow);
+	}
+
+	return result;
+}
+
+/* In adaptive mode only the credit for deliveries the application has already disposed is given back,
+   so the peer can never get more than max_link_credit deliveries ahead of the application */
+static uint32_t get_link_credit_to_grant(LINK_INSTANCE* link_instance)
+{
+	uint32_t result;
+
+	if (link_instance->link_credit_mode == LINK_CREDIT_MODE_ADAPTIVE)
+	{
+		if (link_instance->undisposed_delivery_count >= link_instance->max_link_credit)
+		{
+			result = 0;
+		}
+		else
+		{
+			result = link_instance->max_link_credit - link_instance->undisposed_delivery_count;
+		}
+	}
+	else
+	{
+		result = link_instance->max_link_credit;
+	}
+
+	return result;
+}
+
+static int add_undisposed_delivery(LINK_INSTANCE* link_instance, delivery_number delivery_id)
+{
+	int result;
+
+	if (link_instance->undisposed_delivery_count == link_instance->undisposed_delivery_capacity)
+	{
+		uint32_t new_capacity = (link_instance->undisposed_delivery_capacity == 0) ? 16 : link_instance->undisposed_delivery_capacity * 2;
+		delivery_number* new_ids = (delivery_number*)realloc(link_instance->undisposed_delivery_ids, sizeof(delivery_number) * new_capacity);
+		if (new_ids == NULL)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			link_instance->undisposed_delivery_ids = new_ids;
+			link_instance->undisposed_delivery_capacity = new_capacity;
+			result = 0;
+		}
+	}
+	else
+	{
+		result = 0;
+	}
+
+	if (result == 0)
+	{
+		link_instance->undisposed_delivery_ids[link_instance->undisposed_delivery_count] = delivery_id;
+		link_instance->undisposed_delivery_count++;
 	}
 
 	return result;
 }
 
+/* Dispositions mostly come in delivery order, so the id is usually found at the front */
+static bool remove_undisposed_delivery(LINK_INSTANCE* link_instance, delivery_number delivery_id)
+{
+	bool result = false;
+	uint32_t i;
+
+	for (i = 0; i < link_instance->undisposed_delivery_count; i++)
+	{
+		if (link_instance->undisposed_delivery_ids[i] == delivery_id)
+		{
+			(void)memmove(&link_instance->undisposed_delivery_ids[i], &link_instance->undisposed_delivery_ids[i + 1], sizeof(delivery_number) * (link_instance->undisposed_delivery_count - i - 1));
+			link_instance->undisposed_delivery_count--;
+			result = true;
+			break;
+		}
+	}
+
+	return result;
+}
+
+static void replenish_link_credit(LINK_INSTANCE* link_instance)
+{
+	if (link_instance->link_credit <= link_instance->link_credit_refill_threshold)
+	{
+		uint32_t new_link_credit = get_link_credit_to_grant(link_instance);
+		if (new_link_credit > link_instance->link_credit)
+		{
+			link_instance->link_credit = new_link_credit;
+			if (send_flow(link_instance) != 0)
+			{
+				LogError("Cannot send flow frame");
+			}
+		}
+	}
+}
+
 static int send_detach(LINK_INSTANCE* link_instance, bool close, ERROR_HANDLE error_handle)
 {
 	int result;
@@ -258,6 +684,146 @@ static int send_attach(LINK_INSTANCE* link, const char* name, handle handle, rol
     return result;
 }
 
+/* Appends a frame to the contiguous reassembly buffer, doubling its capacity when it is full */
+static int append_received_payload(LINK_INSTANCE* link_instance, const unsigned char* payload_bytes, uint32_t payload_size)
+{
+    int result;
+
+    if (payload_size > UINT32_MAX - link_instance->received_payload_size)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        uint32_t needed_capacity = link_instance->received_payload_size + payload_size;
+
+        if (needed_capacity > link_instance->received_payload_capacity)
+        {
+            uint32_t new_capacity = (link_instance->received_payload_capacity == 0) ? needed_capacity : link_instance->received_payload_capacity;
+            unsigned char* new_received_payload;
+
+            while (new_capacity < needed_capacity)
+            {
+                new_capacity = (new_capacity > UINT32_MAX / 2) ? needed_capacity : new_capacity * 2;
+            }
+
+            new_received_payload = (unsigned char*)realloc(link_instance->received_payload, new_capacity);
+            if (new_received_payload == NULL)
+            {
+                needed_capacity = 0;
+            }
+            else
+            {
+                link_instance->received_payload = new_received_payload;
+                link_instance->received_payload_capacity = new_capacity;
+            }
+        }
+
+        if (needed_capacity == 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            (void)memcpy(link_instance->received_payload + link_instance->received_payload_size, payload_bytes, payload_size);
+            link_instance->received_payload_size += payload_size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Copies a frame into its own segment buffer, so earlier frames are never moved again */
+static int append_received_segment(LINK_INSTANCE* link_instance, const unsigned char* payload_bytes, uint32_t payload_size)
+{
+    int result;
+
+    if (payload_size > UINT32_MAX - link_instance->received_payload_size)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (link_instance->received_segment_count == link_instance->received_segment_buffer_count)
+        {
+            size_t new_count = (link_instance->received_segment_buffer_count == 0) ? 4 : link_instance->received_segment_buffer_count * 2;
+            RECEIVED_SEGMENT* new_segment_buffers = (RECEIVED_SEGMENT*)realloc(link_instance->received_segment_buffers, sizeof(RECEIVED_SEGMENT) * new_count);
+            if (new_segment_buffers != NULL)
+            {
+                PAYLOAD* new_segments;
+                size_t i;
+
+                for (i = link_instance->received_segment_buffer_count; i < new_count; i++)
+                {
+                    new_segment_buffers[i].bytes = NULL;
+                    new_segment_buffers[i].capacity = 0;
+                }
+
+                link_instance->received_segment_buffers = new_segment_buffers;
+
+                new_segments = (PAYLOAD*)realloc(link_instance->received_segments, sizeof(PAYLOAD) * new_count);
+                if (new_segments != NULL)
+                {
+                    link_instance->received_segments = new_segments;
+                    link_instance->received_segment_buffer_count = new_count;
+                }
+            }
+        }
+
+        if (link_instance->received_segment_count == link_instance->received_segment_buffer_count)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            RECEIVED_SEGMENT* segment_buffer = &link_instance->received_segment_buffers[link_instance->received_segment_count];
+
+            if (segment_buffer->capacity < payload_size)
+            {
+                unsigned char* new_bytes = (unsigned char*)realloc(segment_buffer->bytes, payload_size);
+                if (new_bytes != NULL)
+                {
+                    segment_buffer->bytes = new_bytes;
+                    segment_buffer->capacity = payload_size;
+                }
+            }
+
+            if (segment_buffer->capacity < payload_size)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                (void)memcpy(segment_buffer->bytes, payload_bytes, payload_size);
+                link_instance->received_segments[link_instance->received_segment_count].bytes = segment_buffer->bytes;
+                link_instance->received_segments[link_instance->received_segment_count].length = payload_size;
+                link_instance->received_segment_count++;
+                link_instance->received_payload_size += payload_size;
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int store_received_frame(LINK_INSTANCE* link_instance, const unsigned char* payload_bytes, uint32_t payload_size)
+{
+    int result;
+
+    if (link_instance->on_transfer_segments_received != NULL)
+    {
+        result = append_received_segment(link_instance, payload_bytes, payload_size);
+    }
+    else
+    {
+        result = append_received_payload(link_instance, payload_bytes, payload_size);
+    }
+
+    return result;
+}
+
 static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t payload_size, const unsigned char* payload_bytes)
 {
 	LINK_INSTANCE* link_instance = (LINK_INSTANCE*)context;
@@ -280,7 +846,7 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 				{
 					if (link_instance->role == role_receiver)
 					{
-						link_instance->link_credit = DEFAULT_LINK_CREDIT;
+						link_instance->link_credit = get_link_credit_to_grant(link_instance);
 						send_flow(link_instance);
 					}
 					else
@@ -326,7 +892,9 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 	}
 	else if (is_transfer_type_by_descriptor(descriptor))
 	{
-		if (link_instance->on_transfer_received != NULL)
+		if ((link_instance->on_transfer_received != NULL) ||
+			(link_instance->on_transfer_segments_received != NULL) ||
+			(link_instance->on_transfer_frame_received != NULL))
 		{
 			TRANSFER_HANDLE transfer_handle;
 			if (amqpvalue_get_transfer(performative, &transfer_handle) == 0)
@@ -334,13 +902,19 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 				AMQP_VALUE delivery_state;
                 bool more;
 				bool is_error;
+				bool settled;
+
+				bool is_first_transfer = (link_instance->received_payload_size == 0) && !link_instance->is_receiving_streamed_transfer;
 
-				link_instance->link_credit--;
-				link_instance->delivery_count++;
-				if (link_instance->link_credit == 0)
+				/* Only the first transfer of a delivery consumes link credit */
+				if (is_first_transfer)
 				{
-					link_instance->link_credit = DEFAULT_LINK_CREDIT;
-					send_flow(link_instance);
+					if (link_instance->link_credit > 0)
+					{
+						link_instance->link_credit--;
+					}
+
+					link_instance->delivery_count++;
 				}
 
 				more = false;
@@ -348,10 +922,22 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 				(void)transfer_get_more(transfer_handle, &more);
 				is_error = false;
 
+				/* settled may be set on any transfer of the delivery */
+				if (is_first_transfer)
+				{
+					link_instance->is_received_delivery_settled = false;
+				}
+
+				settled = false;
+				if ((transfer_get_settled(transfer_handle, &settled) == 0) && settled)
+				{
+					link_instance->is_received_delivery_settled = true;
+				}
+
                 if (transfer_get_delivery_id(transfer_handle, &link_instance->received_delivery_id) != 0)
                 {
                     /* is this not a continuation transfer? */
-                    if (link_instance->received_payload_size == 0)
+                    if (is_first_transfer)
                     {
                         LogError("Could not get the delivery Id from the transfer performative");
                         is_error = true;
@@ -360,59 +946,105 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
                     
                 if (!is_error)
                 {
-                    /* If this is a continuation transfer or if this is the first chunk of a multi frame transfer */
-                    if ((link_instance->received_payload_size > 0) || more)
+                    if (link_instance->on_transfer_frame_received != NULL)
                     {
-                        unsigned char* new_received_payload = (unsigned char*)realloc(link_instance->received_payload, link_instance->received_payload_size + payload_size);
-                        if (new_received_payload == NULL)
+                        /* streamed receive: frames are handed over as they arrive and nothing is reassembled */
+                        link_instance->is_receiving_streamed_transfer = more;
+                        if (more)
                         {
-                            LogError("Could not allocate memory for the received payload");
+                            delivery_state = link_instance->on_transfer_frame_received(link_instance->callback_context, transfer_handle, payload_size, payload_bytes, true);
+                            if (delivery_state != NULL)
+                            {
+                                amqpvalue_destroy(delivery_state);
+                            }
                         }
-                        else
+                    }
+                    /* If this is a continuation transfer or if this is the first chunk of a multi frame transfer */
+                    else if ((link_instance->received_payload_size > 0) || more)
+                    {
+                        if (store_received_frame(link_instance, payload_bytes, payload_size) != 0)
                         {
-                            link_instance->received_payload = new_received_payload;
-                            (void)memcpy(link_instance->received_payload + link_instance->received_payload_size, payload_bytes, payload_size);
-                            link_instance->received_payload_size += payload_size;
+                            LogError("Could not allocate memory for the received payload");
                         }
                     }
 
                     if (!more)
                     {
-                        const unsigned char* indicate_payload_bytes;
-                        uint32_t indicate_payload_size;
-
-                        /* if no previously stored chunks then simply report the current payload */
-                        if (link_instance->received_payload_size > 0)
+                        if (link_instance->on_transfer_frame_received != NULL)
                         {
-                            indicate_payload_size = link_instance->received_payload_size;
-                            indicate_payload_bytes = link_instance->received_payload;
+                            delivery_state = link_instance->on_transfer_frame_received(link_instance->callback_context, transfer_handle, payload_size, payload_bytes, false);
                         }
-                        else
+                        else if (link_instance->on_transfer_segments_received != NULL)
                         {
-                            indicate_payload_size = payload_size;
-                            indicate_payload_bytes = payload_bytes;
+                            PAYLOAD single_segment;
+                            const PAYLOAD* indicate_segments;
+                            size_t indicate_segment_count;
+
+                            /* a single frame transfer is reported straight from the frame */
+                            if (link_instance->received_payload_size > 0)
+                            {
+                                indicate_segments = link_instance->received_segments;
+                                indicate_segment_count = link_instance->received_segment_count;
+                            }
+                            else
+                            {
+                                single_segment.bytes = payload_bytes;
+                                single_segment.length = payload_size;
+                                indicate_segments = &single_segment;
+                                indicate_segment_count = 1;
+                            }
+
+                            delivery_state = link_instance->on_transfer_segments_received(link_instance->callback_context, transfer_handle, indicate_segments, indicate_segment_count);
                         }
+                        else
+                        {
+                            const unsigned char* indicate_payload_bytes;
+                            uint32_t indicate_payload_size;
 
-                        delivery_state = link_instance->on_transfer_received(link_instance->callback_context, transfer_handle, indicate_payload_size, indicate_payload_bytes);
+                            /* if no previously stored chunks then simply report the current payload */
+                            if (link_instance->received_payload_size > 0)
+                            {
+                                indicate_payload_size = link_instance->received_payload_size;
+                                indicate_payload_bytes = link_instance->received_payload;
+                            }
+                            else
+                            {
+                                indicate_payload_size = payload_size;
+                                indicate_payload_bytes = payload_bytes;
+                            }
 
-                        if (link_instance->received_payload_size > 0)
-                        {
-                            free(link_instance->received_payload);
-                            link_instance->received_payload = NULL;
-                            link_instance->received_payload_size = 0;
+                            delivery_state = link_instance->on_transfer_received(link_instance->callback_context, transfer_handle, indicate_payload_size, indicate_payload_bytes);
                         }
 
+                        /* the reassembly memory is kept for the next multi frame transfer */
+                        link_instance->received_payload_size = 0;
+                        link_instance->received_segment_count = 0;
+
                         if (delivery_state != NULL)
                         {
-                            if (send_disposition(link_instance, link_instance->received_delivery_id, delivery_state) != 0)
+                            if (queue_disposition(link_instance, link_instance->received_delivery_id, delivery_state) != 0)
                             {
                                 LogError("Cannot send disposition frame");
                             }
                             amqpvalue_destroy(delivery_state);
                         }
+                        else if (!link_instance->is_received_delivery_settled)
+                        {
+                            /* The application will settle this delivery later through link_send_disposition */
+                            if (add_undisposed_delivery(link_instance, link_instance->received_delivery_id) != 0)
+                            {
+                                LogError("Cannot track undisposed delivery");
+                            }
+                        }
                     }
                 }
 
+                /* Credit is refilled once the delivery is complete, so that in adaptive mode it already counts as undisposed */
+                if (!more)
+                {
+                    replenish_link_credit(link_instance);
+                }
+
 				transfer_destroy(transfer_handle);
 			}
 		}
@@ -435,62 +1067,60 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 			}
 			else
 			{
-                bool settled;
+				bool settled;
 
 				if (disposition_get_last(disposition, &last) != 0)
 				{
 					last = first;
 				}
 
-                if (disposition_get_settled(disposition, &settled) != 0)
-                {
-                    /* Error */
-                    settled = false;
-                }
+				if (disposition_get_settled(disposition, &settled) != 0)
+				{
+					/* Error */
+					settled = false;
+				}
 
-                if (settled)
-                {
-                    LIST_ITEM_HANDLE pending_delivery = singlylinkedlist_get_head_item(link_instance->pending_deliveries);
-                    while (pending_delivery != NULL)
-                    {
-                        LIST_ITEM_HANDLE next_pending_delivery = singlylinkedlist_get_next_item(pending_delivery);
-                        DELIVERY_INSTANCE* delivery_instance = (DELIVERY_INSTANCE*)singlylinkedlist_item_get_value(pending_delivery);
-                        if (delivery_instance == NULL)
-                        {
-                            /* error */
-                            break;
-                        }
-                        else
-                        {
-                            if ((delivery_instance->delivery_id >= first) && (delivery_instance->delivery_id <= last))
-                            {
-                                AMQP_VALUE delivery_state;
-                                if (disposition_get_state(disposition, &delivery_state) != 0)
-                                {
-                                    /* error */
-                                }
-                                else
-                                {
-                                    delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, delivery_state);
-                                    free(delivery_instance);
-                                    if (singlylinkedlist_remove(link_instance->pending_deliveries, pending_delivery) != 0)
-                                    {
-                                        /* error */
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        pending_delivery = next_pending_delivery;
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                pending_delivery = next_pending_delivery;
-                            }
-                        }
-                    }
-                }
+				if (settled)
+				{
+					AMQP_VALUE delivery_state;
+					if (disposition_get_state(disposition, &delivery_state) != 0)
+					{
+						delivery_state = NULL;
+					}
+
+					if (link_instance->pending_delivery_head != link_instance->pending_delivery_tail)
+					{
+						delivery_number head_delivery_id = get_pending_delivery_slot(link_instance, link_instance->pending_delivery_head)->delivery_id;
+						uint32_t i = find_first_pending_delivery_index(link_instance, first);
+
+						/* the settled callback may queue new transfers and settling reclaims slots, so re-check the bounds on each step */
+						while ((int32_t)(link_instance->pending_delivery_tail - i) > 0)
+						{
+							PENDING_DELIVERY_SLOT* slot;
+
+							if ((int32_t)(i - link_instance->pending_delivery_head) < 0)
+							{
+								i = link_instance->pending_delivery_head;
+								continue;
+							}
+
+							slot = get_pending_delivery_slot(link_instance, i);
+							if ((uint32_t)(slot->delivery_id - head_delivery_id) > (uint32_t)(last - head_delivery_id))
+							{
+								break;
+							}
+
+							if (slot->delivery != NULL)
+							{
+								DELIVERY_INSTANCE* delivery_instance = slot->delivery;
+								delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, delivery_state);
+								remove_pending_delivery(link_instance, delivery_instance);
+							}
+
+							i++;
+						}
+					}
+				}
 			}
 
 			disposition_destroy(disposition);
@@ -559,11 +1189,13 @@ static void on_session_state_changed(void* context, SESSION_STATE new_session_st
 	}
 	else if (new_session_state == SESSION_STATE_DISCARDING)
 	{
+        discard_pending_disposition(link_instance);
         remove_all_pending_deliveries(link_instance, true);
 		set_link_state(link_instance, LINK_STATE_DETACHED);
 	}
 	else if (new_session_state == SESSION_STATE_ERROR)
 	{
+        discard_pending_disposition(link_instance);
         remove_all_pending_deliveries(link_instance, true);
 		set_link_state(link_instance, LINK_STATE_ERROR);
 	}
@@ -578,17 +1210,64 @@ static void on_session_flow_on(void* context)
 	}
 }
 
+/* The batch timeout starts on the first dowork that sees the batch. For received transfers that is the
+   dowork which follows their frames in the same connection_dowork, so it matches the time they were queued. */
+static uint64_t get_disposition_batch_time_left(LINK_INSTANCE* link_instance, uint64_t current_ms)
+{
+	uint64_t result;
+
+	if (!link_instance->is_pending_disposition_timer_started)
+	{
+		link_instance->pending_disposition_start_time = current_ms;
+		link_instance->is_pending_disposition_timer_started = true;
+	}
+
+	if (current_ms - link_instance->pending_disposition_start_time >= link_instance->disposition_batch_timeout)
+	{
+		result = 0;
+	}
+	else
+	{
+		result = link_instance->disposition_batch_timeout - (current_ms - link_instance->pending_disposition_start_time);
+	}
+
+	return result;
+}
+
+static uint64_t on_link_dowork(void* context, uint64_t current_ms)
+{
+	LINK_INSTANCE* link_instance = (LINK_INSTANCE*)context;
+	uint64_t result = (uint64_t)-1;
+
+	if ((link_instance->pending_disposition_count > 0) &&
+		(get_disposition_batch_time_left(link_instance, current_ms) == 0))
+	{
+		(void)flush_pending_disposition(link_instance);
+	}
+
+	if (link_instance->on_link_dowork != NULL)
+	{
+		link_instance->on_link_dowork(link_instance->callback_context);
+	}
+
+	/* the connection reports the flush time in connection_handle_deadlines */
+	if (link_instance->pending_disposition_count > 0)
+	{
+		result = get_disposition_batch_time_left(link_instance, current_ms);
+	}
+
+	return result;
+}
+
 static void on_send_complete(void* context, IO_SEND_RESULT send_result)
 {
-	LIST_ITEM_HANDLE delivery_instance_list_item = (LIST_ITEM_HANDLE)context;
-	DELIVERY_INSTANCE* delivery_instance = (DELIVERY_INSTANCE*)singlylinkedlist_item_get_value(delivery_instance_list_item);
+	DELIVERY_INSTANCE* delivery_instance = (DELIVERY_INSTANCE*)context;
 	LINK_INSTANCE* link_instance = (LINK_INSTANCE*)delivery_instance->link;
     (void)send_result;
 	if (link_instance->snd_settle_mode == sender_settle_mode_settled)
 	{
 		delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, NULL);
-		free(delivery_instance);
-		(void)singlylinkedlist_remove(link_instance->pending_deliveries, delivery_instance_list_item);
+		remove_pending_delivery(link_instance, delivery_instance);
 	}
 }
 
@@ -614,39 +1293,59 @@ LINK_HANDLE link_create(SESSION_HANDLE session, const char* name, role role, AMQ
         result->attach_properties = NULL;
         result->received_payload = NULL;
         result->received_payload_size = 0;
+        result->received_payload_capacity = 0;
+        result->on_transfer_segments_received = NULL;
+        result->on_transfer_frame_received = NULL;
+        result->on_link_dowork = NULL;
+        result->is_receiving_streamed_transfer = false;
+        result->received_segment_buffers = NULL;
+        result->received_segments = NULL;
+        result->received_segment_buffer_count = 0;
+        result->received_segment_count = 0;
         result->received_delivery_id = 0;
-
-		result->pending_deliveries = singlylinkedlist_create();
-		if (result->pending_deliveries == NULL)
+        result->is_received_delivery_settled = false;
+        result->link_credit = 0;
+        result->max_link_credit = DEFAULT_LINK_CREDIT;
+        result->link_credit_refill_threshold = 0;
+        result->link_credit_mode = LINK_CREDIT_MODE_FIXED;
+        result->undisposed_delivery_ids = NULL;
+        result->undisposed_delivery_count = 0;
+        result->undisposed_delivery_capacity = 0;
+        result->max_disposition_batch_size = 1;
+        result->disposition_batch_timeout = 0;
+        result->pending_disposition_state = NULL;
+        result->pending_disposition_count = 0;
+        result->is_pending_disposition_timer_started = false;
+
+		result->pending_deliveries = NULL;
+		result->pending_delivery_capacity = 0;
+		result->pending_delivery_head = 0;
+		result->pending_delivery_tail = 0;
+		result->free_deliveries = NULL;
+		result->delivery_chunks = NULL;
+		result->delivery_chunk_count = 0;
+		result->streaming_delivery = NULL;
+
+		result->name = malloc(strlen(name) + 1);
+		if (result->name == NULL)
 		{
 			free(result);
 			result = NULL;
 		}
 		else
 		{
-			result->name = malloc(strlen(name) + 1);
-			if (result->name == NULL)
+			result->on_link_state_changed = NULL;
+			result->callback_context = NULL;
+			set_link_state(result, LINK_STATE_DETACHED);
+
+			(void)strcpy(result->name, name);
+			result->link_endpoint = session_create_link_endpoint(session, name);
+			if (result->link_endpoint == NULL)
 			{
-				singlylinkedlist_destroy(result->pending_deliveries);
+				free(result->name);
 				free(result);
 				result = NULL;
 			}
-			else
-			{
-				result->on_link_state_changed = NULL;
-				result->callback_context = NULL;
-				set_link_state(result, LINK_STATE_DETACHED);
-
-				(void)strcpy(result->name, name);
-				result->link_endpoint = session_create_link_endpoint(session, name);
-				if (result->link_endpoint == NULL)
-				{
-					singlylinkedlist_destroy(result->pending_deliveries);
-					free(result->name);
-					free(result);
-					result = NULL;
-				}
-			}
 		}
 	}
 
@@ -672,7 +1371,29 @@ LINK_HANDLE link_create_from_endpoint(SESSION_HANDLE session, LINK_ENDPOINT_HAND
         result->attach_properties = NULL;
         result->received_payload = NULL;
         result->received_payload_size = 0;
+        result->received_payload_capacity = 0;
+        result->on_transfer_segments_received = NULL;
+        result->on_transfer_frame_received = NULL;
+        result->on_link_dowork = NULL;
+        result->is_receiving_streamed_transfer = false;
+        result->received_segment_buffers = NULL;
+        result->received_segments = NULL;
+        result->received_segment_buffer_count = 0;
+        result->received_segment_count = 0;
         result->received_delivery_id = 0;
+        result->is_received_delivery_settled = false;
+        result->link_credit = 0;
+        result->max_link_credit = DEFAULT_LINK_CREDIT;
+        result->link_credit_refill_threshold = 0;
+        result->link_credit_mode = LINK_CREDIT_MODE_FIXED;
+        result->undisposed_delivery_ids = NULL;
+        result->undisposed_delivery_count = 0;
+        result->undisposed_delivery_capacity = 0;
+        result->max_disposition_batch_size = 1;
+        result->disposition_batch_timeout = 0;
+        result->pending_disposition_state = NULL;
+        result->pending_disposition_count = 0;
+        result->is_pending_disposition_timer_started = false;
         result->source = amqpvalue_clone(target);
 		result->target = amqpvalue_clone(source);
 		if (role == role_sender)
@@ -684,66 +1405,267 @@ LINK_HANDLE link_create_from_endpoint(SESSION_HANDLE session, LINK_ENDPOINT_HAND
 			result->role = role_sender;
 		}
 
-		result->pending_deliveries = singlylinkedlist_create();
-		if (result->pending_deliveries == NULL)
+		result->pending_deliveries = NULL;
+		result->pending_delivery_capacity = 0;
+		result->pending_delivery_head = 0;
+		result->pending_delivery_tail = 0;
+		result->free_deliveries = NULL;
+		result->delivery_chunks = NULL;
+		result->delivery_chunk_count = 0;
+		result->streaming_delivery = NULL;
+
+		result->name = malloc(strlen(name) + 1);
+		if (result->name == NULL)
 		{
 			free(result);
 			result = NULL;
 		}
 		else
 		{
-			result->name = malloc(strlen(name) + 1);
-			if (result->name == NULL)
-			{
-				singlylinkedlist_destroy(result->pending_deliveries);
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				(void)strcpy(result->name, name);
-				result->on_link_state_changed = NULL;
-				result->callback_context = NULL;
-				result->link_endpoint = link_endpoint;
-			}
+			(void)strcpy(result->name, name);
+			result->on_link_state_changed = NULL;
+			result->callback_context = NULL;
+			result->link_endpoint = link_endpoint;
+		}
+	}
+
+	return result;
+}
+
+void link_destroy(LINK_HANDLE link)
+{
+	if (link != NULL)
+	{
+        free_pending_deliveries((LINK_INSTANCE*)link);
+
+        link->on_link_state_changed = NULL;
+        (void)link_detach(link, true);
+        session_destroy_link_endpoint(link->link_endpoint);
+		amqpvalue_destroy(link->source);
+		amqpvalue_destroy(link->target);
+
+		if (link->name != NULL)
+		{
+			free(link->name);
 		}
+
+		if (link->attach_properties != NULL)
+        {
+			amqpvalue_destroy(link->attach_properties);
+        }
+
+        if (link->received_payload != NULL)
+        {
+            free(link->received_payload);
+        }
+
+        if (link->undisposed_delivery_ids != NULL)
+        {
+            free(link->undisposed_delivery_ids);
+        }
+
+        if (link->received_segment_buffers != NULL)
+        {
+            size_t i;
+
+            for (i = 0; i < link->received_segment_buffer_count; i++)
+            {
+                free(link->received_segment_buffers[i].bytes);
+            }
+
+            free(link->received_segment_buffers);
+            free(link->received_segments);
+        }
+
+        discard_pending_disposition(link);
+
+		free(link);
+	}
+}
+
+int link_set_snd_settle_mode(LINK_HANDLE link, sender_settle_mode snd_settle_mode)
+{
+	int result;
+
+	if (link == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		link->snd_settle_mode = snd_settle_mode;
+		result = 0;
+	}
+
+	return result;
+}
+
+int link_get_snd_settle_mode(LINK_HANDLE link, sender_settle_mode* snd_settle_mode)
+{
+	int result;
+
+	if ((link == NULL) ||
+		(snd_settle_mode == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		*snd_settle_mode = link->snd_settle_mode;
+
+		result = 0;
+	}
+
+	return result;
+}
+
+int link_set_rcv_settle_mode(LINK_HANDLE link, receiver_settle_mode rcv_settle_mode)
+{
+	int result;
+
+	if (link == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		link->rcv_settle_mode = rcv_settle_mode;
+		result = 0;
+	}
+
+	return result;
+}
+
+int link_get_rcv_settle_mode(LINK_HANDLE link, receiver_settle_mode* rcv_settle_mode)
+{
+	int result;
+
+	if ((link == NULL) ||
+		(rcv_settle_mode == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		*rcv_settle_mode = link->rcv_settle_mode;
+		result = 0;
+	}
+
+	return result;
+}
+
+int link_set_initial_delivery_count(LINK_HANDLE link, sequence_no initial_delivery_count)
+{
+	int result;
+
+	if (link == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		link->initial_delivery_count = initial_delivery_count;
+		result = 0;
+	}
+
+	return result;
+}
+
+int link_get_initial_delivery_count(LINK_HANDLE link, sequence_no* initial_delivery_count)
+{
+	int result;
+
+	if ((link == NULL) ||
+		(initial_delivery_count == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		*initial_delivery_count = link->initial_delivery_count;
+		result = 0;
+	}
+
+	return result;
+}
+
+int link_set_max_message_size(LINK_HANDLE link, uint64_t max_message_size)
+{
+	int result;
+
+	if (link == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		link->max_message_size = max_message_size;
+		result = 0;
 	}
 
 	return result;
 }
 
-void link_destroy(LINK_HANDLE link)
+int link_get_max_message_size(LINK_HANDLE link, uint64_t* max_message_size)
 {
-	if (link != NULL)
+	int result;
+
+	if ((link == NULL) ||
+		(max_message_size == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
 	{
-        remove_all_pending_deliveries((LINK_INSTANCE*)link, false);
+		*max_message_size = link->max_message_size;
+		result = 0;
+	}
 
-        link->on_link_state_changed = NULL;
-        (void)link_detach(link, true);
-        session_destroy_link_endpoint(link->link_endpoint);
-		amqpvalue_destroy(link->source);
-		amqpvalue_destroy(link->target);
+	return result;
+}
 
-		if (link->name != NULL)
-		{
-			free(link->name);
-		}
+int link_set_max_link_credit(LINK_HANDLE link, uint32_t max_link_credit)
+{
+	int result;
 
-		if (link->attach_properties != NULL)
-        {
-			amqpvalue_destroy(link->attach_properties);
-        }
+	if ((link == NULL) ||
+		(max_link_credit == 0))
+	{
+		result = __FAILURE__;
+	}
+	else if (max_link_credit <= link->link_credit_refill_threshold)
+	{
+		LogError("Max link credit %u has to be above the refill threshold %u", (unsigned int)max_link_credit, (unsigned int)link->link_credit_refill_threshold);
+		result = __FAILURE__;
+	}
+	else
+	{
+		link->max_link_credit = max_link_credit;
+		result = 0;
+	}
 
-        if (link->received_payload != NULL)
-        {
-            free(link->received_payload);
-        }
+	return result;
+}
 
-		free(link);
+int link_get_max_link_credit(LINK_HANDLE link, uint32_t* max_link_credit)
+{
+	int result;
+
+	if ((link == NULL) ||
+		(max_link_credit == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		*max_link_credit = link->max_link_credit;
+		result = 0;
 	}
+
+	return result;
 }
 
-int link_set_snd_settle_mode(LINK_HANDLE link, sender_settle_mode snd_settle_mode)
+int link_set_link_credit_refill_threshold(LINK_HANDLE link, uint32_t refill_threshold)
 {
 	int result;
 
@@ -751,70 +1673,81 @@ int link_set_snd_settle_mode(LINK_HANDLE link, sender_settle_mode snd_settle_mod
 	{
 		result = __FAILURE__;
 	}
+	else if (refill_threshold >= link->max_link_credit)
+	{
+		/* credit would be refilled after every transfer */
+		LogError("Refill threshold %u has to be below the max link credit %u", (unsigned int)refill_threshold, (unsigned int)link->max_link_credit);
+		result = __FAILURE__;
+	}
 	else
 	{
-		link->snd_settle_mode = snd_settle_mode;
+		link->link_credit_refill_threshold = refill_threshold;
 		result = 0;
 	}
 
 	return result;
 }
 
-int link_get_snd_settle_mode(LINK_HANDLE link, sender_settle_mode* snd_settle_mode)
+int link_set_link_credit_mode(LINK_HANDLE link, LINK_CREDIT_MODE link_credit_mode)
 {
 	int result;
 
 	if ((link == NULL) ||
-		(snd_settle_mode == NULL))
+		((link_credit_mode != LINK_CREDIT_MODE_FIXED) && (link_credit_mode != LINK_CREDIT_MODE_ADAPTIVE)))
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		*snd_settle_mode = link->snd_settle_mode;
-
+		link->link_credit_mode = link_credit_mode;
 		result = 0;
 	}
 
 	return result;
 }
 
-int link_set_rcv_settle_mode(LINK_HANDLE link, receiver_settle_mode rcv_settle_mode)
+/* Switches the link to segmented receive: the frames of a multi frame transfer are reported as a list of segments instead of being joined */
+int link_set_on_transfer_segments_received(LINK_HANDLE link, ON_TRANSFER_SEGMENTS_RECEIVED on_transfer_segments_received)
 {
 	int result;
 
-	if (link == NULL)
+	if ((link == NULL) ||
+		(link->received_payload_size > 0))
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		link->rcv_settle_mode = rcv_settle_mode;
+		link->on_transfer_segments_received = on_transfer_segments_received;
 		result = 0;
 	}
 
 	return result;
 }
 
-int link_get_rcv_settle_mode(LINK_HANDLE link, receiver_settle_mode* rcv_settle_mode)
+/* Switches the link to streamed receive: every frame of a transfer is reported as soon as it arrives.
+   Only the last frame (more is false) reports the delivery state of the transfer. */
+int link_set_on_transfer_frame_received(LINK_HANDLE link, ON_TRANSFER_FRAME_RECEIVED on_transfer_frame_received)
 {
 	int result;
 
 	if ((link == NULL) ||
-		(rcv_settle_mode == NULL))
+		(link->received_payload_size > 0) ||
+		link->is_receiving_streamed_transfer)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		*rcv_settle_mode = link->rcv_settle_mode;
+		link->on_transfer_frame_received = on_transfer_frame_received;
 		result = 0;
 	}
 
 	return result;
 }
 
-int link_set_initial_delivery_count(LINK_HANDLE link, sequence_no initial_delivery_count)
+/* on_link_dowork runs on every dowork of the connection, with the context given to link_attach */
+int link_set_on_dowork(LINK_HANDLE link, ON_LINK_DOWORK on_link_dowork)
 {
 	int result;
 
@@ -824,32 +1757,35 @@ int link_set_initial_delivery_count(LINK_HANDLE link, sequence_no initial_delive
 	}
 	else
 	{
-		link->initial_delivery_count = initial_delivery_count;
+		link->on_link_dowork = on_link_dowork;
 		result = 0;
 	}
 
 	return result;
 }
 
-int link_get_initial_delivery_count(LINK_HANDLE link, sequence_no* initial_delivery_count)
+/* Can be called from any thread, for work the on_link_dowork callback picks up */
+int link_request_dowork(LINK_HANDLE link)
 {
 	int result;
 
-	if ((link == NULL) ||
-		(initial_delivery_count == NULL))
+	if (link == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else if (session_request_dowork(link->session) != 0)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		*initial_delivery_count = link->initial_delivery_count;
 		result = 0;
 	}
 
 	return result;
 }
 
-int link_set_max_message_size(LINK_HANDLE link, uint64_t max_message_size)
+int link_set_max_disposition_batch_size(LINK_HANDLE link, uint32_t max_disposition_batch_size)
 {
 	int result;
 
@@ -859,25 +1795,29 @@ int link_set_max_message_size(LINK_HANDLE link, uint64_t max_message_size)
 	}
 	else
 	{
-		link->max_message_size = max_message_size;
+		link->max_disposition_batch_size = max_disposition_batch_size;
+		if (link->pending_disposition_count >= max_disposition_batch_size)
+		{
+			(void)flush_pending_disposition(link);
+		}
+
 		result = 0;
 	}
 
 	return result;
 }
 
-int link_get_max_message_size(LINK_HANDLE link, uint64_t* max_message_size)
+int link_set_disposition_batch_timeout(LINK_HANDLE link, milliseconds disposition_batch_timeout)
 {
 	int result;
 
-	if ((link == NULL) ||
-		(max_message_size == NULL))
+	if (link == NULL)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		*max_message_size = link->max_message_size;
+		link->disposition_batch_timeout = disposition_batch_timeout;
 		result = 0;
 	}
 
@@ -919,6 +1859,9 @@ int link_attach(LINK_HANDLE link, ON_TRANSFER_RECEIVED on_transfer_received, ON_
 	}
 	else
 	{
+		/* deliveries left undisposed by a previous attachment do not hold back credit anymore */
+		link->undisposed_delivery_count = 0;
+
 		if (!link->is_underlying_session_begun)
 		{
 			link->on_link_state_changed = on_link_state_changed;
@@ -934,13 +1877,15 @@ int link_attach(LINK_HANDLE link, ON_TRANSFER_RECEIVED on_transfer_received, ON_
 			{
 				link->is_underlying_session_begun = true;
 
-				if (session_start_link_endpoint(link->link_endpoint, link_frame_received, on_session_state_changed, on_session_flow_on, link) != 0)
+				if ((session_start_link_endpoint(link->link_endpoint, link_frame_received, on_session_state_changed, on_session_flow_on, link) != 0) ||
+					(session_set_link_endpoint_on_dowork(link->link_endpoint, on_link_dowork) != 0))
 				{
 					result = __FAILURE__;
 				}
 				else
 				{
                     link->received_payload_size = 0;
+                    link->is_receiving_streamed_transfer = false;
 
 					result = 0;
 				}
@@ -966,6 +1911,14 @@ int link_detach(LINK_HANDLE link, bool close)
 	}
 	else
 	{
+        /* Do not leave settlements behind when the link goes away */
+        if (link->link_state == LINK_STATE_ATTACHED)
+        {
+            (void)flush_pending_disposition(link);
+        }
+
+        link->undisposed_delivery_count = 0;
+
         switch (link->link_state)
         {
 
@@ -1011,122 +1964,265 @@ int link_detach(LINK_HANDLE link, bool close)
 	return result;
 }
 
-LINK_TRANSFER_RESULT link_transfer(LINK_HANDLE link, message_format message_format, PAYLOAD* payloads, size_t payload_count, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+/* Starts a new delivery. When more is true the delivery stays open and is continued through link_transfer_chunk,
+   with on_chunk_sent reporting when each chunk has been handed to the transport */
+static LINK_TRANSFER_RESULT send_first_transfer(LINK_INSTANCE* link, message_format message_format, PAYLOAD* payloads, size_t payload_count, bool more, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context, ON_SEND_COMPLETE on_chunk_sent, void* on_chunk_sent_context)
 {
 	LINK_TRANSFER_RESULT result;
+	TRANSFER_HANDLE transfer = transfer_create(0);
 
-	if (link == NULL)
+	if (transfer == NULL)
 	{
 		result = LINK_TRANSFER_ERROR;
 	}
 	else
 	{
-		if ((link->role != role_sender) ||
-			(link->link_state != LINK_STATE_ATTACHED))
+		sequence_no delivery_count = link->delivery_count + 1;
+		unsigned char delivery_tag_bytes[sizeof(delivery_count)];
+		delivery_tag delivery_tag;
+		bool settled;
+
+		(void)memcpy(delivery_tag_bytes, &delivery_count, sizeof(delivery_count));
+
+		delivery_tag.bytes = &delivery_tag_bytes;
+		delivery_tag.length = sizeof(delivery_tag_bytes);
+
+		if (link->snd_settle_mode == sender_settle_mode_unsettled)
 		{
-			result = LINK_TRANSFER_ERROR;
+			settled = false;
 		}
-		else if (link->link_credit == 0)
+		else
 		{
-			result = LINK_TRANSFER_BUSY;
+			settled = true;
+		}
+
+		if ((transfer_set_delivery_tag(transfer, delivery_tag) != 0) ||
+			(transfer_set_message_format(transfer, message_format) != 0) ||
+			(transfer_set_settled(transfer, settled) != 0))
+		{
+			result = LINK_TRANSFER_ERROR;
 		}
 		else
 		{
-			TRANSFER_HANDLE transfer = transfer_create(0);
-			if (transfer == NULL)
+			DELIVERY_INSTANCE* pending_delivery = allocate_delivery(link);
+			if (pending_delivery == NULL)
 			{
 				result = LINK_TRANSFER_ERROR;
 			}
 			else
 			{
-                sequence_no delivery_count = link->delivery_count + 1;
-                unsigned char delivery_tag_bytes[sizeof(delivery_count)];
-				delivery_tag delivery_tag;
-				bool settled;
-
-				(void)memcpy(delivery_tag_bytes, &delivery_count, sizeof(delivery_count));
-
-				delivery_tag.bytes = &delivery_tag_bytes;
-				delivery_tag.length = sizeof(delivery_tag_bytes);
-
-				if (link->snd_settle_mode == sender_settle_mode_unsettled)
-				{
-					settled = false;
-				}
-				else
-				{
-					settled = true;
-				}
+				pending_delivery->delivery_id = 0;
+				pending_delivery->on_delivery_settled = on_delivery_settled;
+				pending_delivery->callback_context = callback_context;
+				pending_delivery->link = link;
 
-				if ((transfer_set_delivery_tag(transfer, delivery_tag) != 0) ||
-					(transfer_set_message_format(transfer, message_format) != 0) ||
-					(transfer_set_settled(transfer, settled) != 0))
+				if (add_pending_delivery(link, pending_delivery) != 0)
 				{
+					release_delivery(link, pending_delivery);
 					result = LINK_TRANSFER_ERROR;
 				}
 				else
 				{
-					AMQP_VALUE transfer_value = amqpvalue_create_transfer(transfer);
+					uint32_t pending_delivery_index = pending_delivery->pending_delivery_index;
+					SESSION_SEND_TRANSFER_RESULT session_send_transfer_result;
+					bool is_still_pending;
 
-					if (transfer_value == NULL)
+					/* here we should feed data to the transfer frame */
+					if (more)
 					{
-						result = LINK_TRANSFER_ERROR;
+						session_send_transfer_result = session_send_transfer_chunk(link->link_endpoint, transfer, payloads, payload_count, true, true, &pending_delivery->delivery_id, on_chunk_sent, on_chunk_sent_context);
 					}
 					else
 					{
-						DELIVERY_INSTANCE* pending_delivery = malloc(sizeof(DELIVERY_INSTANCE));
-						if (pending_delivery == NULL)
+						session_send_transfer_result = session_send_transfer(link->link_endpoint, transfer, payloads, payload_count, &pending_delivery->delivery_id, (settled) ? on_send_complete : NULL, pending_delivery);
+					}
+
+					/* the delivery may already have been settled (and its instance recycled) from within session_send_transfer */
+					is_still_pending = (get_pending_delivery_slot(link, pending_delivery_index)->delivery == pending_delivery) &&
+						(pending_delivery->pending_delivery_index == pending_delivery_index);
+
+					switch (session_send_transfer_result)
+					{
+					default:
+					case SESSION_SEND_TRANSFER_ERROR:
+						if (is_still_pending)
 						{
-							result = LINK_TRANSFER_ERROR;
+							remove_pending_delivery(link, pending_delivery);
 						}
-						else
+						result = LINK_TRANSFER_ERROR;
+						break;
+
+					case SESSION_SEND_TRANSFER_BUSY:
+						/* Ensure we remove it again since sender will attempt to transfer again on flow on */
+						if (is_still_pending)
 						{
-							LIST_ITEM_HANDLE delivery_instance_list_item;
-							pending_delivery->on_delivery_settled = on_delivery_settled;
-							pending_delivery->callback_context = callback_context;
-							pending_delivery->link = link;
-							delivery_instance_list_item = singlylinkedlist_add(link->pending_deliveries, pending_delivery);
+							remove_pending_delivery(link, pending_delivery);
+						}
+						result = LINK_TRANSFER_BUSY;
+						break;
 
-							if (delivery_instance_list_item == NULL)
-							{
-								free(pending_delivery);
-								result = LINK_TRANSFER_ERROR;
-							}
-							else
+					case SESSION_SEND_TRANSFER_OK:
+						if (is_still_pending)
+						{
+							get_pending_delivery_slot(link, pending_delivery_index)->delivery_id = pending_delivery->delivery_id;
+							if (more)
 							{
-								/* here we should feed data to the transfer frame */
-								switch (session_send_transfer(link->link_endpoint, transfer, payloads, payload_count, &pending_delivery->delivery_id, (settled) ? on_send_complete : NULL, delivery_instance_list_item))
-								{
-								default:
-								case SESSION_SEND_TRANSFER_ERROR:
-									singlylinkedlist_remove(link->pending_deliveries, delivery_instance_list_item);
-									free(pending_delivery);
-									result = LINK_TRANSFER_ERROR;
-									break;
-
-								case SESSION_SEND_TRANSFER_BUSY:
-									/* Ensure we remove from list again since sender will attempt to transfer again on flow on */
-									singlylinkedlist_remove(link->pending_deliveries, delivery_instance_list_item);
-									free(pending_delivery);
-									result = LINK_TRANSFER_BUSY;
-									break;
-
-								case SESSION_SEND_TRANSFER_OK:
-									link->delivery_count = delivery_count;
-									link->link_credit--;
-									result = LINK_TRANSFER_OK;
-									break;
-								}
+								link->streaming_delivery = pending_delivery;
 							}
 						}
-
-						amqpvalue_destroy(transfer_value);
+						link->delivery_count = delivery_count;
+						link->link_credit--;
+						result = LINK_TRANSFER_OK;
+						break;
 					}
 				}
+			}
+		}
+
+		transfer_destroy(transfer);
+	}
+
+	return result;
+}
+
+static LINK_TRANSFER_RESULT send_continuation_transfer(LINK_INSTANCE* link, PAYLOAD* payloads, size_t payload_count, bool more, bool aborted, ON_SEND_COMPLETE on_chunk_sent, void* on_chunk_sent_context)
+{
+	LINK_TRANSFER_RESULT result;
+	TRANSFER_HANDLE transfer = transfer_create(0);
+
+	if (transfer == NULL)
+	{
+		result = LINK_TRANSFER_ERROR;
+	}
+	else
+	{
+		DELIVERY_INSTANCE* delivery_instance = link->streaming_delivery;
+		bool settled = (link->snd_settle_mode != sender_settle_mode_unsettled);
+
+		if ((transfer_set_settled(transfer, settled) != 0) ||
+			(aborted && (transfer_set_aborted(transfer, true) != 0)))
+		{
+			result = LINK_TRANSFER_ERROR;
+		}
+		else
+		{
+			uint32_t pending_delivery_index = delivery_instance->pending_delivery_index;
+			SESSION_SEND_TRANSFER_RESULT session_send_transfer_result;
+
+			if (!more)
+			{
+				/* the delivery is complete once its last chunk is out */
+				link->streaming_delivery = NULL;
+			}
+
+			session_send_transfer_result = session_send_transfer_chunk(link->link_endpoint, transfer, payloads, payload_count, false, more, &delivery_instance->delivery_id,
+				more ? on_chunk_sent : ((settled && !aborted) ? on_send_complete : NULL), more ? on_chunk_sent_context : delivery_instance);
 
-				transfer_destroy(transfer);
+			if (session_send_transfer_result == SESSION_SEND_TRANSFER_OK)
+			{
+				result = LINK_TRANSFER_OK;
+			}
+			else
+			{
+				result = LINK_TRANSFER_ERROR;
+			}
+
+			/* an aborted or broken delivery will never be settled by the peer */
+			if (((result != LINK_TRANSFER_OK) || aborted) &&
+				(get_pending_delivery_slot(link, pending_delivery_index)->delivery == delivery_instance) &&
+				(delivery_instance->pending_delivery_index == pending_delivery_index))
+			{
+				remove_pending_delivery(link, delivery_instance);
 			}
 		}
+
+		transfer_destroy(transfer);
+	}
+
+	return result;
+}
+
+LINK_TRANSFER_RESULT link_transfer(LINK_HANDLE link, message_format message_format, PAYLOAD* payloads, size_t payload_count, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+	LINK_TRANSFER_RESULT result;
+
+	if (link == NULL)
+	{
+		result = LINK_TRANSFER_ERROR;
+	}
+	else
+	{
+		if ((link->role != role_sender) ||
+			(link->link_state != LINK_STATE_ATTACHED))
+		{
+			result = LINK_TRANSFER_ERROR;
+		}
+		else if ((link->link_credit == 0) ||
+			(link->streaming_delivery != NULL))
+		{
+			/* transfers of different deliveries cannot be interleaved on a link */
+			result = LINK_TRANSFER_BUSY;
+		}
+		else
+		{
+			result = send_first_transfer(link, message_format, payloads, payload_count, false, on_delivery_settled, callback_context, NULL, NULL);
+		}
+	}
+
+	return result;
+}
+
+LINK_TRANSFER_RESULT link_transfer_chunk(LINK_HANDLE link, message_format message_format, PAYLOAD* payloads, size_t payload_count, bool more, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context, ON_SEND_COMPLETE on_chunk_sent, void* on_chunk_sent_context)
+{
+	LINK_TRANSFER_RESULT result;
+
+	if (link == NULL)
+	{
+		result = LINK_TRANSFER_ERROR;
+	}
+	else
+	{
+		if ((link->role != role_sender) ||
+			(link->link_state != LINK_STATE_ATTACHED))
+		{
+			result = LINK_TRANSFER_ERROR;
+		}
+		else if (link->streaming_delivery != NULL)
+		{
+			result = send_continuation_transfer(link, payloads, payload_count, more, false, on_chunk_sent, on_chunk_sent_context);
+		}
+		else if (link->link_credit == 0)
+		{
+			result = LINK_TRANSFER_BUSY;
+		}
+		else
+		{
+			result = send_first_transfer(link, message_format, payloads, payload_count, more, on_delivery_settled, callback_context, on_chunk_sent, on_chunk_sent_context);
+		}
+	}
+
+	return result;
+}
+
+int link_abort_chunked_transfer(LINK_HANDLE link)
+{
+	int result;
+
+	if ((link == NULL) ||
+		(link->streaming_delivery == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		if (send_continuation_transfer(link, NULL, 0, false, true, NULL, NULL) != LINK_TRANSFER_OK)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
 	}
 
 	return result;
@@ -1175,12 +2271,20 @@ int link_send_disposition(LINK_HANDLE link, delivery_number message_id, AMQP_VAL
 	}
 	else
     {
-	    result = send_disposition(link, message_id, delivery_state);
+	    result = queue_disposition(link, message_id, delivery_state);
         if ( result != 0)
         {
             LogError("Cannot send disposition frame");
 			result = __FAILURE__;
         }
+        else if (remove_undisposed_delivery(link, message_id))
+        {
+            if ((link->role == role_receiver) &&
+                (link->link_state == LINK_STATE_ATTACHED))
+            {
+                replenish_link_credit(link);
+            }
+        }
     }
     return result;
 }
\ No newline at end of file
@@ -7,13 +7,36 @@
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_uamqp_c/message.h"
 #include "azure_uamqp_c/amqpvalue.h"
+#include "amqp_atomic.h"
 
 typedef struct BODY_AMQP_DATA_TAG
 {
 	unsigned char* body_data_section_bytes;
 	size_t body_data_section_length;
+	/* borrowed bytes belong to the caller or to a received payload and are not freed with the message */
+	bool is_borrowed;
 } BODY_AMQP_DATA;
 
+/* Sections in the order in which they appear in an encoded message */
+typedef enum ENCODED_SECTION_INDEX_TAG
+{
+	ENCODED_SECTION_HEADER,
+	ENCODED_SECTION_DELIVERY_ANNOTATIONS,
+	ENCODED_SECTION_MESSAGE_ANNOTATIONS,
+	ENCODED_SECTION_PROPERTIES,
+	ENCODED_SECTION_APPLICATION_PROPERTIES,
+	ENCODED_SECTION_BODY,
+	ENCODED_SECTION_FOOTER,
+	ENCODED_SECTION_COUNT
+} ENCODED_SECTION_INDEX;
+
+/* Bytes of a section that has not been decoded yet, borrowed from the payload given to message_set_lazy_payload */
+typedef struct ENCODED_SECTION_TAG
+{
+	const unsigned char* bytes;
+	size_t length;
+} ENCODED_SECTION;
+
 typedef struct MESSAGE_INSTANCE_TAG
 {
 	BODY_AMQP_DATA* body_amqp_data_items;
@@ -28,15 +51,24 @@ typedef struct MESSAGE_INSTANCE_TAG
 	application_properties application_properties;
 	annotations footer;
     uint32_t message_format;
+	ENCODED_SECTION encoded_sections[ENCODED_SECTION_COUNT];
+	MESSAGE_BODY_TYPE encoded_body_type;
 } MESSAGE_INSTANCE;
 
+typedef struct SECTION_DECODE_CONTEXT_TAG
+{
+	MESSAGE_INSTANCE* message_instance;
+	bool decode_error;
+} SECTION_DECODE_CONTEXT;
+
 static void free_all_body_data_items(MESSAGE_INSTANCE* message_instance)
 {
 	size_t i;
 
 	for (i = 0; i < message_instance->body_amqp_data_count; i++)
 	{
-		if (message_instance->body_amqp_data_items[i].body_data_section_bytes != NULL)
+		if ((message_instance->body_amqp_data_items[i].body_data_section_bytes != NULL) &&
+			!message_instance->body_amqp_data_items[i].is_borrowed)
 		{
 			free(message_instance->body_amqp_data_items[i].body_data_section_bytes);
 		}
@@ -64,6 +96,248 @@ static void free_all_body_sequence_items(MESSAGE_INSTANCE* message_instance)
 	message_instance->body_amqp_sequence_items = NULL;
 }
 
+static void discard_encoded_sections(MESSAGE_INSTANCE* message_instance)
+{
+	size_t i;
+
+	for (i = 0; i < ENCODED_SECTION_COUNT; i++)
+	{
+		message_instance->encoded_sections[i].bytes = NULL;
+		message_instance->encoded_sections[i].length = 0;
+	}
+
+	message_instance->encoded_body_type = MESSAGE_BODY_TYPE_NONE;
+}
+
+static void discard_encoded_section(MESSAGE_INSTANCE* message_instance, ENCODED_SECTION_INDEX section_index)
+{
+	message_instance->encoded_sections[section_index].bytes = NULL;
+	message_instance->encoded_sections[section_index].length = 0;
+	if (section_index == ENCODED_SECTION_BODY)
+	{
+		message_instance->encoded_body_type = MESSAGE_BODY_TYPE_NONE;
+	}
+}
+
+static void on_section_value_decoded(void* context, AMQP_VALUE decoded_value)
+{
+	SECTION_DECODE_CONTEXT* decode_context = (SECTION_DECODE_CONTEXT*)context;
+	MESSAGE_INSTANCE* message_instance = decode_context->message_instance;
+	AMQP_VALUE descriptor = amqpvalue_get_inplace_descriptor(decoded_value);
+
+	/* the decoder owns decoded_value, so whatever is kept is cloned exactly once */
+	if (is_header_type_by_descriptor(descriptor))
+	{
+		if (amqpvalue_get_header(decoded_value, &message_instance->header) != 0)
+		{
+			message_instance->header = NULL;
+			decode_context->decode_error = true;
+		}
+	}
+	else if (is_delivery_annotations_type_by_descriptor(descriptor))
+	{
+		message_instance->delivery_annotations = amqpvalue_clone(amqpvalue_get_inplace_described_value(decoded_value));
+		if (message_instance->delivery_annotations == NULL)
+		{
+			decode_context->decode_error = true;
+		}
+	}
+	else if (is_message_annotations_type_by_descriptor(descriptor))
+	{
+		message_instance->message_annotations = amqpvalue_clone(amqpvalue_get_inplace_described_value(decoded_value));
+		if (message_instance->message_annotations == NULL)
+		{
+			decode_context->decode_error = true;
+		}
+	}
+	else if (is_properties_type_by_descriptor(descriptor))
+	{
+		if (amqpvalue_get_properties(decoded_value, &message_instance->properties) != 0)
+		{
+			message_instance->properties = NULL;
+			decode_context->decode_error = true;
+		}
+	}
+	else if (is_application_properties_type_by_descriptor(descriptor))
+	{
+		message_instance->application_properties = amqpvalue_clone(decoded_value);
+		if (message_instance->application_properties == NULL)
+		{
+			decode_context->decode_error = true;
+		}
+	}
+	else if (is_footer_type_by_descriptor(descriptor))
+	{
+		message_instance->footer = amqpvalue_clone(amqpvalue_get_inplace_described_value(decoded_value));
+		if (message_instance->footer == NULL)
+		{
+			decode_context->decode_error = true;
+		}
+	}
+	else if (is_data_type_by_descriptor(descriptor))
+	{
+		AMQP_VALUE body_data_value = amqpvalue_get_inplace_described_value(decoded_value);
+		data data_value;
+
+		if ((body_data_value == NULL) ||
+			(amqpvalue_get_data(body_data_value, &data_value) != 0))
+		{
+			decode_context->decode_error = true;
+		}
+		else
+		{
+			BINARY_DATA binary_data;
+			binary_data.bytes = data_value.bytes;
+			binary_data.length = data_value.length;
+			if (message_add_body_amqp_data((MESSAGE_HANDLE)message_instance, binary_data) != 0)
+			{
+				decode_context->decode_error = true;
+			}
+		}
+	}
+	else if (is_amqp_sequence_type_by_descriptor(descriptor))
+	{
+		AMQP_VALUE sequence_list = amqpvalue_get_inplace_described_value(decoded_value);
+		if ((sequence_list == NULL) ||
+			(message_add_body_amqp_sequence((MESSAGE_HANDLE)message_instance, sequence_list) != 0))
+		{
+			decode_context->decode_error = true;
+		}
+	}
+	else if (is_amqp_value_type_by_descriptor(descriptor))
+	{
+		AMQP_VALUE body_amqp_value = amqpvalue_get_inplace_described_value(decoded_value);
+		if ((body_amqp_value == NULL) ||
+			(message_set_body_amqp_value((MESSAGE_HANDLE)message_instance, body_amqp_value) != 0))
+		{
+			decode_context->decode_error = true;
+		}
+	}
+	else
+	{
+		decode_context->decode_error = true;
+	}
+}
+
+static int add_body_data_item(MESSAGE_INSTANCE* message_instance, BINARY_DATA binary_data, bool is_borrowed);
+
+/* Data sections are binary values, so their bytes are referenced in place in the payload instead of being decoded and copied */
+static int add_encoded_data_sections(MESSAGE_INSTANCE* message_instance, const unsigned char* bytes, size_t length)
+{
+	int result = 0;
+	size_t position = 0;
+
+	while (position < length)
+	{
+		size_t section_length;
+		size_t descriptor_length;
+		size_t value_position;
+		size_t size_length;
+		BINARY_DATA binary_data;
+
+		if ((amqpvalue_get_encoded_value_length(bytes + position, length - position, &section_length) != 0) ||
+			(amqpvalue_get_encoded_value_length(bytes + position + 1, section_length - 1, &descriptor_length) != 0))
+		{
+			result = __FAILURE__;
+			break;
+		}
+
+		value_position = position + 1 + descriptor_length;
+		if (bytes[value_position] == 0xA0)
+		{
+			size_length = 1;
+		}
+		else if (bytes[value_position] == 0xB0)
+		{
+			size_length = 4;
+		}
+		else
+		{
+			result = __FAILURE__;
+			break;
+		}
+
+		binary_data.bytes = bytes + value_position + 1 + size_length;
+		binary_data.length = position + section_length - (value_position + 1 + size_length);
+		if (add_body_data_item(message_instance, binary_data, true) != 0)
+		{
+			result = __FAILURE__;
+			break;
+		}
+
+		position += section_length;
+	}
+
+	return result;
+}
+
+/* Decodes a section that was left encoded by message_set_lazy_payload. The section is consumed even if decoding it fails. */
+static int decode_encoded_section(MESSAGE_INSTANCE* message_instance, ENCODED_SECTION_INDEX section_index)
+{
+	int result;
+	ENCODED_SECTION encoded_section = message_instance->encoded_sections[section_index];
+
+	if (encoded_section.bytes == NULL)
+	{
+		result = 0;
+	}
+	else if ((section_index == ENCODED_SECTION_BODY) &&
+		(message_instance->encoded_body_type == MESSAGE_BODY_TYPE_DATA))
+	{
+		discard_encoded_section(message_instance, section_index);
+		result = add_encoded_data_sections(message_instance, encoded_section.bytes, encoded_section.length);
+	}
+	else
+	{
+		SECTION_DECODE_CONTEXT decode_context;
+		AMQPVALUE_DECODER_HANDLE decoder;
+
+		decode_context.message_instance = message_instance;
+		decode_context.decode_error = false;
+
+		decoder = amqpvalue_decoder_create(on_section_value_decoded, &decode_context);
+		if (decoder == NULL)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			discard_encoded_section(message_instance, section_index);
+
+			if ((amqpvalue_decode_bytes(decoder, encoded_section.bytes, encoded_section.length) != 0) ||
+				decode_context.decode_error)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				result = 0;
+			}
+
+			amqpvalue_decoder_destroy(decoder);
+		}
+	}
+
+	return result;
+}
+
+static int decode_all_encoded_sections(MESSAGE_INSTANCE* message_instance)
+{
+	int result = 0;
+	size_t i;
+
+	for (i = 0; i < ENCODED_SECTION_COUNT; i++)
+	{
+		if (decode_encoded_section(message_instance, (ENCODED_SECTION_INDEX)i) != 0)
+		{
+			result = __FAILURE__;
+			break;
+		}
+	}
+
+	return result;
+}
+
 MESSAGE_HANDLE message_create(void)
 {
 	MESSAGE_INSTANCE* result = (MESSAGE_INSTANCE*)malloc(sizeof(MESSAGE_INSTANCE));
@@ -82,6 +356,7 @@ MESSAGE_HANDLE message_create(void)
 		result->body_amqp_sequence_items = NULL;
 		result->body_amqp_sequence_count = 0;
         result->message_format = 0;
+		discard_encoded_sections(result);
 	}
 
 	/* Codes_SRS_MESSAGE_01_001: [message_create shall create a new AMQP message instance and on success it shall return a non-NULL handle for the newly created message instance.] */
@@ -97,6 +372,10 @@ MESSAGE_HANDLE message_clone(MESSAGE_HANDLE source_message)
 	{
 		result = NULL;
 	}
+	else if (decode_all_encoded_sections((MESSAGE_INSTANCE*)source_message) != 0)
+	{
+		result = NULL;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* source_message_instance = (MESSAGE_INSTANCE*)source_message;
@@ -189,6 +468,7 @@ MESSAGE_HANDLE message_clone(MESSAGE_HANDLE source_message)
 					for (i = 0; i < source_message_instance->body_amqp_data_count; i++)
 					{
 						result->body_amqp_data_items[i].body_data_section_length = source_message_instance->body_amqp_data_items[i].body_data_section_length;
+						result->body_amqp_data_items[i].is_borrowed = false;
 
 						/* Codes_SRS_MESSAGE_01_011: [If an AMQP data has been set as message body on the source message it shall be cloned by allocating memory for the binary payload.] */
 						result->body_amqp_data_items[i].body_data_section_bytes = malloc(source_message_instance->body_amqp_data_items[i].body_data_section_length);
@@ -257,125 +537,323 @@ MESSAGE_HANDLE message_clone(MESSAGE_HANDLE source_message)
 	return result;
 }
 
+static void free_message_contents(MESSAGE_INSTANCE* message_instance)
+{
+	if (message_instance->header != NULL)
+	{
+		header_destroy(message_instance->header);
+		message_instance->header = NULL;
+	}
+	if (message_instance->delivery_annotations != NULL)
+	{
+		annotations_destroy(message_instance->delivery_annotations);
+		message_instance->delivery_annotations = NULL;
+	}
+	if (message_instance->properties != NULL)
+	{
+		properties_destroy(message_instance->properties);
+		message_instance->properties = NULL;
+	}
+	if (message_instance->application_properties != NULL)
+	{
+		application_properties_destroy(message_instance->application_properties);
+		message_instance->application_properties = NULL;
+	}
+	if (message_instance->footer != NULL)
+	{
+		annotations_destroy(message_instance->footer);
+		message_instance->footer = NULL;
+	}
+	if (message_instance->body_amqp_value != NULL)
+	{
+		amqpvalue_destroy(message_instance->body_amqp_value);
+		message_instance->body_amqp_value = NULL;
+	}
+    if (message_instance->message_annotations != NULL)
+    {
+        application_properties_destroy(message_instance->message_annotations);
+        message_instance->message_annotations = NULL;
+    }
+
+	free_all_body_data_items(message_instance);
+	free_all_body_sequence_items(message_instance);
+	discard_encoded_sections(message_instance);
+}
+
 void message_destroy(MESSAGE_HANDLE message)
 {
 	if (message != NULL)
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
 
-		if (message_instance->header != NULL)
-		{
-			header_destroy(message_instance->header);
-		}
-		if (message_instance->properties != NULL)
-		{
-			properties_destroy(message_instance->properties);
-		}
-		if (message_instance->application_properties != NULL)
-		{
-			application_properties_destroy(message_instance->application_properties);
-		}
-		if (message_instance->footer != NULL)
-		{
-			annotations_destroy(message_instance->footer);
-		}
-		if (message_instance->body_amqp_value != NULL)
-		{
-			amqpvalue_destroy(message_instance->body_amqp_value);
-		}
-        if (message_instance->message_annotations != NULL)
-        {
-            application_properties_destroy(message_instance->message_annotations);
-        }
-
-		free_all_body_data_items(message_instance);
-		free_all_body_sequence_items(message_instance);
+		free_message_contents(message_instance);
 		free(message_instance);
 	}
 }
 
-int message_set_header(MESSAGE_HANDLE message, HEADER_HANDLE header)
+/* Drops all sections and body of a message so that the instance can be reused for another message */
+int message_reset(MESSAGE_HANDLE message)
 {
 	int result;
 
-	if ((message == NULL) ||
-		(header == NULL))
+	if (message == NULL)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
-		HEADER_HANDLE new_header;
 
-		new_header = header_clone(header);
-		if (new_header == NULL)
+		free_message_contents(message_instance);
+		message_instance->message_format = 0;
+		result = 0;
+	}
+
+	return result;
+}
+
+static int get_encoded_section_index(const unsigned char* bytes, size_t length, ENCODED_SECTION_INDEX* section_index, MESSAGE_BODY_TYPE* body_type)
+{
+	int result;
+	uint64_t descriptor_code;
+
+	/* sections are described values with a numeric descriptor, anything else is left to the full decoder */
+	if ((length < 2) ||
+		(bytes[0] != 0x00))
+	{
+		result = __FAILURE__;
+	}
+	else if (bytes[1] == 0x44)
+	{
+		descriptor_code = 0;
+		result = 0;
+	}
+	else if ((bytes[1] == 0x53) &&
+		(length >= 3))
+	{
+		descriptor_code = bytes[2];
+		result = 0;
+	}
+	else if ((bytes[1] == 0x80) &&
+		(length >= 10))
+	{
+		size_t i;
+
+		descriptor_code = 0;
+		for (i = 0; i < 8; i++)
 		{
-			result = __FAILURE__;
+			descriptor_code = (descriptor_code << 8) + bytes[2 + i];
 		}
-		else
-		{
-			if (message_instance->header != NULL)
-			{
-				header_destroy(message_instance->header);
-			}
 
-			message_instance->header = new_header;
-			result = 0;
+		result = 0;
+	}
+	else
+	{
+		result = __FAILURE__;
+	}
+
+	if (result == 0)
+	{
+		*body_type = MESSAGE_BODY_TYPE_NONE;
+
+		switch (descriptor_code)
+		{
+		default:
+			result = __FAILURE__;
+			break;
+		case 0x70:
+			*section_index = ENCODED_SECTION_HEADER;
+			break;
+		case 0x71:
+			*section_index = ENCODED_SECTION_DELIVERY_ANNOTATIONS;
+			break;
+		case 0x72:
+			*section_index = ENCODED_SECTION_MESSAGE_ANNOTATIONS;
+			break;
+		case 0x73:
+			*section_index = ENCODED_SECTION_PROPERTIES;
+			break;
+		case 0x74:
+			*section_index = ENCODED_SECTION_APPLICATION_PROPERTIES;
+			break;
+		case 0x75:
+			*section_index = ENCODED_SECTION_BODY;
+			*body_type = MESSAGE_BODY_TYPE_DATA;
+			break;
+		case 0x76:
+			*section_index = ENCODED_SECTION_BODY;
+			*body_type = MESSAGE_BODY_TYPE_SEQUENCE;
+			break;
+		case 0x77:
+			*section_index = ENCODED_SECTION_BODY;
+			*body_type = MESSAGE_BODY_TYPE_VALUE;
+			break;
+		case 0x78:
+			*section_index = ENCODED_SECTION_FOOTER;
+			break;
 		}
 	}
 
 	return result;
 }
 
-int message_get_header(MESSAGE_HANDLE message, HEADER_HANDLE* header)
+/* Replaces the content of a message with an encoded payload whose sections are only located here and decoded by the getters on first use.
+   The payload is borrowed: it has to stay valid until the message is reset or destroyed. */
+int message_set_lazy_payload(MESSAGE_HANDLE message, const unsigned char* payload_bytes, size_t payload_size)
 {
 	int result;
 
 	if ((message == NULL) ||
-		(header == NULL))
+		((payload_bytes == NULL) && (payload_size > 0)))
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
+		size_t position = 0;
+		size_t next_section_index = 0;
 
-		if (message_instance->header == NULL)
-		{
-			*header = NULL;
-			result = 0;
-		}
-		else
+		free_message_contents(message_instance);
+		result = 0;
+
+		while (position < payload_size)
 		{
-			*header = header_clone(message_instance->header);
-			if (*header == NULL)
+			size_t section_length;
+			ENCODED_SECTION_INDEX section_index;
+			MESSAGE_BODY_TYPE body_type;
+
+			if ((amqpvalue_get_encoded_value_length(payload_bytes + position, payload_size - position, &section_length) != 0) ||
+				(get_encoded_section_index(payload_bytes + position, section_length, &section_index, &body_type) != 0))
+			{
+				result = __FAILURE__;
+				break;
+			}
+
+			if ((section_index == ENCODED_SECTION_BODY) &&
+				(next_section_index == ENCODED_SECTION_BODY + 1) &&
+				(body_type == message_instance->encoded_body_type) &&
+				(body_type != MESSAGE_BODY_TYPE_VALUE))
+			{
+				/* consecutive data or sequence sections form one body */
+				message_instance->encoded_sections[ENCODED_SECTION_BODY].length += section_length;
+			}
+			else if ((size_t)section_index < next_section_index)
 			{
 				result = __FAILURE__;
+				break;
 			}
 			else
 			{
-				result = 0;
+				message_instance->encoded_sections[section_index].bytes = payload_bytes + position;
+				message_instance->encoded_sections[section_index].length = section_length;
+				if (section_index == ENCODED_SECTION_BODY)
+				{
+					message_instance->encoded_body_type = body_type;
+				}
+
+				next_section_index = (size_t)section_index + 1;
 			}
+
+			position += section_length;
+		}
+
+		if (result != 0)
+		{
+			discard_encoded_sections(message_instance);
 		}
 	}
 
 	return result;
 }
 
-int message_set_delivery_annotations(MESSAGE_HANDLE message, annotations delivery_annotations)
+int message_set_header(MESSAGE_HANDLE message, HEADER_HANDLE header)
 {
 	int result;
 
 	if ((message == NULL) ||
-		(delivery_annotations == NULL))
+		(header == NULL))
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
-		annotations new_delivery_annotations;
+		HEADER_HANDLE new_header;
+
+		new_header = header_clone(header);
+		if (new_header == NULL)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			if (message_instance->header != NULL)
+			{
+				header_destroy(message_instance->header);
+			}
+
+			discard_encoded_section(message_instance, ENCODED_SECTION_HEADER);
+			message_instance->header = new_header;
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+int message_get_header(MESSAGE_HANDLE message, HEADER_HANDLE* header)
+{
+	int result;
+
+	if ((message == NULL) ||
+		(header == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_HEADER) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
+
+		if (message_instance->header == NULL)
+		{
+			*header = NULL;
+			result = 0;
+		}
+		else
+		{
+			*header = header_clone(message_instance->header);
+			if (*header == NULL)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+int message_set_delivery_annotations(MESSAGE_HANDLE message, annotations delivery_annotations)
+{
+	int result;
+
+	if ((message == NULL) ||
+		(delivery_annotations == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
+		annotations new_delivery_annotations;
 
 		new_delivery_annotations = annotations_clone(delivery_annotations);
 		if (new_delivery_annotations == NULL)
@@ -388,6 +866,7 @@ int message_set_delivery_annotations(MESSAGE_HANDLE message, annotations deliver
 			{
 				annotations_destroy(message_instance->delivery_annotations);
 			}
+			discard_encoded_section(message_instance, ENCODED_SECTION_DELIVERY_ANNOTATIONS);
 			message_instance->delivery_annotations = new_delivery_annotations;
 			result = 0;
 		}
@@ -405,6 +884,10 @@ int message_get_delivery_annotations(MESSAGE_HANDLE message, annotations* delive
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_DELIVERY_ANNOTATIONS) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -457,6 +940,7 @@ int message_set_message_annotations(MESSAGE_HANDLE message, annotations message_
 				annotations_destroy(message_instance->message_annotations);
 			}
 
+			discard_encoded_section(message_instance, ENCODED_SECTION_MESSAGE_ANNOTATIONS);
 			message_instance->message_annotations = new_message_annotations;
 			result = 0;
 		}
@@ -474,6 +958,10 @@ int message_get_message_annotations(MESSAGE_HANDLE message, annotations* message
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_MESSAGE_ANNOTATIONS) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -526,6 +1014,7 @@ int message_set_properties(MESSAGE_HANDLE message, PROPERTIES_HANDLE properties)
 				properties_destroy(message_instance->properties);
 			}
 
+			discard_encoded_section(message_instance, ENCODED_SECTION_PROPERTIES);
 			message_instance->properties = new_properties;
 			result = 0;
 		}
@@ -543,6 +1032,10 @@ int message_get_properties(MESSAGE_HANDLE message, PROPERTIES_HANDLE* properties
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_PROPERTIES) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -595,6 +1088,7 @@ int message_set_application_properties(MESSAGE_HANDLE message, AMQP_VALUE applic
 				amqpvalue_destroy(message_instance->application_properties);
 			}
 
+			discard_encoded_section(message_instance, ENCODED_SECTION_APPLICATION_PROPERTIES);
 			message_instance->application_properties = new_application_properties;
 			result = 0;
 		}
@@ -612,6 +1106,10 @@ int message_get_application_properties(MESSAGE_HANDLE message, AMQP_VALUE* appli
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_APPLICATION_PROPERTIES) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -664,6 +1162,7 @@ int message_set_footer(MESSAGE_HANDLE message, annotations footer)
 				annotations_destroy(message_instance->footer);
 			}
 
+			discard_encoded_section(message_instance, ENCODED_SECTION_FOOTER);
 			message_instance->footer = new_footer;
 			result = 0;
 		}
@@ -681,6 +1180,10 @@ int message_get_footer(MESSAGE_HANDLE message, annotations* footer)
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_FOOTER) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -707,47 +1210,139 @@ int message_get_footer(MESSAGE_HANDLE message, annotations* footer)
 	return result;
 }
 
-int message_add_body_amqp_data(MESSAGE_HANDLE message, BINARY_DATA binary_data)
+static int add_body_data_item(MESSAGE_INSTANCE* message_instance, BINARY_DATA binary_data, bool is_borrowed)
 {
 	int result;
 
-	MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
-	if ((message == NULL) ||
-		((binary_data.bytes == NULL) &&
-		 (binary_data.length != 0)))
+	BODY_AMQP_DATA* new_body_amqp_data_items = (BODY_AMQP_DATA*)realloc(message_instance->body_amqp_data_items, sizeof(BODY_AMQP_DATA) * (message_instance->body_amqp_data_count + 1));
+	if (new_body_amqp_data_items == NULL)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		BODY_AMQP_DATA* new_body_amqp_data_items = (BODY_AMQP_DATA*)realloc(message_instance->body_amqp_data_items, sizeof(BODY_AMQP_DATA) * (message_instance->body_amqp_data_count + 1));
-		if (new_body_amqp_data_items == NULL)
+		BODY_AMQP_DATA* body_data_item = &new_body_amqp_data_items[message_instance->body_amqp_data_count];
+
+		message_instance->body_amqp_data_items = new_body_amqp_data_items;
+
+		if (is_borrowed)
 		{
-			result = __FAILURE__;
+			body_data_item->body_data_section_bytes = (unsigned char*)binary_data.bytes;
 		}
 		else
 		{
-			message_instance->body_amqp_data_items = new_body_amqp_data_items;
+			body_data_item->body_data_section_bytes = (unsigned char*)malloc(binary_data.length);
+		}
 
-			message_instance->body_amqp_data_items[message_instance->body_amqp_data_count].body_data_section_bytes = (unsigned char*)malloc(binary_data.length);
-			if (message_instance->body_amqp_data_items[message_instance->body_amqp_data_count].body_data_section_bytes == NULL)
+		if (body_data_item->body_data_section_bytes == NULL)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			body_data_item->body_data_section_length = binary_data.length;
+			body_data_item->is_borrowed = is_borrowed;
+			if (!is_borrowed)
 			{
-				result = __FAILURE__;
+				(void)memcpy(body_data_item->body_data_section_bytes, binary_data.bytes, binary_data.length);
 			}
-			else
+
+			if (message_instance->body_amqp_value != NULL)
 			{
-				message_instance->body_amqp_data_items[message_instance->body_amqp_data_count].body_data_section_length = binary_data.length;
-				(void)memcpy(message_instance->body_amqp_data_items[message_instance->body_amqp_data_count].body_data_section_bytes, binary_data.bytes, binary_data.length);
+				amqpvalue_destroy(message_instance->body_amqp_value);
+				message_instance->body_amqp_value = NULL;
+			}
+			free_all_body_sequence_items(message_instance);
 
-				if (message_instance->body_amqp_value != NULL)
+			message_instance->body_amqp_data_count++;
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+int message_add_body_amqp_data(MESSAGE_HANDLE message, BINARY_DATA binary_data)
+{
+	int result;
+
+	if ((message == NULL) ||
+		((binary_data.bytes == NULL) &&
+		 (binary_data.length != 0)))
+	{
+		result = __FAILURE__;
+	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = add_body_data_item((MESSAGE_INSTANCE*)message, binary_data, false);
+	}
+
+	return result;
+}
+
+/* Same as message_add_body_amqp_data, except that the bytes are referenced instead of copied.
+   They have to stay valid until the message is destroyed or reset, or until message_retain_body_amqp_data is called. */
+int message_add_body_amqp_data_borrowed(MESSAGE_HANDLE message, BINARY_DATA binary_data)
+{
+	int result;
+
+	if ((message == NULL) ||
+		(binary_data.bytes == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = add_body_data_item((MESSAGE_INSTANCE*)message, binary_data, true);
+	}
+
+	return result;
+}
+
+/* Makes the message independent of any borrowed memory: lazily decoded sections are decoded and borrowed body data is copied */
+int message_retain_body_amqp_data(MESSAGE_HANDLE message)
+{
+	int result;
+
+	if (message == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else if (decode_all_encoded_sections((MESSAGE_INSTANCE*)message) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
+		size_t i;
+
+		result = 0;
+
+		for (i = 0; i < message_instance->body_amqp_data_count; i++)
+		{
+			BODY_AMQP_DATA* body_data_item = &message_instance->body_amqp_data_items[i];
+
+			if (body_data_item->is_borrowed)
+			{
+				unsigned char* bytes = (unsigned char*)malloc(body_data_item->body_data_section_length);
+				if (bytes == NULL)
 				{
-					amqpvalue_destroy(message_instance->body_amqp_value);
-					message_instance->body_amqp_value = NULL;
+					result = __FAILURE__;
+					break;
 				}
-				free_all_body_sequence_items(message_instance);
 
-				message_instance->body_amqp_data_count++;
-				result = 0;
+				(void)memcpy(bytes, body_data_item->body_data_section_bytes, body_data_item->body_data_section_length);
+				body_data_item->body_data_section_bytes = bytes;
+				body_data_item->is_borrowed = false;
 			}
 		}
 	}
@@ -764,6 +1359,10 @@ int message_get_body_amqp_data(MESSAGE_HANDLE message, size_t index, BINARY_DATA
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -794,6 +1393,10 @@ int message_get_body_amqp_data_count(MESSAGE_HANDLE message, size_t* count)
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		*count = message_instance->body_amqp_data_count;
@@ -815,6 +1418,10 @@ int message_add_body_amqp_sequence(MESSAGE_HANDLE message, AMQP_VALUE sequence_l
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		AMQP_VALUE* new_body_amqp_sequence_items = (AMQP_VALUE*)realloc(message_instance->body_amqp_sequence_items, sizeof(AMQP_VALUE) * (message_instance->body_amqp_sequence_count + 1));
@@ -858,6 +1465,10 @@ int message_get_body_amqp_sequence(MESSAGE_HANDLE message, size_t index, AMQP_VA
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -893,6 +1504,10 @@ int message_get_body_amqp_sequence_count(MESSAGE_HANDLE message, size_t* count)
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		*count = message_instance->body_amqp_sequence_count;
@@ -916,6 +1531,7 @@ int message_set_body_amqp_value(MESSAGE_HANDLE message, AMQP_VALUE body_amqp_val
 	{
 		message_instance->body_amqp_value = amqpvalue_clone(body_amqp_value);
 
+		discard_encoded_section(message_instance, ENCODED_SECTION_BODY);
 		free_all_body_data_items(message_instance);
 		free_all_body_sequence_items(message_instance);
 		result = 0;
@@ -933,6 +1549,10 @@ int message_get_inplace_body_amqp_value(MESSAGE_HANDLE message, AMQP_VALUE* body
 	{
 		result = __FAILURE__;
 	}
+	else if (decode_encoded_section((MESSAGE_INSTANCE*)message, ENCODED_SECTION_BODY) != 0)
+	{
+		result = __FAILURE__;
+	}
 	else
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
@@ -958,7 +1578,11 @@ int message_get_body_type(MESSAGE_HANDLE message, MESSAGE_BODY_TYPE* body_type)
 	{
 		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
 
-		if (message_instance->body_amqp_value != NULL)
+		if (message_instance->encoded_sections[ENCODED_SECTION_BODY].bytes != NULL)
+		{
+			*body_type = message_instance->encoded_body_type;
+		}
+		else if (message_instance->body_amqp_value != NULL)
 		{
 			*body_type = MESSAGE_BODY_TYPE_VALUE;
 		}
@@ -1017,3 +1641,631 @@ int message_get_message_format(MESSAGE_HANDLE message, uint32_t *message_format)
 
     return result;
 }
+
+typedef struct MESSAGE_ENCODED_INSTANCE_TAG
+{
+	unsigned char* bytes;
+	size_t length;
+	uint32_t message_format;
+	/* clones may be released from different threads */
+	volatile size_t ref_count;
+} MESSAGE_ENCODED_INSTANCE;
+
+typedef unsigned char*(*ALLOCATE_ENCODED_BYTES)(void* context, size_t size);
+
+static int encode_bytes(void* context, const unsigned char* bytes, size_t length)
+{
+	unsigned char** position = (unsigned char**)context;
+	(void)memcpy(*position, bytes, length);
+	*position += length;
+	return 0;
+}
+
+static size_t get_data_section_encoded_size(size_t length)
+{
+	/* described data section: 0x00 0x53 0x75 followed by a vbin8 or vbin32 */
+	return ((length <= 255) ? 5 : 8) + length;
+}
+
+static unsigned char* encode_data_section(unsigned char* position, const unsigned char* bytes, size_t length)
+{
+	*position++ = 0x00;
+	*position++ = 0x53;
+	*position++ = 0x75;
+
+	if (length <= 255)
+	{
+		*position++ = 0xA0;
+		*position++ = (unsigned char)length;
+	}
+	else
+	{
+		*position++ = 0xB0;
+		*position++ = (unsigned char)((length >> 24) & 0xFF);
+		*position++ = (unsigned char)((length >> 16) & 0xFF);
+		*position++ = (unsigned char)((length >> 8) & 0xFF);
+		*position++ = (unsigned char)(length & 0xFF);
+	}
+
+	if (length > 0)
+	{
+		(void)memcpy(position, bytes, length);
+	}
+
+	return position + length;
+}
+
+/* Sizes all sections first so that the destination can be allocated once, then encodes them in place.
+   Data sections are framed directly rather than going through amqpvalue_create_data, which would copy each body chunk. */
+static int encode_message_sections(MESSAGE_INSTANCE* message_instance, ALLOCATE_ENCODED_BYTES allocate_encoded_bytes, void* context, size_t* encoded_length)
+{
+	int result;
+	AMQP_VALUE header_value = NULL;
+	AMQP_VALUE properties_value = NULL;
+	AMQP_VALUE application_properties_value = NULL;
+	AMQP_VALUE body_value = NULL;
+
+	if (decode_all_encoded_sections(message_instance) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else if ((message_instance->body_amqp_value == NULL) &&
+		(message_instance->body_amqp_data_count == 0) &&
+		(message_instance->body_amqp_sequence_count > 0))
+	{
+		/* sequence bodies are not supported for sending */
+		result = __FAILURE__;
+	}
+	else if (((message_instance->header != NULL) && ((header_value = amqpvalue_create_header(message_instance->header)) == NULL)) ||
+		((message_instance->properties != NULL) && ((properties_value = amqpvalue_create_properties(message_instance->properties)) == NULL)) ||
+		((message_instance->application_properties != NULL) && ((application_properties_value = amqpvalue_create_application_properties(message_instance->application_properties)) == NULL)) ||
+		((message_instance->body_amqp_value != NULL) && ((body_value = amqpvalue_create_amqp_value(message_instance->body_amqp_value)) == NULL)))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		AMQP_VALUE sections[5];
+		size_t section_count = 0;
+		size_t total_encoded_size = 0;
+		size_t i;
+
+		sections[section_count++] = header_value;
+		sections[section_count++] = message_instance->message_annotations;
+		sections[section_count++] = properties_value;
+		sections[section_count++] = application_properties_value;
+		sections[section_count++] = body_value;
+
+		result = 0;
+
+		for (i = 0; i < section_count; i++)
+		{
+			size_t encoded_size;
+
+			if (sections[i] == NULL)
+			{
+				continue;
+			}
+
+			if (amqpvalue_get_encoded_size(sections[i], &encoded_size) != 0)
+			{
+				result = __FAILURE__;
+				break;
+			}
+
+			total_encoded_size += encoded_size;
+		}
+
+		if ((result == 0) &&
+			(body_value == NULL))
+		{
+			for (i = 0; i < message_instance->body_amqp_data_count; i++)
+			{
+				total_encoded_size += get_data_section_encoded_size(message_instance->body_amqp_data_items[i].body_data_section_length);
+			}
+		}
+
+		if (result == 0)
+		{
+			unsigned char* position = allocate_encoded_bytes(context, total_encoded_size);
+			if (position == NULL)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				for (i = 0; i < section_count; i++)
+				{
+					if ((sections[i] != NULL) &&
+						(amqpvalue_encode(sections[i], encode_bytes, &position) != 0))
+					{
+						result = __FAILURE__;
+						break;
+					}
+				}
+
+				if ((result == 0) &&
+					(body_value == NULL))
+				{
+					for (i = 0; i < message_instance->body_amqp_data_count; i++)
+					{
+						position = encode_data_section(position, message_instance->body_amqp_data_items[i].body_data_section_bytes, message_instance->body_amqp_data_items[i].body_data_section_length);
+					}
+				}
+
+				if (result == 0)
+				{
+					*encoded_length = total_encoded_size;
+				}
+			}
+		}
+	}
+
+	if (header_value != NULL)
+	{
+		amqpvalue_destroy(header_value);
+	}
+
+	if (properties_value != NULL)
+	{
+		amqpvalue_destroy(properties_value);
+	}
+
+	if (application_properties_value != NULL)
+	{
+		amqpvalue_destroy(application_properties_value);
+	}
+
+	if (body_value != NULL)
+	{
+		amqpvalue_destroy(body_value);
+	}
+
+	return result;
+}
+
+static unsigned char* allocate_message_encoded(void* context, size_t size)
+{
+	MESSAGE_ENCODED_INSTANCE** message_encoded = (MESSAGE_ENCODED_INSTANCE**)context;
+
+	/* one block for the handle and the bytes */
+	*message_encoded = (MESSAGE_ENCODED_INSTANCE*)malloc(sizeof(MESSAGE_ENCODED_INSTANCE) + size);
+	return (*message_encoded == NULL) ? NULL : (unsigned char*)(*message_encoded + 1);
+}
+
+MESSAGE_ENCODED_HANDLE message_encode(MESSAGE_HANDLE message)
+{
+	MESSAGE_ENCODED_INSTANCE* result;
+
+	if (message == NULL)
+	{
+		result = NULL;
+	}
+	else
+	{
+		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
+		MESSAGE_ENCODED_INSTANCE* message_encoded = NULL;
+		size_t encoded_length;
+
+		if (encode_message_sections(message_instance, allocate_message_encoded, &message_encoded, &encoded_length) != 0)
+		{
+			if (message_encoded != NULL)
+			{
+				free(message_encoded);
+			}
+
+			result = NULL;
+		}
+		else
+		{
+			message_encoded->bytes = (unsigned char*)(message_encoded + 1);
+			message_encoded->length = encoded_length;
+			message_encoded->message_format = message_instance->message_format;
+			message_encoded->ref_count = 1;
+			result = message_encoded;
+		}
+	}
+
+	return result;
+}
+
+typedef struct ENCODE_APPEND_CONTEXT_TAG
+{
+	unsigned char** buffer;
+	size_t* buffer_size;
+	size_t* buffer_length;
+} ENCODE_APPEND_CONTEXT;
+
+static unsigned char* allocate_appended_bytes(void* context, size_t size)
+{
+	ENCODE_APPEND_CONTEXT* append_context = (ENCODE_APPEND_CONTEXT*)context;
+	unsigned char* result;
+
+	if ((*append_context->buffer != NULL) &&
+		(*append_context->buffer_size - *append_context->buffer_length >= size))
+	{
+		result = *append_context->buffer + *append_context->buffer_length;
+	}
+	else
+	{
+		/* grow geometrically so that appending many messages does not realloc once per message */
+		size_t new_size = *append_context->buffer_size * 2;
+		unsigned char* new_buffer;
+
+		if (new_size < *append_context->buffer_length + size)
+		{
+			new_size = *append_context->buffer_length + size;
+		}
+
+		/* a message without any sections still needs a non-NULL buffer */
+		if (new_size == 0)
+		{
+			new_size = 1;
+		}
+
+		new_buffer = (unsigned char*)realloc(*append_context->buffer, new_size);
+		if (new_buffer == NULL)
+		{
+			result = NULL;
+		}
+		else
+		{
+			*append_context->buffer = new_buffer;
+			*append_context->buffer_size = new_size;
+			result = new_buffer + *append_context->buffer_length;
+		}
+	}
+
+	return result;
+}
+
+int message_encode_append(MESSAGE_HANDLE message, unsigned char** buffer, size_t* buffer_size, size_t* buffer_length)
+{
+	int result;
+
+	if ((message == NULL) ||
+		(buffer == NULL) ||
+		(buffer_size == NULL) ||
+		(buffer_length == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		ENCODE_APPEND_CONTEXT append_context;
+		size_t encoded_length;
+
+		append_context.buffer = buffer;
+		append_context.buffer_size = buffer_size;
+		append_context.buffer_length = buffer_length;
+
+		if (encode_message_sections((MESSAGE_INSTANCE*)message, allocate_appended_bytes, &append_context, &encoded_length) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			*buffer_length += encoded_length;
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+MESSAGE_ENCODED_HANDLE message_encoded_clone(MESSAGE_ENCODED_HANDLE message_encoded)
+{
+	if (message_encoded != NULL)
+	{
+		(void)amqp_atomic_increment_size(&message_encoded->ref_count);
+	}
+
+	return message_encoded;
+}
+
+void message_encoded_destroy(MESSAGE_ENCODED_HANDLE message_encoded)
+{
+	if (message_encoded != NULL)
+	{
+		if (amqp_atomic_decrement_size(&message_encoded->ref_count) == 0)
+		{
+			free(message_encoded);
+		}
+	}
+}
+
+int message_encoded_get_bytes(MESSAGE_ENCODED_HANDLE message_encoded, const unsigned char** bytes, size_t* length)
+{
+	int result;
+
+	if ((message_encoded == NULL) ||
+		(bytes == NULL) ||
+		(length == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		*bytes = message_encoded->bytes;
+		*length = message_encoded->length;
+		result = 0;
+	}
+
+	return result;
+}
+
+int message_encoded_get_message_format(MESSAGE_ENCODED_HANDLE message_encoded, uint32_t* message_format)
+{
+	int result;
+
+	if ((message_encoded == NULL) ||
+		(message_format == NULL))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		*message_format = message_encoded->message_format;
+		result = 0;
+	}
+
+	return result;
+}
+
+typedef struct MESSAGE_TEMPLATE_INSTANCE_TAG
+{
+	unsigned char* bytes;
+	size_t length;
+	uint32_t message_format;
+	size_t message_id_offset;
+	size_t creation_time_offset;
+} MESSAGE_TEMPLATE_INSTANCE;
+
+/* placeholders are large enough to force the fixed-width ulong (0x80) encoding, and differ in every byte */
+#define MESSAGE_TEMPLATE_PLACEHOLDER_A	0x5A5A5A5A5A5A5A5AULL
+#define MESSAGE_TEMPLATE_PLACEHOLDER_B	0xA5A5A5A5A5A5A5A5ULL
+#define MESSAGE_TEMPLATE_FIELD_SIZE	8
+#define MESSAGE_TEMPLATE_NO_FIELD	((size_t)-1)
+
+static int encode_template_sections(MESSAGE_INSTANCE* message_instance, PROPERTIES_HANDLE properties, unsigned int variable_fields, uint64_t placeholder, unsigned char** buffer, size_t* buffer_length)
+{
+	int result;
+	AMQP_VALUE message_id_value = NULL;
+
+	if (((variable_fields & MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID) != 0) &&
+		(((message_id_value = amqpvalue_create_message_id_ulong(placeholder)) == NULL) ||
+		(properties_set_message_id(properties, message_id_value) != 0)))
+	{
+		result = __FAILURE__;
+	}
+	else if (((variable_fields & MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME) != 0) &&
+		(properties_set_creation_time(properties, (timestamp)placeholder) != 0))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		/* only the sections ahead of the body go into the template */
+		MESSAGE_INSTANCE template_sections = *message_instance;
+		ENCODE_APPEND_CONTEXT append_context;
+		size_t buffer_size = 0;
+
+		template_sections.properties = properties;
+		template_sections.body_amqp_value = NULL;
+		template_sections.body_amqp_data_count = 0;
+		template_sections.body_amqp_sequence_count = 0;
+
+		*buffer = NULL;
+		*buffer_length = 0;
+		append_context.buffer = buffer;
+		append_context.buffer_size = &buffer_size;
+		append_context.buffer_length = buffer_length;
+
+		if (encode_message_sections(&template_sections, allocate_appended_bytes, &append_context, buffer_length) != 0)
+		{
+			free(*buffer);
+			*buffer = NULL;
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	if (message_id_value != NULL)
+	{
+		amqpvalue_destroy(message_id_value);
+	}
+
+	return result;
+}
+
+MESSAGE_TEMPLATE_HANDLE message_template_create(MESSAGE_HANDLE message, unsigned int variable_fields)
+{
+	MESSAGE_TEMPLATE_INSTANCE* result;
+
+	if ((message == NULL) ||
+		((variable_fields & ~(MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID | MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME)) != 0) ||
+		(decode_all_encoded_sections((MESSAGE_INSTANCE*)message) != 0))
+	{
+		result = NULL;
+	}
+	else
+	{
+		MESSAGE_INSTANCE* message_instance = (MESSAGE_INSTANCE*)message;
+		PROPERTIES_HANDLE properties = (message_instance->properties != NULL) ? properties_clone(message_instance->properties) : properties_create();
+
+		if (properties == NULL)
+		{
+			result = NULL;
+		}
+		else
+		{
+			unsigned char* bytes_a;
+			size_t length_a;
+			unsigned char* bytes_b;
+			size_t length_b;
+
+			/* the variable fields are located by encoding the sections twice with different placeholders */
+			if (encode_template_sections(message_instance, properties, variable_fields, MESSAGE_TEMPLATE_PLACEHOLDER_A, &bytes_a, &length_a) != 0)
+			{
+				result = NULL;
+			}
+			else
+			{
+				if (encode_template_sections(message_instance, properties, variable_fields, MESSAGE_TEMPLATE_PLACEHOLDER_B, &bytes_b, &length_b) != 0)
+				{
+					result = NULL;
+				}
+				else
+				{
+					result = (MESSAGE_TEMPLATE_INSTANCE*)malloc(sizeof(MESSAGE_TEMPLATE_INSTANCE));
+					if (result != NULL)
+					{
+						size_t field_offsets[2] = { MESSAGE_TEMPLATE_NO_FIELD, MESSAGE_TEMPLATE_NO_FIELD };
+						size_t field_count = 0;
+						size_t expected_field_count = 0;
+						size_t i = 0;
+
+						/* differing runs appear in properties order: message-id first, then creation-time */
+						while ((length_a == length_b) && (i < length_a))
+						{
+							if (bytes_a[i] == bytes_b[i])
+							{
+								i++;
+							}
+							else
+							{
+								size_t run_length = 1;
+								while ((run_length < MESSAGE_TEMPLATE_FIELD_SIZE) &&
+									(i + run_length < length_a) &&
+									(bytes_a[i + run_length] != bytes_b[i + run_length]))
+								{
+									run_length++;
+								}
+
+								if ((run_length != MESSAGE_TEMPLATE_FIELD_SIZE) ||
+									(field_count == 2))
+								{
+									break;
+								}
+
+								field_offsets[field_count++] = i;
+								i += MESSAGE_TEMPLATE_FIELD_SIZE;
+							}
+						}
+
+						result->message_id_offset = MESSAGE_TEMPLATE_NO_FIELD;
+						result->creation_time_offset = MESSAGE_TEMPLATE_NO_FIELD;
+
+						if ((variable_fields & MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID) != 0)
+						{
+							result->message_id_offset = field_offsets[expected_field_count++];
+						}
+
+						if ((variable_fields & MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME) != 0)
+						{
+							result->creation_time_offset = field_offsets[expected_field_count++];
+						}
+
+						if ((length_a != length_b) ||
+							(i != length_a) ||
+							(field_count != expected_field_count))
+						{
+							free(result);
+							result = NULL;
+						}
+						else
+						{
+							result->bytes = bytes_a;
+							result->length = length_a;
+							result->message_format = message_instance->message_format;
+							bytes_a = NULL;
+						}
+					}
+
+					free(bytes_b);
+				}
+
+				free(bytes_a);
+			}
+
+			properties_destroy(properties);
+		}
+	}
+
+	return result;
+}
+
+void message_template_destroy(MESSAGE_TEMPLATE_HANDLE message_template)
+{
+	if (message_template != NULL)
+	{
+		free(message_template->bytes);
+		free(message_template);
+	}
+}
+
+static void patch_template_field(unsigned char* position, uint64_t value)
+{
+	int i;
+
+	for (i = MESSAGE_TEMPLATE_FIELD_SIZE - 1; i >= 0; i--)
+	{
+		position[i] = (unsigned char)(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+MESSAGE_ENCODED_HANDLE message_template_encode(MESSAGE_TEMPLATE_HANDLE message_template, uint64_t message_id, timestamp creation_time, const BINARY_DATA* body_data_items, size_t body_data_count)
+{
+	MESSAGE_ENCODED_INSTANCE* result;
+
+	if ((message_template == NULL) ||
+		((body_data_items == NULL) && (body_data_count > 0)))
+	{
+		result = NULL;
+	}
+	else
+	{
+		size_t total_encoded_size = message_template->length;
+		size_t i;
+
+		for (i = 0; i < body_data_count; i++)
+		{
+			total_encoded_size += get_data_section_encoded_size(body_data_items[i].length);
+		}
+
+		result = (MESSAGE_ENCODED_INSTANCE*)malloc(sizeof(MESSAGE_ENCODED_INSTANCE) + total_encoded_size);
+		if (result != NULL)
+		{
+			unsigned char* position = (unsigned char*)(result + 1);
+
+			result->bytes = position;
+			result->length = total_encoded_size;
+			result->message_format = message_template->message_format;
+			result->ref_count = 1;
+
+			(void)memcpy(position, message_template->bytes, message_template->length);
+
+			if (message_template->message_id_offset != MESSAGE_TEMPLATE_NO_FIELD)
+			{
+				patch_template_field(position + message_template->message_id_offset, message_id);
+			}
+
+			if (message_template->creation_time_offset != MESSAGE_TEMPLATE_NO_FIELD)
+			{
+				patch_template_field(position + message_template->creation_time_offset, (uint64_t)creation_time);
+			}
+
+			position += message_template->length;
+			for (i = 0; i < body_data_count; i++)
+			{
+				position = encode_data_section(position, body_data_items[i].bytes, body_data_items[i].length);
+			}
+		}
+	}
+
+	return result;
+}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -18,9 +19,27 @@ typedef struct MESSAGE_RECEIVER_INSTANCE_TAG
 	const void* on_message_receiver_state_changed_context;
 	const void* callback_context;
 	MESSAGE_HANDLE decoded_message;
+	AMQPVALUE_DECODER_HANDLE decoder;
 	bool decode_error;
+	bool lazy_decode;
+	bool is_streaming;
+	ON_MESSAGE_SECTIONS_RECEIVED on_message_sections_received;
+	ON_MESSAGE_BODY_CHUNK_RECEIVED on_message_body_chunk_received;
+	unsigned char* stream_buffer;
+	size_t stream_buffer_size;
+	size_t stream_buffer_length;
+	uint64_t stream_data_remaining;
+	bool are_stream_sections_reported;
+	bool stream_error;
 } MESSAGE_RECEIVER_INSTANCE;
 
+typedef enum STREAM_PARSE_RESULT_TAG
+{
+	STREAM_PARSE_OK,
+	STREAM_PARSE_NEED_MORE_BYTES,
+	STREAM_PARSE_ERROR
+} STREAM_PARSE_RESULT;
+
 static void set_message_receiver_state(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, MESSAGE_RECEIVER_STATE new_state)
 {
 	MESSAGE_RECEIVER_STATE previous_state = message_receiver_instance->message_receiver_state;
@@ -164,42 +183,376 @@ static AMQP_VALUE on_transfer_received(void* context, TRANSFER_HANDLE transfer,
     (void)transfer;
 	if (message_receiver_instance->on_message_received != NULL)
 	{
-		MESSAGE_HANDLE message = message_create();
-		if (message == NULL)
+		/* The message and the decoder are created on the first transfer and reused for every transfer after it */
+		if ((message_receiver_instance->decoded_message == NULL) &&
+			((message_receiver_instance->decoded_message = message_create()) == NULL))
+		{
+			set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
+		}
+		else if (message_receiver_instance->lazy_decode &&
+			(message_set_lazy_payload(message_receiver_instance->decoded_message, payload_bytes, payload_size) == 0))
+		{
+			/* sections are decoded by the message getters, straight from the payload, while the callback runs.
+			   Data body bytes point into the payload, so keeping them past the callback requires message_clone or message_retain_body_amqp_data. */
+			result = message_receiver_instance->on_message_received(message_receiver_instance->callback_context, message_receiver_instance->decoded_message);
+			(void)message_reset(message_receiver_instance->decoded_message);
+		}
+		else if ((message_receiver_instance->decoder == NULL) &&
+			((message_receiver_instance->decoder = amqpvalue_decoder_create(decode_message_value_callback, message_receiver_instance)) == NULL))
 		{
 			set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
 		}
 		else
 		{
-			AMQPVALUE_DECODER_HANDLE amqpvalue_decoder = amqpvalue_decoder_create(decode_message_value_callback, message_receiver_instance);
-			if (amqpvalue_decoder == NULL)
+			bool decode_failed;
+
+			message_receiver_instance->decode_error = false;
+			if (amqpvalue_decode_bytes(message_receiver_instance->decoder, payload_bytes, payload_size) != 0)
 			{
+				decode_failed = true;
 				set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
 			}
 			else
 			{
-				message_receiver_instance->decoded_message = message;
-				message_receiver_instance->decode_error = false;
-				if (amqpvalue_decode_bytes(amqpvalue_decoder, payload_bytes, payload_size) != 0)
+				decode_failed = message_receiver_instance->decode_error;
+				if (decode_failed)
 				{
 					set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
 				}
 				else
 				{
-					if (message_receiver_instance->decode_error)
+                    result = message_receiver_instance->on_message_received(message_receiver_instance->callback_context, message_receiver_instance->decoded_message);
+				}
+			}
+
+			(void)message_reset(message_receiver_instance->decoded_message);
+
+			/* A payload that ends in the middle of a value leaves the decoder mid-value, so it is reset before the next transfer.
+			   After a decode failure its state is not trusted and it is recreated on the next transfer instead. */
+			if (decode_failed ||
+				(amqpvalue_decoder_reset(message_receiver_instance->decoder) != 0))
+			{
+				amqpvalue_decoder_destroy(message_receiver_instance->decoder);
+				message_receiver_instance->decoder = NULL;
+			}
+		}
+	}
+
+	return result;
+}
+
+static void report_stream_sections(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance)
+{
+	if (!message_receiver_instance->are_stream_sections_reported)
+	{
+		message_receiver_instance->are_stream_sections_reported = true;
+		if (message_receiver_instance->on_message_sections_received != NULL)
+		{
+			message_receiver_instance->on_message_sections_received(message_receiver_instance->callback_context, message_receiver_instance->decoded_message);
+		}
+	}
+}
+
+static int append_stream_bytes(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, const unsigned char* bytes, size_t length)
+{
+	int result;
+	size_t needed_size = message_receiver_instance->stream_buffer_length + length;
+
+	if (needed_size > message_receiver_instance->stream_buffer_size)
+	{
+		size_t new_size = (message_receiver_instance->stream_buffer_size == 0) ? needed_size : message_receiver_instance->stream_buffer_size;
+		unsigned char* new_stream_buffer;
+
+		while (new_size < needed_size)
+		{
+			new_size *= 2;
+		}
+
+		new_stream_buffer = (unsigned char*)realloc(message_receiver_instance->stream_buffer, new_size);
+		if (new_stream_buffer == NULL)
+		{
+			needed_size = 0;
+		}
+		else
+		{
+			message_receiver_instance->stream_buffer = new_stream_buffer;
+			message_receiver_instance->stream_buffer_size = new_size;
+		}
+	}
+
+	if (needed_size == 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		(void)memcpy(message_receiver_instance->stream_buffer + message_receiver_instance->stream_buffer_length, bytes, length);
+		message_receiver_instance->stream_buffer_length += length;
+		result = 0;
+	}
+
+	return result;
+}
+
+/* Consumes one section from the start of bytes. For a data section only its header is consumed and the binary bytes
+   that follow are streamed to the application, any other section is decoded once all its bytes are available. */
+static STREAM_PARSE_RESULT parse_stream_section(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, const unsigned char* bytes, size_t length, size_t* consumed)
+{
+	STREAM_PARSE_RESULT result;
+
+	if (length < 2)
+	{
+		result = STREAM_PARSE_NEED_MORE_BYTES;
+	}
+	else if (bytes[0] != 0x00)
+	{
+		result = STREAM_PARSE_ERROR;
+	}
+	else
+	{
+		size_t descriptor_length;
+		uint64_t descriptor_code = 0;
+
+		switch (bytes[1])
+		{
+		default:
+			/* symbolic descriptor, the section is decoded as a whole */
+			descriptor_length = 0;
+			break;
+		case 0x44:
+			descriptor_length = 1;
+			break;
+		case 0x53:
+			descriptor_length = 2;
+			break;
+		case 0x80:
+			descriptor_length = 9;
+			break;
+		}
+
+		if (length < 1 + descriptor_length)
+		{
+			result = STREAM_PARSE_NEED_MORE_BYTES;
+		}
+		else
+		{
+			size_t i;
+
+			for (i = 2; i < 1 + descriptor_length; i++)
+			{
+				descriptor_code = (descriptor_code << 8) + bytes[i];
+			}
+
+			if ((descriptor_length > 0) &&
+				(descriptor_code == 0x75))
+			{
+				size_t value_position = 1 + descriptor_length;
+				size_t size_length;
+
+				if (length <= value_position)
+				{
+					size_length = 0;
+					result = STREAM_PARSE_NEED_MORE_BYTES;
+				}
+				else if (bytes[value_position] == 0xA0)
+				{
+					size_length = 1;
+					result = STREAM_PARSE_OK;
+				}
+				else if (bytes[value_position] == 0xB0)
+				{
+					size_length = 4;
+					result = STREAM_PARSE_OK;
+				}
+				else
+				{
+					size_length = 0;
+					result = STREAM_PARSE_ERROR;
+				}
+
+				if ((result == STREAM_PARSE_OK) &&
+					(length < value_position + 1 + size_length))
+				{
+					result = STREAM_PARSE_NEED_MORE_BYTES;
+				}
+
+				if (result == STREAM_PARSE_OK)
+				{
+					uint64_t data_length = 0;
+
+					for (i = 0; i < size_length; i++)
 					{
-						set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
+						data_length = (data_length << 8) + bytes[value_position + 1 + i];
+					}
+
+					report_stream_sections(message_receiver_instance);
+					message_receiver_instance->stream_data_remaining = data_length;
+					*consumed = value_position + 1 + size_length;
+				}
+			}
+			else
+			{
+				size_t section_length;
+
+				if (amqpvalue_get_encoded_value_length(bytes, length, &section_length) != 0)
+				{
+					result = STREAM_PARSE_NEED_MORE_BYTES;
+				}
+				else
+				{
+					/* the body and the footer come after the sections that are reported up front */
+					if ((descriptor_length > 0) &&
+						(descriptor_code >= 0x75))
+					{
+						report_stream_sections(message_receiver_instance);
+					}
+
+					message_receiver_instance->decode_error = false;
+					if ((amqpvalue_decode_bytes(message_receiver_instance->decoder, bytes, section_length) != 0) ||
+						message_receiver_instance->decode_error)
+					{
+						result = STREAM_PARSE_ERROR;
 					}
 					else
 					{
-                        result = message_receiver_instance->on_message_received(message_receiver_instance->callback_context, message);
+						*consumed = section_length;
+						result = STREAM_PARSE_OK;
 					}
 				}
+			}
+		}
+	}
+
+	return result;
+}
 
-				amqpvalue_decoder_destroy(amqpvalue_decoder);
+static int process_stream_bytes(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, const unsigned char* payload_bytes, size_t payload_size)
+{
+	int result = 0;
+	const unsigned char* bytes;
+	size_t length;
+	size_t position = 0;
+
+	/* a section split across frames is completed in the stream buffer, everything else is parsed straight from the frame */
+	if (message_receiver_instance->stream_buffer_length > 0)
+	{
+		if (append_stream_bytes(message_receiver_instance, payload_bytes, payload_size) != 0)
+		{
+			result = __FAILURE__;
+		}
+
+		bytes = message_receiver_instance->stream_buffer;
+		length = message_receiver_instance->stream_buffer_length;
+	}
+	else
+	{
+		bytes = payload_bytes;
+		length = payload_size;
+	}
+
+	while ((result == 0) && (position < length))
+	{
+		if (message_receiver_instance->stream_data_remaining > 0)
+		{
+			size_t chunk_length = length - position;
+			if (chunk_length > message_receiver_instance->stream_data_remaining)
+			{
+				chunk_length = (size_t)message_receiver_instance->stream_data_remaining;
+			}
+
+			if (message_receiver_instance->on_message_body_chunk_received != NULL)
+			{
+				message_receiver_instance->on_message_body_chunk_received(message_receiver_instance->callback_context, bytes + position, chunk_length);
+			}
+
+			position += chunk_length;
+			message_receiver_instance->stream_data_remaining -= chunk_length;
+		}
+		else
+		{
+			size_t consumed;
+			STREAM_PARSE_RESULT parse_result = parse_stream_section(message_receiver_instance, bytes + position, length - position, &consumed);
+
+			if (parse_result == STREAM_PARSE_ERROR)
+			{
+				result = __FAILURE__;
+			}
+			else if (parse_result == STREAM_PARSE_NEED_MORE_BYTES)
+			{
+				break;
+			}
+			else
+			{
+				position += consumed;
+			}
+		}
+	}
+
+	if (result == 0)
+	{
+		if (bytes == message_receiver_instance->stream_buffer)
+		{
+			(void)memmove(message_receiver_instance->stream_buffer, message_receiver_instance->stream_buffer + position, length - position);
+			message_receiver_instance->stream_buffer_length = length - position;
+		}
+		else if (position < length)
+		{
+			result = append_stream_bytes(message_receiver_instance, bytes + position, length - position);
+		}
+	}
+
+	return result;
+}
+
+static AMQP_VALUE on_transfer_frame_received(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes, bool more)
+{
+	AMQP_VALUE result = NULL;
+
+	MESSAGE_RECEIVER_INSTANCE* message_receiver_instance = (MESSAGE_RECEIVER_INSTANCE*)context;
+	(void)transfer;
+	if (message_receiver_instance->on_message_received != NULL)
+	{
+		if (!message_receiver_instance->stream_error)
+		{
+			if (((message_receiver_instance->decoded_message == NULL) &&
+				((message_receiver_instance->decoded_message = message_create()) == NULL)) ||
+				((message_receiver_instance->decoder == NULL) &&
+				((message_receiver_instance->decoder = amqpvalue_decoder_create(decode_message_value_callback, message_receiver_instance)) == NULL)) ||
+				(process_stream_bytes(message_receiver_instance, payload_bytes, payload_size) != 0))
+			{
+				/* the rest of the transfer is dropped */
+				message_receiver_instance->stream_error = true;
+			}
+		}
+
+		if (!more)
+		{
+			if (message_receiver_instance->stream_error ||
+				(message_receiver_instance->stream_buffer_length > 0) ||
+				(message_receiver_instance->stream_data_remaining > 0))
+			{
+				set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
+				if (message_receiver_instance->decoder != NULL)
+				{
+					amqpvalue_decoder_destroy(message_receiver_instance->decoder);
+					message_receiver_instance->decoder = NULL;
+				}
+			}
+			else
+			{
+				report_stream_sections(message_receiver_instance);
+				result = message_receiver_instance->on_message_received(message_receiver_instance->callback_context, message_receiver_instance->decoded_message);
 			}
 
-			message_destroy(message);
+			if (message_receiver_instance->decoded_message != NULL)
+			{
+				(void)message_reset(message_receiver_instance->decoded_message);
+			}
+
+			message_receiver_instance->stream_buffer_length = 0;
+			message_receiver_instance->stream_data_remaining = 0;
+			message_receiver_instance->are_stream_sections_reported = false;
+			message_receiver_instance->stream_error = false;
 		}
 	}
 
@@ -253,6 +606,18 @@ MESSAGE_RECEIVER_HANDLE messagereceiver_create(LINK_HANDLE link, ON_MESSAGE_RECE
 		result->on_message_receiver_state_changed = on_message_receiver_state_changed;
 		result->on_message_receiver_state_changed_context = context;
 		result->message_receiver_state = MESSAGE_RECEIVER_STATE_IDLE;
+		result->decoded_message = NULL;
+		result->decoder = NULL;
+		result->lazy_decode = false;
+		result->is_streaming = false;
+		result->on_message_sections_received = NULL;
+		result->on_message_body_chunk_received = NULL;
+		result->stream_buffer = NULL;
+		result->stream_buffer_size = 0;
+		result->stream_buffer_length = 0;
+		result->stream_data_remaining = 0;
+		result->are_stream_sections_reported = false;
+		result->stream_error = false;
 	}
 
 	return result;
@@ -262,7 +627,21 @@ void messagereceiver_destroy(MESSAGE_RECEIVER_HANDLE message_receiver)
 {
 	if (message_receiver != NULL)
 	{
+		MESSAGE_RECEIVER_INSTANCE* message_receiver_instance = (MESSAGE_RECEIVER_INSTANCE*)message_receiver;
+
 		(void)messagereceiver_close(message_receiver);
+		if (message_receiver_instance->decoder != NULL)
+		{
+			amqpvalue_decoder_destroy(message_receiver_instance->decoder);
+		}
+		if (message_receiver_instance->decoded_message != NULL)
+		{
+			message_destroy(message_receiver_instance->decoded_message);
+		}
+		if (message_receiver_instance->stream_buffer != NULL)
+		{
+			free(message_receiver_instance->stream_buffer);
+		}
 		free(message_receiver);
 	}
 }
@@ -282,7 +661,9 @@ int messagereceiver_open(MESSAGE_RECEIVER_HANDLE message_receiver, ON_MESSAGE_RE
 		if (message_receiver_instance->message_receiver_state == MESSAGE_RECEIVER_STATE_IDLE)
 		{
 			set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_OPENING);
-			if (link_attach(message_receiver_instance->link, on_transfer_received, on_link_state_changed, NULL, message_receiver_instance) != 0)
+			if ((message_receiver_instance->is_streaming &&
+				(link_set_on_transfer_frame_received(message_receiver_instance->link, on_transfer_frame_received) != 0)) ||
+				(link_attach(message_receiver_instance->link, on_transfer_received, on_link_state_changed, NULL, message_receiver_instance) != 0))
 			{
 				result = __FAILURE__;
 				set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
@@ -433,3 +814,51 @@ int messagereceiver_send_message_disposition(MESSAGE_RECEIVER_HANDLE message_rec
 
     return result;
 }
+
+int messagereceiver_set_lazy_decode(MESSAGE_RECEIVER_HANDLE message_receiver, bool lazy_decode)
+{
+	int result;
+
+	if (message_receiver == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		MESSAGE_RECEIVER_INSTANCE* message_receiver_instance = (MESSAGE_RECEIVER_INSTANCE*)message_receiver;
+		message_receiver_instance->lazy_decode = lazy_decode;
+		result = 0;
+	}
+
+	return result;
+}
+
+/* Must be called before messagereceiver_open. Each message is then reported in three steps: the sections ahead of the body,
+   the bytes of its data sections as they arrive in each transfer frame, and finally on_message_received with the footer. */
+int messagereceiver_set_streaming(MESSAGE_RECEIVER_HANDLE message_receiver, ON_MESSAGE_SECTIONS_RECEIVED on_message_sections_received, ON_MESSAGE_BODY_CHUNK_RECEIVED on_message_body_chunk_received)
+{
+	int result;
+
+	if (message_receiver == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		MESSAGE_RECEIVER_INSTANCE* message_receiver_instance = (MESSAGE_RECEIVER_INSTANCE*)message_receiver;
+
+		if (message_receiver_instance->message_receiver_state != MESSAGE_RECEIVER_STATE_IDLE)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			message_receiver_instance->on_message_sections_received = on_message_sections_received;
+			message_receiver_instance->on_message_body_chunk_received = on_message_body_chunk_received;
+			message_receiver_instance->is_streaming = true;
+			result = 0;
+		}
+	}
+
+	return result;
+}
@@ -8,14 +8,20 @@
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_uamqp_c/message_sender.h"
+#include "amqp_atomic.h"
 #include "azure_uamqp_c/amqpvalue_to_string.h"
 
 typedef enum MESSAGE_SEND_STATE_TAG
 {
     MESSAGE_SEND_STATE_NOT_SENT,
+    MESSAGE_SEND_STATE_STREAMING,
     MESSAGE_SEND_STATE_PENDING
 } MESSAGE_SEND_STATE;
 
+#define DEFAULT_MAX_STREAM_CHUNK_SIZE   (64 * 1024)
+/* described data section: 0x00 0x53 0x75 followed by a vbin8 or vbin32 constructor and length */
+#define DATA_SECTION_HEADER_MAX_SIZE    8
+
 typedef enum SEND_ONE_MESSAGE_RESULT_TAG
 {
     SEND_ONE_MESSAGE_OK,
@@ -23,71 +29,192 @@ typedef enum SEND_ONE_MESSAGE_RESULT_TAG
     SEND_ONE_MESSAGE_BUSY
 } SEND_ONE_MESSAGE_RESULT;
 
+typedef struct ENCODE_BUFFER_TAG
+{
+    unsigned char* bytes;
+    size_t size;
+    size_t length;
+} ENCODE_BUFFER;
+
+typedef struct MESSAGE_BATCH_ENTRY_TAG
+{
+    struct MESSAGE_BATCH_TAG* message_batch;
+    size_t index;
+} MESSAGE_BATCH_ENTRY;
+
+/* allocated in one block together with its entries and send results */
+typedef struct MESSAGE_BATCH_TAG
+{
+    ON_MESSAGE_BATCH_SEND_COMPLETE on_message_batch_send_complete;
+    void* context;
+    size_t message_count;
+    size_t outstanding_count;
+    MESSAGE_BATCH_ENTRY* entries;
+    MESSAGE_SEND_RESULT* send_results;
+} MESSAGE_BATCH;
+
 typedef struct MESSAGE_WITH_CALLBACK_TAG
 {
-    MESSAGE_HANDLE message;
     ON_MESSAGE_SEND_COMPLETE on_message_send_complete;
     void* context;
     MESSAGE_SENDER_HANDLE message_sender;
     MESSAGE_SEND_STATE message_send_state;
+    ON_MESSAGE_BODY_CHUNK_REQUESTED on_message_body_chunk_requested;
+    void* body_context;
+    /* the encoding kept for a message that could not be sent yet; for a streamed message only the sections ahead of the body */
+    PAYLOAD encoded_message;
+    /* an encoding shared with other senders, sent as is */
+    MESSAGE_ENCODED_HANDLE shared_encoded_message;
+    message_format message_format;
+    struct MESSAGE_WITH_CALLBACK_TAG* previous;
+    struct MESSAGE_WITH_CALLBACK_TAG* next;
 } MESSAGE_WITH_CALLBACK;
 
+typedef struct SEND_QUEUE_CELL_TAG
+{
+    /* equal to the enqueue position when the cell is free, one past it once the message in it is published */
+    size_t sequence;
+    MESSAGE_ENCODED_HANDLE message_encoded;
+    ON_MESSAGE_SEND_COMPLETE on_message_send_complete;
+    void* callback_context;
+} SEND_QUEUE_CELL;
+
 typedef struct MESSAGE_SENDER_INSTANCE_TAG
 {
     LINK_HANDLE link;
-    size_t message_count;
-    MESSAGE_WITH_CALLBACK** messages;
+    MESSAGE_WITH_CALLBACK* first_message;
+    MESSAGE_WITH_CALLBACK* last_message;
+    /* every message ahead of this one has been handed to the link */
+    MESSAGE_WITH_CALLBACK* first_not_sent_message;
     MESSAGE_SENDER_STATE message_sender_state;
     ON_MESSAGE_SENDER_STATE_CHANGED on_message_sender_state_changed;
     void* on_message_sender_state_changed_context;
+    MESSAGE_WITH_CALLBACK* streaming_message;
+    unsigned char* stream_buffer;
+    size_t stream_buffer_size;
+    size_t max_stream_chunk_size;
+    size_t stream_chunk_length;
+    /* bounded MPSC ring filled by messagesender_enqueue from any thread and drained on the thread doing the connection work */
+    SEND_QUEUE_CELL* send_queue;
+    size_t send_queue_mask;
+    size_t send_queue_enqueue_position;
+    size_t send_queue_dequeue_position;
+    int is_send_queue_signalled;
+    ON_MESSAGE_SENDER_WORK_QUEUED on_work_queued;
+    void* on_work_queued_context;
+    MESSAGE_SENDER_COMPLETION_EXECUTOR completion_executor;
+    void* completion_executor_context;
     unsigned int is_trace_on : 1;
+    unsigned int has_stream_chunk : 1;
+    unsigned int is_stream_chunk_last : 1;
+    unsigned int is_sending_stream_chunk : 1;
+    unsigned int is_stream_chunk_sent : 1;
 } MESSAGE_SENDER_INSTANCE;
 
-static void remove_pending_message_by_index(MESSAGE_SENDER_INSTANCE* message_sender_instance, size_t index)
+typedef struct ENQUEUED_SEND_COMPLETION_TAG
 {
-    MESSAGE_WITH_CALLBACK** new_messages;
+    MESSAGE_SENDER_INSTANCE* message_sender;
+    ON_MESSAGE_SEND_COMPLETE on_message_send_complete;
+    void* callback_context;
+} ENQUEUED_SEND_COMPLETION;
+
+static void send_all_pending_messages(MESSAGE_SENDER_INSTANCE* message_sender_instance);
 
-    if (message_sender_instance->messages[index]->message != NULL)
+static void advance_first_not_sent_message(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+{
+    while ((message_sender_instance->first_not_sent_message != NULL) &&
+        (message_sender_instance->first_not_sent_message->message_send_state != MESSAGE_SEND_STATE_NOT_SENT))
     {
-        message_destroy(message_sender_instance->messages[index]->message);
-        message_sender_instance->messages[index]->message = NULL;
+        message_sender_instance->first_not_sent_message = message_sender_instance->first_not_sent_message->next;
     }
+}
 
-    free(message_sender_instance->messages[index]);
+static void add_pending_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    message_with_callback->previous = message_sender_instance->last_message;
+    message_with_callback->next = NULL;
 
-    if (message_sender_instance->message_count - index > 1)
+    if (message_sender_instance->last_message == NULL)
+    {
+        message_sender_instance->first_message = message_with_callback;
+    }
+    else
     {
-        (void)memmove(&message_sender_instance->messages[index], &message_sender_instance->messages[index + 1], sizeof(MESSAGE_WITH_CALLBACK*) * (message_sender_instance->message_count - index - 1));
+        message_sender_instance->last_message->next = message_with_callback;
     }
 
-    message_sender_instance->message_count--;
+    message_sender_instance->last_message = message_with_callback;
 
-    if (message_sender_instance->message_count > 0)
+    if ((message_sender_instance->first_not_sent_message == NULL) &&
+        (message_with_callback->message_send_state == MESSAGE_SEND_STATE_NOT_SENT))
     {
-        new_messages = (MESSAGE_WITH_CALLBACK**)realloc(message_sender_instance->messages, sizeof(MESSAGE_WITH_CALLBACK*) * (message_sender_instance->message_count));
-        if (new_messages != NULL)
-        {
-            message_sender_instance->messages = new_messages;
-        }
+        message_sender_instance->first_not_sent_message = message_with_callback;
     }
-    else
+}
+
+static void free_message_with_callback(MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    if (message_with_callback->shared_encoded_message != NULL)
     {
-        free(message_sender_instance->messages);
-        message_sender_instance->messages = NULL;
+        message_encoded_destroy(message_with_callback->shared_encoded_message);
     }
+
+    free((void*)message_with_callback->encoded_message.bytes);
+    free(message_with_callback);
 }
 
 static void remove_pending_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
 {
-    size_t i;
+    if (message_with_callback->previous == NULL)
+    {
+        message_sender_instance->first_message = message_with_callback->next;
+    }
+    else
+    {
+        message_with_callback->previous->next = message_with_callback->next;
+    }
+
+    if (message_with_callback->next == NULL)
+    {
+        message_sender_instance->last_message = message_with_callback->previous;
+    }
+    else
+    {
+        message_with_callback->next->previous = message_with_callback->previous;
+    }
+
+
+    if (message_sender_instance->first_not_sent_message == message_with_callback)
+    {
+        message_sender_instance->first_not_sent_message = message_with_callback->next;
+        advance_first_not_sent_message(message_sender_instance);
+    }
+
+    if (message_with_callback == message_sender_instance->streaming_message)
+    {
+        message_sender_instance->streaming_message = NULL;
+        message_sender_instance->has_stream_chunk = 0;
+    }
 
-    for (i = 0; i < message_sender_instance->message_count; i++)
+    free_message_with_callback(message_with_callback);
+}
+
+static void on_batch_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    MESSAGE_BATCH_ENTRY* message_batch_entry = (MESSAGE_BATCH_ENTRY*)context;
+    MESSAGE_BATCH* message_batch = message_batch_entry->message_batch;
+
+    message_batch->send_results[message_batch_entry->index] = send_result;
+    message_batch->outstanding_count--;
+
+    if (message_batch->outstanding_count == 0)
     {
-        if (message_sender_instance->messages[i] == message_with_callback)
+        if (message_batch->on_message_batch_send_complete != NULL)
         {
-            remove_pending_message_by_index(message_sender_instance, i);
-            break;
+            message_batch->on_message_batch_send_complete(message_batch->context, message_batch->send_results, message_batch->message_count);
         }
+
+        free(message_batch);
     }
 }
 
@@ -125,14 +252,6 @@ static void on_delivery_settled(void* context, delivery_number delivery_no, AMQP
     remove_pending_message(message_sender_instance, message_with_callback);
 }
 
-static int encode_bytes(void* context, const unsigned char* bytes, size_t length)
-{
-    PAYLOAD* payload = (PAYLOAD*)context;
-    (void)memcpy((unsigned char*)payload->bytes + payload->length, bytes, length);
-    payload->length += length;
-    return 0;
-}
-
 static void log_message_chunk(MESSAGE_SENDER_INSTANCE* message_sender_instance, const char* name, AMQP_VALUE value)
 {
 #ifdef NO_LOGGING
@@ -153,367 +272,540 @@ static void log_message_chunk(MESSAGE_SENDER_INSTANCE* message_sender_instance,
 #endif
 }
 
-static SEND_ONE_MESSAGE_RESULT send_one_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_HANDLE message)
+static void log_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_HANDLE message)
 {
-    SEND_ONE_MESSAGE_RESULT result;
-
-    size_t encoded_size;
-    size_t total_encoded_size = 0;
-    MESSAGE_BODY_TYPE message_body_type;
-    message_format message_format;
-
-    if ((message_get_body_type(message, &message_body_type) != 0) ||
-        (message_get_message_format(message, &message_format) != 0))
-    {
-        result = SEND_ONE_MESSAGE_ERROR;
-    }
-    else
+#ifdef NO_LOGGING
+    UNUSED(message_sender_instance);
+    UNUSED(message);
+#else
+    if (xlogging_get_log_function() != NULL && message_sender_instance->is_trace_on == 1)
     {
-        // header
         HEADER_HANDLE header;
-        AMQP_VALUE header_amqp_value;
+        AMQP_VALUE msg_annotations;
         PROPERTIES_HANDLE properties;
-        AMQP_VALUE properties_amqp_value;
         AMQP_VALUE application_properties;
-        AMQP_VALUE application_properties_value;
-        AMQP_VALUE body_amqp_value = NULL;
-        size_t body_data_count = 0;
-        AMQP_VALUE msg_annotations = NULL;
+        AMQP_VALUE body_amqp_value;
 
-        message_get_header(message, &header);
-        header_amqp_value = amqpvalue_create_header(header);
-        if (header != NULL)
+        if ((message_get_header(message, &header) == 0) && (header != NULL))
         {
-            amqpvalue_get_encoded_size(header_amqp_value, &encoded_size);
-            total_encoded_size += encoded_size;
+            AMQP_VALUE header_amqp_value = amqpvalue_create_header(header);
+            log_message_chunk(message_sender_instance, "Header:", header_amqp_value);
+            amqpvalue_destroy(header_amqp_value);
+            header_destroy(header);
         }
 
-        // message annotations
-        if ((message_get_message_annotations(message, &msg_annotations) == 0) &&
-            (msg_annotations != NULL))
+        if ((message_get_message_annotations(message, &msg_annotations) == 0) && (msg_annotations != NULL))
         {
-            amqpvalue_get_encoded_size(msg_annotations, &encoded_size);
-            total_encoded_size += encoded_size;
+            log_message_chunk(message_sender_instance, "Message Annotations:", msg_annotations);
+            amqpvalue_destroy(msg_annotations);
         }
 
-        // properties
-        message_get_properties(message, &properties);
-        properties_amqp_value = amqpvalue_create_properties(properties);
-        if (properties != NULL)
+        if ((message_get_properties(message, &properties) == 0) && (properties != NULL))
         {
-            amqpvalue_get_encoded_size(properties_amqp_value, &encoded_size);
-            total_encoded_size += encoded_size;
+            AMQP_VALUE properties_amqp_value = amqpvalue_create_properties(properties);
+            log_message_chunk(message_sender_instance, "Properties:", properties_amqp_value);
+            amqpvalue_destroy(properties_amqp_value);
+            properties_destroy(properties);
         }
 
-        // application properties
-        message_get_application_properties(message, &application_properties);
-        application_properties_value = amqpvalue_create_application_properties(application_properties);
-        if (application_properties != NULL)
+        if ((message_get_application_properties(message, &application_properties) == 0) && (application_properties != NULL))
         {
-            amqpvalue_get_encoded_size(application_properties_value, &encoded_size);
-            total_encoded_size += encoded_size;
+            AMQP_VALUE application_properties_value = amqpvalue_create_application_properties(application_properties);
+            log_message_chunk(message_sender_instance, "Application properties:", application_properties_value);
+            amqpvalue_destroy(application_properties_value);
+            amqpvalue_destroy(application_properties);
         }
 
-        result = SEND_ONE_MESSAGE_OK;
-
-        // body - amqp data
-        switch (message_body_type)
+        if ((message_get_inplace_body_amqp_value(message, &body_amqp_value) == 0) && (body_amqp_value != NULL))
         {
-            default:
-                result = SEND_ONE_MESSAGE_ERROR;
-                break;
-
-            case MESSAGE_BODY_TYPE_VALUE:
-            {
-                AMQP_VALUE message_body_amqp_value;
-                if (message_get_inplace_body_amqp_value(message, &message_body_amqp_value) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-                else
-                {
-                    body_amqp_value = amqpvalue_create_amqp_value(message_body_amqp_value);
-                    if ((body_amqp_value == NULL) ||
-                        (amqpvalue_get_encoded_size(body_amqp_value, &encoded_size) != 0))
-                    {
-                        result = SEND_ONE_MESSAGE_ERROR;
-                    }
-                    else
-                    {
-                        total_encoded_size += encoded_size;
-                    }
-                }
-
-                break;
-            }
-
-            case MESSAGE_BODY_TYPE_DATA:
-            {
-                BINARY_DATA binary_data;
-                size_t i;
-
-                if (message_get_body_amqp_data_count(message, &body_data_count) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-                else
-                {
-                    for (i = 0; i < body_data_count; i++)
-                    {
-                        if (message_get_body_amqp_data(message, i, &binary_data) != 0)
-                        {
-                            result = SEND_ONE_MESSAGE_ERROR;
-                        }
-                        else
-                        {
-                            amqp_binary binary_value;
-                            binary_value.bytes = binary_data.bytes;
-                            binary_value.length = (uint32_t)binary_data.length;
-                            AMQP_VALUE body_amqp_data = amqpvalue_create_data(binary_value);
-                            if (body_amqp_data == NULL)
-                            {
-                                result = SEND_ONE_MESSAGE_ERROR;
-                            }
-                            else
-                            {
-                                if (amqpvalue_get_encoded_size(body_amqp_data, &encoded_size) != 0)
-                                {
-                                    result = SEND_ONE_MESSAGE_ERROR;
-                                }
-                                else
-                                {
-                                    total_encoded_size += encoded_size;
-                                }
-
-                                amqpvalue_destroy(body_amqp_data);
-                            }
-                        }
-                    }
-                }
-                break;
-            }
+            log_message_chunk(message_sender_instance, "Body - amqp value:", body_amqp_value);
         }
+    }
+#endif
+}
 
-        if (result == 0)
-        {
-            void* data_bytes = malloc(total_encoded_size);
-            PAYLOAD payload;
-            payload.bytes = data_bytes;
-            payload.length = 0;
-            result = SEND_ONE_MESSAGE_OK;
-
-            if (header != NULL)
-            {
-                if (amqpvalue_encode(header_amqp_value, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-
-                log_message_chunk(message_sender_instance, "Header:", header_amqp_value);
-            }
-
-            if ((result == SEND_ONE_MESSAGE_OK) && (msg_annotations != NULL))
-            {
-                if (amqpvalue_encode(msg_annotations, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-
-                log_message_chunk(message_sender_instance, "Message Annotations:", msg_annotations);
-            }
-
-            if ((result == SEND_ONE_MESSAGE_OK) && (properties != NULL))
-            {
-                if (amqpvalue_encode(properties_amqp_value, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-
-                log_message_chunk(message_sender_instance, "Properties:", properties_amqp_value);
-            }
-
-            if ((result == SEND_ONE_MESSAGE_OK) && (application_properties != NULL))
-            {
-                if (amqpvalue_encode(application_properties_value, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-
-                log_message_chunk(message_sender_instance, "Application properties:", application_properties_value);
-            }
-
-            if (result == SEND_ONE_MESSAGE_OK)
-            {
-                switch (message_body_type)
-                {
-                default:
-                    result = SEND_ONE_MESSAGE_ERROR;
-                    break;
-
-                case MESSAGE_BODY_TYPE_VALUE:
-                {
-                    if (amqpvalue_encode(body_amqp_value, encode_bytes, &payload) != 0)
-                    {
-                        result = SEND_ONE_MESSAGE_ERROR;
-                    }
-
-                    log_message_chunk(message_sender_instance, "Body - amqp value:", body_amqp_value);
-                    break;
-                }
-                case MESSAGE_BODY_TYPE_DATA:
-                {
-                    BINARY_DATA binary_data;
-                    size_t i;
+/* Appends the encoding of all sections of a message to an encode buffer. For a streamed message the body is supplied
+   separately as data sections, so the message itself must not carry one */
+static int encode_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_HANDLE message, bool is_body_streamed, ENCODE_BUFFER* encode_buffer, message_format* encoded_message_format)
+{
+    int result;
+    MESSAGE_BODY_TYPE message_body_type;
+    message_format message_format;
 
-                    for (i = 0; i < body_data_count; i++)
-                    {
-                        if (message_get_body_amqp_data(message, i, &binary_data) != 0)
-                        {
-                            result = SEND_ONE_MESSAGE_ERROR;
-                        }
-                        else
-                        {
-                            amqp_binary binary_value;
-                            binary_value.bytes = binary_data.bytes;
-                            binary_value.length = (uint32_t)binary_data.length;
-                            AMQP_VALUE body_amqp_data = amqpvalue_create_data(binary_value);
-                            if (body_amqp_data == NULL)
-                            {
-                                result = SEND_ONE_MESSAGE_ERROR;
-                            }
-                            else
-                            {
-                                if (amqpvalue_encode(body_amqp_data, encode_bytes, &payload) != 0)
-                                {
-                                    result = SEND_ONE_MESSAGE_ERROR;
-                                    break;
-                                }
+    if ((message_get_body_type(message, &message_body_type) != 0) ||
+        (message_get_message_format(message, &message_format) != 0) ||
+        ((message_body_type == MESSAGE_BODY_TYPE_NONE) != is_body_streamed) ||
+        (message_encode_append(message, &encode_buffer->bytes, &encode_buffer->size, &encode_buffer->length) != 0))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        log_message(message_sender_instance, message);
+        *encoded_message_format = message_format;
+        result = 0;
+    }
 
-                                amqpvalue_destroy(body_amqp_data);
-                            }
-                        }
-                    }
-                    break;
-                }
-                }
-            }
+    return result;
+}
 
-            if (result == SEND_ONE_MESSAGE_OK)
-            {
-                message_with_callback->message_send_state = MESSAGE_SEND_STATE_PENDING;
-                switch (link_transfer(message_sender_instance->link, message_format, &payload, 1, on_delivery_settled, message_with_callback))
-                {
-                default:
-                case LINK_TRANSFER_ERROR:
-                    result = SEND_ONE_MESSAGE_ERROR;
-                    break;
-
-                case LINK_TRANSFER_BUSY:
-                    message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
-                    result = SEND_ONE_MESSAGE_BUSY;
-                    break;
-
-                case LINK_TRANSFER_OK:
-                    result = SEND_ONE_MESSAGE_OK;
-                    break;
-                }
-            }
+static SEND_ONE_MESSAGE_RESULT send_encoded_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback, message_format message_format, PAYLOAD* payload)
+{
+    SEND_ONE_MESSAGE_RESULT result;
 
-            free(data_bytes);
+    message_with_callback->message_send_state = MESSAGE_SEND_STATE_PENDING;
+    switch (link_transfer(message_sender_instance->link, message_format, payload, 1, on_delivery_settled, message_with_callback))
+    {
+    default:
+    case LINK_TRANSFER_ERROR:
+        result = SEND_ONE_MESSAGE_ERROR;
+        break;
 
-            if (body_amqp_value != NULL)
-            {
-                amqpvalue_destroy(body_amqp_value);
-            }
-        }
+    case LINK_TRANSFER_BUSY:
+        message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+        result = SEND_ONE_MESSAGE_BUSY;
+        break;
 
-        amqpvalue_destroy(application_properties);
-        amqpvalue_destroy(application_properties_value);
-        amqpvalue_destroy(properties_amqp_value);
-        properties_destroy(properties);
+    case LINK_TRANSFER_OK:
+        result = SEND_ONE_MESSAGE_OK;
+        break;
     }
 
     return result;
 }
 
-static void send_all_pending_messages(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+static SEND_ONE_MESSAGE_RESULT send_shared_encoded_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
 {
-    size_t i;
+    SEND_ONE_MESSAGE_RESULT result;
+    MESSAGE_ENCODED_HANDLE shared_encoded_message = message_with_callback->shared_encoded_message;
+    const unsigned char* bytes;
+    size_t length;
 
-    for (i = 0; i < message_sender_instance->message_count; i++)
+    if (message_encoded_get_bytes(shared_encoded_message, &bytes, &length) != 0)
     {
-        if (message_sender_instance->messages[i]->message_send_state == MESSAGE_SEND_STATE_NOT_SENT)
-        {
-            switch (send_one_message(message_sender_instance, message_sender_instance->messages[i], message_sender_instance->messages[i]->message))
-            {
-            default:
-            case SEND_ONE_MESSAGE_ERROR:
-            {
-                ON_MESSAGE_SEND_COMPLETE on_message_send_complete = message_sender_instance->messages[i]->on_message_send_complete;
-                void* context = message_sender_instance->messages[i]->context;
-                remove_pending_message_by_index(message_sender_instance, i);
-
-				if (on_message_send_complete != NULL)
-				{
-					on_message_send_complete(context, MESSAGE_SEND_ERROR);
-				}
-
-                i = message_sender_instance->message_count;
-                break;
-            }
-            case SEND_ONE_MESSAGE_BUSY:
-                i = message_sender_instance->message_count + 1;
-                break;
+        result = SEND_ONE_MESSAGE_ERROR;
+    }
+    else
+    {
+        PAYLOAD payload;
+        payload.bytes = bytes;
+        payload.length = length;
 
-            case SEND_ONE_MESSAGE_OK:
-                break;
-            }
+        /* the message may be settled and freed from within the transfer, so it gives up its reference first */
+        message_with_callback->shared_encoded_message = NULL;
 
-            i--;
+        result = send_encoded_message(message_sender_instance, message_with_callback, message_with_callback->message_format, &payload);
+        if (result == SEND_ONE_MESSAGE_BUSY)
+        {
+            message_with_callback->shared_encoded_message = shared_encoded_message;
+        }
+        else
+        {
+            message_encoded_destroy(shared_encoded_message);
         }
     }
+
+    return result;
 }
 
-static void set_message_sender_state(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_SENDER_STATE new_state)
+static int keep_encoded_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_HANDLE message)
 {
-    MESSAGE_SENDER_STATE previous_state = message_sender_instance->message_sender_state;
-    message_sender_instance->message_sender_state = new_state;
-    if (message_sender_instance->on_message_sender_state_changed != NULL)
+    int result;
+    ENCODE_BUFFER encode_buffer = { NULL, 0, 0 };
+
+    if (encode_message(message_sender_instance, message, false, &encode_buffer, &message_with_callback->message_format) != 0)
     {
-        message_sender_instance->on_message_sender_state_changed(message_sender_instance->on_message_sender_state_changed_context, new_state, previous_state);
+        free(encode_buffer.bytes);
+        result = __FAILURE__;
+    }
+    else
+    {
+        message_with_callback->encoded_message.bytes = encode_buffer.bytes;
+        message_with_callback->encoded_message.length = encode_buffer.length;
+        result = 0;
     }
+
+    return result;
 }
 
-static void indicate_all_messages_as_error(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+static SEND_ONE_MESSAGE_RESULT send_one_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_HANDLE message)
 {
-    size_t i;
+    SEND_ONE_MESSAGE_RESULT result;
+    ENCODE_BUFFER encode_buffer = { NULL, 0, 0 };
+    message_format message_format;
 
-    for (i = 0; i < message_sender_instance->message_count; i++)
+    if (encode_message(message_sender_instance, message, false, &encode_buffer, &message_format) != 0)
+    {
+        result = SEND_ONE_MESSAGE_ERROR;
+    }
+    else
     {
-        if (message_sender_instance->messages[i]->on_message_send_complete != NULL)
+        PAYLOAD payload;
+        payload.bytes = encode_buffer.bytes;
+        payload.length = encode_buffer.length;
+
+        result = send_encoded_message(message_sender_instance, message_with_callback, message_format, &payload);
+        if (result == SEND_ONE_MESSAGE_BUSY)
         {
-            message_sender_instance->messages[i]->on_message_send_complete(message_sender_instance->messages[i]->context, MESSAGE_SEND_ERROR);
+            /* keep the encoding for the retry instead of a copy of the message */
+            message_with_callback->encoded_message = payload;
+            message_with_callback->message_format = message_format;
+            encode_buffer.bytes = NULL;
         }
-
-        message_destroy(message_sender_instance->messages[i]->message);
-        free(message_sender_instance->messages[i]);
     }
 
-    if (message_sender_instance->messages != NULL)
-    {
-        message_sender_instance->message_count = 0;
+    free(encode_buffer.bytes);
 
-        free(message_sender_instance->messages);
-        message_sender_instance->messages = NULL;
-    }
+    return result;
 }
 
-static void on_link_state_changed(void* context, LINK_STATE new_link_state, LINK_STATE previous_link_state)
+static size_t write_data_section_header(unsigned char* section_end, size_t data_length)
 {
-    MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)context;
-    (void)previous_link_state;
+    size_t header_size;
+    unsigned char* header;
 
-    switch (new_link_state)
+    if (data_length <= 255)
+    {
+        header_size = 5;
+        header = section_end - header_size;
+        header[3] = 0xA0;
+        header[4] = (unsigned char)data_length;
+    }
+    else
+    {
+        header_size = DATA_SECTION_HEADER_MAX_SIZE;
+        header = section_end - header_size;
+        header[3] = 0xB0;
+        header[4] = (unsigned char)((data_length >> 24) & 0xFF);
+        header[5] = (unsigned char)((data_length >> 16) & 0xFF);
+        header[6] = (unsigned char)((data_length >> 8) & 0xFF);
+        header[7] = (unsigned char)(data_length & 0xFF);
+    }
+
+    header[0] = 0x00;
+    header[1] = 0x53;
+    header[2] = 0x75;
+
+    return header_size;
+}
+
+static void on_stream_chunk_sent(void* context, IO_SEND_RESULT send_result);
+
+/* Pulls body chunks from the application and sends each as a data section of the same delivery. A new chunk is only
+   pulled once the previous one has been handed to the transport, which bounds the memory used to one chunk */
+static SEND_ONE_MESSAGE_RESULT send_stream_chunks(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    SEND_ONE_MESSAGE_RESULT result;
+
+    if ((message_sender_instance->streaming_message != NULL) &&
+        (message_sender_instance->streaming_message != message_with_callback))
+    {
+        /* only one streamed delivery can be in progress on a link */
+        result = SEND_ONE_MESSAGE_BUSY;
+    }
+    else
+    {
+        if (message_sender_instance->stream_buffer_size < message_sender_instance->max_stream_chunk_size + DATA_SECTION_HEADER_MAX_SIZE)
+        {
+            unsigned char* new_stream_buffer = (unsigned char*)realloc(message_sender_instance->stream_buffer, message_sender_instance->max_stream_chunk_size + DATA_SECTION_HEADER_MAX_SIZE);
+            if (new_stream_buffer != NULL)
+            {
+                message_sender_instance->stream_buffer = new_stream_buffer;
+                message_sender_instance->stream_buffer_size = message_sender_instance->max_stream_chunk_size + DATA_SECTION_HEADER_MAX_SIZE;
+            }
+        }
+
+        if (message_sender_instance->stream_buffer_size < message_sender_instance->max_stream_chunk_size + DATA_SECTION_HEADER_MAX_SIZE)
+        {
+            LogError("Cannot allocate stream buffer");
+            result = SEND_ONE_MESSAGE_ERROR;
+        }
+        else
+        {
+            bool is_last_chunk = false;
+
+            message_sender_instance->streaming_message = message_with_callback;
+            message_sender_instance->is_sending_stream_chunk = 1;
+
+            do
+            {
+                unsigned char* chunk_bytes = message_sender_instance->stream_buffer + DATA_SECTION_HEADER_MAX_SIZE;
+
+                message_sender_instance->is_stream_chunk_sent = 0;
+                result = SEND_ONE_MESSAGE_OK;
+
+                if (message_sender_instance->has_stream_chunk == 0)
+                {
+                    size_t bytes_written = 0;
+
+                    if ((message_with_callback->on_message_body_chunk_requested(message_with_callback->body_context, chunk_bytes, message_sender_instance->max_stream_chunk_size, &bytes_written, &is_last_chunk) != 0) ||
+                        (bytes_written > message_sender_instance->max_stream_chunk_size) ||
+                        ((bytes_written == 0) && !is_last_chunk))
+                    {
+                        LogError("Cannot get next body chunk");
+                        if ((message_with_callback->message_send_state == MESSAGE_SEND_STATE_STREAMING) &&
+                            (link_abort_chunked_transfer(message_sender_instance->link) != 0))
+                        {
+                            LogError("Cannot abort streamed delivery");
+                        }
+
+                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                        message_sender_instance->streaming_message = NULL;
+                        result = SEND_ONE_MESSAGE_ERROR;
+                    }
+                    else
+                    {
+                        message_sender_instance->stream_chunk_length = bytes_written;
+                        message_sender_instance->is_stream_chunk_last = is_last_chunk ? 1 : 0;
+                        message_sender_instance->has_stream_chunk = 1;
+                    }
+                }
+
+                if (result == SEND_ONE_MESSAGE_OK)
+                {
+                    size_t header_size = write_data_section_header(chunk_bytes, message_sender_instance->stream_chunk_length);
+                    bool is_first_chunk = (message_with_callback->message_send_state == MESSAGE_SEND_STATE_NOT_SENT);
+                    PAYLOAD encoded_message = message_with_callback->encoded_message;
+                    PAYLOAD payloads[2];
+                    size_t payload_count = 0;
+
+                    is_last_chunk = (message_sender_instance->is_stream_chunk_last != 0);
+
+                    if (is_first_chunk && (encoded_message.length > 0))
+                    {
+                        payloads[payload_count++] = encoded_message;
+                    }
+
+                    payloads[payload_count].bytes = chunk_bytes - header_size;
+                    payloads[payload_count].length = header_size + message_sender_instance->stream_chunk_length;
+                    payload_count++;
+
+                    /* the message may be settled from within link_transfer_chunk once its last chunk is out */
+                    message_with_callback->encoded_message.bytes = NULL;
+                    message_with_callback->encoded_message.length = 0;
+                    message_sender_instance->has_stream_chunk = 0;
+                    if (is_last_chunk)
+                    {
+                        message_sender_instance->streaming_message = NULL;
+                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_PENDING;
+                    }
+                    else
+                    {
+                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_STREAMING;
+                    }
+
+                    switch (link_transfer_chunk(message_sender_instance->link, message_with_callback->message_format, payloads, payload_count, !is_last_chunk, on_delivery_settled, message_with_callback, on_stream_chunk_sent, message_sender_instance))
+                    {
+                    default:
+                    case LINK_TRANSFER_ERROR:
+                        /* the link has already dropped the delivery */
+                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                        message_sender_instance->streaming_message = NULL;
+                        free((void*)encoded_message.bytes);
+                        result = SEND_ONE_MESSAGE_ERROR;
+                        break;
+
+                    case LINK_TRANSFER_BUSY:
+                        /* keep the chunk that was already pulled for when the link flows again */
+                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                        message_with_callback->encoded_message = encoded_message;
+                        message_sender_instance->streaming_message = message_with_callback;
+                        message_sender_instance->has_stream_chunk = 1;
+                        result = SEND_ONE_MESSAGE_BUSY;
+                        break;
+
+                    case LINK_TRANSFER_OK:
+                        free((void*)encoded_message.bytes);
+                        result = SEND_ONE_MESSAGE_OK;
+                        break;
+                    }
+                }
+            } while ((result == SEND_ONE_MESSAGE_OK) &&
+                (!is_last_chunk) &&
+                (message_sender_instance->is_stream_chunk_sent != 0));
+
+            message_sender_instance->is_sending_stream_chunk = 0;
+        }
+    }
+
+    return result;
+}
+
+static void continue_streamed_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    switch (send_stream_chunks(message_sender_instance, message_with_callback))
+    {
+    default:
+    case SEND_ONE_MESSAGE_ERROR:
+    {
+        ON_MESSAGE_SEND_COMPLETE on_message_send_complete = message_with_callback->on_message_send_complete;
+        void* context = message_with_callback->context;
+        remove_pending_message(message_sender_instance, message_with_callback);
+
+        if (on_message_send_complete != NULL)
+        {
+            on_message_send_complete(context, MESSAGE_SEND_ERROR);
+        }
+
+        send_all_pending_messages(message_sender_instance);
+        break;
+    }
+    case SEND_ONE_MESSAGE_BUSY:
+        break;
+
+    case SEND_ONE_MESSAGE_OK:
+        if (message_sender_instance->streaming_message == NULL)
+        {
+            /* the stream is complete, messages queued behind it can go now */
+            send_all_pending_messages(message_sender_instance);
+        }
+        break;
+    }
+}
+
+static void on_stream_chunk_sent(void* context, IO_SEND_RESULT send_result)
+{
+    MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)context;
+    MESSAGE_WITH_CALLBACK* message_with_callback = message_sender_instance->streaming_message;
+
+    /* the stream may have been failed in the meantime (e.g. the link went away) */
+    if (message_with_callback != NULL)
+    {
+        if (send_result != IO_SEND_OK)
+        {
+            LogError("Sending body chunk failed");
+            if (link_abort_chunked_transfer(message_sender_instance->link) != 0)
+            {
+                LogError("Cannot abort streamed delivery");
+            }
+
+            message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+            message_sender_instance->streaming_message = NULL;
+            message_sender_instance->has_stream_chunk = 0;
+
+            if (message_with_callback->on_message_send_complete != NULL)
+            {
+                message_with_callback->on_message_send_complete(message_with_callback->context, MESSAGE_SEND_ERROR);
+            }
+
+            remove_pending_message(message_sender_instance, message_with_callback);
+        }
+        else if (message_sender_instance->is_sending_stream_chunk)
+        {
+            /* completed synchronously, send_stream_chunks picks up the next chunk */
+            message_sender_instance->is_stream_chunk_sent = 1;
+        }
+        else
+        {
+            continue_streamed_message(message_sender_instance, message_with_callback);
+        }
+    }
+}
+
+static SEND_ONE_MESSAGE_RESULT send_queued_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    SEND_ONE_MESSAGE_RESULT result;
+
+    if (message_with_callback->on_message_body_chunk_requested != NULL)
+    {
+        result = send_stream_chunks(message_sender_instance, message_with_callback);
+    }
+    else if (message_with_callback->shared_encoded_message != NULL)
+    {
+        result = send_shared_encoded_message(message_sender_instance, message_with_callback);
+    }
+    else
+    {
+        /* the message may be settled and freed from within the transfer, so it gives up its encoding first */
+        PAYLOAD payload = message_with_callback->encoded_message;
+        message_with_callback->encoded_message.bytes = NULL;
+        message_with_callback->encoded_message.length = 0;
+
+        result = send_encoded_message(message_sender_instance, message_with_callback, message_with_callback->message_format, &payload);
+        if (result == SEND_ONE_MESSAGE_BUSY)
+        {
+            message_with_callback->encoded_message = payload;
+        }
+        else
+        {
+            free((void*)payload.bytes);
+        }
+    }
+
+    return result;
+}
+
+static void send_all_pending_messages(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+{
+    MESSAGE_WITH_CALLBACK* message_with_callback;
+
+    while ((message_with_callback = message_sender_instance->first_not_sent_message) != NULL)
+    {
+        SEND_ONE_MESSAGE_RESULT send_result = send_queued_message(message_sender_instance, message_with_callback);
+        if (send_result == SEND_ONE_MESSAGE_OK)
+        {
+            /* a message settled while being sent has already moved the cursor on removal */
+            advance_first_not_sent_message(message_sender_instance);
+        }
+        else
+        {
+            if (send_result != SEND_ONE_MESSAGE_BUSY)
+            {
+                ON_MESSAGE_SEND_COMPLETE on_message_send_complete = message_with_callback->on_message_send_complete;
+                void* context = message_with_callback->context;
+                remove_pending_message(message_sender_instance, message_with_callback);
+
+                if (on_message_send_complete != NULL)
+                {
+                    on_message_send_complete(context, MESSAGE_SEND_ERROR);
+                }
+            }
+
+            break;
+        }
+    }
+}
+
+static void set_message_sender_state(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_SENDER_STATE new_state)
+{
+    MESSAGE_SENDER_STATE previous_state = message_sender_instance->message_sender_state;
+    message_sender_instance->message_sender_state = new_state;
+    if (message_sender_instance->on_message_sender_state_changed != NULL)
+    {
+        message_sender_instance->on_message_sender_state_changed(message_sender_instance->on_message_sender_state_changed_context, new_state, previous_state);
+    }
+}
+
+static void indicate_all_messages_as_error(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+{
+    MESSAGE_WITH_CALLBACK* message_with_callback = message_sender_instance->first_message;
+
+    message_sender_instance->first_message = NULL;
+    message_sender_instance->last_message = NULL;
+    message_sender_instance->first_not_sent_message = NULL;
+    message_sender_instance->streaming_message = NULL;
+    message_sender_instance->has_stream_chunk = 0;
+
+    while (message_with_callback != NULL)
+    {
+        MESSAGE_WITH_CALLBACK* next_message = message_with_callback->next;
+
+        if (message_with_callback->on_message_send_complete != NULL)
+        {
+            message_with_callback->on_message_send_complete(message_with_callback->context, MESSAGE_SEND_ERROR);
+        }
+
+        free_message_with_callback(message_with_callback);
+        message_with_callback = next_message;
+    }
+}
+
+static void on_link_state_changed(void* context, LINK_STATE new_link_state, LINK_STATE previous_link_state)
+{
+    MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)context;
+    (void)previous_link_state;
+
+    switch (new_link_state)
     {
     default:
         break;
@@ -554,18 +846,154 @@ static void on_link_flow_on(void* context)
     send_all_pending_messages(message_sender_instance);
 }
 
+static void complete_enqueued_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context, MESSAGE_SEND_RESULT send_result)
+{
+    if (message_sender_instance->completion_executor != NULL)
+    {
+        message_sender_instance->completion_executor(message_sender_instance->completion_executor_context, on_message_send_complete, callback_context, send_result);
+    }
+    else if (on_message_send_complete != NULL)
+    {
+        on_message_send_complete(callback_context, send_result);
+    }
+}
+
+static void on_enqueued_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    ENQUEUED_SEND_COMPLETION* enqueued_send_completion = (ENQUEUED_SEND_COMPLETION*)context;
+    complete_enqueued_message(enqueued_send_completion->message_sender, enqueued_send_completion->on_message_send_complete, enqueued_send_completion->callback_context, send_result);
+    free(enqueued_send_completion);
+}
+
+static bool take_enqueued_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, SEND_QUEUE_CELL* enqueued_message)
+{
+    bool result;
+    SEND_QUEUE_CELL* cell = &message_sender_instance->send_queue[message_sender_instance->send_queue_dequeue_position & message_sender_instance->send_queue_mask];
+
+    /* either empty or the producer that claimed the cell has not published it yet, it signals again once it has */
+    if (amqp_atomic_load_size(&cell->sequence) != message_sender_instance->send_queue_dequeue_position + 1)
+    {
+        result = false;
+    }
+    else
+    {
+        enqueued_message->message_encoded = cell->message_encoded;
+        enqueued_message->on_message_send_complete = cell->on_message_send_complete;
+        enqueued_message->callback_context = cell->callback_context;
+
+        amqp_atomic_store_size(&cell->sequence, message_sender_instance->send_queue_dequeue_position + message_sender_instance->send_queue_mask + 1);
+        message_sender_instance->send_queue_dequeue_position++;
+        result = true;
+    }
+
+    return result;
+}
+
+static void submit_enqueued_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, SEND_QUEUE_CELL* enqueued_message)
+{
+    int result;
+
+    if (message_sender_instance->completion_executor == NULL)
+    {
+        result = messagesender_send_encoded(message_sender_instance, enqueued_message->message_encoded, enqueued_message->on_message_send_complete, enqueued_message->callback_context);
+    }
+    else
+    {
+        ENQUEUED_SEND_COMPLETION* enqueued_send_completion = (ENQUEUED_SEND_COMPLETION*)malloc(sizeof(ENQUEUED_SEND_COMPLETION));
+        if (enqueued_send_completion == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            enqueued_send_completion->message_sender = message_sender_instance;
+            enqueued_send_completion->on_message_send_complete = enqueued_message->on_message_send_complete;
+            enqueued_send_completion->callback_context = enqueued_message->callback_context;
+
+            result = messagesender_send_encoded(message_sender_instance, enqueued_message->message_encoded, on_enqueued_message_send_complete, enqueued_send_completion);
+            if (result != 0)
+            {
+                free(enqueued_send_completion);
+            }
+        }
+    }
+
+    if (result != 0)
+    {
+        LogError("Could not send enqueued message");
+        complete_enqueued_message(message_sender_instance, enqueued_message->on_message_send_complete, enqueued_message->callback_context, MESSAGE_SEND_ERROR);
+    }
+}
+
+static void send_enqueued_messages(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+{
+    SEND_QUEUE_CELL enqueued_message;
+
+    /* cleared before draining so that a message enqueued from now on signals again */
+    amqp_atomic_store_int(&message_sender_instance->is_send_queue_signalled, 0);
+
+    while (take_enqueued_message(message_sender_instance, &enqueued_message))
+    {
+        /* a message that could not be encoded was already reported to its producer */
+        if (enqueued_message.message_encoded != NULL)
+        {
+            submit_enqueued_message(message_sender_instance, &enqueued_message);
+            message_encoded_destroy(enqueued_message.message_encoded);
+        }
+    }
+}
+
+static void fail_enqueued_messages(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+{
+    SEND_QUEUE_CELL enqueued_message;
+
+    while (take_enqueued_message(message_sender_instance, &enqueued_message))
+    {
+        if (enqueued_message.message_encoded != NULL)
+        {
+            complete_enqueued_message(message_sender_instance, enqueued_message.on_message_send_complete, enqueued_message.callback_context, MESSAGE_SEND_ERROR);
+            message_encoded_destroy(enqueued_message.message_encoded);
+        }
+    }
+}
+
+static void on_link_dowork(void* context)
+{
+    MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)context;
+    send_enqueued_messages(message_sender_instance);
+}
+
 MESSAGE_SENDER_HANDLE messagesender_create(LINK_HANDLE link, ON_MESSAGE_SENDER_STATE_CHANGED on_message_sender_state_changed, void* context)
 {
     MESSAGE_SENDER_INSTANCE* result = malloc(sizeof(MESSAGE_SENDER_INSTANCE));
     if (result != NULL)
     {
-        result->messages = NULL;
-        result->message_count = 0;
+        result->first_message = NULL;
+        result->last_message = NULL;
+        result->first_not_sent_message = NULL;
         result->link = link;
         result->on_message_sender_state_changed = on_message_sender_state_changed;
         result->on_message_sender_state_changed_context = context;
         result->message_sender_state = MESSAGE_SENDER_STATE_IDLE;
+        result->streaming_message = NULL;
+        result->stream_buffer = NULL;
+        result->stream_buffer_size = 0;
+        result->max_stream_chunk_size = DEFAULT_MAX_STREAM_CHUNK_SIZE;
+        result->stream_chunk_length = 0;
+        result->send_queue = NULL;
+        result->send_queue_mask = 0;
+        result->send_queue_enqueue_position = 0;
+        result->send_queue_dequeue_position = 0;
+        result->is_send_queue_signalled = 0;
+        result->on_work_queued = NULL;
+        result->on_work_queued_context = NULL;
+        result->completion_executor = NULL;
+        result->completion_executor_context = NULL;
         result->is_trace_on = 0;
+        result->has_stream_chunk = 0;
+        result->is_stream_chunk_last = 0;
+        result->is_sending_stream_chunk = 0;
+        result->is_stream_chunk_sent = 0;
     }
 
     return result;
@@ -581,6 +1009,18 @@ void messagesender_destroy(MESSAGE_SENDER_HANDLE message_sender)
 
         indicate_all_messages_as_error(message_sender_instance);
 
+        if (message_sender_instance->send_queue != NULL)
+        {
+            (void)link_set_on_dowork(message_sender_instance->link, NULL);
+            fail_enqueued_messages(message_sender_instance);
+            free(message_sender_instance->send_queue);
+        }
+
+        if (message_sender_instance->stream_buffer != NULL)
+        {
+            free(message_sender_instance->stream_buffer);
+        }
+
         free(message_sender);
     }
 }
@@ -607,6 +1047,12 @@ int messagesender_open(MESSAGE_SENDER_HANDLE message_sender)
             }
             else
             {
+                /* the link dowork only runs once attached, messages enqueued before wait as pending until the link is open */
+                if (message_sender_instance->send_queue != NULL)
+                {
+                    send_enqueued_messages(message_sender_instance);
+                }
+
                 result = 0;
             }
         }
@@ -679,86 +1125,627 @@ int messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE mess
             }
             else
             {
-                MESSAGE_WITH_CALLBACK** new_messages = (MESSAGE_WITH_CALLBACK**)realloc(message_sender_instance->messages, sizeof(MESSAGE_WITH_CALLBACK*) * (message_sender_instance->message_count + 1));
-                if (new_messages == NULL)
+                result = 0;
+
+                message_with_callback->on_message_body_chunk_requested = NULL;
+                message_with_callback->body_context = NULL;
+                message_with_callback->encoded_message.bytes = NULL;
+                message_with_callback->encoded_message.length = 0;
+                message_with_callback->shared_encoded_message = NULL;
+
+                /* messages that cannot go out yet keep their order behind the ones already waiting */
+                if ((message_sender_instance->message_sender_state != MESSAGE_SENDER_STATE_OPEN) ||
+                    (message_sender_instance->first_not_sent_message != NULL))
                 {
-                    free(message_with_callback);
-                    result = __FAILURE__;
+                    if (keep_encoded_message(message_sender_instance, message_with_callback, message) != 0)
+                    {
+                        free(message_with_callback);
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                    }
                 }
                 else
                 {
-                    result = 0;
+                    message_with_callback->message_send_state = MESSAGE_SEND_STATE_PENDING;
+                }
+
+                if (result == 0)
+                {
+                    message_with_callback->on_message_send_complete = on_message_send_complete;
+                    message_with_callback->context = callback_context;
+                    message_with_callback->message_sender = message_sender_instance;
+
+                    add_pending_message(message_sender_instance, message_with_callback);
 
-                    message_sender_instance->messages = new_messages;
-                    if (message_sender_instance->message_sender_state != MESSAGE_SENDER_STATE_OPEN)
+                    if (message_with_callback->message_send_state == MESSAGE_SEND_STATE_PENDING)
                     {
-                        message_with_callback->message = message_clone(message);
-                        if (message_with_callback->message == NULL)
+                        switch (send_one_message(message_sender_instance, message_with_callback, message))
                         {
-                            free(message_with_callback);
+                        default:
+                        case SEND_ONE_MESSAGE_ERROR:
+                            remove_pending_message(message_sender_instance, message_with_callback);
                             result = __FAILURE__;
+                            break;
+
+                        case SEND_ONE_MESSAGE_BUSY:
+                            message_sender_instance->first_not_sent_message = message_with_callback;
+                            result = 0;
+                            break;
+
+                        case SEND_ONE_MESSAGE_OK:
+                            result = 0;
+                            break;
                         }
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
 
-                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+int messagesender_send_encoded(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_ENCODED_HANDLE message_encoded, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+{
+    int result;
+
+    if ((message_sender == NULL) ||
+        (message_encoded == NULL))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+        if (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_ERROR)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            MESSAGE_WITH_CALLBACK* message_with_callback = (MESSAGE_WITH_CALLBACK*)malloc(sizeof(MESSAGE_WITH_CALLBACK));
+            if (message_with_callback == NULL)
+            {
+                result = __FAILURE__;
+            }
+            else if (message_encoded_get_message_format(message_encoded, &message_with_callback->message_format) != 0)
+            {
+                free(message_with_callback);
+                result = __FAILURE__;
+            }
+            else
+            {
+                bool can_send_now = (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_OPEN) &&
+                    (message_sender_instance->first_not_sent_message == NULL);
+
+                /* the encoding is only referenced, so the same bytes can be queued on any number of senders */
+                message_with_callback->shared_encoded_message = message_encoded_clone(message_encoded);
+                message_with_callback->encoded_message.bytes = NULL;
+                message_with_callback->encoded_message.length = 0;
+                message_with_callback->on_message_body_chunk_requested = NULL;
+                message_with_callback->body_context = NULL;
+                message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                message_with_callback->on_message_send_complete = on_message_send_complete;
+                message_with_callback->context = callback_context;
+                message_with_callback->message_sender = message_sender_instance;
+
+                add_pending_message(message_sender_instance, message_with_callback);
+
+                result = 0;
+
+                if (can_send_now)
+                {
+                    switch (send_shared_encoded_message(message_sender_instance, message_with_callback))
+                    {
+                    default:
+                    case SEND_ONE_MESSAGE_ERROR:
+                        remove_pending_message(message_sender_instance, message_with_callback);
+                        result = __FAILURE__;
+                        break;
+
+                    case SEND_ONE_MESSAGE_BUSY:
+                        break;
+
+                    case SEND_ONE_MESSAGE_OK:
+                        advance_first_not_sent_message(message_sender_instance);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+void messagesender_set_trace(MESSAGE_SENDER_HANDLE message_sender, bool traceOn)
+{
+    MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+    if (message_sender_instance != NULL)
+    {
+        message_sender_instance->is_trace_on = traceOn ? 1 : 0;
+    }
+}
+
+int messagesender_send_batch(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE* messages, size_t message_count, ON_MESSAGE_BATCH_SEND_COMPLETE on_message_batch_send_complete, void* callback_context)
+{
+    int result;
+    size_t i;
+
+    if ((message_sender == NULL) ||
+        (messages == NULL) ||
+        (message_count == 0))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+
+        for (i = 0; i < message_count; i++)
+        {
+            if (messages[i] == NULL)
+            {
+                break;
+            }
+        }
+
+        if ((i < message_count) ||
+            (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_ERROR))
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            MESSAGE_BATCH* message_batch = (MESSAGE_BATCH*)malloc(sizeof(MESSAGE_BATCH) + (message_count * (sizeof(MESSAGE_BATCH_ENTRY) + sizeof(MESSAGE_SEND_RESULT))));
+            if (message_batch == NULL)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                bool can_send_now = (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_OPEN) &&
+                    (message_sender_instance->first_not_sent_message == NULL);
+                MESSAGE_WITH_CALLBACK* first_batch_message = NULL;
+                MESSAGE_WITH_CALLBACK* last_batch_message = NULL;
+                MESSAGE_WITH_CALLBACK* message_with_callback;
+
+                message_batch->on_message_batch_send_complete = on_message_batch_send_complete;
+                message_batch->context = callback_context;
+                message_batch->message_count = message_count;
+                message_batch->outstanding_count = message_count;
+                message_batch->entries = (MESSAGE_BATCH_ENTRY*)(message_batch + 1);
+                message_batch->send_results = (MESSAGE_SEND_RESULT*)(message_batch->entries + message_count);
+
+                result = 0;
+
+                /* everything is allocated up front so the batch is either queued as a whole or not at all */
+                for (i = 0; i < message_count; i++)
+                {
+                    message_with_callback = (MESSAGE_WITH_CALLBACK*)malloc(sizeof(MESSAGE_WITH_CALLBACK));
+                    if (message_with_callback == NULL)
+                    {
+                        result = __FAILURE__;
+                        break;
+                    }
+
+                    message_batch->entries[i].message_batch = message_batch;
+                    message_batch->entries[i].index = i;
+                    message_batch->send_results[i] = MESSAGE_SEND_ERROR;
+
+                    message_with_callback->on_message_body_chunk_requested = NULL;
+                    message_with_callback->body_context = NULL;
+                    message_with_callback->encoded_message.bytes = NULL;
+                    message_with_callback->encoded_message.length = 0;
+                    message_with_callback->shared_encoded_message = NULL;
+                    message_with_callback->on_message_send_complete = on_batch_message_send_complete;
+                    message_with_callback->context = &message_batch->entries[i];
+                    message_with_callback->message_sender = message_sender_instance;
+                    message_with_callback->next = NULL;
+
+                    message_with_callback->message_send_state = can_send_now ? MESSAGE_SEND_STATE_PENDING : MESSAGE_SEND_STATE_NOT_SENT;
+
+                    if (last_batch_message == NULL)
+                    {
+                        first_batch_message = message_with_callback;
                     }
                     else
                     {
-                        message_with_callback->message = NULL;
-                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_PENDING;
+                        last_batch_message->next = message_with_callback;
                     }
 
-                    if (result == 0)
+                    last_batch_message = message_with_callback;
+
+                    if ((!can_send_now) &&
+                        (keep_encoded_message(message_sender_instance, message_with_callback, messages[i]) != 0))
+                    {
+                        result = __FAILURE__;
+                        break;
+                    }
+                }
+
+                if (result != 0)
+                {
+                    while (first_batch_message != NULL)
                     {
-                        message_with_callback->on_message_send_complete = on_message_send_complete;
-                        message_with_callback->context = callback_context;
-                        message_with_callback->message_sender = message_sender_instance;
+                        message_with_callback = first_batch_message;
+                        first_batch_message = first_batch_message->next;
+                        free_message_with_callback(message_with_callback);
+                    }
 
-                        message_sender_instance->messages[message_sender_instance->message_count] = message_with_callback;
-                        message_sender_instance->message_count++;
+                    free(message_batch);
+                }
+                else
+                {
+                    ENCODE_BUFFER encode_buffer = { NULL, 0, 0 };
+                    bool is_link_busy = false;
 
-                        if (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_OPEN)
+                    message_with_callback = first_batch_message;
+                    while (message_with_callback != NULL)
+                    {
+                        MESSAGE_WITH_CALLBACK* next_batch_message = message_with_callback->next;
+                        add_pending_message(message_sender_instance, message_with_callback);
+                        message_with_callback = next_batch_message;
+                    }
+
+                    message_with_callback = first_batch_message;
+                    for (i = 0; (i < message_count) && can_send_now; i++)
+                    {
+                        /* read ahead, the current message may be settled and freed while it is sent */
+                        MESSAGE_WITH_CALLBACK* next_batch_message = message_with_callback->next;
+                        SEND_ONE_MESSAGE_RESULT send_result = SEND_ONE_MESSAGE_BUSY;
+                        message_format message_format;
+
+                        if (!is_link_busy)
                         {
-                            switch (send_one_message(message_sender_instance, message_with_callback, message))
+                            /* one encode buffer serves the whole batch, it only grows to the largest message */
+                            encode_buffer.length = 0;
+                            if (encode_message(message_sender_instance, messages[i], false, &encode_buffer, &message_format) != 0)
                             {
-                            default:
-                            case SEND_ONE_MESSAGE_ERROR:
-							
-                                remove_pending_message_by_index(message_sender_instance, message_sender_instance->message_count - 1);
-                                result = __FAILURE__;
-                                break;
-
-                            case SEND_ONE_MESSAGE_BUSY:
-                                message_with_callback->message = message_clone(message);
-                                if (message_with_callback->message == NULL)
-                                {
-                                    free(message_with_callback);
-                                    result = __FAILURE__;
-                                }
-                                else
+                                send_result = SEND_ONE_MESSAGE_ERROR;
+                            }
+                            else
+                            {
+                                PAYLOAD payload;
+                                payload.bytes = encode_buffer.bytes;
+                                payload.length = encode_buffer.length;
+
+                                send_result = send_encoded_message(message_sender_instance, message_with_callback, message_format, &payload);
+                                if (send_result == SEND_ONE_MESSAGE_BUSY)
                                 {
-                                    message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
-                                    result = 0;
+                                    /* hand the encoding over to the message rather than copying it */
+                                    message_with_callback->encoded_message = payload;
+                                    message_with_callback->message_format = message_format;
+                                    encode_buffer.bytes = NULL;
+                                    encode_buffer.size = 0;
+                                    encode_buffer.length = 0;
+                                    is_link_busy = true;
                                 }
-                                break;
+                            }
+                        }
+                        else if (keep_encoded_message(message_sender_instance, message_with_callback, messages[i]) != 0)
+                        {
+                            send_result = SEND_ONE_MESSAGE_ERROR;
+                        }
 
-                            case SEND_ONE_MESSAGE_OK:
-                                result = 0;
-                                break;
+                        if (send_result == SEND_ONE_MESSAGE_BUSY)
+                        {
+                            /* the rest of the batch waits for the link to flow again */
+                            message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                            if (message_sender_instance->first_not_sent_message == NULL)
+                            {
+                                message_sender_instance->first_not_sent_message = message_with_callback;
                             }
                         }
+
+                        if (send_result == SEND_ONE_MESSAGE_ERROR)
+                        {
+                            void* context = message_with_callback->context;
+                            remove_pending_message(message_sender_instance, message_with_callback);
+                            on_batch_message_send_complete(context, MESSAGE_SEND_ERROR);
+                        }
+
+                        message_with_callback = next_batch_message;
                     }
+
+                    free(encode_buffer.bytes);
                 }
             }
         }
     }
+
     return result;
 }
 
-void messagesender_set_trace(MESSAGE_SENDER_HANDLE message_sender, bool traceOn)
+int messagesender_send_streamed(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, ON_MESSAGE_BODY_CHUNK_REQUESTED on_message_body_chunk_requested, void* body_context, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
 {
-    MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
-    if (message_sender_instance != NULL)
+    int result;
+
+    if ((message_sender == NULL) ||
+        (message == NULL) ||
+        (on_message_body_chunk_requested == NULL))
     {
-        message_sender_instance->is_trace_on = traceOn ? 1 : 0;
+        result = __FAILURE__;
     }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+        if (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_ERROR)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            ENCODE_BUFFER encode_buffer = { NULL, 0, 0 };
+            MESSAGE_WITH_CALLBACK* message_with_callback = (MESSAGE_WITH_CALLBACK*)malloc(sizeof(MESSAGE_WITH_CALLBACK));
+            if (message_with_callback == NULL)
+            {
+                result = __FAILURE__;
+            }
+            /* only the sections ahead of the body are kept, the body itself is pulled chunk by chunk */
+            else if (encode_message(message_sender_instance, message, true, &encode_buffer, &message_with_callback->message_format) != 0)
+            {
+                free(encode_buffer.bytes);
+                free(message_with_callback);
+                result = __FAILURE__;
+            }
+            else
+            {
+                bool can_send_now = (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_OPEN) &&
+                    (message_sender_instance->first_not_sent_message == NULL);
+
+                message_with_callback->encoded_message.bytes = encode_buffer.bytes;
+                message_with_callback->encoded_message.length = encode_buffer.length;
+                message_with_callback->shared_encoded_message = NULL;
+                message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                message_with_callback->on_message_body_chunk_requested = on_message_body_chunk_requested;
+                message_with_callback->body_context = body_context;
+                message_with_callback->on_message_send_complete = on_message_send_complete;
+                message_with_callback->context = callback_context;
+                message_with_callback->message_sender = message_sender_instance;
+
+                add_pending_message(message_sender_instance, message_with_callback);
+
+                result = 0;
+
+                if (can_send_now)
+                {
+                    switch (send_stream_chunks(message_sender_instance, message_with_callback))
+                    {
+                    default:
+                    case SEND_ONE_MESSAGE_ERROR:
+                        remove_pending_message(message_sender_instance, message_with_callback);
+                        result = __FAILURE__;
+                        break;
+
+                    case SEND_ONE_MESSAGE_BUSY:
+                        break;
+
+                    case SEND_ONE_MESSAGE_OK:
+                        advance_first_not_sent_message(message_sender_instance);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+int messagesender_set_max_stream_chunk_size(MESSAGE_SENDER_HANDLE message_sender, size_t max_stream_chunk_size)
+{
+    int result;
+
+    if ((message_sender == NULL) ||
+        (max_stream_chunk_size == 0) ||
+        (max_stream_chunk_size > UINT32_MAX - DATA_SECTION_HEADER_MAX_SIZE))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+        if (message_sender_instance->streaming_message != NULL)
+        {
+            /* the stream buffer holds a chunk of the message being streamed */
+            result = __FAILURE__;
+        }
+        else
+        {
+            message_sender_instance->max_stream_chunk_size = max_stream_chunk_size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Has to be called before any producer thread uses messagesender_enqueue. Enqueuing requests a dowork of the connection,
+   on_work_queued is then called from the producer thread to wake up the thread running the connection, e.g. with event_loop_wake */
+int messagesender_enable_send_queue(MESSAGE_SENDER_HANDLE message_sender, size_t capacity, ON_MESSAGE_SENDER_WORK_QUEUED on_work_queued, void* on_work_queued_context)
+{
+    int result;
+
+    if ((message_sender == NULL) ||
+        (capacity == 0) ||
+        (capacity > (SIZE_MAX / 2) / sizeof(SEND_QUEUE_CELL)))
+    {
+        LogError("Bad arguments: message_sender = %p, capacity = %lu", message_sender, (unsigned long)capacity);
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+        size_t queue_size = 2;
+
+        /* a power of two so that positions map to cells with a mask */
+        while (queue_size < capacity)
+        {
+            queue_size *= 2;
+        }
+
+        if (message_sender_instance->send_queue != NULL)
+        {
+            LogError("Send queue already enabled");
+            result = __FAILURE__;
+        }
+        else if ((message_sender_instance->send_queue = (SEND_QUEUE_CELL*)malloc(sizeof(SEND_QUEUE_CELL) * queue_size)) == NULL)
+        {
+            LogError("Could not allocate send queue");
+            result = __FAILURE__;
+        }
+        else if (link_set_on_dowork(message_sender_instance->link, on_link_dowork) != 0)
+        {
+            LogError("Could not hook the send queue to the link dowork");
+            free(message_sender_instance->send_queue);
+            message_sender_instance->send_queue = NULL;
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+
+            for (i = 0; i < queue_size; i++)
+            {
+                message_sender_instance->send_queue[i].sequence = i;
+                message_sender_instance->send_queue[i].message_encoded = NULL;
+            }
+
+            message_sender_instance->send_queue_mask = queue_size - 1;
+            message_sender_instance->send_queue_enqueue_position = 0;
+            message_sender_instance->send_queue_dequeue_position = 0;
+            message_sender_instance->on_work_queued = on_work_queued;
+            message_sender_instance->on_work_queued_context = on_work_queued_context;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/* Completions of enqueued messages go through the executor, which is responsible for calling on_message_send_complete on the thread of its choice */
+int messagesender_set_completion_executor(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_SENDER_COMPLETION_EXECUTOR executor, void* executor_context)
+{
+    int result;
+
+    if (message_sender == NULL)
+    {
+        LogError("NULL message_sender");
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+        message_sender_instance->completion_executor = executor;
+        message_sender_instance->completion_executor_context = executor_context;
+        result = 0;
+    }
+
+    return result;
+}
+
+/* Can be called from any thread. The message is encoded on the calling thread and can be destroyed as soon as the call returns */
+MESSAGE_ENQUEUE_RESULT messagesender_enqueue(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+{
+    MESSAGE_ENQUEUE_RESULT result;
+
+    if ((message_sender == NULL) ||
+        (message == NULL) ||
+        (message_sender->send_queue == NULL))
+    {
+        LogError("Bad arguments: message_sender = %p, message = %p", message_sender, message);
+        result = MESSAGE_ENQUEUE_ERROR;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+        size_t position = amqp_atomic_load_size(&message_sender_instance->send_queue_enqueue_position);
+        SEND_QUEUE_CELL* cell = NULL;
+
+        result = MESSAGE_ENQUEUE_OK;
+
+        while (cell == NULL)
+        {
+            SEND_QUEUE_CELL* candidate = &message_sender_instance->send_queue[position & message_sender_instance->send_queue_mask];
+            size_t sequence = amqp_atomic_load_size(&candidate->sequence);
+
+            if (sequence == position)
+            {
+                /* on failure another producer took the cell and position is reloaded */
+                if (amqp_atomic_compare_exchange_size(&message_sender_instance->send_queue_enqueue_position, &position, position + 1))
+                {
+                    cell = candidate;
+                }
+            }
+            else if (sequence < position)
+            {
+                /* the cell still holds the message enqueued one lap ago */
+                result = MESSAGE_ENQUEUE_FULL;
+                break;
+            }
+            else
+            {
+                position = amqp_atomic_load_size(&message_sender_instance->send_queue_enqueue_position);
+            }
+        }
+
+        if (cell != NULL)
+        {
+            cell->message_encoded = message_encode(message);
+            if (cell->message_encoded == NULL)
+            {
+                /* the claimed cell still has to be published, the consumer skips it */
+                LogError("Could not encode message");
+                cell->on_message_send_complete = NULL;
+                cell->callback_context = NULL;
+                result = MESSAGE_ENQUEUE_ERROR;
+            }
+            else
+            {
+                cell->on_message_send_complete = on_message_send_complete;
+                cell->callback_context = callback_context;
+            }
+
+            amqp_atomic_store_size(&cell->sequence, position + 1);
+
+            if (amqp_atomic_exchange_int(&message_sender_instance->is_send_queue_signalled, 1) == 0)
+            {
+                /* the dowork of the link drains the queue */
+                if (link_request_dowork(message_sender_instance->link) != 0)
+                {
+                    LogError("Could not request a dowork for the enqueued message");
+                }
+
+                if (message_sender_instance->on_work_queued != NULL)
+                {
+                    message_sender_instance->on_work_queued(message_sender_instance->on_work_queued_context);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/* Sends everything enqueued so far, it also happens on every dowork of the connection */
+int messagesender_drain_send_queue(MESSAGE_SENDER_HANDLE message_sender)
+{
+    int result;
+
+    if ((message_sender == NULL) ||
+        (message_sender->send_queue == NULL))
+    {
+        LogError("Bad arguments: message_sender = %p", message_sender);
+        result = __FAILURE__;
+    }
+    else
+    {
+        send_enqueued_messages((MESSAGE_SENDER_INSTANCE*)message_sender);
+        result = 0;
+    }
+
+    return result;
 }
@@ -17,6 +17,7 @@ typedef struct LINK_ENDPOINT_INSTANCE_TAG
 	ON_ENDPOINT_FRAME_RECEIVED frame_received_callback;
 	ON_SESSION_STATE_CHANGED on_session_state_changed;
 	ON_SESSION_FLOW_ON on_session_flow_on;
+	ON_ENDPOINT_DOWORK on_link_endpoint_dowork;
 	void* callback_context;
 	SESSION_HANDLE session;
 } LINK_ENDPOINT_INSTANCE;
@@ -45,6 +46,8 @@ typedef struct SESSION_INSTANCE_TAG
 	uint32_t remote_incoming_window;
 	uint32_t remote_outgoing_window;
 	int is_underlying_connection_open : 1;
+	/* the connection has too many bytes waiting to be written, new transfers are refused until it drains */
+	bool is_connection_send_blocked;
 } SESSION_INSTANCE;
 
 #define UNDERLYING_CONNECTION_NOT_OPEN 0
@@ -312,6 +315,73 @@ static void on_connection_state_changed(void* context, CONNECTION_STATE new_conn
 	}
 }
 
+/* Link callbacks may destroy link endpoints, which moves the others around in the array.
+   The array is sorted by output handle, so the next link endpoint is looked up by handle instead of by index. */
+static LINK_ENDPOINT_INSTANCE* get_next_link_endpoint(SESSION_INSTANCE* session_instance, uint64_t first_output_handle)
+{
+	LINK_ENDPOINT_INSTANCE* result = NULL;
+	uint32_t i;
+
+	for (i = 0; i < session_instance->link_endpoint_count; i++)
+	{
+		if (session_instance->link_endpoints[i]->output_handle >= first_output_handle)
+		{
+			result = session_instance->link_endpoints[i];
+			break;
+		}
+	}
+
+	return result;
+}
+
+static uint64_t on_connection_dowork(void* context, uint64_t current_ms)
+{
+	SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)context;
+	LINK_ENDPOINT_INSTANCE* link_endpoint = get_next_link_endpoint(session_instance, 0);
+	uint64_t result = (uint64_t)-1;
+
+	while (link_endpoint != NULL)
+	{
+		handle output_handle = link_endpoint->output_handle;
+
+		if (link_endpoint->on_link_endpoint_dowork != NULL)
+		{
+			uint64_t time_to_dowork = link_endpoint->on_link_endpoint_dowork(link_endpoint->callback_context, current_ms);
+			if (time_to_dowork < result)
+			{
+				result = time_to_dowork;
+			}
+		}
+
+		link_endpoint = get_next_link_endpoint(session_instance, (uint64_t)output_handle + 1);
+	}
+
+	return result;
+}
+
+static void on_connection_send_blocked_changed(void* context, bool is_send_blocked)
+{
+	SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)context;
+	LINK_ENDPOINT_INSTANCE* link_endpoint = get_next_link_endpoint(session_instance, 0);
+
+	session_instance->is_connection_send_blocked = is_send_blocked;
+
+	/* links that got busy because of the connection can send again */
+	while ((!session_instance->is_connection_send_blocked) &&
+		(session_instance->remote_incoming_window > 0) &&
+		(link_endpoint != NULL))
+	{
+		handle output_handle = link_endpoint->output_handle;
+
+		if (link_endpoint->on_session_flow_on != NULL)
+		{
+			link_endpoint->on_session_flow_on(link_endpoint->callback_context);
+		}
+
+		link_endpoint = get_next_link_endpoint(session_instance, (uint64_t)output_handle + 1);
+	}
+}
+
 static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t payload_size, const unsigned char* payload_bytes)
 {
 	SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)context;
@@ -514,7 +584,7 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 				}
 
 				size_t i = 0;
-				while ((session_instance->remote_incoming_window > 0) && (i < session_instance->link_endpoint_count))
+				while ((session_instance->remote_incoming_window > 0) && (!session_instance->is_connection_send_blocked) && (i < session_instance->link_endpoint_count))
 				{
 					/* notify the caller that it can send here */
 					if (session_instance->link_endpoints[i]->on_session_flow_on != NULL)
@@ -641,6 +711,7 @@ SESSION_HANDLE session_create(CONNECTION_HANDLE connection, ON_LINK_ATTACHED on_
 			result->remote_outgoing_window = 0;
 			result->previous_session_state = SESSION_STATE_UNMAPPED;
 			result->is_underlying_connection_open = UNDERLYING_CONNECTION_NOT_OPEN;
+			result->is_connection_send_blocked = false;
 			result->session_state = SESSION_STATE_UNMAPPED;
 			result->on_link_attached = on_link_attached;
 			result->on_link_attached_callback_context = callback_context;
@@ -691,6 +762,7 @@ SESSION_HANDLE session_create_from_endpoint(CONNECTION_HANDLE connection, ENDPOI
 			result->remote_outgoing_window = 0;
 			result->previous_session_state = SESSION_STATE_UNMAPPED;
 			result->is_underlying_connection_open = UNDERLYING_CONNECTION_NOT_OPEN;
+			result->is_connection_send_blocked = false;
 			result->session_state = SESSION_STATE_UNMAPPED;
 			result->on_link_attached = on_link_attached;
 			result->on_link_attached_callback_context = callback_context;
@@ -736,7 +808,9 @@ int session_begin(SESSION_HANDLE session)
 	{
 		SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)session;
 
-		if (connection_start_endpoint(session_instance->endpoint, on_frame_received, on_connection_state_changed, session_instance) != 0)
+		if ((connection_start_endpoint(session_instance->endpoint, on_frame_received, on_connection_state_changed, session_instance) != 0) ||
+			(connection_endpoint_set_on_dowork(session_instance->endpoint, on_connection_dowork) != 0) ||
+			(connection_endpoint_set_on_send_blocked_changed(session_instance->endpoint, on_connection_send_blocked_changed) != 0))
 		{
 			result = __FAILURE__;
 		}
@@ -985,6 +1059,7 @@ LINK_ENDPOINT_HANDLE session_create_link_endpoint(SESSION_HANDLE session, const
 
 			result->on_session_state_changed = NULL;
 			result->on_session_flow_on = NULL;
+			result->on_link_endpoint_dowork = NULL;
 			result->frame_received_callback = NULL;
 			result->callback_context = NULL;
 			result->output_handle = selected_handle;
@@ -1109,6 +1184,45 @@ int session_start_link_endpoint(LINK_ENDPOINT_HANDLE link_endpoint, ON_ENDPOINT_
 	return result;
 }
 
+int session_set_link_endpoint_on_dowork(LINK_ENDPOINT_HANDLE link_endpoint, ON_ENDPOINT_DOWORK on_link_endpoint_dowork)
+{
+	int result;
+
+	if (link_endpoint == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		link_endpoint->on_link_endpoint_dowork = on_link_endpoint_dowork;
+		result = 0;
+	}
+
+	return result;
+}
+
+/* Can be called from any thread, the dowork of the connection calls the dowork of every link endpoint */
+int session_request_dowork(SESSION_HANDLE session)
+{
+	int result;
+
+	if (session == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else if (connection_request_dowork(session->connection) != 0)
+	{
+		LogError("Could not request a dowork of the connection");
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
 static int encode_frame(LINK_ENDPOINT_HANDLE link_endpoint, const AMQP_VALUE performative, PAYLOAD* payloads, size_t payload_count)
 {
 	int result;
@@ -1317,14 +1431,259 @@ int session_send_detach(LINK_ENDPOINT_HANDLE link_endpoint, DETACH_HANDLE detach
 	return result;
 }
 
-/* Codes_SRS_SESSION_01_051: [session_send_transfer shall send a transfer frame with the performative indicated in the transfer argument.] */
-SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+static int encode_bytes(void* context, const unsigned char* bytes, size_t length)
+{
+	PAYLOAD* payload = (PAYLOAD*)context;
+	(void)memcpy((unsigned char*)payload->bytes + payload->length, bytes, length);
+	payload->length += length;
+	return 0;
+}
+
+/* The transfer performative is encoded once with more set to true and reused for every fragment. When the last fragment
+   has to carry more set to false, it is encoded a second time only to find the byte holding the flag, which is then patched.
+   The fragment payload array and both encodings share a single allocation for the whole delivery. */
+static int send_multi_frame_transfer(SESSION_INSTANCE* session_instance, TRANSFER_HANDLE transfer, AMQP_VALUE transfer_value, size_t encoded_size, PAYLOAD* payloads, size_t payload_count, size_t payload_size, uint32_t available_frame_size, bool more, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	int result;
+	AMQP_VALUE more_transfer_value;
+	size_t more_encoded_size;
+
+	if ((available_frame_size == 0) ||
+		(transfer_set_more(transfer, true) != 0))
+	{
+		result = __FAILURE__;
+	}
+	else if ((more_transfer_value = amqpvalue_create_transfer(transfer)) == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		if ((amqpvalue_get_encoded_size(more_transfer_value, &more_encoded_size) != 0) ||
+			(more_encoded_size != encoded_size))
+		{
+			LogError("Unexpected encoded size for the continuation transfer");
+			result = __FAILURE__;
+		}
+		else
+		{
+			PAYLOAD* frame_payloads = (PAYLOAD*)malloc((sizeof(PAYLOAD) * (payload_count + 1)) + (encoded_size * 2));
+			if (frame_payloads == NULL)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				PAYLOAD more_header;
+				PAYLOAD last_header;
+				size_t more_flag_offset = 0;
+
+				more_header.bytes = (unsigned char*)(frame_payloads + payload_count + 1);
+				more_header.length = 0;
+				last_header.bytes = more_header.bytes + encoded_size;
+				last_header.length = 0;
+
+				if ((amqpvalue_encode(more_transfer_value, encode_bytes, &more_header) != 0) ||
+					((!more) && (amqpvalue_encode(transfer_value, encode_bytes, &last_header) != 0)))
+				{
+					result = __FAILURE__;
+				}
+				else
+				{
+					result = 0;
+
+					if (!more)
+					{
+						for (more_flag_offset = 0; more_flag_offset < encoded_size; more_flag_offset++)
+						{
+							if (more_header.bytes[more_flag_offset] != last_header.bytes[more_flag_offset])
+							{
+								break;
+							}
+						}
+
+						if ((more_flag_offset == encoded_size) ||
+							(memcmp(more_header.bytes + more_flag_offset + 1, last_header.bytes + more_flag_offset + 1, encoded_size - more_flag_offset - 1) != 0))
+						{
+							LogError("Cannot locate the more flag in the encoded transfer");
+							result = __FAILURE__;
+						}
+					}
+
+					if (result == 0)
+					{
+						unsigned char* header_bytes = (unsigned char*)more_header.bytes;
+						size_t current_payload_index = 0;
+						size_t current_payload_pos = 0;
+
+						while (payload_size > 0)
+						{
+							uint32_t current_transfer_frame_payload_size = (payload_size > available_frame_size) ? available_frame_size : (uint32_t)payload_size;
+							bool is_last_fragment = (current_transfer_frame_payload_size == payload_size);
+							uint32_t byte_counter = current_transfer_frame_payload_size;
+							size_t transfer_frame_payload_count = 1;
+
+							if (is_last_fragment && !more)
+							{
+								header_bytes[more_flag_offset] = last_header.bytes[more_flag_offset];
+							}
+
+							frame_payloads[0].bytes = header_bytes;
+							frame_payloads[0].length = encoded_size;
+
+							while (byte_counter > 0)
+							{
+								size_t remaining = payloads[current_payload_index].length - current_payload_pos;
+								if (remaining > byte_counter)
+								{
+									remaining = byte_counter;
+								}
+
+								if (remaining > 0)
+								{
+									frame_payloads[transfer_frame_payload_count].bytes = payloads[current_payload_index].bytes + current_payload_pos;
+									frame_payloads[transfer_frame_payload_count].length = remaining;
+									transfer_frame_payload_count++;
+									current_payload_pos += remaining;
+									byte_counter -= (uint32_t)remaining;
+								}
+
+								if (current_payload_pos == payloads[current_payload_index].length)
+								{
+									current_payload_index++;
+									current_payload_pos = 0;
+								}
+							}
+
+							/* the transfer is only complete once its last fragment has been sent */
+							if (connection_encode_preencoded_frame(session_instance->endpoint, frame_payloads, transfer_frame_payload_count, is_last_fragment ? on_send_complete : NULL, is_last_fragment ? callback_context : NULL) != 0)
+							{
+								break;
+							}
+
+							payload_size -= current_transfer_frame_payload_size;
+						}
+
+						if (payload_size > 0)
+						{
+							result = __FAILURE__;
+						}
+					}
+				}
+
+				free(frame_payloads);
+			}
+		}
+
+		amqpvalue_destroy(more_transfer_value);
+	}
+
+	return result;
+}
+
+static int get_transfer_payload_size(PAYLOAD* payloads, size_t payload_count, size_t* payload_size)
+{
+	int result;
+	size_t i;
+
+	*payload_size = 0;
+
+	for (i = 0; i < payload_count; i++)
+	{
+		if ((payloads[i].length > UINT32_MAX) ||
+			(*payload_size + payloads[i].length < *payload_size))
+		{
+			break;
+		}
+
+		*payload_size += payloads[i].length;
+	}
+
+	if ((i < payload_count) ||
+		(*payload_size > UINT32_MAX))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+/* Sends the payloads as one or more transfer frames, the last of which carries the given more flag */
+static int send_transfer_frames(SESSION_INSTANCE* session_instance, LINK_ENDPOINT_INSTANCE* link_endpoint_instance, TRANSFER_HANDLE transfer, delivery_number delivery_id, PAYLOAD* payloads, size_t payload_count, size_t payload_size, bool more, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	int result;
+
+	if ((transfer_set_handle(transfer, link_endpoint_instance->output_handle) != 0) ||
+		(transfer_set_delivery_id(transfer, delivery_id) != 0) ||
+		(transfer_set_more(transfer, more) != 0))
+	{
+		/* Codes_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
+		result = __FAILURE__;
+	}
+	else
+	{
+		AMQP_VALUE transfer_value;
+
+		transfer_value = amqpvalue_create_transfer(transfer);
+		if (transfer_value == NULL)
+		{
+			/* Codes_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
+			result = __FAILURE__;
+		}
+		else
+		{
+			uint32_t available_frame_size;
+			size_t encoded_size;
+
+			if ((connection_get_remote_max_frame_size(session_instance->connection, &available_frame_size) != 0) ||
+				(amqpvalue_get_encoded_size(transfer_value, &encoded_size) != 0) ||
+				(available_frame_size <= encoded_size + 8))
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				available_frame_size -= (uint32_t)encoded_size;
+				available_frame_size -= 8;
+
+				if (available_frame_size >= payload_size)
+				{
+					/* Codes_SRS_SESSION_01_055: [The encoding of the frame shall be done by calling connection_encode_frame and passing as arguments: the connection handle associated with the session, the transfer performative and the payload chunks passed to session_send_transfer.] */
+					if (connection_encode_frame(session_instance->endpoint, transfer_value, payloads, payload_count, on_send_complete, callback_context) != 0)
+					{
+						/* Codes_SRS_SESSION_01_056: [If connection_encode_frame fails then session_send_transfer shall fail and return a non-zero value.] */
+						result = __FAILURE__;
+					}
+					else
+					{
+						result = 0;
+					}
+				}
+				else
+				{
+					result = send_multi_frame_transfer(session_instance, transfer, transfer_value, encoded_size, payloads, payload_count, payload_size, available_frame_size, more, on_send_complete, callback_context);
+				}
+			}
+
+			amqpvalue_destroy(transfer_value);
+		}
+	}
+
+	return result;
+}
+
+static SESSION_SEND_TRANSFER_RESULT send_transfer(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, bool is_first_chunk, bool more, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
 {
 	SESSION_SEND_TRANSFER_RESULT result;
 
 	/* Codes_SRS_SESSION_01_054: [If link_endpoint or transfer is NULL, session_send_transfer shall fail and return a non-zero value.] */
 	if ((link_endpoint == NULL) ||
-		(transfer == NULL))
+		(transfer == NULL) ||
+		(delivery_id == NULL))
 	{
 		result = SESSION_SEND_TRANSFER_ERROR;
 	}
@@ -1332,230 +1691,62 @@ SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_end
 	{
 		LINK_ENDPOINT_INSTANCE* link_endpoint_instance = (LINK_ENDPOINT_INSTANCE*)link_endpoint;
 		SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)link_endpoint_instance->session;
+		size_t payload_size;
 
 		/* Codes_SRS_SESSION_01_059: [When session_send_transfer is called while the session is not in the MAPPED state, session_send_transfer shall fail and return a non-zero value.] */
 		if (session_instance->session_state != SESSION_STATE_MAPPED)
 		{
 			result = SESSION_SEND_TRANSFER_ERROR;
 		}
+		else if (get_transfer_payload_size(payloads, payload_count, &payload_size) != 0)
+		{
+			result = SESSION_SEND_TRANSFER_ERROR;
+		}
+		else if (is_first_chunk &&
+			((session_instance->remote_incoming_window == 0) || session_instance->is_connection_send_blocked))
+		{
+			result = SESSION_SEND_TRANSFER_BUSY;
+		}
 		else
 		{
-			size_t payload_size = 0;
-			size_t i;
-
-			for (i = 0; i < payload_count; i++)
+			/* Codes_SRS_SESSION_01_012: [The session endpoint assigns each outgoing transfer frame an implicit transfer-id from a session scoped sequence.] */
+			/* Codes_SRS_SESSION_01_027: [sending a transfer Upon sending a transfer, the sending endpoint will increment its next-outgoing-id] */
+			if (is_first_chunk)
 			{
-                if ((payloads[i].length > UINT32_MAX) ||
-                    (payload_size + payloads[i].length < payload_size))
-                {
-                    break;
-                }
+				*delivery_id = session_instance->next_outgoing_id;
+			}
 
-                payload_size += payloads[i].length;
-            }
+			if (send_transfer_frames(session_instance, link_endpoint_instance, transfer, *delivery_id, payloads, payload_count, payload_size, more, on_send_complete, callback_context) != 0)
+			{
+				result = SESSION_SEND_TRANSFER_ERROR;
+			}
+			else
+			{
+				/* the delivery id is reserved by its first chunk so that other links cannot reuse it while it is still being streamed */
+				if (is_first_chunk)
+				{
+					/* Codes_SRS_SESSION_01_018: [is incremented after each successive transfer according to RFC-1982 [RFC1982] serial number arithmetic.] */
+					session_instance->next_outgoing_id++;
+					session_instance->remote_incoming_window--;
+					session_instance->outgoing_window--;
+				}
 
-            if ((i < payload_count) ||
-                (payload_size > UINT32_MAX))
-            {
-                result = SESSION_SEND_TRANSFER_ERROR;
-            }
-            else
-            {
-                if (session_instance->remote_incoming_window == 0)
-                {
-                    result = SESSION_SEND_TRANSFER_BUSY;
-                }
-                else
-                {
-                    /* Codes_SRS_SESSION_01_012: [The session endpoint assigns each outgoing transfer frame an implicit transfer-id from a session scoped sequence.] */
-                    /* Codes_SRS_SESSION_01_027: [sending a transfer Upon sending a transfer, the sending endpoint will increment its next-outgoing-id] */
-                    *delivery_id = session_instance->next_outgoing_id;
-                    if ((transfer_set_handle(transfer, link_endpoint_instance->output_handle) != 0) ||
-                        (transfer_set_delivery_id(transfer, *delivery_id) != 0) ||
-                        (transfer_set_more(transfer, false) != 0))
-                    {
-                        /* Codes_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
-                        result = SESSION_SEND_TRANSFER_ERROR;
-                    }
-                    else
-                    {
-                        AMQP_VALUE transfer_value;
-
-                        transfer_value = amqpvalue_create_transfer(transfer);
-                        if (transfer_value == NULL)
-                        {
-                            /* Codes_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
-                            result = SESSION_SEND_TRANSFER_ERROR;
-                        }
-                        else
-                        {
-                            uint32_t available_frame_size;
-                            size_t encoded_size;
-
-                            if ((connection_get_remote_max_frame_size(session_instance->connection, &available_frame_size) != 0) ||
-                                (amqpvalue_get_encoded_size(transfer_value, &encoded_size) != 0))
-                            {
-                                result = SESSION_SEND_TRANSFER_ERROR;
-                            }
-                            else
-                            {
-                                payload_size = 0;
-
-                                for (i = 0; i < payload_count; i++)
-                                {
-                                    payload_size += payloads[i].length;
-                                }
-
-                                available_frame_size -= (uint32_t)encoded_size;
-                                available_frame_size -= 8;
-
-                                if (available_frame_size >= payload_size)
-                                {
-                                    /* Codes_SRS_SESSION_01_055: [The encoding of the frame shall be done by calling connection_encode_frame and passing as arguments: the connection handle associated with the session, the transfer performative and the payload chunks passed to session_send_transfer.] */
-                                    if (connection_encode_frame(session_instance->endpoint, transfer_value, payloads, payload_count, on_send_complete, callback_context) != 0)
-                                    {
-                                        /* Codes_SRS_SESSION_01_056: [If connection_encode_frame fails then session_send_transfer shall fail and return a non-zero value.] */
-                                        result = SESSION_SEND_TRANSFER_ERROR;
-                                    }
-                                    else
-                                    {
-                                        /* Codes_SRS_SESSION_01_018: [is incremented after each successive transfer according to RFC-1982 [RFC1982] serial number arithmetic.] */
-                                        session_instance->next_outgoing_id++;
-                                        session_instance->remote_incoming_window--;
-                                        session_instance->outgoing_window--;
-
-                                        /* Codes_SRS_SESSION_01_053: [On success, session_send_transfer shall return 0.] */
-                                        result = SESSION_SEND_TRANSFER_OK;
-                                    }
-                                }
-                                else
-                                {
-                                    size_t current_payload_index = 0;
-                                    uint32_t current_payload_pos = 0;
-
-                                    /* break it down into different deliveries */
-                                    while (payload_size > 0)
-                                    {
-                                        uint32_t transfer_frame_payload_count = 0;
-                                        uint32_t current_transfer_frame_payload_size = (uint32_t)payload_size;
-                                        uint32_t byte_counter;
-                                        size_t temp_current_payload_index = current_payload_index;
-                                        uint32_t temp_current_payload_pos = current_payload_pos;
-                                        AMQP_VALUE multi_transfer_amqp_value;
-                                        bool more;
-
-                                        if (current_transfer_frame_payload_size > available_frame_size)
-                                        {
-                                            current_transfer_frame_payload_size = available_frame_size;
-                                        }
-
-                                        if (available_frame_size >= payload_size)
-                                        {
-                                            more = false;
-                                        }
-                                        else
-                                        {
-                                            more = true;
-                                        }
-
-                                        if (transfer_set_more(transfer, more) != 0)
-                                        {
-                                            break;
-                                        }
-
-                                        multi_transfer_amqp_value = amqpvalue_create_transfer(transfer);
-                                        if (multi_transfer_amqp_value == NULL)
-                                        {
-                                            break;
-                                        }
-
-                                        byte_counter = current_transfer_frame_payload_size;
-                                        while (byte_counter > 0)
-                                        {
-                                            if (payloads[temp_current_payload_index].length - temp_current_payload_pos >= byte_counter)
-                                            {
-                                                /* more data than we need */
-                                                temp_current_payload_pos += byte_counter;
-                                                byte_counter = 0;
-                                            }
-                                            else
-                                            {
-                                                byte_counter -= (uint32_t)payloads[temp_current_payload_index].length - temp_current_payload_pos;
-                                                temp_current_payload_index++;
-                                                temp_current_payload_pos = 0;
-                                            }
-                                        }
-
-                                        transfer_frame_payload_count = (uint32_t)(temp_current_payload_index - current_payload_index + 1);
-                                        PAYLOAD* transfer_frame_payloads = (PAYLOAD*)malloc(transfer_frame_payload_count * sizeof(PAYLOAD));
-                                        if (transfer_frame_payloads == NULL)
-                                        {
-                                            amqpvalue_destroy(multi_transfer_amqp_value);
-                                            break;
-                                        }
-
-                                        /* copy data */
-                                        byte_counter = current_transfer_frame_payload_size;
-                                        transfer_frame_payload_count = 0;
-
-                                        while (byte_counter > 0)
-                                        {
-                                            if (payloads[current_payload_index].length - current_payload_pos > byte_counter)
-                                            {
-                                                /* more data than we need */
-                                                transfer_frame_payloads[transfer_frame_payload_count].bytes = payloads[current_payload_index].bytes + current_payload_pos;
-                                                transfer_frame_payloads[transfer_frame_payload_count].length = byte_counter;
-                                                current_payload_pos += byte_counter;
-                                                byte_counter = 0;
-                                            }
-                                            else
-                                            {
-                                                /* copy entire payload and move to the next */
-                                                transfer_frame_payloads[transfer_frame_payload_count].bytes = payloads[current_payload_index].bytes + current_payload_pos;
-                                                transfer_frame_payloads[transfer_frame_payload_count].length = payloads[current_payload_index].length - current_payload_pos;
-                                                byte_counter -= (uint32_t)payloads[current_payload_index].length - current_payload_pos;
-                                                current_payload_index++;
-                                                current_payload_pos = 0;
-                                            }
-
-                                            transfer_frame_payload_count++;
-                                        }
-
-                                        if (connection_encode_frame(session_instance->endpoint, multi_transfer_amqp_value, transfer_frame_payloads, transfer_frame_payload_count, on_send_complete, callback_context) != 0)
-                                        {
-                                            free(transfer_frame_payloads);
-                                            amqpvalue_destroy(multi_transfer_amqp_value);
-                                            break;
-                                        }
-
-                                        free(transfer_frame_payloads);
-                                        amqpvalue_destroy(multi_transfer_amqp_value);
-                                        payload_size -= current_transfer_frame_payload_size;
-                                    }
-
-                                    if (payload_size > 0)
-                                    {
-                                        result = SESSION_SEND_TRANSFER_ERROR;
-                                    }
-                                    else
-                                    {
-                                        /* Codes_SRS_SESSION_01_018: [is incremented after each successive transfer according to RFC-1982 [RFC1982] serial number arithmetic.] */
-                                        session_instance->next_outgoing_id++;
-                                        session_instance->remote_incoming_window--;
-                                        session_instance->outgoing_window--;
-
-                                        result = SESSION_SEND_TRANSFER_OK;
-                                    }
-                                }
-                            }
-
-                            amqpvalue_destroy(transfer_value);
-                        }
-                    }
-                }
-            }
+				/* Codes_SRS_SESSION_01_053: [On success, session_send_transfer shall return 0.] */
+				result = SESSION_SEND_TRANSFER_OK;
+			}
 		}
 	}
 
 	return result;
 }
+
+/* Codes_SRS_SESSION_01_051: [session_send_transfer shall send a transfer frame with the performative indicated in the transfer argument.] */
+SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	return send_transfer(link_endpoint, transfer, payloads, payload_count, true, false, delivery_id, on_send_complete, callback_context);
+}
+
+SESSION_SEND_TRANSFER_RESULT session_send_transfer_chunk(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, bool is_first_chunk, bool more, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	return send_transfer(link_endpoint, transfer, payloads, payload_count, is_first_chunk, more, delivery_id, on_send_complete, callback_context);
+}
@@ -1,9 +1,17 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+/* for accept4 */
+#define _GNU_SOURCE
+#endif
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -19,16 +27,205 @@ typedef struct SOCKET_LISTENER_INSTANCE_TAG
 	int socket;
 	ON_SOCKET_ACCEPTED on_socket_accepted;
 	void* callback_context;
+	int accepted_socket;
+	int backlog;
+	bool is_ipv6;
+	bool is_ipv6_only;
+	bool is_reuse_port;
+	/* 0 drains the accept queue on every dowork */
+	size_t max_accepts_per_dowork;
+	bool is_tcp_nodelay;
+	int send_buffer_size;
+	int receive_buffer_size;
+	/* held open while listening and given up to shed a connection when the process runs out of descriptors */
+	int reserve_fd;
 } SOCKET_LISTENER_INSTANCE;
 
+static int set_listening_socket_options(SOCKET_LISTENER_INSTANCE* socket_listener_instance)
+{
+	int result;
+	int ipv6_only = socket_listener_instance->is_ipv6_only ? 1 : 0;
+
+	if (socket_listener_instance->is_ipv6 &&
+		(setsockopt(socket_listener_instance->socket, IPPROTO_IPV6, IPV6_V6ONLY, &ipv6_only, sizeof(ipv6_only)) != 0))
+	{
+		LogError("Could not set IPV6_V6ONLY, errno = %d", errno);
+		result = __FAILURE__;
+	}
+	else if (socket_listener_instance->is_reuse_port)
+	{
+#ifdef SO_REUSEPORT
+		int enable = 1;
+
+		/* every listener bound to the port with SO_REUSEPORT gets its share of the incoming connections */
+		if (setsockopt(socket_listener_instance->socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0)
+		{
+			LogError("Could not set SO_REUSEPORT, errno = %d", errno);
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+#else
+		LogError("SO_REUSEPORT is not supported on this platform");
+		result = __FAILURE__;
+#endif
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+static int set_accepted_socket_options(SOCKET_LISTENER_INSTANCE* socket_listener_instance, int accepted_socket)
+{
+	int result;
+	int enable = 1;
+
+	if (socket_listener_instance->is_tcp_nodelay &&
+		(setsockopt(accepted_socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) != 0))
+	{
+		LogError("Could not set TCP_NODELAY, errno = %d", errno);
+		result = __FAILURE__;
+	}
+	else if ((socket_listener_instance->send_buffer_size > 0) &&
+		(setsockopt(accepted_socket, SOL_SOCKET, SO_SNDBUF, &socket_listener_instance->send_buffer_size, sizeof(socket_listener_instance->send_buffer_size)) != 0))
+	{
+		LogError("Could not set SO_SNDBUF, errno = %d", errno);
+		result = __FAILURE__;
+	}
+	else if ((socket_listener_instance->receive_buffer_size > 0) &&
+		(setsockopt(accepted_socket, SOL_SOCKET, SO_RCVBUF, &socket_listener_instance->receive_buffer_size, sizeof(socket_listener_instance->receive_buffer_size)) != 0))
+	{
+		LogError("Could not set SO_RCVBUF, errno = %d", errno);
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+static int accept_nonblocking(SOCKET_LISTENER_INSTANCE* socket_listener_instance)
+{
+	int result;
+
+#ifdef SOCK_NONBLOCK
+	result = accept4(socket_listener_instance->socket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+	result = accept(socket_listener_instance->socket, NULL, NULL);
+	if (result != -1)
+	{
+		int flags;
+		if ((-1 == (flags = fcntl(result, F_GETFL, 0))) ||
+			(fcntl(result, F_SETFL, flags | O_NONBLOCK) == -1))
+		{
+			LogError("Failure: fcntl failure on accepted socket.");
+			(void)close(result);
+			result = -1;
+			errno = ECONNABORTED;
+		}
+	}
+#endif
+
+	return result;
+}
+
+static int open_reserve_fd(void)
+{
+#ifdef O_CLOEXEC
+	return open("/dev/null", O_RDONLY | O_CLOEXEC);
+#else
+	return open("/dev/null", O_RDONLY);
+#endif
+}
+
+static int shed_pending_connection(SOCKET_LISTENER_INSTANCE* socket_listener_instance)
+{
+	int result;
+	int accepted_socket;
+
+	LogError("Out of file descriptors, closing an incoming connection");
+
+	/* frees one descriptor so that the pending connection can be accepted and closed */
+	(void)close(socket_listener_instance->reserve_fd);
+	accepted_socket = accept(socket_listener_instance->socket, NULL, NULL);
+	if (accepted_socket == -1)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		(void)close(accepted_socket);
+		result = 0;
+	}
+
+	socket_listener_instance->reserve_fd = open_reserve_fd();
+	if (socket_listener_instance->reserve_fd == -1)
+	{
+		LogError("Could not reopen the reserve descriptor, errno = %d", errno);
+	}
+
+	return result;
+}
+
+static void indicate_accepted_socket(SOCKET_LISTENER_INSTANCE* socket_listener_instance, int accepted_socket)
+{
+	if (socket_listener_instance->on_socket_accepted == NULL)
+	{
+		(void)close(accepted_socket);
+	}
+	else if (set_accepted_socket_options(socket_listener_instance, accepted_socket) != 0)
+	{
+		(void)close(accepted_socket);
+	}
+	else
+	{
+		SOCKETIO_CONFIG socketio_config;
+		XIO_HANDLE io;
+
+		socketio_config.hostname = NULL;
+		socketio_config.port = socket_listener_instance->port;
+		socketio_config.accepted_socket = &accepted_socket;
+		io = xio_create(socketio_get_interface_description(), &socketio_config);
+		if (io == NULL)
+		{
+			LogError("Failed creating socket IO");
+			(void)close(accepted_socket);
+		}
+		else
+		{
+			socket_listener_instance->accepted_socket = accepted_socket;
+			socket_listener_instance->on_socket_accepted(socket_listener_instance->callback_context, io);
+			socket_listener_instance->accepted_socket = -1;
+		}
+	}
+}
+
 SOCKET_LISTENER_HANDLE socketlistener_create(int port)
 {
 	SOCKET_LISTENER_INSTANCE* result = (SOCKET_LISTENER_INSTANCE*)malloc(sizeof(SOCKET_LISTENER_INSTANCE));
 	if (result != NULL)
 	{
 		result->port = port;
+		result->socket = -1;
 		result->on_socket_accepted = NULL;
 		result->callback_context = NULL;
+		result->accepted_socket = -1;
+		result->backlog = SOMAXCONN;
+		result->is_ipv6 = false;
+		result->is_ipv6_only = false;
+		result->is_reuse_port = false;
+		result->max_accepts_per_dowork = 0;
+		result->is_tcp_nodelay = false;
+		result->send_buffer_size = 0;
+		result->receive_buffer_size = 0;
+		result->reserve_fd = -1;
 	}
 
 	return (SOCKET_LISTENER_HANDLE)result;
@@ -56,7 +253,7 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
 	{
 		SOCKET_LISTENER_INSTANCE* socket_listener_instance = (SOCKET_LISTENER_INSTANCE*)socket_listener;
 
-		socket_listener_instance->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		socket_listener_instance->socket = socket(socket_listener_instance->is_ipv6 ? AF_INET6 : AF_INET, SOCK_STREAM, IPPROTO_TCP);
 		if (socket_listener_instance->socket == -1)
 		{
             LogError("Creating socket failed");
@@ -65,15 +262,33 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
 		else
 		{
             struct sockaddr_in sa;
+            struct sockaddr_in6 sa6;
+            const struct sockaddr* bind_address;
+            socklen_t bind_address_length;
+            int flags;
 
 			socket_listener_instance->on_socket_accepted = on_socket_accepted;
 			socket_listener_instance->callback_context = callback_context;
 
-            sa.sin_family = AF_INET;
-            sa.sin_port = htons(socket_listener_instance->port);
-            sa.sin_addr.s_addr = htonl(INADDR_ANY);
+            if (socket_listener_instance->is_ipv6)
+            {
+                (void)memset(&sa6, 0, sizeof(sa6));
+                sa6.sin6_family = AF_INET6;
+                sa6.sin6_port = htons(socket_listener_instance->port);
+                sa6.sin6_addr = in6addr_any;
+                bind_address = (const struct sockaddr*)&sa6;
+                bind_address_length = sizeof(sa6);
+            }
+            else
+            {
+                (void)memset(&sa, 0, sizeof(sa));
+                sa.sin_family = AF_INET;
+                sa.sin_port = htons(socket_listener_instance->port);
+                sa.sin_addr.s_addr = htonl(INADDR_ANY);
+                bind_address = (const struct sockaddr*)&sa;
+                bind_address_length = sizeof(sa);
+            }
 
-            int flags;
             if ((-1 == (flags = fcntl(socket_listener_instance->socket, F_GETFL, 0))) ||
                 (fcntl(socket_listener_instance->socket, F_SETFL, flags | O_NONBLOCK) == -1))
             {
@@ -82,7 +297,13 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
                 socket_listener_instance->socket = -1;
                 result = __FAILURE__;
             }
-            else if (bind(socket_listener_instance->socket, (const struct sockaddr*)&sa, sizeof(sa)) == -1)
+            else if (set_listening_socket_options(socket_listener_instance) != 0)
+            {
+                (void)close(socket_listener_instance->socket);
+                socket_listener_instance->socket = -1;
+                result = __FAILURE__;
+            }
+            else if (bind(socket_listener_instance->socket, bind_address, bind_address_length) == -1)
 			{
                 LogError("bind socket failed");
                 (void)close(socket_listener_instance->socket);
@@ -91,7 +312,7 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
 			}
 			else
 			{
-                if (listen(socket_listener_instance->socket, SOMAXCONN) == -1)
+                if (listen(socket_listener_instance->socket, socket_listener_instance->backlog) == -1)
 				{
                     LogError("listen on socket failed");
                     (void)close(socket_listener_instance->socket);
@@ -100,6 +321,12 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
 				}
 				else
 				{
+					socket_listener_instance->reserve_fd = open_reserve_fd();
+					if (socket_listener_instance->reserve_fd == -1)
+					{
+						LogError("Could not open the reserve descriptor, errno = %d, connections cannot be shed when out of descriptors", errno);
+					}
+
 					result = 0;
 				}
 			}
@@ -128,6 +355,12 @@ int socketlistener_stop(SOCKET_LISTENER_HANDLE socket_listener)
 		(void)close(socket_listener_instance->socket);
 		socket_listener_instance->socket = -1;
 
+		if (socket_listener_instance->reserve_fd != -1)
+		{
+			(void)close(socket_listener_instance->reserve_fd);
+			socket_listener_instance->reserve_fd = -1;
+		}
+
 		result = 0;
 	}
 
@@ -139,37 +372,161 @@ void socketlistener_dowork(SOCKET_LISTENER_HANDLE socket_listener)
 	if (socket_listener != NULL)
 	{
 		SOCKET_LISTENER_INSTANCE* socket_listener_instance = (SOCKET_LISTENER_INSTANCE*)socket_listener;
-		int accepted_socket = accept(socket_listener_instance->socket, NULL, NULL);
-		if (accepted_socket != -1)
+		size_t accept_count = 0;
+
+		/* the callback may stop the listener, which closes the listening socket */
+		while ((socket_listener_instance->socket != -1) &&
+			((socket_listener_instance->max_accepts_per_dowork == 0) || (accept_count < socket_listener_instance->max_accepts_per_dowork)))
 		{
-            int flags;
-            if ((-1 == (flags = fcntl(accepted_socket, F_GETFL, 0))) ||
-                (fcntl(accepted_socket, F_SETFL, flags | O_NONBLOCK) == -1))
-            {
-                LogError("Failure: fcntl failure on accepted socket.");
-                close(accepted_socket);
-            }
-            else if (socket_listener_instance->on_socket_accepted != NULL)
+			int accepted_socket = accept_nonblocking(socket_listener_instance);
+			if (accepted_socket != -1)
 			{
-				SOCKETIO_CONFIG socketio_config;
-                socketio_config.hostname = NULL;
-                socketio_config.port = socket_listener_instance->port;
-                socketio_config.accepted_socket = &accepted_socket;
-                XIO_HANDLE io = xio_create(socketio_get_interface_description(), &socketio_config);
-				if (io == NULL)
-				{
-                    LogError("Failed creating socket IO");
-                    (void)close(accepted_socket);
-				}
-				else
+				accept_count++;
+				indicate_accepted_socket(socket_listener_instance, accepted_socket);
+			}
+			else if (((errno == EMFILE) || (errno == ENFILE)) &&
+				(socket_listener_instance->reserve_fd != -1))
+			{
+				/* the listening socket stays readable while the connection is queued, so leaving it there would spin the event loop */
+				if (shed_pending_connection(socket_listener_instance) != 0)
 				{
-					socket_listener_instance->on_socket_accepted(socket_listener_instance->callback_context, io);
+					break;
 				}
+
+				accept_count++;
 			}
-			else
+			else if ((errno != ECONNABORTED) &&
+				(errno != EINTR))
 			{
-				(void)close(accepted_socket);
+				/* EAGAIN once the queue is drained */
+				if ((errno != EAGAIN) &&
+					(errno != EWOULDBLOCK))
+				{
+					LogError("accept failed, errno = %d", errno);
+				}
+
+				break;
 			}
 		}
 	}
 }
+
+int socketlistener_setoption(SOCKET_LISTENER_HANDLE socket_listener, const char* optionName, const void* value)
+{
+	int result;
+
+	if ((socket_listener == NULL) ||
+		(optionName == NULL) ||
+		(value == NULL))
+	{
+		LogError("Bad arguments: socket_listener = %p, optionName = %p, value = %p", socket_listener, optionName, value);
+		result = __FAILURE__;
+	}
+	else
+	{
+		SOCKET_LISTENER_INSTANCE* socket_listener_instance = (SOCKET_LISTENER_INSTANCE*)socket_listener;
+		result = 0;
+
+		if (strcmp(optionName, SOCKET_LISTENER_OPTION_TCP_NODELAY) == 0)
+		{
+			socket_listener_instance->is_tcp_nodelay = *(const bool*)value;
+		}
+		else if (strcmp(optionName, SOCKET_LISTENER_OPTION_SEND_BUFFER_SIZE) == 0)
+		{
+			socket_listener_instance->send_buffer_size = *(const int*)value;
+		}
+		else if (strcmp(optionName, SOCKET_LISTENER_OPTION_RECEIVE_BUFFER_SIZE) == 0)
+		{
+			socket_listener_instance->receive_buffer_size = *(const int*)value;
+		}
+		else if (strcmp(optionName, SOCKET_LISTENER_OPTION_MAX_ACCEPTS_PER_DOWORK) == 0)
+		{
+			socket_listener_instance->max_accepts_per_dowork = *(const size_t*)value;
+		}
+		else if (socket_listener_instance->socket != -1)
+		{
+			LogError("Option %s can only be set before the listener is started", optionName);
+			result = __FAILURE__;
+		}
+		else if (strcmp(optionName, SOCKET_LISTENER_OPTION_BACKLOG) == 0)
+		{
+			socket_listener_instance->backlog = *(const int*)value;
+		}
+		else if (strcmp(optionName, SOCKET_LISTENER_OPTION_IPV6) == 0)
+		{
+			socket_listener_instance->is_ipv6 = *(const bool*)value;
+		}
+		else if (strcmp(optionName, SOCKET_LISTENER_OPTION_IPV6_ONLY) == 0)
+		{
+			socket_listener_instance->is_ipv6_only = *(const bool*)value;
+		}
+		else if (strcmp(optionName, SOCKET_LISTENER_OPTION_REUSE_PORT) == 0)
+		{
+			socket_listener_instance->is_reuse_port = *(const bool*)value;
+		}
+		else
+		{
+			LogError("Unknown option %s", optionName);
+			result = __FAILURE__;
+		}
+	}
+
+	return result;
+}
+
+int socketlistener_get_socket(SOCKET_LISTENER_HANDLE socket_listener, int* listening_socket)
+{
+	int result;
+
+	if ((socket_listener == NULL) ||
+		(listening_socket == NULL))
+	{
+		LogError("Bad arguments: socket_listener = %p, listening_socket = %p", socket_listener, listening_socket);
+		result = __FAILURE__;
+	}
+	else
+	{
+		SOCKET_LISTENER_INSTANCE* socket_listener_instance = (SOCKET_LISTENER_INSTANCE*)socket_listener;
+		if (socket_listener_instance->socket == -1)
+		{
+			LogError("Socket listener is not started");
+			result = __FAILURE__;
+		}
+		else
+		{
+			*listening_socket = socket_listener_instance->socket;
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+/* Only valid from within the on_socket_accepted callback, so that the socket underneath the new IO can be watched for readiness */
+int socketlistener_get_accepted_socket(SOCKET_LISTENER_HANDLE socket_listener, int* accepted_socket)
+{
+	int result;
+
+	if ((socket_listener == NULL) ||
+		(accepted_socket == NULL))
+	{
+		LogError("Bad arguments: socket_listener = %p, accepted_socket = %p", socket_listener, accepted_socket);
+		result = __FAILURE__;
+	}
+	else
+	{
+		SOCKET_LISTENER_INSTANCE* socket_listener_instance = (SOCKET_LISTENER_INSTANCE*)socket_listener;
+		if (socket_listener_instance->accepted_socket == -1)
+		{
+			LogError("No socket is being accepted");
+			result = __FAILURE__;
+		}
+		else
+		{
+			*accepted_socket = socket_listener_instance->accepted_socket;
+			result = 0;
+		}
+	}
+
+	return result;
+}
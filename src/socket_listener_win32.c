@@ -167,3 +167,27 @@ void socketlistener_dowork(SOCKET_LISTENER_HANDLE socket_listener)
 		}
 	}
 }
+
+int socketlistener_setoption(SOCKET_LISTENER_HANDLE socket_listener, const char* optionName, const void* value)
+{
+	/* the listener options are only implemented for the berkeley sockets listener */
+	(void)socket_listener;
+	(void)optionName;
+	(void)value;
+	return __FAILURE__;
+}
+
+int socketlistener_get_socket(SOCKET_LISTENER_HANDLE socket_listener, int* listening_socket)
+{
+	/* a SOCKET does not fit in an int on 64 bit Windows, socket access is only provided for the readiness based runtimes */
+	(void)socket_listener;
+	(void)listening_socket;
+	return __FAILURE__;
+}
+
+int socketlistener_get_accepted_socket(SOCKET_LISTENER_HANDLE socket_listener, int* accepted_socket)
+{
+	(void)socket_listener;
+	(void)accepted_socket;
+	return __FAILURE__;
+}
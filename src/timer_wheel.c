@@ -0,0 +1,401 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/timer_wheel.h"
+
+/* 4 levels of 64 slots with a 1 ms tick cover a bit more than 4.6 hours, later deadlines are parked in the last level */
+#define TIMER_WHEEL_LEVEL_COUNT 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOT_COUNT (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOT_COUNT - 1)
+#define TIMER_WHEEL_RANGE ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVEL_COUNT))
+#define NO_EXPIRY ((uint64_t)-1)
+
+typedef struct TIMER_LIST_NODE_TAG
+{
+    struct TIMER_LIST_NODE_TAG* previous;
+    struct TIMER_LIST_NODE_TAG* next;
+} TIMER_LIST_NODE;
+
+typedef struct TIMER_WHEEL_TIMER_INSTANCE_TAG
+{
+    /* first, so that list nodes can be cast back to timers */
+    TIMER_LIST_NODE node;
+    struct TIMER_WHEEL_INSTANCE_TAG* timer_wheel;
+    uint64_t deadline;
+    ON_TIMER_EXPIRED on_timer_expired;
+    void* context;
+    bool is_scheduled;
+} TIMER_WHEEL_TIMER_INSTANCE;
+
+typedef struct TIMER_WHEEL_INSTANCE_TAG
+{
+    uint64_t current_tick;
+    size_t timer_count;
+    TIMER_LIST_NODE slots[TIMER_WHEEL_LEVEL_COUNT][TIMER_WHEEL_SLOT_COUNT];
+} TIMER_WHEEL_INSTANCE;
+
+static void list_init(TIMER_LIST_NODE* head)
+{
+    head->previous = head;
+    head->next = head;
+}
+
+static bool list_is_empty(const TIMER_LIST_NODE* head)
+{
+    return head->next == head;
+}
+
+static void list_append(TIMER_LIST_NODE* head, TIMER_LIST_NODE* node)
+{
+    node->previous = head->previous;
+    node->next = head;
+    head->previous->next = node;
+    head->previous = node;
+}
+
+static void list_remove(TIMER_LIST_NODE* node)
+{
+    node->previous->next = node->next;
+    node->next->previous = node->previous;
+    node->previous = node;
+    node->next = node;
+}
+
+/* moves all the nodes of a slot to an empty list */
+static void list_take_all(TIMER_LIST_NODE* head, TIMER_LIST_NODE* target)
+{
+    if (list_is_empty(head))
+    {
+        list_init(target);
+    }
+    else
+    {
+        target->next = head->next;
+        target->previous = head->previous;
+        target->next->previous = target;
+        target->previous->next = target;
+        list_init(head);
+    }
+}
+
+/* earliest_tick is the next tick to be processed: the one after current_tick, or current_tick itself while it is being cascaded */
+static void insert_timer(TIMER_WHEEL_INSTANCE* timer_wheel_instance, TIMER_WHEEL_TIMER_INSTANCE* timer_instance, uint64_t earliest_tick)
+{
+    uint64_t slot_tick = timer_instance->deadline;
+    uint64_t delta;
+    size_t level;
+
+    if (slot_tick < earliest_tick)
+    {
+        slot_tick = earliest_tick;
+    }
+
+    delta = slot_tick - timer_wheel_instance->current_tick;
+    if (delta >= TIMER_WHEEL_RANGE)
+    {
+        slot_tick = timer_wheel_instance->current_tick + TIMER_WHEEL_RANGE - 1;
+        delta = TIMER_WHEEL_RANGE - 1;
+    }
+
+    level = 0;
+    while ((level < TIMER_WHEEL_LEVEL_COUNT - 1) &&
+        (delta >= ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * (level + 1)))))
+    {
+        level++;
+    }
+
+    list_append(&timer_wheel_instance->slots[level][(slot_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK], &timer_instance->node);
+}
+
+static void cascade(TIMER_WHEEL_INSTANCE* timer_wheel_instance, size_t level)
+{
+    TIMER_LIST_NODE timers;
+    size_t slot = (size_t)((timer_wheel_instance->current_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK);
+
+    list_take_all(&timer_wheel_instance->slots[level][slot], &timers);
+    while (!list_is_empty(&timers))
+    {
+        TIMER_WHEEL_TIMER_INSTANCE* timer_instance = (TIMER_WHEEL_TIMER_INSTANCE*)timers.next;
+        list_remove(&timer_instance->node);
+        insert_timer(timer_wheel_instance, timer_instance, timer_wheel_instance->current_tick);
+    }
+}
+
+static void advance_one_tick(TIMER_WHEEL_INSTANCE* timer_wheel_instance)
+{
+    TIMER_LIST_NODE expired_timers;
+
+    timer_wheel_instance->current_tick++;
+
+    if ((timer_wheel_instance->current_tick & TIMER_WHEEL_SLOT_MASK) == 0)
+    {
+        size_t level;
+
+        /* the next level only wraps when this one did */
+        for (level = 1; level < TIMER_WHEEL_LEVEL_COUNT; level++)
+        {
+            cascade(timer_wheel_instance, level);
+            if (((timer_wheel_instance->current_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK) != 0)
+            {
+                break;
+            }
+        }
+    }
+
+    list_take_all(&timer_wheel_instance->slots[0][timer_wheel_instance->current_tick & TIMER_WHEEL_SLOT_MASK], &expired_timers);
+    while (!list_is_empty(&expired_timers))
+    {
+        TIMER_WHEEL_TIMER_INSTANCE* timer_instance = (TIMER_WHEEL_TIMER_INSTANCE*)expired_timers.next;
+
+        /* the callback may reschedule or destroy this timer, or cancel the ones still in the list */
+        list_remove(&timer_instance->node);
+        timer_instance->is_scheduled = false;
+        timer_wheel_instance->timer_count--;
+
+        timer_instance->on_timer_expired(timer_instance->context);
+    }
+}
+
+/* The tick at which the next timer fires or a slot has to be cascaded, whichever comes first */
+static uint64_t get_next_event_tick(TIMER_WHEEL_INSTANCE* timer_wheel_instance)
+{
+    uint64_t result = NO_EXPIRY;
+
+    if (timer_wheel_instance->timer_count > 0)
+    {
+        size_t level;
+
+        for (level = 0; level < TIMER_WHEEL_LEVEL_COUNT; level++)
+        {
+            size_t shift = TIMER_WHEEL_SLOT_BITS * level;
+            uint64_t base = timer_wheel_instance->current_tick >> shift;
+            uint64_t i;
+
+            for (i = 1; i <= TIMER_WHEEL_SLOT_COUNT; i++)
+            {
+                if (!list_is_empty(&timer_wheel_instance->slots[level][(base + i) & TIMER_WHEEL_SLOT_MASK]))
+                {
+                    uint64_t event_tick = (base + i) << shift;
+                    if (event_tick < result)
+                    {
+                        result = event_tick;
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+TIMER_WHEEL_HANDLE timer_wheel_create(uint64_t current_ms)
+{
+    TIMER_WHEEL_INSTANCE* result = (TIMER_WHEEL_INSTANCE*)malloc(sizeof(TIMER_WHEEL_INSTANCE));
+    if (result == NULL)
+    {
+        LogError("Could not allocate timer wheel");
+    }
+    else
+    {
+        size_t level;
+        size_t slot;
+
+        result->current_tick = current_ms;
+        result->timer_count = 0;
+
+        for (level = 0; level < TIMER_WHEEL_LEVEL_COUNT; level++)
+        {
+            for (slot = 0; slot < TIMER_WHEEL_SLOT_COUNT; slot++)
+            {
+                list_init(&result->slots[level][slot]);
+            }
+        }
+    }
+
+    return result;
+}
+
+/* Timers still scheduled are only unlinked, they belong to whoever created them */
+void timer_wheel_destroy(TIMER_WHEEL_HANDLE timer_wheel)
+{
+    if (timer_wheel != NULL)
+    {
+        size_t level;
+        size_t slot;
+
+        for (level = 0; level < TIMER_WHEEL_LEVEL_COUNT; level++)
+        {
+            for (slot = 0; slot < TIMER_WHEEL_SLOT_COUNT; slot++)
+            {
+                while (!list_is_empty(&timer_wheel->slots[level][slot]))
+                {
+                    TIMER_WHEEL_TIMER_INSTANCE* timer_instance = (TIMER_WHEEL_TIMER_INSTANCE*)timer_wheel->slots[level][slot].next;
+                    list_remove(&timer_instance->node);
+                    timer_instance->is_scheduled = false;
+                    timer_instance->timer_wheel = NULL;
+                }
+            }
+        }
+
+        free(timer_wheel);
+    }
+}
+
+TIMER_WHEEL_TIMER_HANDLE timer_wheel_create_timer(TIMER_WHEEL_HANDLE timer_wheel, ON_TIMER_EXPIRED on_timer_expired, void* context)
+{
+    TIMER_WHEEL_TIMER_INSTANCE* result;
+
+    if ((timer_wheel == NULL) ||
+        (on_timer_expired == NULL))
+    {
+        LogError("Bad arguments: timer_wheel = %p, on_timer_expired = %p", timer_wheel, on_timer_expired);
+        result = NULL;
+    }
+    else
+    {
+        result = (TIMER_WHEEL_TIMER_INSTANCE*)malloc(sizeof(TIMER_WHEEL_TIMER_INSTANCE));
+        if (result == NULL)
+        {
+            LogError("Could not allocate timer");
+        }
+        else
+        {
+            list_init(&result->node);
+            result->timer_wheel = timer_wheel;
+            result->deadline = NO_EXPIRY;
+            result->on_timer_expired = on_timer_expired;
+            result->context = context;
+            result->is_scheduled = false;
+        }
+    }
+
+    return result;
+}
+
+/* Can be called from any expiry callback, including the timer's own */
+void timer_wheel_destroy_timer(TIMER_WHEEL_TIMER_HANDLE timer)
+{
+    if (timer != NULL)
+    {
+        (void)timer_wheel_cancel(timer);
+        free(timer);
+    }
+}
+
+/* Rescheduling a scheduled timer moves it, in constant time */
+int timer_wheel_schedule(TIMER_WHEEL_TIMER_HANDLE timer, uint64_t deadline_ms)
+{
+    int result;
+
+    if ((timer == NULL) ||
+        (timer->timer_wheel == NULL))
+    {
+        LogError("Bad arguments: timer = %p", timer);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (timer->is_scheduled)
+        {
+            list_remove(&timer->node);
+        }
+        else
+        {
+            timer->is_scheduled = true;
+            timer->timer_wheel->timer_count++;
+        }
+
+        timer->deadline = deadline_ms;
+        insert_timer(timer->timer_wheel, timer, timer->timer_wheel->current_tick + 1);
+        result = 0;
+    }
+
+    return result;
+}
+
+int timer_wheel_cancel(TIMER_WHEEL_TIMER_HANDLE timer)
+{
+    int result;
+
+    if (timer == NULL)
+    {
+        LogError("NULL timer");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (timer->is_scheduled)
+        {
+            list_remove(&timer->node);
+            timer->is_scheduled = false;
+            timer->timer_wheel->timer_count--;
+        }
+
+        result = 0;
+    }
+
+    return result;
+}
+
+/* The value can be earlier than the earliest deadline when a coarse slot has to be split first; it is UINT64_MAX when nothing is scheduled */
+int timer_wheel_get_next_expiry(TIMER_WHEEL_HANDLE timer_wheel, uint64_t* next_expiry_ms)
+{
+    int result;
+
+    if ((timer_wheel == NULL) ||
+        (next_expiry_ms == NULL))
+    {
+        LogError("Bad arguments: timer_wheel = %p, next_expiry_ms = %p", timer_wheel, next_expiry_ms);
+        result = __FAILURE__;
+    }
+    else
+    {
+        *next_expiry_ms = get_next_event_tick(timer_wheel);
+        result = 0;
+    }
+
+    return result;
+}
+
+/* Fires every timer due by current_ms; the cost depends on the expirations and slots visited, not on the number of timers */
+int timer_wheel_advance(TIMER_WHEEL_HANDLE timer_wheel, uint64_t current_ms)
+{
+    int result;
+
+    if (timer_wheel == NULL)
+    {
+        LogError("NULL timer_wheel");
+        result = __FAILURE__;
+    }
+    else
+    {
+        while (timer_wheel->current_tick < current_ms)
+        {
+            uint64_t next_event_tick = get_next_event_tick(timer_wheel);
+
+            if (next_event_tick > current_ms)
+            {
+                /* nothing happens in between, skip the idle ticks */
+                timer_wheel->current_tick = current_ms;
+            }
+            else
+            {
+                timer_wheel->current_tick = next_event_tick - 1;
+                advance_one_tick(timer_wheel);
+            }
+        }
+
+        result = 0;
+    }
+
+    return result;
+}
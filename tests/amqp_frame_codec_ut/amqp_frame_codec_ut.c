@@ -1173,6 +1173,123 @@ TEST_FUNCTION(when_frame_codec_encode_frame_fails_then_amqp_frame_codec_encode_e
     amqp_frame_codec_destroy(amqp_frame_codec);
 }
 
+/* amqp_frame_codec_encode_preencoded_frame */
+
+TEST_FUNCTION(amqp_frame_codec_encode_preencoded_frame_passes_the_payloads_to_frame_codec_encode_frame_without_encoding_a_performative)
+{
+    // arrange
+    AMQP_FRAME_CODEC_HANDLE amqp_frame_codec = amqp_frame_codec_create(TEST_FRAME_CODEC_HANDLE, amqp_frame_received_callback_1, amqp_empty_frame_received_callback_1, test_amqp_frame_codec_error, TEST_CONTEXT);
+    int result;
+    unsigned char channel_bytes[] = { 0x01, 0x02 };
+    PAYLOAD payloads[2];
+    payloads[0].bytes = test_performative;
+    payloads[0].length = sizeof(test_performative);
+    payloads[1] = test_user_payload;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(frame_codec_encode_frame(TEST_FRAME_CODEC_HANDLE, FRAME_TYPE_AMQP, IGNORED_PTR_ARG, 2, channel_bytes, sizeof(channel_bytes), test_on_bytes_encoded, (void*)0x4242))
+        .ValidateArgumentBuffer(5, &channel_bytes, sizeof(channel_bytes));
+
+    // act
+    result = amqp_frame_codec_encode_preencoded_frame(amqp_frame_codec, 0x0102, payloads, 2, test_on_bytes_encoded, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, actual_payload_count);
+    ASSERT_ARE_EQUAL(size_t, sizeof(test_performative), actual_payloads[0].length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(test_performative, actual_payloads[0].bytes, actual_payloads[0].length));
+    ASSERT_ARE_EQUAL(size_t, test_user_payload.length, actual_payloads[1].length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(test_user_payload.bytes, actual_payloads[1].bytes, actual_payloads[1].length));
+
+    // cleanup
+    amqp_frame_codec_destroy(amqp_frame_codec);
+}
+
+TEST_FUNCTION(amqp_frame_codec_encode_preencoded_frame_with_NULL_amqp_frame_codec_fails)
+{
+    // arrange
+    int result;
+    PAYLOAD payload;
+    payload.bytes = test_performative;
+    payload.length = sizeof(test_performative);
+
+    // act
+    result = amqp_frame_codec_encode_preencoded_frame(NULL, 0, &payload, 1, test_on_bytes_encoded, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(amqp_frame_codec_encode_preencoded_frame_without_payloads_fails)
+{
+    // arrange
+    AMQP_FRAME_CODEC_HANDLE amqp_frame_codec = amqp_frame_codec_create(TEST_FRAME_CODEC_HANDLE, amqp_frame_received_callback_1, amqp_empty_frame_received_callback_1, test_amqp_frame_codec_error, TEST_CONTEXT);
+    int result;
+    PAYLOAD payload;
+    payload.bytes = test_performative;
+    payload.length = sizeof(test_performative);
+    umock_c_reset_all_calls();
+
+    // act
+    result = amqp_frame_codec_encode_preencoded_frame(amqp_frame_codec, 0, &payload, 0, test_on_bytes_encoded, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    amqp_frame_codec_destroy(amqp_frame_codec);
+}
+
+TEST_FUNCTION(amqp_frame_codec_encode_preencoded_frame_with_an_empty_performative_payload_fails)
+{
+    // arrange
+    AMQP_FRAME_CODEC_HANDLE amqp_frame_codec = amqp_frame_codec_create(TEST_FRAME_CODEC_HANDLE, amqp_frame_received_callback_1, amqp_empty_frame_received_callback_1, test_amqp_frame_codec_error, TEST_CONTEXT);
+    int result;
+    PAYLOAD payload;
+    payload.bytes = test_performative;
+    payload.length = 0;
+    umock_c_reset_all_calls();
+
+    // act
+    result = amqp_frame_codec_encode_preencoded_frame(amqp_frame_codec, 0, &payload, 1, test_on_bytes_encoded, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    amqp_frame_codec_destroy(amqp_frame_codec);
+}
+
+TEST_FUNCTION(when_frame_codec_encode_frame_fails_then_amqp_frame_codec_encode_preencoded_frame_fails)
+{
+    // arrange
+    AMQP_FRAME_CODEC_HANDLE amqp_frame_codec = amqp_frame_codec_create(TEST_FRAME_CODEC_HANDLE, amqp_frame_received_callback_1, amqp_empty_frame_received_callback_1, test_amqp_frame_codec_error, TEST_CONTEXT);
+    int result;
+    unsigned char channel_bytes[] = { 0, 0 };
+    PAYLOAD payload;
+    payload.bytes = test_performative;
+    payload.length = sizeof(test_performative);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(frame_codec_encode_frame(TEST_FRAME_CODEC_HANDLE, FRAME_TYPE_AMQP, IGNORED_PTR_ARG, 1, channel_bytes, sizeof(channel_bytes), test_on_bytes_encoded, (void*)0x4242))
+        .ValidateArgumentBuffer(5, &channel_bytes, sizeof(channel_bytes))
+        .SetReturn(1);
+
+    // act
+    result = amqp_frame_codec_encode_preencoded_frame(amqp_frame_codec, 0, &payload, 1, test_on_bytes_encoded, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    amqp_frame_codec_destroy(amqp_frame_codec);
+}
+
 /* Receive frames */
 
 /* Tests_SRS_AMQP_FRAME_CODEC_01_048: [When a frame header is received from frame_codec and the frame payload size is 0, empty_frame_received_callback shall be invoked, while passing the channel number as argument.] */
@@ -14478,4 +14478,512 @@ TEST_FUNCTION(amqpvalue_decode_list_0xD0_256_null_items_not_enough_bytes_does_no
     amqpvalue_decoder_destroy(amqpvalue_decoder);
 }
 
+/* amqpvalue_decoder_reset */
+
+TEST_FUNCTION(amqpvalue_decoder_reset_with_NULL_handle_fails)
+{
+    // arrange
+
+    // act
+    int result = amqpvalue_decoder_reset(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(amqpvalue_decoder_reset_between_values_does_not_allocate)
+{
+    // arrange
+    AMQPVALUE_DECODER_HANDLE amqpvalue_decoder = amqpvalue_decoder_create(value_decoded_callback, test_context);
+    unsigned char bytes[] = { 0x40 };
+    (void)amqpvalue_decode_bytes(amqpvalue_decoder, bytes, sizeof(bytes));
+    umock_c_reset_all_calls();
+
+    // act
+    int result = amqpvalue_decoder_reset(amqpvalue_decoder);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    amqpvalue_decoder_destroy(amqpvalue_decoder);
+}
+
+TEST_FUNCTION(values_decoded_after_amqpvalue_decoder_reset_between_values_are_decoded)
+{
+    // arrange
+    AMQPVALUE_DECODER_HANDLE amqpvalue_decoder = amqpvalue_decoder_create(value_decoded_callback, test_context);
+    unsigned char first_bytes[] = { 0x40 };
+    unsigned char second_bytes[] = { 0x41 };
+    (void)amqpvalue_decode_bytes(amqpvalue_decoder, first_bytes, sizeof(first_bytes));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(value_decoded_callback(test_context, IGNORED_PTR_ARG));
+
+    // act
+    int reset_result = amqpvalue_decoder_reset(amqpvalue_decoder);
+    int result = amqpvalue_decode_bytes(amqpvalue_decoder, second_bytes, sizeof(second_bytes));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, reset_result);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, decoded_value_count);
+    ASSERT_ARE_EQUAL(int, (int)AMQP_TYPE_NULL, (int)amqpvalue_get_type(decoded_values[0]));
+    ASSERT_ARE_EQUAL(int, (int)AMQP_TYPE_BOOL, (int)amqpvalue_get_type(decoded_values[1]));
+
+    // cleanup
+    amqpvalue_decoder_destroy(amqpvalue_decoder);
+}
+
+TEST_FUNCTION(amqpvalue_decoder_reset_in_the_middle_of_a_value_drops_the_bytes_decoded_so_far)
+{
+    // arrange
+    AMQPVALUE_DECODER_HANDLE amqpvalue_decoder = amqpvalue_decoder_create(value_decoded_callback, test_context);
+    unsigned char truncated_bytes[] = { 0xA0, 0x03, 'a' };
+    unsigned char bytes[] = { 0x52, 0x2A };
+    uint32_t actual_value = 0;
+    (void)amqpvalue_decode_bytes(amqpvalue_decoder, truncated_bytes, sizeof(truncated_bytes));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(value_decoded_callback(test_context, IGNORED_PTR_ARG));
+
+    // act
+    int reset_result = amqpvalue_decoder_reset(amqpvalue_decoder);
+    int result = amqpvalue_decode_bytes(amqpvalue_decoder, bytes, sizeof(bytes));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, reset_result);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, decoded_value_count);
+    ASSERT_ARE_EQUAL(int, (int)AMQP_TYPE_UINT, (int)amqpvalue_get_type(decoded_values[0]));
+    (void)amqpvalue_get_uint(decoded_values[0], &actual_value);
+    ASSERT_ARE_EQUAL(uint32_t, 42, actual_value);
+
+    // cleanup
+    amqpvalue_decoder_destroy(amqpvalue_decoder);
+}
+
+TEST_FUNCTION(amqpvalue_decoder_reset_in_the_middle_of_a_described_value_drops_the_descriptor_decoded_so_far)
+{
+    // arrange
+    AMQPVALUE_DECODER_HANDLE amqpvalue_decoder = amqpvalue_decoder_create(value_decoded_callback, test_context);
+    unsigned char truncated_bytes[] = { 0x00, 0x53, 0x70 };
+    unsigned char bytes[] = { 0x00, 0x53, 0x75, 0xA0, 0x01, 'x' };
+    uint64_t actual_descriptor = 0;
+    (void)amqpvalue_decode_bytes(amqpvalue_decoder, truncated_bytes, sizeof(truncated_bytes));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(value_decoded_callback(test_context, IGNORED_PTR_ARG));
+
+    // act
+    int reset_result = amqpvalue_decoder_reset(amqpvalue_decoder);
+    int result = amqpvalue_decode_bytes(amqpvalue_decoder, bytes, sizeof(bytes));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, reset_result);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, decoded_value_count);
+    ASSERT_ARE_EQUAL(int, (int)AMQP_TYPE_DESCRIBED, (int)amqpvalue_get_type(decoded_values[0]));
+    (void)amqpvalue_get_ulong(amqpvalue_get_inplace_descriptor(decoded_values[0]), &actual_descriptor);
+    ASSERT_ARE_EQUAL(uint64_t, 0x75, actual_descriptor);
+
+    // cleanup
+    amqpvalue_decoder_destroy(amqpvalue_decoder);
+}
+
+TEST_FUNCTION(amqpvalue_decoder_reset_after_a_bad_constructor_lets_the_decoder_decode_again)
+{
+    // arrange
+    AMQPVALUE_DECODER_HANDLE amqpvalue_decoder = amqpvalue_decoder_create(value_decoded_callback, test_context);
+    unsigned char bad_bytes[] = { 0x01 };
+    unsigned char bytes[] = { 0x40 };
+    int bad_constructor_result = amqpvalue_decode_bytes(amqpvalue_decoder, bad_bytes, sizeof(bad_bytes));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreAllCalls();
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+    STRICT_EXPECTED_CALL(value_decoded_callback(test_context, IGNORED_PTR_ARG));
+
+    // act
+    int reset_result = amqpvalue_decoder_reset(amqpvalue_decoder);
+    int result = amqpvalue_decode_bytes(amqpvalue_decoder, bytes, sizeof(bytes));
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, bad_constructor_result);
+    ASSERT_ARE_EQUAL(int, 0, reset_result);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, (int)AMQP_TYPE_NULL, (int)amqpvalue_get_type(decoded_values[0]));
+
+    // cleanup
+    amqpvalue_decoder_destroy(amqpvalue_decoder);
+}
+
+TEST_FUNCTION(when_allocating_the_new_decode_value_fails_amqpvalue_decoder_reset_fails)
+{
+    // arrange
+    AMQPVALUE_DECODER_HANDLE amqpvalue_decoder = amqpvalue_decoder_create(value_decoded_callback, test_context);
+    unsigned char truncated_bytes[] = { 0xA0, 0x03, 'a' };
+    (void)amqpvalue_decode_bytes(amqpvalue_decoder, truncated_bytes, sizeof(truncated_bytes));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = amqpvalue_decoder_reset(amqpvalue_decoder);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    amqpvalue_decoder_destroy(amqpvalue_decoder);
+}
+
+/* amqpvalue_get_encoded_value_length */
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_with_NULL_bytes_fails)
+{
+    // arrange
+    size_t value_length;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(NULL, 1, &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_with_NULL_value_length_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0x40 };
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_with_0_length_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0x40 };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, 0, &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_null_value_is_1)
+{
+    // arrange
+    unsigned char bytes[] = { 0x40 };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_only_counts_the_first_value)
+{
+    // arrange
+    unsigned char bytes[] = { 0x40, 0x41 };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_smalluint_is_2)
+{
+    // arrange
+    unsigned char bytes[] = { 0x52, 0x2A };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_uint_is_5)
+{
+    // arrange
+    unsigned char bytes[] = { 0x70, 0x01, 0x02, 0x03, 0x04 };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 5, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_ulong_is_9)
+{
+    // arrange
+    unsigned char bytes[] = { 0x80, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 9, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_uuid_is_17)
+{
+    // arrange
+    unsigned char bytes[] = { 0x98, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 17, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_str8_includes_the_size_byte)
+{
+    // arrange
+    unsigned char bytes[] = { 0xA1, 0x03, 'a', 'b', 'c' };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 5, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_vbin32_includes_the_4_size_bytes)
+{
+    // arrange
+    unsigned char bytes[] = { 0xB0, 0x00, 0x00, 0x00, 0x02, 'x', 'y' };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 7, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_list8_skips_its_items_by_size)
+{
+    // arrange
+    unsigned char bytes[] = { 0xC0, 0x03, 0x02, 0x40, 0x41 };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 5, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_an_array8_skips_its_items_by_size)
+{
+    // arrange
+    unsigned char bytes[] = { 0xE0, 0x02, 0x02, 0x41 };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 4, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_described_value_includes_the_descriptor_and_the_value)
+{
+    // arrange
+    unsigned char bytes[] = { 0x00, 0x53, 0x75, 0xA0, 0x01, 'x' };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 6, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_value_with_a_described_descriptor_includes_all_descriptors)
+{
+    // arrange
+    unsigned char bytes[] = { 0x00, 0x00, 0x53, 0x01, 0x40, 0x41 };
+    size_t value_length = 0;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 6, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_truncated_fixed_width_value_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0x70, 0x01, 0x02 };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_value_with_truncated_size_bytes_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0xB0, 0x00, 0x00 };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_value_with_less_bytes_than_its_size_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0xA0, 0x05, 'a' };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_of_a_described_value_without_its_value_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0x00, 0x53, 0x75 };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_with_a_bad_constructor_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0x01 };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_with_a_reserved_constructor_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0x30, 0x00 };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
+TEST_FUNCTION(amqpvalue_get_encoded_value_length_with_a_bad_constructor_after_a_descriptor_constructor_fails)
+{
+    // arrange
+    unsigned char bytes[] = { 0x00, 0x21 };
+    size_t value_length = 42;
+
+    // act
+    int result = amqpvalue_get_encoded_value_length(bytes, sizeof(bytes), &value_length);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 42, value_length);
+}
+
 END_TEST_SUITE(amqpvalue_ut)
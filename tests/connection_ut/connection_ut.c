@@ -69,6 +69,13 @@ static void my_gballoc_free(void* ptr)
 #define TEST_CLOSE_PERFORMATIVE				(AMQP_VALUE)0x4302
 #define TEST_CLOSE_DESCRIPTOR_AMQP_VALUE	(AMQP_VALUE)0x4303
 #define TEST_TRANSFER_PERFORMATIVE			(AMQP_VALUE)0x4304
+#define TEST_FLOW_PERFORMATIVE				(AMQP_VALUE)0x4306
+#define TEST_DISPOSITION_PERFORMATIVE		(AMQP_VALUE)0x4307
+#define TEST_BEGIN_PERFORMATIVE				(AMQP_VALUE)0x4308
+#define TEST_OPEN_DESCRIPTOR_AMQP_VALUE			(AMQP_VALUE)0x4309
+#define TEST_FLOW_DESCRIPTOR_AMQP_VALUE			(AMQP_VALUE)0x430A
+#define TEST_DISPOSITION_DESCRIPTOR_AMQP_VALUE	(AMQP_VALUE)0x430B
+#define TEST_OPEN_HANDLE					(OPEN_HANDLE)0x430C
 
 #define TEST_CONTEXT					(void*)(0x4242)
 
@@ -207,6 +214,254 @@ static void test_on_send_complete(void* context, IO_SEND_RESULT io_send_result)
     (void)io_send_result;
 }
 
+/* endpoint dowork */
+static uint64_t test_current_ms;
+static size_t test_endpoint_dowork_counts[3];
+static uint64_t test_endpoint_dowork_current_ms;
+static uint64_t test_time_to_endpoint_dowork;
+static size_t test_destroying_endpoint_index;
+static ENDPOINT_HANDLE test_endpoint_to_destroy;
+static CONNECTION_HANDLE test_connection_to_request_dowork;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = (tickcounter_ms_t)test_current_ms;
+    return 0;
+}
+
+/* the context is the index of the endpoint in test_endpoint_dowork_counts */
+static uint64_t test_on_endpoint_dowork(void* context, uint64_t current_ms)
+{
+    size_t endpoint_index = (size_t)context;
+
+    test_endpoint_dowork_counts[endpoint_index]++;
+    test_endpoint_dowork_current_ms = current_ms;
+
+    if ((test_endpoint_to_destroy != NULL) &&
+        (endpoint_index == test_destroying_endpoint_index))
+    {
+        ENDPOINT_HANDLE endpoint = test_endpoint_to_destroy;
+        test_endpoint_to_destroy = NULL;
+        connection_destroy_endpoint(endpoint);
+    }
+
+    if (test_connection_to_request_dowork != NULL)
+    {
+        (void)connection_request_dowork(test_connection_to_request_dowork);
+    }
+
+    return test_time_to_endpoint_dowork;
+}
+
+static ENDPOINT_HANDLE create_endpoint_with_dowork(CONNECTION_HANDLE connection, size_t endpoint_index)
+{
+    ENDPOINT_HANDLE endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, (void*)endpoint_index);
+    (void)connection_endpoint_set_on_dowork(endpoint, test_on_endpoint_dowork);
+    return endpoint;
+}
+
+/* output buffering and send watermarks */
+#define TEST_MAX_RECORDED_CALLS 16
+
+static size_t test_encoded_frame_size;
+static unsigned char test_next_frame_tag;
+static int test_xio_send_result;
+static unsigned char test_sent_bytes[1024];
+static size_t test_sent_byte_count;
+static size_t test_xio_send_count;
+static size_t test_xio_send_sizes[TEST_MAX_RECORDED_CALLS];
+static ON_SEND_COMPLETE test_xio_send_callbacks[TEST_MAX_RECORDED_CALLS];
+static void* test_xio_send_contexts[TEST_MAX_RECORDED_CALLS];
+static size_t test_completed_xio_send_count;
+static void* test_completed_frame_contexts[TEST_MAX_RECORDED_CALLS];
+static IO_SEND_RESULT test_completed_frame_results[TEST_MAX_RECORDED_CALLS];
+static size_t test_completed_frame_count;
+static bool test_send_blocked_notifications[TEST_MAX_RECORDED_CALLS];
+static size_t test_send_blocked_notification_count;
+static size_t test_endpoint_send_blocked_counts[3];
+
+static AMQP_VALUE my_amqpvalue_get_inplace_descriptor(AMQP_VALUE value)
+{
+    AMQP_VALUE result;
+
+    if (value == TEST_OPEN_PERFORMATIVE)
+    {
+        result = TEST_OPEN_DESCRIPTOR_AMQP_VALUE;
+    }
+    else if (value == TEST_FLOW_PERFORMATIVE)
+    {
+        result = TEST_FLOW_DESCRIPTOR_AMQP_VALUE;
+    }
+    else if (value == TEST_DISPOSITION_PERFORMATIVE)
+    {
+        result = TEST_DISPOSITION_DESCRIPTOR_AMQP_VALUE;
+    }
+    else
+    {
+        result = TEST_DESCRIPTOR_AMQP_VALUE;
+    }
+
+    return result;
+}
+
+static bool my_is_open_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return (descriptor == TEST_OPEN_DESCRIPTOR_AMQP_VALUE);
+}
+
+static bool my_is_flow_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return (descriptor == TEST_FLOW_DESCRIPTOR_AMQP_VALUE);
+}
+
+static bool my_is_disposition_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return (descriptor == TEST_DISPOSITION_DESCRIPTOR_AMQP_VALUE);
+}
+
+static int my_amqpvalue_get_open(AMQP_VALUE value, OPEN_HANDLE* open_handle)
+{
+    (void)value;
+    *open_handle = TEST_OPEN_HANDLE;
+    return 0;
+}
+
+static int my_open_get_max_frame_size(OPEN_HANDLE open, uint32_t* max_frame_size_value)
+{
+    (void)open;
+    *max_frame_size_value = 65536;
+    return 0;
+}
+
+/* every frame but the open frame is encoded as test_encoded_frame_size bytes carrying a tag that tells the frames apart on the wire */
+static int my_amqp_frame_codec_encode_frame(AMQP_FRAME_CODEC_HANDLE amqp_frame_codec, uint16_t channel, const AMQP_VALUE performative, const PAYLOAD* payloads, size_t payload_count, ON_BYTES_ENCODED on_bytes_encoded, void* callback_context)
+{
+    (void)amqp_frame_codec;
+    (void)channel;
+    (void)payloads;
+    (void)payload_count;
+
+    if ((performative != TEST_OPEN_PERFORMATIVE) &&
+        (test_encoded_frame_size > 0))
+    {
+        unsigned char frame_bytes[256];
+        (void)memset(frame_bytes, test_next_frame_tag, test_encoded_frame_size);
+        test_next_frame_tag++;
+        on_bytes_encoded(callback_context, frame_bytes, test_encoded_frame_size, true);
+    }
+
+    return 0;
+}
+
+static int my_xio_send(XIO_HANDLE xio, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)xio;
+
+    if (test_xio_send_result == 0)
+    {
+        (void)memcpy(test_sent_bytes + test_sent_byte_count, buffer, size);
+        test_sent_byte_count += size;
+        test_xio_send_sizes[test_xio_send_count] = size;
+        test_xio_send_callbacks[test_xio_send_count] = on_send_complete;
+        test_xio_send_contexts[test_xio_send_count] = callback_context;
+        test_xio_send_count++;
+    }
+
+    return test_xio_send_result;
+}
+
+static void complete_next_test_xio_send(IO_SEND_RESULT send_result)
+{
+    size_t i = test_completed_xio_send_count++;
+    if (test_xio_send_callbacks[i] != NULL)
+    {
+        test_xio_send_callbacks[i](test_xio_send_contexts[i], send_result);
+    }
+}
+
+/* completes the sends handed to the IO so far, in the order the IO took them */
+static void complete_test_xio_sends(IO_SEND_RESULT send_result)
+{
+    while (test_completed_xio_send_count < test_xio_send_count)
+    {
+        complete_next_test_xio_send(send_result);
+    }
+}
+
+static void test_on_frame_send_complete(void* context, IO_SEND_RESULT send_result)
+{
+    test_completed_frame_contexts[test_completed_frame_count] = context;
+    test_completed_frame_results[test_completed_frame_count] = send_result;
+    test_completed_frame_count++;
+}
+
+static void test_on_send_blocked_changed(void* context, bool is_send_blocked)
+{
+    (void)context;
+    test_send_blocked_notifications[test_send_blocked_notification_count++] = is_send_blocked;
+}
+
+/* the context is the index of the endpoint in test_endpoint_send_blocked_counts */
+static void test_on_indexed_send_blocked_changed(void* context, bool is_send_blocked)
+{
+    size_t endpoint_index = (size_t)context;
+
+    (void)is_send_blocked;
+    test_endpoint_send_blocked_counts[endpoint_index]++;
+
+    if ((test_endpoint_to_destroy != NULL) &&
+        (endpoint_index == test_destroying_endpoint_index))
+    {
+        ENDPOINT_HANDLE endpoint = test_endpoint_to_destroy;
+        test_endpoint_to_destroy = NULL;
+        connection_destroy_endpoint(endpoint);
+    }
+}
+
+static void test_on_endpoint_frame_received(void* context, AMQP_VALUE performative, uint32_t frame_payload_size, const unsigned char* payload_bytes)
+{
+    (void)context;
+    (void)performative;
+    (void)frame_payload_size;
+    (void)payload_bytes;
+}
+
+static void test_on_endpoint_connection_state_changed(void* context, CONNECTION_STATE new_connection_state, CONNECTION_STATE previous_connection_state)
+{
+    (void)context;
+    (void)new_connection_state;
+    (void)previous_connection_state;
+}
+
+/* runs the header and open exchange, after which frames can be encoded */
+static CONNECTION_HANDLE create_opened_connection(void)
+{
+    const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, NULL, test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    (void)connection_open(connection);
+    saved_on_io_open_complete(saved_on_io_open_complete_context, IO_OPEN_OK);
+    saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
+    saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, NULL, 0);
+
+    /* only what is sent from here on is of interest */
+    complete_test_xio_sends(IO_SEND_OK);
+    test_sent_byte_count = 0;
+    test_xio_send_count = 0;
+    test_completed_xio_send_count = 0;
+
+    return connection;
+}
+
+static ENDPOINT_HANDLE create_started_endpoint(CONNECTION_HANDLE connection)
+{
+    ENDPOINT_HANDLE endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_endpoint_frame_received, test_on_endpoint_connection_state_changed, NULL);
+    return endpoint;
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -240,15 +495,15 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(xio_create, TEST_IO_HANDLE);
     REGISTER_GLOBAL_MOCK_HOOK(xio_open, my_xio_open);
     REGISTER_GLOBAL_MOCK_RETURN(xio_close, 0);
-    REGISTER_GLOBAL_MOCK_RETURN(xio_send, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_send, my_xio_send);
     REGISTER_GLOBAL_MOCK_HOOK(frame_codec_receive_bytes, my_frame_codec_receive_bytes);
     REGISTER_GLOBAL_MOCK_RETURN(frame_codec_create, TEST_FRAME_CODEC_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(frame_codec_set_max_frame_size, 0);
     REGISTER_GLOBAL_MOCK_HOOK(amqp_frame_codec_create, my_amqp_frame_codec_create);
-    REGISTER_GLOBAL_MOCK_RETURN(amqp_frame_codec_encode_frame, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(amqp_frame_codec_encode_frame, my_amqp_frame_codec_encode_frame);
     REGISTER_GLOBAL_MOCK_RETURN(amqp_frame_codec_encode_empty_frame, 0);
     REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_ulong, my_amqpvalue_get_ulong);
-    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_descriptor, TEST_DESCRIPTOR_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_inplace_descriptor, my_amqpvalue_get_inplace_descriptor);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_string, 0);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_list_item, TEST_LIST_ITEM_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_described_value, TEST_DESCRIBED_AMQP_VALUE);
@@ -258,7 +513,14 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, my_singlylinkedlist_find);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, my_singlylinkedlist_item_get_value);
     REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, test_tick_counter);
-    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_get_current_ms, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_RETURN(open_create, TEST_OPEN_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_open, TEST_OPEN_PERFORMATIVE);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_open, my_amqpvalue_get_open);
+    REGISTER_GLOBAL_MOCK_HOOK(open_get_max_frame_size, my_open_get_max_frame_size);
+    REGISTER_GLOBAL_MOCK_HOOK(is_open_type_by_descriptor, my_is_open_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_flow_type_by_descriptor, my_is_flow_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_disposition_type_by_descriptor, my_is_disposition_type_by_descriptor);
 
     REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ON_FRAME_CODEC_ERROR, void*);
@@ -268,6 +530,15 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_FRAME_CODEC_ERROR_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_FRAME_CODEC_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPEN_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_BYTES_ENCODED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_OPEN_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_CLOSE_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_BYTES_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_ERROR, void*);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -290,6 +561,26 @@ TEST_FUNCTION_INITIALIZE(method_init)
     frame_codec_bytes = NULL;
     frame_codec_byte_count = 0;
     performative_ulong = 0x10;
+
+    test_current_ms = 0;
+    test_endpoint_dowork_counts[0] = 0;
+    test_endpoint_dowork_counts[1] = 0;
+    test_endpoint_dowork_counts[2] = 0;
+    test_time_to_endpoint_dowork = (uint64_t)-1;
+    test_endpoint_to_destroy = NULL;
+    test_connection_to_request_dowork = NULL;
+
+    test_encoded_frame_size = 0;
+    test_next_frame_tag = 1;
+    test_xio_send_result = 0;
+    test_sent_byte_count = 0;
+    test_xio_send_count = 0;
+    test_completed_xio_send_count = 0;
+    test_completed_frame_count = 0;
+    test_send_blocked_notification_count = 0;
+    test_endpoint_send_blocked_counts[0] = 0;
+    test_endpoint_send_blocked_counts[1] = 0;
+    test_endpoint_send_blocked_counts[2] = 0;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -3427,4 +3718,662 @@ TEST_FUNCTION(connection_set_trace_succeeds)
     connection_destroy(connection);
 }
 
+/* connection_endpoint_set_on_dowork */
+
+TEST_FUNCTION(connection_dowork_calls_the_endpoint_dowork_callback_with_the_current_time)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint = create_endpoint_with_dowork(connection, 0);
+    test_current_ms = 1000;
+    umock_c_reset_all_calls();
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[0]);
+    ASSERT_ARE_EQUAL(uint64_t, 1000, test_endpoint_dowork_current_ms);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_handle_deadlines_returns_the_time_left_until_the_dowork_an_endpoint_asked_for)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint = create_endpoint_with_dowork(connection, 0);
+    uint64_t result;
+    test_current_ms = 1000;
+    test_time_to_endpoint_dowork = 40;
+    connection_dowork(connection);
+    test_current_ms = 1010;
+    umock_c_reset_all_calls();
+
+    // act
+    result = connection_handle_deadlines(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 30, result);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_handle_deadlines_returns_1_when_the_dowork_an_endpoint_asked_for_is_due)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint = create_endpoint_with_dowork(connection, 0);
+    uint64_t result;
+    test_current_ms = 1000;
+    test_time_to_endpoint_dowork = 40;
+    connection_dowork(connection);
+    test_current_ms = 1050;
+    umock_c_reset_all_calls();
+
+    // act
+    result = connection_handle_deadlines(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 1, result);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_handle_deadlines_returns_no_deadline_when_no_endpoint_has_a_timer_running)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint = create_endpoint_with_dowork(connection, 0);
+    uint64_t result;
+    test_time_to_endpoint_dowork = 40;
+    connection_dowork(connection);
+    test_time_to_endpoint_dowork = (uint64_t)-1;
+    connection_dowork(connection);
+    umock_c_reset_all_calls();
+
+    // act
+    result = connection_handle_deadlines(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, (uint64_t)-1, result);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_an_endpoint_destroys_itself_in_its_dowork_callback_the_following_endpoints_still_get_their_dowork)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint_0 = create_endpoint_with_dowork(connection, 0);
+    ENDPOINT_HANDLE endpoint_1 = create_endpoint_with_dowork(connection, 1);
+    ENDPOINT_HANDLE endpoint_2 = create_endpoint_with_dowork(connection, 2);
+    test_destroying_endpoint_index = 0;
+    test_endpoint_to_destroy = endpoint_0;
+    umock_c_reset_all_calls();
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[1]);
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[2]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint_2);
+    connection_destroy_endpoint(endpoint_1);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_an_endpoint_destroys_an_endpoint_already_called_in_its_dowork_callback_no_endpoint_is_skipped_or_called_twice)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint_0 = create_endpoint_with_dowork(connection, 0);
+    ENDPOINT_HANDLE endpoint_1 = create_endpoint_with_dowork(connection, 1);
+    ENDPOINT_HANDLE endpoint_2 = create_endpoint_with_dowork(connection, 2);
+    test_destroying_endpoint_index = 1;
+    test_endpoint_to_destroy = endpoint_0;
+    umock_c_reset_all_calls();
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[1]);
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[2]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint_2);
+    connection_destroy_endpoint(endpoint_1);
+    connection_destroy(connection);
+}
+
+/* connection_request_dowork */
+
+TEST_FUNCTION(connection_request_dowork_with_NULL_connection_fails)
+{
+    // arrange
+
+    // act
+    int result = connection_request_dowork(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(connection_is_dowork_requested_returns_true_after_connection_request_dowork)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    bool is_dowork_requested_before;
+    bool is_dowork_requested_after;
+    int result;
+    umock_c_reset_all_calls();
+
+    // act
+    is_dowork_requested_before = connection_is_dowork_requested(connection);
+    result = connection_request_dowork(connection);
+    is_dowork_requested_after = connection_is_dowork_requested(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(is_dowork_requested_before);
+    ASSERT_IS_TRUE(is_dowork_requested_after);
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_dowork_clears_the_dowork_request_and_calls_the_endpoint_dowork)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint = create_endpoint_with_dowork(connection, 0);
+    (void)connection_request_dowork(connection);
+    umock_c_reset_all_calls();
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_IS_FALSE(connection_is_dowork_requested(connection));
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_dowork_counts[0]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(a_dowork_requested_from_an_endpoint_dowork_callback_stays_requested)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL);
+    ENDPOINT_HANDLE endpoint = create_endpoint_with_dowork(connection, 0);
+    test_connection_to_request_dowork = connection;
+    umock_c_reset_all_calls();
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_IS_TRUE(connection_is_dowork_requested(connection));
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+/* connection_set_output_buffer_size */
+
+TEST_FUNCTION(connection_uncork_sends_the_corked_frames_in_one_xio_send)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    ASSERT_ARE_EQUAL(size_t, 0, test_xio_send_count);
+
+    // act
+    int result = connection_uncork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 30, test_xio_send_sizes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 1, test_sent_bytes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 2, test_sent_bytes[10]);
+    ASSERT_ARE_EQUAL(uint8_t, 3, test_sent_bytes[20]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(an_uncorked_connection_sends_each_frame_as_soon_as_it_is_encoded)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    test_encoded_frame_size = 10;
+
+    // act
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 10, test_xio_send_sizes[0]);
+    ASSERT_ARE_EQUAL(size_t, 10, test_xio_send_sizes[1]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_a_frame_would_take_the_buffered_output_over_the_high_watermark_the_buffered_output_is_flushed_first)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 64);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 40;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // act
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 40, test_xio_send_sizes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 1, test_sent_bytes[0]);
+    (void)connection_uncork(connection);
+    ASSERT_ARE_EQUAL(size_t, 2, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 40, test_xio_send_sizes[1]);
+    ASSERT_ARE_EQUAL(uint8_t, 2, test_sent_bytes[40]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(a_frame_as_large_as_the_high_watermark_is_sent_on_its_own_after_the_buffered_output)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 64);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    test_encoded_frame_size = 64;
+
+    // act
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 10, test_xio_send_sizes[0]);
+    ASSERT_ARE_EQUAL(size_t, 64, test_xio_send_sizes[1]);
+    ASSERT_ARE_EQUAL(uint8_t, 1, test_sent_bytes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 2, test_sent_bytes[10]);
+
+    // cleanup
+    (void)connection_uncork(connection);
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(frames_sent_in_one_flush_complete_in_encode_order_when_the_io_completes_the_send)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x01);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x02);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x03);
+    (void)connection_uncork(connection);
+    ASSERT_ARE_EQUAL(size_t, 0, test_completed_frame_count);
+
+    // act
+    complete_test_xio_sends(IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, test_completed_frame_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x01, test_completed_frame_contexts[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x02, test_completed_frame_contexts[1]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x03, test_completed_frame_contexts[2]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_OK, (int)test_completed_frame_results[0]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_OK, (int)test_completed_frame_results[1]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_OK, (int)test_completed_frame_results[2]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(frames_sent_in_one_flush_complete_in_encode_order_with_the_error_of_the_send)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x01);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x02);
+    (void)connection_uncork(connection);
+
+    // act
+    complete_test_xio_sends(IO_SEND_ERROR);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_completed_frame_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x01, test_completed_frame_contexts[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x02, test_completed_frame_contexts[1]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_ERROR, (int)test_completed_frame_results[0]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_ERROR, (int)test_completed_frame_results[1]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(frames_sent_in_one_flush_complete_in_encode_order_when_the_io_cancels_the_send)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x01);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x02);
+    (void)connection_uncork(connection);
+
+    // act
+    complete_test_xio_sends(IO_SEND_CANCELLED);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_completed_frame_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x01, test_completed_frame_contexts[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x02, test_completed_frame_contexts[1]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_CANCELLED, (int)test_completed_frame_results[0]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_CANCELLED, (int)test_completed_frame_results[1]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_xio_send_fails_for_the_buffered_output_its_frames_complete_in_encode_order_with_IO_SEND_ERROR)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x01);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x02);
+    test_xio_send_result = 1;
+
+    // act
+    int result = connection_uncork(connection);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 2, test_completed_frame_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x01, test_completed_frame_contexts[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x02, test_completed_frame_contexts[1]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_ERROR, (int)test_completed_frame_results[0]);
+    ASSERT_ARE_EQUAL(int, (int)IO_SEND_ERROR, (int)test_completed_frame_results[1]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(buffered_frames_of_a_destroyed_endpoint_are_not_completed_when_the_io_completes_them)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x01);
+    connection_destroy_endpoint(endpoint);
+    (void)connection_uncork(connection);
+
+    // act
+    complete_test_xio_sends(IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 0, test_completed_frame_count);
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_destroy_does_not_complete_buffered_frames_of_a_destroyed_endpoint)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)0x01);
+    connection_destroy_endpoint(endpoint);
+
+    // act
+    connection_destroy(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, test_completed_frame_count);
+}
+
+/* connection_set_send_watermarks */
+
+TEST_FUNCTION(endpoints_are_told_when_the_pending_bytes_reach_the_high_watermark_and_when_they_drop_to_the_low_watermark)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_endpoint_set_on_send_blocked_changed(endpoint, test_on_send_blocked_changed);
+    (void)connection_set_send_watermarks(connection, 100, 50);
+    test_encoded_frame_size = 60;
+
+    // act
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    ASSERT_ARE_EQUAL(size_t, 0, test_send_blocked_notification_count);
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    ASSERT_ARE_EQUAL(size_t, 1, test_send_blocked_notification_count);
+    complete_next_test_xio_send(IO_SEND_OK);
+    ASSERT_ARE_EQUAL(size_t, 1, test_send_blocked_notification_count);
+    complete_next_test_xio_send(IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_send_blocked_notification_count);
+    ASSERT_ARE_EQUAL(bool, true, test_send_blocked_notifications[0]);
+    ASSERT_ARE_EQUAL(bool, false, test_send_blocked_notifications[1]);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_an_endpoint_destroys_itself_when_told_that_sending_is_blocked_the_following_endpoints_are_still_told)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint_0 = create_endpoint_with_dowork(connection, 0);
+    ENDPOINT_HANDLE endpoint_1 = create_endpoint_with_dowork(connection, 1);
+    ENDPOINT_HANDLE endpoint_2 = create_endpoint_with_dowork(connection, 2);
+    (void)connection_endpoint_set_on_send_blocked_changed(endpoint_0, test_on_indexed_send_blocked_changed);
+    (void)connection_endpoint_set_on_send_blocked_changed(endpoint_1, test_on_indexed_send_blocked_changed);
+    (void)connection_endpoint_set_on_send_blocked_changed(endpoint_2, test_on_indexed_send_blocked_changed);
+    (void)connection_set_send_watermarks(connection, 100, 50);
+    test_encoded_frame_size = 60;
+    test_destroying_endpoint_index = 0;
+    test_endpoint_to_destroy = endpoint_0;
+
+    // act
+    (void)connection_encode_frame(endpoint_2, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(endpoint_2, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_send_blocked_counts[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_send_blocked_counts[1]);
+    ASSERT_ARE_EQUAL(size_t, 1, test_endpoint_send_blocked_counts[2]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(endpoint_2);
+    connection_destroy_endpoint(endpoint_1);
+    connection_destroy(connection);
+}
+
+/* output lanes */
+
+TEST_FUNCTION(a_flow_frame_is_sent_ahead_of_the_buffered_transfers_of_other_endpoints)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE sending_endpoint = create_started_endpoint(connection);
+    ENDPOINT_HANDLE receiving_endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(sending_endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(receiving_endpoint, TEST_FLOW_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // act
+    (void)connection_uncork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 10, test_xio_send_sizes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 2, test_sent_bytes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 1, test_sent_bytes[10]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(receiving_endpoint);
+    connection_destroy_endpoint(sending_endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(flow_and_disposition_frames_stay_behind_the_buffered_transfers_of_their_own_endpoint)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(endpoint, TEST_FLOW_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(endpoint, TEST_DISPOSITION_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // act
+    (void)connection_uncork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_xio_send_count);
+    ASSERT_ARE_EQUAL(size_t, 30, test_xio_send_sizes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 1, test_sent_bytes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 2, test_sent_bytes[10]);
+    ASSERT_ARE_EQUAL(uint8_t, 3, test_sent_bytes[20]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(a_begin_frame_stays_behind_the_frames_buffered_before_it)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE ending_endpoint = create_started_endpoint(connection);
+    ENDPOINT_HANDLE beginning_endpoint = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(ending_endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(beginning_endpoint, TEST_BEGIN_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // act
+    (void)connection_uncork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_xio_send_count);
+    ASSERT_ARE_EQUAL(uint8_t, 1, test_sent_bytes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 2, test_sent_bytes[10]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(beginning_endpoint);
+    connection_destroy_endpoint(ending_endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(a_flow_frame_goes_ahead_again_once_the_transfers_of_its_endpoint_were_flushed)
+{
+    // arrange
+    CONNECTION_HANDLE connection = create_opened_connection();
+    ENDPOINT_HANDLE endpoint_1 = create_started_endpoint(connection);
+    ENDPOINT_HANDLE endpoint_2 = create_started_endpoint(connection);
+    (void)connection_set_output_buffer_size(connection, 1024);
+    (void)connection_cork(connection);
+    test_encoded_frame_size = 10;
+    (void)connection_encode_frame(endpoint_1, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_uncork(connection);
+    (void)connection_cork(connection);
+    (void)connection_encode_frame(endpoint_2, TEST_TRANSFER_PERFORMATIVE, NULL, 0, NULL, NULL);
+    (void)connection_encode_frame(endpoint_1, TEST_FLOW_PERFORMATIVE, NULL, 0, NULL, NULL);
+
+    // act
+    (void)connection_uncork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, test_xio_send_count);
+    ASSERT_ARE_EQUAL(uint8_t, 1, test_sent_bytes[0]);
+    ASSERT_ARE_EQUAL(uint8_t, 3, test_sent_bytes[10]);
+    ASSERT_ARE_EQUAL(uint8_t, 2, test_sent_bytes[20]);
+
+    // cleanup
+    complete_test_xio_sends(IO_SEND_OK);
+    connection_destroy_endpoint(endpoint_2);
+    connection_destroy_endpoint(endpoint_1);
+    connection_destroy(connection);
+}
+
 END_TEST_SUITE(connection_ut)
@@ -0,0 +1,1659 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static size_t realloc_count;
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    realloc_count++;
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/link.h"
+
+#define TEST_SESSION_HANDLE             (SESSION_HANDLE)0x4242
+#define TEST_LINK_ENDPOINT_HANDLE       (LINK_ENDPOINT_HANDLE)0x4243
+#define TEST_ATTACH_PERFORMATIVE        (AMQP_VALUE)0x5000
+#define TEST_FLOW_PERFORMATIVE          (AMQP_VALUE)0x5001
+#define TEST_TRANSFER_PERFORMATIVE      (AMQP_VALUE)0x5002
+#define TEST_DISPOSITION_PERFORMATIVE   (AMQP_VALUE)0x5003
+#define TEST_ATTACH_HANDLE              (ATTACH_HANDLE)0x6000
+#define TEST_FLOW_HANDLE                (FLOW_HANDLE)0x6001
+#define TEST_TRANSFER_HANDLE            (TRANSFER_HANDLE)0x6002
+#define TEST_DISPOSITION_HANDLE         (DISPOSITION_HANDLE)0x6003
+#define TEST_CONTEXT                    (void*)0x4444
+#define TEST_ACCEPTED_STATE             (AMQP_VALUE)0x7000
+#define TEST_REJECTED_STATE             (AMQP_VALUE)0x7001
+
+static ON_ENDPOINT_FRAME_RECEIVED saved_frame_received;
+static ON_SESSION_STATE_CHANGED saved_on_session_state_changed;
+static ON_SESSION_FLOW_ON saved_on_session_flow_on;
+static void* saved_link_endpoint_context;
+static ON_ENDPOINT_DOWORK saved_on_link_endpoint_dowork;
+
+/* what the next received transfer frame carries */
+static delivery_number test_transfer_delivery_id;
+static bool test_transfer_more;
+static bool test_transfer_settled;
+static AMQP_VALUE test_delivery_state_to_return;
+
+/* flow frames sent by the link */
+static size_t sent_flow_count;
+static uint32_t sent_flow_link_credit;
+
+/* disposition frames sent by the link */
+static size_t sent_disposition_count;
+static delivery_number sent_disposition_first;
+static delivery_number sent_disposition_last;
+static AMQP_VALUE sent_disposition_state;
+
+/* 'D' for every disposition and 'F' for every flow, in the order they were sent */
+static char sent_frames[64];
+
+/* what the peer sends to a sender link */
+static uint32_t test_flow_link_credit;
+static sequence_no test_flow_delivery_count;
+static delivery_number test_disposition_first;
+static delivery_number test_disposition_last;
+static AMQP_VALUE test_disposition_state;
+
+/* delivery ids handed out by the session, other links on the session may take ids in between */
+static delivery_number next_delivery_id;
+static delivery_number delivery_id_step;
+static ON_SEND_COMPLETE saved_on_send_complete;
+static void* saved_on_send_complete_context;
+
+static delivery_number settled_delivery_ids[64];
+static AMQP_VALUE settled_delivery_states[64];
+static size_t settled_delivery_count;
+
+static unsigned char received_payload[256];
+static uint32_t received_payload_size;
+static const unsigned char* received_payload_bytes;
+static size_t received_segment_count;
+static size_t received_transfer_count;
+static bool received_frame_more[16];
+static uint32_t received_frame_sizes[16];
+static size_t received_frame_count;
+static AMQP_VALUE test_frame_delivery_state_to_return;
+
+MOCK_FUNCTION_WITH_CODE(, AMQP_VALUE, test_on_transfer_received, void*, context, TRANSFER_HANDLE, transfer, uint32_t, payload_size, const unsigned char*, payload_bytes)
+    if (payload_size <= sizeof(received_payload))
+    {
+        (void)memcpy(received_payload, payload_bytes, payload_size);
+    }
+    received_payload_size = payload_size;
+    received_payload_bytes = payload_bytes;
+    received_transfer_count++;
+MOCK_FUNCTION_END(test_delivery_state_to_return);
+MOCK_FUNCTION_WITH_CODE(, AMQP_VALUE, test_on_transfer_segments_received, void*, context, TRANSFER_HANDLE, transfer, const PAYLOAD*, segments, size_t, segment_count)
+    size_t i;
+    received_payload_size = 0;
+    for (i = 0; i < segment_count; i++)
+    {
+        if (received_payload_size + segments[i].length <= sizeof(received_payload))
+        {
+            (void)memcpy(received_payload + received_payload_size, segments[i].bytes, segments[i].length);
+        }
+        received_payload_size += (uint32_t)segments[i].length;
+    }
+    received_payload_bytes = (segment_count > 0) ? segments[0].bytes : NULL;
+    received_segment_count = segment_count;
+    received_transfer_count++;
+MOCK_FUNCTION_END(test_delivery_state_to_return);
+MOCK_FUNCTION_WITH_CODE(, AMQP_VALUE, test_on_transfer_frame_received, void*, context, TRANSFER_HANDLE, transfer, uint32_t, payload_size, const unsigned char*, payload_bytes, bool, more)
+    if (received_frame_count < sizeof(received_frame_more) / sizeof(received_frame_more[0]))
+    {
+        received_frame_more[received_frame_count] = more;
+        received_frame_sizes[received_frame_count] = payload_size;
+    }
+    received_frame_count++;
+MOCK_FUNCTION_END(more ? test_frame_delivery_state_to_return : test_delivery_state_to_return);
+MOCK_FUNCTION_WITH_CODE(, void, test_on_delivery_settled, void*, context, delivery_number, delivery_no, AMQP_VALUE, delivery_state)
+    if (settled_delivery_count < sizeof(settled_delivery_ids) / sizeof(settled_delivery_ids[0]))
+    {
+        settled_delivery_ids[settled_delivery_count] = delivery_no;
+        settled_delivery_states[settled_delivery_count] = delivery_state;
+    }
+    settled_delivery_count++;
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_link_state_changed, void*, context, LINK_STATE, new_link_state, LINK_STATE, previous_link_state)
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_link_flow_on, void*, context)
+MOCK_FUNCTION_END();
+
+static int my_session_start_link_endpoint(LINK_ENDPOINT_HANDLE link_endpoint, ON_ENDPOINT_FRAME_RECEIVED frame_received_callback, ON_SESSION_STATE_CHANGED on_session_state_changed, ON_SESSION_FLOW_ON on_session_flow_on, void* context)
+{
+    (void)link_endpoint;
+    saved_frame_received = frame_received_callback;
+    saved_on_session_state_changed = on_session_state_changed;
+    saved_on_session_flow_on = on_session_flow_on;
+    saved_link_endpoint_context = context;
+    return 0;
+}
+
+static int my_session_set_link_endpoint_on_dowork(LINK_ENDPOINT_HANDLE link_endpoint, ON_ENDPOINT_DOWORK on_link_endpoint_dowork)
+{
+    (void)link_endpoint;
+    saved_on_link_endpoint_dowork = on_link_endpoint_dowork;
+    return 0;
+}
+
+static void append_sent_frame(char frame_type)
+{
+    size_t length = strlen(sent_frames);
+    if (length < sizeof(sent_frames) - 1)
+    {
+        sent_frames[length] = frame_type;
+        sent_frames[length + 1] = '\0';
+    }
+}
+
+static AMQP_VALUE my_amqpvalue_clone(AMQP_VALUE value)
+{
+    return value;
+}
+
+static bool my_amqpvalue_are_equal(AMQP_VALUE value1, AMQP_VALUE value2)
+{
+    return value1 == value2;
+}
+
+static AMQP_VALUE my_amqpvalue_get_inplace_descriptor(AMQP_VALUE value)
+{
+    /* the test performatives are their own descriptors */
+    return value;
+}
+
+static bool my_is_attach_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return descriptor == TEST_ATTACH_PERFORMATIVE;
+}
+
+static bool my_is_flow_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return descriptor == TEST_FLOW_PERFORMATIVE;
+}
+
+static bool my_is_transfer_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return descriptor == TEST_TRANSFER_PERFORMATIVE;
+}
+
+static bool my_is_disposition_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return descriptor == TEST_DISPOSITION_PERFORMATIVE;
+}
+
+static int my_amqpvalue_get_attach(AMQP_VALUE value, ATTACH_HANDLE* attach_handle)
+{
+    (void)value;
+    *attach_handle = TEST_ATTACH_HANDLE;
+    return 0;
+}
+
+static int my_amqpvalue_get_transfer(AMQP_VALUE value, TRANSFER_HANDLE* transfer_handle)
+{
+    (void)value;
+    *transfer_handle = TEST_TRANSFER_HANDLE;
+    return 0;
+}
+
+static int my_amqpvalue_get_flow(AMQP_VALUE value, FLOW_HANDLE* flow_handle)
+{
+    (void)value;
+    *flow_handle = TEST_FLOW_HANDLE;
+    return 0;
+}
+
+static int my_flow_get_link_credit(FLOW_HANDLE flow, uint32_t* link_credit_value)
+{
+    (void)flow;
+    *link_credit_value = test_flow_link_credit;
+    return 0;
+}
+
+static int my_flow_get_delivery_count(FLOW_HANDLE flow, sequence_no* delivery_count_value)
+{
+    (void)flow;
+    *delivery_count_value = test_flow_delivery_count;
+    return 0;
+}
+
+static int my_amqpvalue_get_disposition(AMQP_VALUE value, DISPOSITION_HANDLE* disposition_handle)
+{
+    (void)value;
+    *disposition_handle = TEST_DISPOSITION_HANDLE;
+    return 0;
+}
+
+static int my_disposition_get_first(DISPOSITION_HANDLE disposition, delivery_number* first_value)
+{
+    (void)disposition;
+    *first_value = test_disposition_first;
+    return 0;
+}
+
+static int my_disposition_get_last(DISPOSITION_HANDLE disposition, delivery_number* last_value)
+{
+    (void)disposition;
+    *last_value = test_disposition_last;
+    return 0;
+}
+
+static int my_disposition_get_settled(DISPOSITION_HANDLE disposition, bool* settled_value)
+{
+    (void)disposition;
+    *settled_value = true;
+    return 0;
+}
+
+static int my_disposition_get_state(DISPOSITION_HANDLE disposition, AMQP_VALUE* state_value)
+{
+    (void)disposition;
+    *state_value = test_disposition_state;
+    return 0;
+}
+
+static SESSION_SEND_TRANSFER_RESULT my_session_send_transfer(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)link_endpoint;
+    (void)transfer;
+    (void)payloads;
+    (void)payload_count;
+    *delivery_id = next_delivery_id;
+    next_delivery_id += delivery_id_step;
+    saved_on_send_complete = on_send_complete;
+    saved_on_send_complete_context = callback_context;
+    return SESSION_SEND_TRANSFER_OK;
+}
+
+static int my_transfer_get_delivery_id(TRANSFER_HANDLE transfer, delivery_number* delivery_id_value)
+{
+    (void)transfer;
+    *delivery_id_value = test_transfer_delivery_id;
+    return 0;
+}
+
+static int my_transfer_get_more(TRANSFER_HANDLE transfer, bool* more_value)
+{
+    (void)transfer;
+    *more_value = test_transfer_more;
+    return 0;
+}
+
+static int my_transfer_get_settled(TRANSFER_HANDLE transfer, bool* settled_value)
+{
+    (void)transfer;
+    *settled_value = test_transfer_settled;
+    return 0;
+}
+
+static int my_flow_set_link_credit(FLOW_HANDLE flow, uint32_t link_credit_value)
+{
+    (void)flow;
+    sent_flow_link_credit = link_credit_value;
+    return 0;
+}
+
+static int my_session_send_flow(LINK_ENDPOINT_HANDLE link_endpoint, FLOW_HANDLE flow)
+{
+    (void)link_endpoint;
+    (void)flow;
+    sent_flow_count++;
+    append_sent_frame('F');
+    return 0;
+}
+
+static DISPOSITION_HANDLE my_disposition_create(role role_value, delivery_number first_value)
+{
+    (void)role_value;
+    sent_disposition_first = first_value;
+    sent_disposition_last = first_value;
+    sent_disposition_state = NULL;
+    return TEST_DISPOSITION_HANDLE;
+}
+
+static int my_disposition_set_last(DISPOSITION_HANDLE disposition, delivery_number last_value)
+{
+    (void)disposition;
+    sent_disposition_last = last_value;
+    return 0;
+}
+
+static int my_disposition_set_state(DISPOSITION_HANDLE disposition, AMQP_VALUE state_value)
+{
+    (void)disposition;
+    sent_disposition_state = state_value;
+    return 0;
+}
+
+static int my_session_send_disposition(LINK_ENDPOINT_HANDLE link_endpoint, DISPOSITION_HANDLE disposition)
+{
+    (void)link_endpoint;
+    (void)disposition;
+    sent_disposition_count++;
+    append_sent_frame('D');
+    return 0;
+}
+
+static char* umocktypes_stringify_delivery_tag(const delivery_tag* value)
+{
+    char* result = (char*)my_gballoc_malloc(3 + (5 * value->length));
+    if (result != NULL)
+    {
+        size_t pos = 0;
+        size_t i;
+
+        result[pos++] = '[';
+        for (i = 0; i < value->length; i++)
+        {
+            (void)sprintf(&result[pos], "0x%02X ", ((const unsigned char*)value->bytes)[i]);
+            pos += 5;
+        }
+        result[pos++] = ']';
+        result[pos++] = '\0';
+    }
+
+    return result;
+}
+
+static int umocktypes_are_equal_delivery_tag(const delivery_tag* left, const delivery_tag* right)
+{
+    int result;
+
+    if (left->length != right->length)
+    {
+        result = 0;
+    }
+    else if (left->length == 0)
+    {
+        result = 1;
+    }
+    else
+    {
+        result = (memcmp(left->bytes, right->bytes, left->length) == 0) ? 1 : 0;
+    }
+
+    return result;
+}
+
+static int umocktypes_copy_delivery_tag(delivery_tag* destination, const delivery_tag* source)
+{
+    int result;
+
+    destination->length = source->length;
+    if (source->length == 0)
+    {
+        destination->bytes = NULL;
+        result = 0;
+    }
+    else
+    {
+        destination->bytes = my_gballoc_malloc(source->length);
+        if (destination->bytes == NULL)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            (void)memcpy((void*)destination->bytes, source->bytes, source->length);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void umocktypes_free_delivery_tag(delivery_tag* value)
+{
+    my_gballoc_free((void*)value->bytes);
+}
+
+static LINK_HANDLE create_receiver_link(void)
+{
+    return link_create(TEST_SESSION_HANDLE, "test_link", role_receiver, NULL, NULL);
+}
+
+static LINK_HANDLE create_sender_link(void)
+{
+    return link_create(TEST_SESSION_HANDLE, "test_link", role_sender, NULL, NULL);
+}
+
+/* attaches the link: the session gets mapped and the peer answers the ATTACH */
+static void attach_link(LINK_HANDLE link)
+{
+    (void)link_attach(link, test_on_transfer_received, test_on_link_state_changed, test_on_link_flow_on, TEST_CONTEXT);
+    saved_on_session_state_changed(saved_link_endpoint_context, SESSION_STATE_MAPPED, SESSION_STATE_UNMAPPED);
+    saved_frame_received(saved_link_endpoint_context, TEST_ATTACH_PERFORMATIVE, 0, NULL);
+    sent_flow_count = 0;
+    sent_frames[0] = '\0';
+    umock_c_reset_all_calls();
+}
+
+static void receive_flow(uint32_t link_credit)
+{
+    test_flow_link_credit = link_credit;
+    saved_frame_received(saved_link_endpoint_context, TEST_FLOW_PERFORMATIVE, 0, NULL);
+}
+
+static void receive_disposition(delivery_number first, delivery_number last, AMQP_VALUE delivery_state)
+{
+    test_disposition_first = first;
+    test_disposition_last = last;
+    test_disposition_state = delivery_state;
+    saved_frame_received(saved_link_endpoint_context, TEST_DISPOSITION_PERFORMATIVE, 0, NULL);
+}
+
+static void send_messages(LINK_HANDLE link, size_t count)
+{
+    unsigned char payload_bytes[] = { 0x42 };
+    PAYLOAD payload;
+    size_t i;
+
+    payload.bytes = payload_bytes;
+    payload.length = sizeof(payload_bytes);
+
+    for (i = 0; i < count; i++)
+    {
+        ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer(link, 0, &payload, 1, test_on_delivery_settled, TEST_CONTEXT));
+    }
+}
+
+static void receive_transfer_frame(delivery_number delivery_id, bool more, const unsigned char* payload_bytes, uint32_t payload_size)
+{
+    test_transfer_delivery_id = delivery_id;
+    test_transfer_more = more;
+    saved_frame_received(saved_link_endpoint_context, TEST_TRANSFER_PERFORMATIVE, payload_size, payload_bytes);
+}
+
+/* receives one delivery split in frames of frame_size bytes */
+static void receive_multi_frame_transfer(delivery_number delivery_id, const unsigned char* payload_bytes, uint32_t frame_size, size_t frame_count)
+{
+    size_t i;
+
+    for (i = 0; i < frame_count; i++)
+    {
+        receive_transfer_frame(delivery_id, i < frame_count - 1, payload_bytes + (i * frame_size), frame_size);
+    }
+}
+
+static void receive_transfers(delivery_number first_delivery_id, size_t count)
+{
+    unsigned char payload_byte = 0x42;
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        receive_transfer_frame(first_delivery_id + (delivery_number)i, false, &payload_byte, 1);
+    }
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(link_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_RETURN(session_create_link_endpoint, TEST_LINK_ENDPOINT_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(session_start_link_endpoint, my_session_start_link_endpoint);
+    REGISTER_GLOBAL_MOCK_HOOK(session_send_flow, my_session_send_flow);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_inplace_descriptor, my_amqpvalue_get_inplace_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_attach_type_by_descriptor, my_is_attach_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_flow_type_by_descriptor, my_is_flow_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_transfer_type_by_descriptor, my_is_transfer_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_disposition_type_by_descriptor, my_is_disposition_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_attach, my_amqpvalue_get_attach);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_transfer, my_amqpvalue_get_transfer);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_delivery_id, my_transfer_get_delivery_id);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_more, my_transfer_get_more);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_settled, my_transfer_get_settled);
+    REGISTER_GLOBAL_MOCK_RETURN(attach_create, TEST_ATTACH_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(flow_create, TEST_FLOW_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_set_link_credit, my_flow_set_link_credit);
+    REGISTER_GLOBAL_MOCK_HOOK(session_set_link_endpoint_on_dowork, my_session_set_link_endpoint_on_dowork);
+    REGISTER_GLOBAL_MOCK_HOOK(session_send_disposition, my_session_send_disposition);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_clone, my_amqpvalue_clone);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_are_equal, my_amqpvalue_are_equal);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_create, my_disposition_create);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_set_last, my_disposition_set_last);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_set_state, my_disposition_set_state);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_flow, my_amqpvalue_get_flow);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_get_link_credit, my_flow_get_link_credit);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_get_delivery_count, my_flow_get_delivery_count);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_disposition, my_amqpvalue_get_disposition);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_first, my_disposition_get_first);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_last, my_disposition_get_last);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_settled, my_disposition_get_settled);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_state, my_disposition_get_state);
+    REGISTER_GLOBAL_MOCK_RETURN(transfer_create, TEST_TRANSFER_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(session_send_transfer, my_session_send_transfer);
+
+    REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_ENDPOINT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_ENDPOINT_FRAME_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SESSION_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SESSION_FLOW_ON, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_ENDPOINT_DOWORK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ATTACH_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(FLOW_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DISPOSITION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DETACH_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_STATE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(role, bool);
+    REGISTER_UMOCK_ALIAS_TYPE(handle, uint32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(sequence_no, uint32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(delivery_number, uint32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(transfer_number, uint32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(sender_settle_mode, uint8_t);
+    REGISTER_UMOCK_ALIAS_TYPE(receiver_settle_mode, uint8_t);
+    REGISTER_UMOCK_ALIAS_TYPE(fields, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(message_format, uint32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_SEGMENTS_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_FRAME_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SESSION_SEND_TRANSFER_RESULT, int);
+    REGISTER_TYPE(delivery_tag, delivery_tag);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    test_transfer_delivery_id = 0;
+    test_transfer_more = false;
+    test_transfer_settled = false;
+    test_delivery_state_to_return = NULL;
+    sent_flow_count = 0;
+    sent_flow_link_credit = 0;
+    sent_disposition_count = 0;
+    sent_disposition_first = 0;
+    sent_disposition_last = 0;
+    sent_disposition_state = NULL;
+    sent_frames[0] = '\0';
+    test_flow_link_credit = 0;
+    test_flow_delivery_count = 0;
+    test_disposition_first = 0;
+    test_disposition_last = 0;
+    test_disposition_state = NULL;
+    next_delivery_id = 0;
+    delivery_id_step = 1;
+    saved_on_send_complete = NULL;
+    saved_on_send_complete_context = NULL;
+    settled_delivery_count = 0;
+    realloc_count = 0;
+    received_payload_size = 0;
+    received_payload_bytes = NULL;
+    received_segment_count = 0;
+    received_transfer_count = 0;
+    received_frame_count = 0;
+    test_frame_delivery_state_to_return = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* link_set_link_credit_refill_threshold */
+
+TEST_FUNCTION(link_set_link_credit_refill_threshold_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_set_link_credit_refill_threshold(NULL, 10);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(link_set_link_credit_refill_threshold_below_the_max_link_credit_succeeds)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 100);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = link_set_link_credit_refill_threshold(link, 99);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_set_link_credit_refill_threshold_equal_to_the_max_link_credit_fails)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 100);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = link_set_link_credit_refill_threshold(link, 100);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* link_set_max_link_credit */
+
+TEST_FUNCTION(link_set_max_link_credit_with_0_fails)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = link_set_max_link_credit(link, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_set_max_link_credit_not_above_the_refill_threshold_fails)
+{
+    // arrange
+    uint32_t max_link_credit;
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 100);
+    (void)link_set_link_credit_refill_threshold(link, 50);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = link_set_max_link_credit(link, 50);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    (void)link_get_max_link_credit(link, &max_link_credit);
+    ASSERT_ARE_EQUAL(uint32_t, 100, max_link_credit);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* link_set_link_credit_mode */
+
+TEST_FUNCTION(link_set_link_credit_mode_with_an_unknown_mode_fails)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = link_set_link_credit_mode(link, (LINK_CREDIT_MODE)42);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* link credit refill */
+
+TEST_FUNCTION(attaching_a_receiver_link_grants_the_max_link_credit)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    (void)link_attach(link, test_on_transfer_received, test_on_link_state_changed, test_on_link_flow_on, TEST_CONTEXT);
+    saved_on_session_state_changed(saved_link_endpoint_context, SESSION_STATE_MAPPED, SESSION_STATE_UNMAPPED);
+
+    // act
+    saved_frame_received(saved_link_endpoint_context, TEST_ATTACH_PERFORMATIVE, 0, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 10, sent_flow_link_credit);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(no_flow_is_sent_while_the_link_credit_is_above_the_refill_threshold)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    (void)link_set_link_credit_refill_threshold(link, 5);
+    attach_link(link);
+
+    // act
+    receive_transfers(0, 4);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sent_flow_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_link_credit_is_refilled_to_the_max_link_credit_when_it_drops_to_the_refill_threshold)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    (void)link_set_link_credit_refill_threshold(link, 5);
+    attach_link(link);
+    receive_transfers(0, 4);
+
+    // act
+    receive_transfers(4, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 10, sent_flow_link_credit);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(with_the_default_refill_threshold_the_link_credit_is_refilled_once_it_is_used_up)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    attach_link(link);
+    receive_transfers(0, 9);
+    ASSERT_ARE_EQUAL(size_t, 0, sent_flow_count);
+
+    // act
+    receive_transfers(9, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 10, sent_flow_link_credit);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(continuation_transfer_frames_do_not_consume_link_credit)
+{
+    // arrange
+    unsigned char payload_byte = 0x42;
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 2);
+    (void)link_set_link_credit_refill_threshold(link, 1);
+    attach_link(link);
+
+    // act
+    receive_transfer_frame(0, true, &payload_byte, 1);
+    receive_transfer_frame(0, true, &payload_byte, 1);
+    receive_transfer_frame(0, false, &payload_byte, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 2, sent_flow_link_credit);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_adaptive_mode_no_credit_is_granted_for_deliveries_the_application_has_not_disposed)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    (void)link_set_link_credit_refill_threshold(link, 5);
+    (void)link_set_link_credit_mode(link, LINK_CREDIT_MODE_ADAPTIVE);
+    attach_link(link);
+
+    // act
+    receive_transfers(0, 5);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sent_flow_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_adaptive_mode_disposing_a_delivery_gives_its_credit_back)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    (void)link_set_link_credit_refill_threshold(link, 5);
+    (void)link_set_link_credit_mode(link, LINK_CREDIT_MODE_ADAPTIVE);
+    attach_link(link);
+    receive_transfers(0, 5);
+
+    // act
+    int result = link_send_disposition(link, 0, (AMQP_VALUE)0x7000);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 6, sent_flow_link_credit);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_adaptive_mode_disposing_a_delivery_twice_gives_its_credit_back_once)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    (void)link_set_link_credit_refill_threshold(link, 5);
+    (void)link_set_link_credit_mode(link, LINK_CREDIT_MODE_ADAPTIVE);
+    attach_link(link);
+    receive_transfers(0, 5);
+    (void)link_send_disposition(link, 0, (AMQP_VALUE)0x7000);
+    receive_transfers(5, 1);
+    sent_flow_count = 0;
+
+    // act
+    (void)link_send_disposition(link, 0, (AMQP_VALUE)0x7000);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sent_flow_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_adaptive_mode_deliveries_settled_by_the_sender_do_not_hold_back_credit)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 10);
+    (void)link_set_link_credit_refill_threshold(link, 5);
+    (void)link_set_link_credit_mode(link, LINK_CREDIT_MODE_ADAPTIVE);
+    attach_link(link);
+    test_transfer_settled = true;
+
+    // act
+    receive_transfers(0, 5);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 10, sent_flow_link_credit);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* link_set_max_disposition_batch_size */
+
+TEST_FUNCTION(link_set_max_disposition_batch_size_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_set_max_disposition_batch_size(NULL, 10);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(link_set_disposition_batch_timeout_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_set_disposition_batch_timeout(NULL, 100);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/* disposition batching */
+
+TEST_FUNCTION(by_default_each_disposition_is_sent_when_the_delivery_is_disposed)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_transfers(0, 3);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 2, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 2, sent_disposition_last);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, sent_disposition_state);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(contiguous_deliveries_with_the_same_state_are_settled_with_one_ranged_disposition)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 3);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+    receive_transfers(0, 2);
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+
+    // act
+    receive_transfers(2, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 2, sent_disposition_last);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, sent_disposition_state);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(a_different_delivery_state_flushes_the_pending_disposition_range)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 10);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+    receive_transfers(0, 2);
+
+    // act
+    test_delivery_state_to_return = TEST_REJECTED_STATE;
+    receive_transfers(2, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_disposition_last);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, sent_disposition_state);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(a_non_contiguous_delivery_id_flushes_the_pending_disposition_range)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 10);
+    attach_link(link);
+    receive_transfers(0, 4);
+    (void)link_send_disposition(link, 0, TEST_ACCEPTED_STATE);
+    (void)link_send_disposition(link, 1, TEST_ACCEPTED_STATE);
+
+    // act
+    int result = link_send_disposition(link, 3, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_disposition_last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(lowering_the_max_disposition_batch_size_flushes_the_pending_disposition_range)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 10);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+    receive_transfers(0, 2);
+
+    // act
+    int result = link_set_max_disposition_batch_size(link, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_disposition_last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_link_endpoint_dowork_reports_the_time_left_until_the_pending_dispositions_are_flushed)
+{
+    // arrange
+    uint64_t time_left_1;
+    uint64_t time_left_2;
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 10);
+    (void)link_set_disposition_batch_timeout(link, 100);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+    receive_transfers(0, 1);
+
+    // act
+    time_left_1 = saved_on_link_endpoint_dowork(saved_link_endpoint_context, 1000);
+    time_left_2 = saved_on_link_endpoint_dowork(saved_link_endpoint_context, 1050);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 100, time_left_1);
+    ASSERT_ARE_EQUAL(uint64_t, 50, time_left_2);
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_pending_dispositions_are_flushed_when_the_batch_timeout_elapses)
+{
+    // arrange
+    uint64_t time_left;
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 10);
+    (void)link_set_disposition_batch_timeout(link, 100);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+    receive_transfers(0, 2);
+    (void)saved_on_link_endpoint_dowork(saved_link_endpoint_context, 1000);
+
+    // act
+    time_left = saved_on_link_endpoint_dowork(saved_link_endpoint_context, 1100);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, (uint64_t)-1, time_left);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_disposition_last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_link_endpoint_dowork_without_pending_dispositions_has_no_deadline)
+{
+    // arrange
+    uint64_t time_left;
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 10);
+    attach_link(link);
+
+    // act
+    time_left = saved_on_link_endpoint_dowork(saved_link_endpoint_context, 1000);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, (uint64_t)-1, time_left);
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_detach_flushes_the_pending_dispositions)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_disposition_batch_size(link, 10);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+    receive_transfers(0, 2);
+
+    // act
+    (void)link_detach(link, true);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_disposition_last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_pending_dispositions_are_sent_before_the_flow_that_refills_the_link_credit)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 2);
+    (void)link_set_max_disposition_batch_size(link, 10);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_transfers(0, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "DF", sent_frames);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_disposition_first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_disposition_last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* pending deliveries */
+
+TEST_FUNCTION(link_transfer_without_link_credit_returns_busy)
+{
+    // arrange
+    unsigned char payload_bytes[] = { 0x42 };
+    PAYLOAD payload;
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    payload.bytes = payload_bytes;
+    payload.length = sizeof(payload_bytes);
+
+    // act
+    LINK_TRANSFER_RESULT result = link_transfer(link, 0, &payload, 1, test_on_delivery_settled, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_BUSY, (int)result);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(a_ranged_disposition_settles_all_the_deliveries_in_the_range_in_order)
+{
+    // arrange
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    receive_flow(100);
+    send_messages(link, 4);
+
+    // act
+    receive_disposition(0, 2, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, settled_delivery_ids[0]);
+    ASSERT_ARE_EQUAL(uint32_t, 1, settled_delivery_ids[1]);
+    ASSERT_ARE_EQUAL(uint32_t, 2, settled_delivery_ids[2]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, settled_delivery_states[0]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, settled_delivery_states[2]);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(deliveries_settled_out_of_order_are_each_indicated_once)
+{
+    // arrange
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    receive_flow(100);
+    send_messages(link, 4);
+    receive_disposition(2, 2, TEST_ACCEPTED_STATE);
+
+    // act
+    receive_disposition(0, 3, TEST_REJECTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 4, settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 2, settled_delivery_ids[0]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, settled_delivery_states[0]);
+    ASSERT_ARE_EQUAL(uint32_t, 0, settled_delivery_ids[1]);
+    ASSERT_ARE_EQUAL(uint32_t, 1, settled_delivery_ids[2]);
+    ASSERT_ARE_EQUAL(uint32_t, 3, settled_delivery_ids[3]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_REJECTED_STATE, settled_delivery_states[3]);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(a_disposition_for_deliveries_that_are_not_pending_settles_nothing)
+{
+    // arrange
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    receive_flow(100);
+    send_messages(link, 3);
+
+    // act
+    receive_disposition(10, 12, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, settled_delivery_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(more_deliveries_than_the_initial_ring_capacity_are_all_settled_in_order)
+{
+    // arrange
+    size_t i;
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    receive_flow(100);
+    send_messages(link, 40);
+
+    // act
+    receive_disposition(0, 39, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 40, settled_delivery_count);
+    for (i = 0; i < 40; i++)
+    {
+        ASSERT_ARE_EQUAL(uint32_t, (uint32_t)i, settled_delivery_ids[i]);
+    }
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(when_delivery_ids_are_not_contiguous_the_settled_deliveries_are_still_found)
+{
+    // arrange
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    receive_flow(100);
+    delivery_id_step = 2;
+    send_messages(link, 5);
+
+    // act
+    receive_disposition(4, 6, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 4, settled_delivery_ids[0]);
+    ASSERT_ARE_EQUAL(uint32_t, 6, settled_delivery_ids[1]);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(a_settled_delivery_instance_is_reused_for_the_next_transfer)
+{
+    // arrange
+    unsigned char payload_bytes[] = { 0x42 };
+    unsigned char delivery_tag_bytes[sizeof(sequence_no)];
+    sequence_no expected_delivery_count = 2;
+    delivery_tag expected_delivery_tag;
+    PAYLOAD payload;
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    receive_flow(100);
+    send_messages(link, 1);
+    receive_disposition(0, 0, TEST_ACCEPTED_STATE);
+    umock_c_reset_all_calls();
+
+    payload.bytes = payload_bytes;
+    payload.length = sizeof(payload_bytes);
+    (void)memcpy(delivery_tag_bytes, &expected_delivery_count, sizeof(expected_delivery_count));
+    expected_delivery_tag.bytes = delivery_tag_bytes;
+    expected_delivery_tag.length = sizeof(delivery_tag_bytes);
+
+    STRICT_EXPECTED_CALL(transfer_create(0));
+    STRICT_EXPECTED_CALL(transfer_set_delivery_tag(TEST_TRANSFER_HANDLE, expected_delivery_tag));
+    STRICT_EXPECTED_CALL(transfer_set_message_format(TEST_TRANSFER_HANDLE, 0));
+    STRICT_EXPECTED_CALL(transfer_set_settled(TEST_TRANSFER_HANDLE, false));
+    STRICT_EXPECTED_CALL(session_send_transfer(TEST_LINK_ENDPOINT_HANDLE, TEST_TRANSFER_HANDLE, &payload, 1, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(transfer_destroy(TEST_TRANSFER_HANDLE));
+
+    // act
+    LINK_TRANSFER_RESULT result = link_transfer(link, 0, &payload, 1, test_on_delivery_settled, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_settled_mode_the_delivery_is_settled_once_the_transfer_is_sent)
+{
+    // arrange
+    LINK_HANDLE link = create_sender_link();
+    (void)link_set_snd_settle_mode(link, sender_settle_mode_settled);
+    attach_link(link);
+    receive_flow(100);
+    send_messages(link, 1);
+    ASSERT_ARE_EQUAL(size_t, 0, settled_delivery_count);
+
+    // act
+    saved_on_send_complete(saved_on_send_complete_context, IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, settled_delivery_ids[0]);
+    ASSERT_IS_NULL(settled_delivery_states[0]);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(when_the_session_is_discarding_all_pending_deliveries_are_settled)
+{
+    // arrange
+    LINK_HANDLE link = create_sender_link();
+    attach_link(link);
+    receive_flow(100);
+    send_messages(link, 3);
+    receive_disposition(1, 1, TEST_ACCEPTED_STATE);
+    settled_delivery_count = 0;
+
+    // act
+    saved_on_session_state_changed(saved_link_endpoint_context, SESSION_STATE_DISCARDING, SESSION_STATE_MAPPED);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, settled_delivery_ids[0]);
+    ASSERT_ARE_EQUAL(uint32_t, 2, settled_delivery_ids[1]);
+    ASSERT_IS_NULL(settled_delivery_states[0]);
+    ASSERT_IS_NULL(settled_delivery_states[1]);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* reassembly */
+
+TEST_FUNCTION(link_set_on_transfer_segments_received_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_set_on_transfer_segments_received(NULL, test_on_transfer_segments_received);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(a_single_frame_transfer_is_reported_straight_from_the_frame)
+{
+    // arrange
+    unsigned char payload_bytes[] = { 'a', 'b', 'c' };
+    LINK_HANDLE link = create_receiver_link();
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_transfer_frame(0, false, payload_bytes, sizeof(payload_bytes));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, received_transfer_count);
+    ASSERT_ARE_EQUAL(void_ptr, payload_bytes, received_payload_bytes);
+    ASSERT_ARE_EQUAL(uint32_t, sizeof(payload_bytes), received_payload_size);
+    ASSERT_ARE_EQUAL(size_t, 0, realloc_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_frames_of_a_multi_frame_transfer_are_reported_as_one_payload)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_transfer_frame(0, true, (const unsigned char*)"ab", 2);
+    receive_transfer_frame(0, true, (const unsigned char*)"c", 1);
+    receive_transfer_frame(0, false, (const unsigned char*)"de", 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, received_transfer_count);
+    ASSERT_ARE_EQUAL(uint32_t, 5, received_payload_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_payload, "abcde", 5));
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_reassembly_buffer_grows_geometrically)
+{
+    // arrange
+    unsigned char payload_bytes[90] = { 0 };
+    LINK_HANDLE link = create_receiver_link();
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_multi_frame_transfer(0, payload_bytes, 10, 9);
+
+    // assert
+    /* 10, 20, 40, 80 and 160 bytes */
+    ASSERT_ARE_EQUAL(size_t, 5, realloc_count);
+    ASSERT_ARE_EQUAL(uint32_t, 90, received_payload_size);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(the_reassembly_buffer_is_kept_for_the_next_multi_frame_transfer)
+{
+    // arrange
+    unsigned char payload_bytes[50];
+    LINK_HANDLE link = create_receiver_link();
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+    (void)memset(payload_bytes, 'x', sizeof(payload_bytes));
+    receive_multi_frame_transfer(0, payload_bytes, 10, 5);
+    realloc_count = 0;
+    (void)memset(payload_bytes, 'y', sizeof(payload_bytes));
+
+    // act
+    receive_multi_frame_transfer(1, payload_bytes, 10, 5);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, realloc_count);
+    ASSERT_ARE_EQUAL(size_t, 2, received_transfer_count);
+    ASSERT_ARE_EQUAL(uint32_t, 50, received_payload_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_payload, payload_bytes, sizeof(payload_bytes)));
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_segments_mode_each_frame_is_reported_as_a_segment)
+{
+    // arrange
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_on_transfer_segments_received(link, test_on_transfer_segments_received);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_transfer_frame(0, true, (const unsigned char*)"ab", 2);
+    receive_transfer_frame(0, true, (const unsigned char*)"c", 1);
+    receive_transfer_frame(0, false, (const unsigned char*)"de", 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, received_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 3, received_segment_count);
+    ASSERT_ARE_EQUAL(uint32_t, 5, received_payload_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_payload, "abcde", 5));
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_segments_mode_a_single_frame_transfer_is_reported_straight_from_the_frame)
+{
+    // arrange
+    unsigned char payload_bytes[] = { 'a', 'b', 'c' };
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_on_transfer_segments_received(link, test_on_transfer_segments_received);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_transfer_frame(0, false, payload_bytes, sizeof(payload_bytes));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, received_segment_count);
+    ASSERT_ARE_EQUAL(void_ptr, payload_bytes, received_payload_bytes);
+    ASSERT_ARE_EQUAL(size_t, 0, realloc_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* streamed receive */
+
+TEST_FUNCTION(link_set_on_transfer_frame_received_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_set_on_transfer_frame_received(NULL, test_on_transfer_frame_received);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(in_streamed_mode_each_frame_is_reported_as_it_arrives)
+{
+    // arrange
+    unsigned char payload_bytes[30] = { 0 };
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_on_transfer_frame_received(link, test_on_transfer_frame_received);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_multi_frame_transfer(0, payload_bytes, 10, 3);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, received_frame_count);
+    ASSERT_IS_TRUE(received_frame_more[0]);
+    ASSERT_IS_TRUE(received_frame_more[1]);
+    ASSERT_IS_FALSE(received_frame_more[2]);
+    ASSERT_ARE_EQUAL(uint32_t, 10, received_frame_sizes[2]);
+    ASSERT_ARE_EQUAL(size_t, 0, received_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 0, realloc_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_streamed_mode_only_the_delivery_state_of_the_last_frame_is_sent)
+{
+    // arrange
+    unsigned char payload_bytes[30] = { 0 };
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_on_transfer_frame_received(link, test_on_transfer_frame_received);
+    attach_link(link);
+    test_frame_delivery_state_to_return = TEST_REJECTED_STATE;
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_multi_frame_transfer(0, payload_bytes, 10, 3);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, sent_disposition_state);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(in_streamed_mode_a_delivery_consumes_one_link_credit)
+{
+    // arrange
+    unsigned char payload_bytes[30] = { 0 };
+    LINK_HANDLE link = create_receiver_link();
+    (void)link_set_max_link_credit(link, 2);
+    (void)link_set_on_transfer_frame_received(link, test_on_transfer_frame_received);
+    attach_link(link);
+    test_delivery_state_to_return = TEST_ACCEPTED_STATE;
+
+    // act
+    receive_multi_frame_transfer(0, payload_bytes, 10, 3);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sent_flow_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+END_TEST_SUITE(link_ut)
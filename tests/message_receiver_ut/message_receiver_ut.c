@@ -0,0 +1,512 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/message_receiver.h"
+
+#define TEST_LINK_HANDLE                (LINK_HANDLE)0x4242
+#define TEST_MESSAGE_HANDLE             (MESSAGE_HANDLE)0x4243
+#define TEST_DECODER_HANDLE             (AMQPVALUE_DECODER_HANDLE)0x4244
+#define TEST_TRANSFER_HANDLE            (TRANSFER_HANDLE)0x4245
+#define TEST_CONTEXT                    (void*)0x4246
+#define TEST_ACCEPTED_STATE             (AMQP_VALUE)0x7000
+
+/* a header, a data section carrying "abcdef" and a footer; the test sections other than data are always 4 bytes long */
+static const unsigned char test_streamed_message[] =
+{
+    0x00, 0x53, 0x70, 0x45,
+    0x00, 0x53, 0x75, 0xA0, 0x06, 'a', 'b', 'c', 'd', 'e', 'f',
+    0x00, 0x53, 0x78, 0x45
+};
+#define TEST_DATA_POSITION              9
+
+static ON_TRANSFER_FRAME_RECEIVED saved_on_transfer_frame_received;
+static void* saved_link_callback_context;
+
+/* 'd' for every decoded section, 'S' when the sections ahead of the body are reported, 'C' for every body chunk and 'M' for every message */
+static char events[128];
+static unsigned char received_body[64];
+static size_t received_body_length;
+static const unsigned char* first_body_chunk;
+static MESSAGE_RECEIVER_STATE last_message_receiver_state;
+
+static void append_event(char event)
+{
+    size_t length = strlen(events);
+    if (length < sizeof(events) - 1)
+    {
+        events[length] = event;
+        events[length + 1] = '\0';
+    }
+}
+
+MOCK_FUNCTION_WITH_CODE(, AMQP_VALUE, test_on_message_received, const void*, context, MESSAGE_HANDLE, message)
+    append_event('M');
+MOCK_FUNCTION_END(TEST_ACCEPTED_STATE);
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_sections_received, const void*, context, MESSAGE_HANDLE, message)
+    append_event('S');
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_body_chunk_received, const void*, context, const unsigned char*, bytes, size_t, length)
+    if (received_body_length + length <= sizeof(received_body))
+    {
+        (void)memcpy(received_body + received_body_length, bytes, length);
+    }
+    if (first_body_chunk == NULL)
+    {
+        first_body_chunk = bytes;
+    }
+    received_body_length += length;
+    append_event('C');
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_receiver_state_changed, const void*, context, MESSAGE_RECEIVER_STATE, new_state, MESSAGE_RECEIVER_STATE, previous_state)
+    last_message_receiver_state = new_state;
+MOCK_FUNCTION_END();
+
+static int my_link_set_on_transfer_frame_received(LINK_HANDLE link, ON_TRANSFER_FRAME_RECEIVED on_transfer_frame_received)
+{
+    (void)link;
+    saved_on_transfer_frame_received = on_transfer_frame_received;
+    return 0;
+}
+
+static int my_link_attach(LINK_HANDLE link, ON_TRANSFER_RECEIVED on_transfer_received, ON_LINK_STATE_CHANGED on_link_state_changed, ON_LINK_FLOW_ON on_link_flow_on, void* callback_context)
+{
+    (void)link;
+    (void)on_transfer_received;
+    (void)on_link_state_changed;
+    (void)on_link_flow_on;
+    saved_link_callback_context = callback_context;
+    return 0;
+}
+
+static int my_amqpvalue_get_encoded_value_length(const unsigned char* bytes, size_t length, size_t* value_length)
+{
+    int result;
+    (void)bytes;
+
+    if (length < 4)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *value_length = 4;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int my_amqpvalue_decode_bytes(AMQPVALUE_DECODER_HANDLE handle, const unsigned char* buffer, size_t size)
+{
+    (void)handle;
+    (void)buffer;
+    (void)size;
+    append_event('d');
+    return 0;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static MESSAGE_RECEIVER_HANDLE create_streaming_message_receiver(void)
+{
+    MESSAGE_RECEIVER_HANDLE message_receiver = messagereceiver_create(TEST_LINK_HANDLE, test_on_message_receiver_state_changed, NULL);
+    (void)messagereceiver_set_streaming(message_receiver, test_on_message_sections_received, test_on_message_body_chunk_received);
+    (void)messagereceiver_open(message_receiver, test_on_message_received, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+    return message_receiver;
+}
+
+/* hands the message to the receiver in frames of frame_size bytes */
+static void receive_streamed_message(const unsigned char* message_bytes, size_t message_length, size_t frame_size)
+{
+    size_t position = 0;
+
+    do
+    {
+        size_t length = message_length - position;
+        if (length > frame_size)
+        {
+            length = frame_size;
+        }
+
+        (void)saved_on_transfer_frame_received(saved_link_callback_context, TEST_TRANSFER_HANDLE, (uint32_t)length, message_bytes + position, position + length < message_length);
+        position += length;
+    } while (position < message_length);
+}
+
+static void reset_received_message(void)
+{
+    events[0] = '\0';
+    received_body_length = 0;
+    first_body_chunk = NULL;
+}
+
+BEGIN_TEST_SUITE(message_receiver_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(link_set_on_transfer_frame_received, my_link_set_on_transfer_frame_received);
+    REGISTER_GLOBAL_MOCK_HOOK(link_attach, my_link_attach);
+    REGISTER_GLOBAL_MOCK_RETURN(message_create, TEST_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_decoder_create, TEST_DECODER_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_encoded_value_length, my_amqpvalue_get_encoded_value_length);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_decode_bytes, my_amqpvalue_decode_bytes);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_DECODER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_VALUE_DECODED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_FRAME_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_FLOW_ON, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_RECEIVER_STATE, int);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    saved_on_transfer_frame_received = NULL;
+    saved_link_callback_context = NULL;
+    last_message_receiver_state = MESSAGE_RECEIVER_STATE_IDLE;
+    reset_received_message();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* messagereceiver_set_streaming */
+
+TEST_FUNCTION(messagereceiver_set_streaming_with_NULL_message_receiver_fails)
+{
+    // arrange
+
+    // act
+    int result = messagereceiver_set_streaming(NULL, test_on_message_sections_received, test_on_message_body_chunk_received);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(messagereceiver_set_streaming_after_open_fails)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = messagereceiver_create(TEST_LINK_HANDLE, NULL, NULL);
+    (void)messagereceiver_open(message_receiver, test_on_message_received, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = messagereceiver_set_streaming(message_receiver, test_on_message_sections_received, test_on_message_body_chunk_received);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(messagereceiver_open_in_streaming_mode_takes_the_transfer_frames_of_the_link)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = messagereceiver_create(TEST_LINK_HANDLE, NULL, NULL);
+    (void)messagereceiver_set_streaming(message_receiver, test_on_message_sections_received, test_on_message_body_chunk_received);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(link_set_on_transfer_frame_received(TEST_LINK_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(link_attach(TEST_LINK_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    int result = messagereceiver_open(message_receiver, test_on_message_received, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+/* on_transfer_frame_received */
+
+TEST_FUNCTION(a_streamed_message_reports_its_sections_then_its_body_chunks_then_the_message)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    receive_streamed_message(test_streamed_message, sizeof(test_streamed_message), sizeof(test_streamed_message));
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "dSCdM", events);
+    ASSERT_ARE_EQUAL(size_t, 6, received_body_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_body, "abcdef", 6));
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(the_body_chunks_of_a_streamed_message_point_into_the_transfer_frame)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    receive_streamed_message(test_streamed_message, sizeof(test_streamed_message), sizeof(test_streamed_message));
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)(test_streamed_message + TEST_DATA_POSITION), (void*)first_body_chunk);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_streamed_message_split_at_any_point_across_frames_is_reported_the_same_way)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    size_t frame_size;
+
+    for (frame_size = 1; frame_size <= sizeof(test_streamed_message); frame_size++)
+    {
+        size_t i;
+        reset_received_message();
+
+        // act
+        receive_streamed_message(test_streamed_message, sizeof(test_streamed_message), frame_size);
+
+        // assert
+        ASSERT_ARE_EQUAL(size_t, 6, received_body_length);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(received_body, "abcdef", 6));
+        ASSERT_ARE_EQUAL(char, 'd', events[0]);
+        ASSERT_ARE_EQUAL(char, 'S', events[1]);
+        for (i = 2; events[i] == 'C'; i++)
+        {
+        }
+        ASSERT_ARE_EQUAL(char_ptr, "dM", events + i);
+        ASSERT_ARE_NOT_EQUAL(int, (int)MESSAGE_RECEIVER_STATE_ERROR, (int)last_message_receiver_state);
+    }
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_streamed_message_with_two_data_sections_reports_its_sections_once)
+{
+    // arrange
+    static const unsigned char two_data_sections[] =
+    {
+        0x00, 0x53, 0x70, 0x45,
+        0x00, 0x53, 0x75, 0xA0, 0x02, 'a', 'b',
+        0x00, 0x53, 0x75, 0xB0, 0x00, 0x00, 0x00, 0x03, 'c', 'd', 'e'
+    };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    receive_streamed_message(two_data_sections, sizeof(two_data_sections), sizeof(two_data_sections));
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "dSCCM", events);
+    ASSERT_ARE_EQUAL(size_t, 5, received_body_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_body, "abcde", 5));
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_streamed_message_without_a_data_body_reports_its_sections_ahead_of_the_body)
+{
+    // arrange
+    static const unsigned char amqp_value_body[] =
+    {
+        0x00, 0x53, 0x70, 0x45,
+        0x00, 0x53, 0x77, 0x45
+    };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    receive_streamed_message(amqp_value_body, sizeof(amqp_value_body), sizeof(amqp_value_body));
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "dSdM", events);
+    ASSERT_ARE_EQUAL(size_t, 0, received_body_length);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_transfer_that_ends_in_the_middle_of_a_section_puts_the_receiver_in_error)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    receive_streamed_message(test_streamed_message, sizeof(test_streamed_message) - 2, 5);
+
+    // assert
+    ASSERT_IS_NULL(strchr(events, 'M'));
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_RECEIVER_STATE_ERROR, (int)last_message_receiver_state);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_transfer_that_ends_in_the_middle_of_a_data_section_puts_the_receiver_in_error)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    receive_streamed_message(test_streamed_message, TEST_DATA_POSITION + 3, TEST_DATA_POSITION + 3);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "dSC", events);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_RECEIVER_STATE_ERROR, (int)last_message_receiver_state);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_transfer_that_is_not_a_section_is_dropped_until_its_last_frame)
+{
+    // arrange
+    static const unsigned char not_a_section[] = { 0x42, 0x42, 0x42, 0x42 };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    (void)saved_on_transfer_frame_received(saved_link_callback_context, TEST_TRANSFER_HANDLE, sizeof(not_a_section), not_a_section, true);
+    receive_streamed_message(test_streamed_message, sizeof(test_streamed_message), sizeof(test_streamed_message));
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "", events);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_RECEIVER_STATE_ERROR, (int)last_message_receiver_state);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(the_transfer_after_a_failed_one_is_received_again)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    receive_streamed_message(test_streamed_message, TEST_DATA_POSITION + 3, TEST_DATA_POSITION + 3);
+    reset_received_message();
+
+    // act
+    receive_streamed_message(test_streamed_message, sizeof(test_streamed_message), 7);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 6, received_body_length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_body, "abcdef", 6));
+    ASSERT_IS_NOT_NULL(strchr(events, 'M'));
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(the_result_of_on_message_received_is_the_delivery_state_of_a_streamed_message)
+{
+    // arrange
+    AMQP_VALUE delivery_state;
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    (void)saved_on_transfer_frame_received(saved_link_callback_context, TEST_TRANSFER_HANDLE, 10, test_streamed_message, true);
+
+    // act
+    delivery_state = saved_on_transfer_frame_received(saved_link_callback_context, TEST_TRANSFER_HANDLE, sizeof(test_streamed_message) - 10, test_streamed_message + 10, false);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_ACCEPTED_STATE, delivery_state);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+END_TEST_SUITE(message_receiver_ut)
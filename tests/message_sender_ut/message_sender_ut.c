@@ -0,0 +1,1255 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/amqpvalue_to_string.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/message_sender.h"
+
+/* every test message encodes to a single byte, the low byte of its handle */
+#define TEST_LINK_HANDLE                (LINK_HANDLE)0x4242
+#define TEST_MESSAGE_HANDLE_1           (MESSAGE_HANDLE)0x4301
+#define TEST_MESSAGE_HANDLE_2           (MESSAGE_HANDLE)0x4302
+#define TEST_MESSAGE_HANDLE_3           (MESSAGE_HANDLE)0x4303
+/* a message without a body, its body is streamed */
+#define TEST_STREAMED_MESSAGE_HANDLE    (MESSAGE_HANDLE)0x43AA
+#define TEST_MESSAGE_ENCODED_HANDLE_1   (MESSAGE_ENCODED_HANDLE)0x5201
+#define TEST_CONTEXT_1                  (void*)0x4401
+#define TEST_CONTEXT_2                  (void*)0x4402
+#define TEST_CONTEXT_3                  (void*)0x4403
+#define TEST_ACCEPTED_STATE             (AMQP_VALUE)0x7000
+#define TEST_REJECTED_STATE             (AMQP_VALUE)0x7001
+
+static ON_LINK_STATE_CHANGED saved_on_link_state_changed;
+static ON_LINK_FLOW_ON saved_on_link_flow_on;
+static void* saved_link_callback_context;
+static ON_LINK_DOWORK saved_on_link_dowork;
+static size_t link_request_dowork_call_count;
+
+/* number of transfers the link takes before it reports busy */
+static size_t test_link_credit;
+static LINK_TRANSFER_RESULT test_link_transfer_chunk_result;
+/* when set the transport completes every chunk from within link_transfer_chunk */
+static bool test_complete_chunks_synchronously;
+
+/* deliveries accepted by the link, with all their payloads concatenated */
+static unsigned char transferred_bytes[16][32];
+static size_t transferred_length[16];
+static size_t transfer_count;
+static ON_DELIVERY_SETTLED saved_on_delivery_settled[16];
+static void* saved_on_delivery_settled_context[16];
+static size_t delivery_count;
+
+/* chunks accepted by the link */
+static unsigned char chunk_bytes[16][32];
+static size_t chunk_length[16];
+static size_t chunk_payload_count[16];
+static bool chunk_more[16];
+static size_t chunk_count;
+static size_t link_transfer_chunk_call_count;
+static size_t link_abort_chunked_transfer_call_count;
+static ON_SEND_COMPLETE saved_on_chunk_sent;
+static void* saved_on_chunk_sent_context;
+
+/* calls made to read or encode a message */
+static size_t message_access_count;
+
+/* the bytes of an encoded message handle are the low byte of the handle */
+static unsigned char encoded_message_bytes[256];
+static size_t message_encoded_clone_count;
+static size_t message_encoded_destroy_count;
+static size_t message_encode_count;
+static size_t work_queued_count;
+static size_t executed_completion_count;
+
+static MESSAGE_SEND_RESULT send_complete_results[16];
+static void* send_complete_contexts[16];
+static size_t send_complete_count;
+
+static MESSAGE_SEND_RESULT batch_send_results[16];
+static size_t batch_send_result_count;
+static size_t batch_send_complete_count;
+
+static const unsigned char* stream_body;
+static size_t stream_body_length;
+static size_t stream_body_position;
+static size_t chunk_request_count;
+
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_sender_state_changed, void*, context, MESSAGE_SENDER_STATE, new_state, MESSAGE_SENDER_STATE, previous_state)
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_send_complete, void*, context, MESSAGE_SEND_RESULT, send_result)
+    if (send_complete_count < sizeof(send_complete_results) / sizeof(send_complete_results[0]))
+    {
+        send_complete_results[send_complete_count] = send_result;
+        send_complete_contexts[send_complete_count] = context;
+    }
+    send_complete_count++;
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_batch_send_complete, void*, context, const MESSAGE_SEND_RESULT*, send_results, size_t, message_count)
+    if (message_count <= sizeof(batch_send_results) / sizeof(batch_send_results[0]))
+    {
+        (void)memcpy(batch_send_results, send_results, message_count * sizeof(MESSAGE_SEND_RESULT));
+    }
+    batch_send_result_count = message_count;
+    batch_send_complete_count++;
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_work_queued, void*, context)
+    work_queued_count++;
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_completion_executor, void*, executor_context, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context, MESSAGE_SEND_RESULT, send_result)
+    executed_completion_count++;
+    on_message_send_complete(callback_context, send_result);
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, int, test_on_message_body_chunk_requested, void*, context, unsigned char*, buffer, size_t, buffer_size, size_t*, bytes_written, bool*, is_last_chunk)
+    size_t chunk_size = stream_body_length - stream_body_position;
+    if (chunk_size > buffer_size)
+    {
+        chunk_size = buffer_size;
+    }
+    (void)memcpy(buffer, stream_body + stream_body_position, chunk_size);
+    stream_body_position += chunk_size;
+    *bytes_written = chunk_size;
+    *is_last_chunk = (stream_body_position == stream_body_length);
+    chunk_request_count++;
+MOCK_FUNCTION_END(0);
+
+static int my_link_attach(LINK_HANDLE link, ON_TRANSFER_RECEIVED on_transfer_received, ON_LINK_STATE_CHANGED on_link_state_changed, ON_LINK_FLOW_ON on_link_flow_on, void* callback_context)
+{
+    (void)link;
+    (void)on_transfer_received;
+    saved_on_link_state_changed = on_link_state_changed;
+    saved_on_link_flow_on = on_link_flow_on;
+    saved_link_callback_context = callback_context;
+    return 0;
+}
+
+static int my_link_set_on_dowork(LINK_HANDLE link, ON_LINK_DOWORK on_link_dowork)
+{
+    (void)link;
+    saved_on_link_dowork = on_link_dowork;
+    return 0;
+}
+
+static int my_link_request_dowork(LINK_HANDLE link)
+{
+    (void)link;
+    link_request_dowork_call_count++;
+    return 0;
+}
+
+static size_t concatenate_payloads(unsigned char* destination, size_t destination_size, const PAYLOAD* payloads, size_t payload_count)
+{
+    size_t length = 0;
+    size_t i;
+
+    for (i = 0; i < payload_count; i++)
+    {
+        if (length + payloads[i].length <= destination_size)
+        {
+            (void)memcpy(destination + length, payloads[i].bytes, payloads[i].length);
+        }
+        length += payloads[i].length;
+    }
+
+    return length;
+}
+
+static void add_delivery(ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+    if (delivery_count < sizeof(saved_on_delivery_settled) / sizeof(saved_on_delivery_settled[0]))
+    {
+        saved_on_delivery_settled[delivery_count] = on_delivery_settled;
+        saved_on_delivery_settled_context[delivery_count] = callback_context;
+    }
+    delivery_count++;
+}
+
+static LINK_TRANSFER_RESULT my_link_transfer(LINK_HANDLE link, message_format message_format, PAYLOAD* payloads, size_t payload_count, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+    LINK_TRANSFER_RESULT result;
+    (void)link;
+    (void)message_format;
+
+    if (test_link_credit == 0)
+    {
+        result = LINK_TRANSFER_BUSY;
+    }
+    else
+    {
+        test_link_credit--;
+        if (transfer_count < sizeof(transferred_bytes) / sizeof(transferred_bytes[0]))
+        {
+            transferred_length[transfer_count] = concatenate_payloads(transferred_bytes[transfer_count], sizeof(transferred_bytes[transfer_count]), payloads, payload_count);
+        }
+        transfer_count++;
+        add_delivery(on_delivery_settled, callback_context);
+        result = LINK_TRANSFER_OK;
+    }
+
+    return result;
+}
+
+static LINK_TRANSFER_RESULT my_link_transfer_chunk(LINK_HANDLE link, message_format message_format, PAYLOAD* payloads, size_t payload_count, bool more, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context, ON_SEND_COMPLETE on_chunk_sent, void* on_chunk_sent_context)
+{
+    (void)link;
+    (void)message_format;
+
+    link_transfer_chunk_call_count++;
+    if (test_link_transfer_chunk_result == LINK_TRANSFER_OK)
+    {
+        if (chunk_count < sizeof(chunk_bytes) / sizeof(chunk_bytes[0]))
+        {
+            chunk_length[chunk_count] = concatenate_payloads(chunk_bytes[chunk_count], sizeof(chunk_bytes[chunk_count]), payloads, payload_count);
+            chunk_payload_count[chunk_count] = payload_count;
+            chunk_more[chunk_count] = more;
+        }
+        chunk_count++;
+
+        if (!more)
+        {
+            add_delivery(on_delivery_settled, callback_context);
+        }
+
+        saved_on_chunk_sent = on_chunk_sent;
+        saved_on_chunk_sent_context = on_chunk_sent_context;
+        if (test_complete_chunks_synchronously)
+        {
+            on_chunk_sent(on_chunk_sent_context, IO_SEND_OK);
+        }
+    }
+
+    return test_link_transfer_chunk_result;
+}
+
+static int my_link_abort_chunked_transfer(LINK_HANDLE link)
+{
+    (void)link;
+    link_abort_chunked_transfer_call_count++;
+    return 0;
+}
+
+static MESSAGE_HANDLE my_message_clone(MESSAGE_HANDLE source_message)
+{
+    return source_message;
+}
+
+static int my_message_get_body_type(MESSAGE_HANDLE message, MESSAGE_BODY_TYPE* body_type)
+{
+    message_access_count++;
+    *body_type = (message == TEST_STREAMED_MESSAGE_HANDLE) ? MESSAGE_BODY_TYPE_NONE : MESSAGE_BODY_TYPE_VALUE;
+    return 0;
+}
+
+static int my_message_get_message_format(MESSAGE_HANDLE message, uint32_t* message_format)
+{
+    (void)message;
+    message_access_count++;
+    *message_format = 0;
+    return 0;
+}
+
+/* a streamed message only has a header, any other message only has an AMQP value body */
+static int my_message_get_header(MESSAGE_HANDLE message, HEADER_HANDLE* message_header)
+{
+    message_access_count++;
+    *message_header = (message == TEST_STREAMED_MESSAGE_HANDLE) ? (HEADER_HANDLE)message : NULL;
+    return 0;
+}
+
+static int my_message_get_message_annotations(MESSAGE_HANDLE message, annotations* message_annotations)
+{
+    (void)message;
+    message_access_count++;
+    *message_annotations = NULL;
+    return 0;
+}
+
+static int my_message_get_properties(MESSAGE_HANDLE message, PROPERTIES_HANDLE* properties)
+{
+    (void)message;
+    message_access_count++;
+    *properties = NULL;
+    return 0;
+}
+
+static int my_message_get_application_properties(MESSAGE_HANDLE message, AMQP_VALUE* application_properties)
+{
+    (void)message;
+    message_access_count++;
+    *application_properties = NULL;
+    return 0;
+}
+
+static int my_message_get_inplace_body_amqp_value(MESSAGE_HANDLE message, AMQP_VALUE* body_amqp_value)
+{
+    message_access_count++;
+    *body_amqp_value = (AMQP_VALUE)message;
+    return 0;
+}
+
+static int my_message_encode_append(MESSAGE_HANDLE message, unsigned char** buffer, size_t* buffer_size, size_t* buffer_length)
+{
+    int result;
+
+    message_access_count++;
+    if (*buffer_length + 1 > *buffer_size)
+    {
+        unsigned char* new_buffer = (unsigned char*)realloc(*buffer, *buffer_length + 1);
+        if (new_buffer != NULL)
+        {
+            *buffer = new_buffer;
+            *buffer_size = *buffer_length + 1;
+        }
+    }
+
+    if (*buffer_length + 1 > *buffer_size)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        (*buffer)[*buffer_length] = (unsigned char)((uintptr_t)message & 0xFF);
+        (*buffer_length)++;
+        result = 0;
+    }
+
+    return result;
+}
+
+static MESSAGE_ENCODED_HANDLE my_message_encode(MESSAGE_HANDLE message)
+{
+    message_access_count++;
+    message_encode_count++;
+    return (MESSAGE_ENCODED_HANDLE)(0x5200 | ((uintptr_t)message & 0xFF));
+}
+
+static MESSAGE_ENCODED_HANDLE my_message_encoded_clone(MESSAGE_ENCODED_HANDLE message_encoded)
+{
+    message_encoded_clone_count++;
+    return message_encoded;
+}
+
+static void my_message_encoded_destroy(MESSAGE_ENCODED_HANDLE message_encoded)
+{
+    (void)message_encoded;
+    message_encoded_destroy_count++;
+}
+
+static int my_message_encoded_get_bytes(MESSAGE_ENCODED_HANDLE message_encoded, const unsigned char** bytes, size_t* length)
+{
+    *bytes = &encoded_message_bytes[(uintptr_t)message_encoded & 0xFF];
+    *length = 1;
+    return 0;
+}
+
+static int my_message_encoded_get_message_format(MESSAGE_ENCODED_HANDLE message_encoded, uint32_t* message_format)
+{
+    (void)message_encoded;
+    *message_format = 0;
+    return 0;
+}
+
+static AMQP_VALUE my_amqpvalue_create_header(HEADER_HANDLE header)
+{
+    return (AMQP_VALUE)header;
+}
+
+static AMQP_VALUE my_amqpvalue_create_amqp_value(AMQP_VALUE value)
+{
+    return value;
+}
+
+static int my_amqpvalue_get_encoded_size(AMQP_VALUE value, size_t* encoded_size)
+{
+    (void)value;
+    *encoded_size = 1;
+    return 0;
+}
+
+static int my_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+    unsigned char encoded_byte = (unsigned char)((uintptr_t)value & 0xFF);
+    message_access_count++;
+    return encoder_output(context, &encoded_byte, 1);
+}
+
+static AMQP_VALUE my_amqpvalue_get_inplace_descriptor(AMQP_VALUE value)
+{
+    /* the test delivery states are their own descriptors */
+    return value;
+}
+
+static bool my_is_accepted_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    return descriptor == TEST_ACCEPTED_STATE;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+/* creates a message sender whose link is attached */
+static MESSAGE_SENDER_HANDLE create_open_message_sender(void)
+{
+    MESSAGE_SENDER_HANDLE message_sender = messagesender_create(TEST_LINK_HANDLE, test_on_message_sender_state_changed, NULL);
+    (void)messagesender_open(message_sender);
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ATTACHED, LINK_STATE_DETACHED);
+    umock_c_reset_all_calls();
+    return message_sender;
+}
+
+static void settle_delivery(size_t delivery_index, AMQP_VALUE delivery_state)
+{
+    saved_on_delivery_settled[delivery_index](saved_on_delivery_settled_context[delivery_index], (delivery_number)delivery_index, delivery_state);
+}
+
+static void set_stream_body(const unsigned char* body, size_t body_length)
+{
+    stream_body = body;
+    stream_body_length = body_length;
+    stream_body_position = 0;
+}
+
+BEGIN_TEST_SUITE(message_sender_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+    size_t i;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    for (i = 0; i < sizeof(encoded_message_bytes); i++)
+    {
+        encoded_message_bytes[i] = (unsigned char)i;
+    }
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(link_attach, my_link_attach);
+    REGISTER_GLOBAL_MOCK_HOOK(link_transfer, my_link_transfer);
+    REGISTER_GLOBAL_MOCK_HOOK(link_transfer_chunk, my_link_transfer_chunk);
+    REGISTER_GLOBAL_MOCK_HOOK(link_abort_chunked_transfer, my_link_abort_chunked_transfer);
+    REGISTER_GLOBAL_MOCK_HOOK(link_set_on_dowork, my_link_set_on_dowork);
+    REGISTER_GLOBAL_MOCK_HOOK(link_request_dowork, my_link_request_dowork);
+    REGISTER_GLOBAL_MOCK_HOOK(message_clone, my_message_clone);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_type, my_message_get_body_type);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_message_format, my_message_get_message_format);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_header, my_message_get_header);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_message_annotations, my_message_get_message_annotations);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_properties, my_message_get_properties);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_application_properties, my_message_get_application_properties);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_inplace_body_amqp_value, my_message_get_inplace_body_amqp_value);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encode_append, my_message_encode_append);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encode, my_message_encode);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encoded_clone, my_message_encoded_clone);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encoded_destroy, my_message_encoded_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encoded_get_bytes, my_message_encoded_get_bytes);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encoded_get_message_format, my_message_encoded_get_message_format);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_create_header, my_amqpvalue_create_header);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_create_amqp_value, my_amqpvalue_create_amqp_value);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_encoded_size, my_amqpvalue_get_encoded_size);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, my_amqpvalue_encode);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_inplace_descriptor, my_amqpvalue_get_inplace_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_accepted_type_by_descriptor, my_is_accepted_type_by_descriptor);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_ENCODED_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(annotations, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HEADER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PROPERTIES_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_FLOW_ON, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_DELIVERY_SETTLED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_DOWORK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_TRANSFER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_STATE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SENDER_STATE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SEND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_BODY_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IO_SEND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(message_format, uint32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(delivery_number, uint32_t);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    saved_on_link_state_changed = NULL;
+    saved_on_link_flow_on = NULL;
+    saved_link_callback_context = NULL;
+    saved_on_link_dowork = NULL;
+    link_request_dowork_call_count = 0;
+    test_link_credit = 1000;
+    test_link_transfer_chunk_result = LINK_TRANSFER_OK;
+    test_complete_chunks_synchronously = false;
+    transfer_count = 0;
+    delivery_count = 0;
+    chunk_count = 0;
+    link_transfer_chunk_call_count = 0;
+    link_abort_chunked_transfer_call_count = 0;
+    saved_on_chunk_sent = NULL;
+    saved_on_chunk_sent_context = NULL;
+    message_access_count = 0;
+    message_encoded_clone_count = 0;
+    message_encoded_destroy_count = 0;
+    message_encode_count = 0;
+    work_queued_count = 0;
+    executed_completion_count = 0;
+    send_complete_count = 0;
+    batch_send_result_count = 0;
+    batch_send_complete_count = 0;
+    set_stream_body(NULL, 0);
+    chunk_request_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* messagesender_send */
+
+TEST_FUNCTION(messages_sent_while_the_link_is_busy_go_out_in_order_once_it_flows_again)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_link_credit = 0;
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    test_link_credit = 1000;
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_2, test_on_message_send_complete, TEST_CONTEXT_2);
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_3, test_on_message_send_complete, TEST_CONTEXT_3);
+    ASSERT_ARE_EQUAL(size_t, 0, transfer_count);
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(int, 0x02, (int)transferred_bytes[1][0]);
+    ASSERT_ARE_EQUAL(int, 0x03, (int)transferred_bytes[2][0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messages_sent_before_the_sender_is_open_go_out_in_order_once_the_link_flows)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = messagesender_create(TEST_LINK_HANDLE, test_on_message_sender_state_changed, NULL);
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_2, test_on_message_send_complete, TEST_CONTEXT_2);
+    (void)messagesender_open(message_sender);
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ATTACHED, LINK_STATE_DETACHED);
+    ASSERT_ARE_EQUAL(size_t, 0, transfer_count);
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(int, 0x02, (int)transferred_bytes[1][0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_message_settled_out_of_order_completes_and_leaves_the_others_pending)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_2, test_on_message_send_complete, TEST_CONTEXT_2);
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_3, test_on_message_send_complete, TEST_CONTEXT_3);
+
+    // act
+    settle_delivery(1, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT_2, send_complete_contexts[0]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)send_complete_results[0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 3, send_complete_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT_1, send_complete_contexts[1]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)send_complete_results[1]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT_3, send_complete_contexts[2]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)send_complete_results[2]);
+}
+
+TEST_FUNCTION(a_rejected_message_completes_with_an_error)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // act
+    settle_delivery(0, TEST_REJECTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)send_complete_results[0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+}
+
+TEST_FUNCTION(a_message_sent_before_the_sender_is_open_is_not_read_again_when_it_goes_out)
+{
+    // arrange
+    size_t message_access_count_after_send;
+    MESSAGE_SENDER_HANDLE message_sender = messagesender_create(TEST_LINK_HANDLE, test_on_message_sender_state_changed, NULL);
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    message_access_count_after_send = message_access_count;
+    (void)messagesender_open(message_sender);
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ATTACHED, LINK_STATE_DETACHED);
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 1, transferred_length[0]);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(size_t, message_access_count_after_send, message_access_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_message_the_link_was_busy_for_is_not_encoded_again_when_it_goes_out)
+{
+    // arrange
+    size_t message_access_count_after_send;
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_link_credit = 0;
+    (void)messagesender_send(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    message_access_count_after_send = message_access_count;
+    test_link_credit = 1000;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 1, transferred_length[0]);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(size_t, message_access_count_after_send, message_access_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+/* messagesender_send_batch */
+
+TEST_FUNCTION(messagesender_send_batch_with_a_NULL_message_fails_and_sends_nothing)
+{
+    // arrange
+    MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE_1, NULL, TEST_MESSAGE_HANDLE_3 };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    int result = messagesender_send_batch(message_sender, messages, 3, test_on_message_batch_send_complete, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, transfer_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 0, batch_send_complete_count);
+}
+
+TEST_FUNCTION(messagesender_send_batch_sends_all_messages_and_completes_once_all_are_settled)
+{
+    // arrange
+    MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE_1, TEST_MESSAGE_HANDLE_2, TEST_MESSAGE_HANDLE_3 };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    int result = messagesender_send_batch(message_sender, messages, 3, test_on_message_batch_send_complete, TEST_CONTEXT_1);
+    settle_delivery(2, TEST_ACCEPTED_STATE);
+    settle_delivery(1, TEST_REJECTED_STATE);
+    ASSERT_ARE_EQUAL(size_t, 0, batch_send_complete_count);
+    settle_delivery(0, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 3, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(int, 0x02, (int)transferred_bytes[1][0]);
+    ASSERT_ARE_EQUAL(int, 0x03, (int)transferred_bytes[2][0]);
+    ASSERT_ARE_EQUAL(size_t, 1, batch_send_complete_count);
+    ASSERT_ARE_EQUAL(size_t, 3, batch_send_result_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)batch_send_results[0]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)batch_send_results[1]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)batch_send_results[2]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(the_rest_of_a_batch_is_sent_once_the_link_flows_again)
+{
+    // arrange
+    MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE_1, TEST_MESSAGE_HANDLE_2, TEST_MESSAGE_HANDLE_3 };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_link_credit = 1;
+    (void)messagesender_send_batch(message_sender, messages, 3, test_on_message_batch_send_complete, TEST_CONTEXT_1);
+    ASSERT_ARE_EQUAL(size_t, 1, transfer_count);
+    test_link_credit = 1000;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x02, (int)transferred_bytes[1][0]);
+    ASSERT_ARE_EQUAL(int, 0x03, (int)transferred_bytes[2][0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_batch_sent_before_the_sender_is_open_is_sent_once_the_link_flows)
+{
+    // arrange
+    MESSAGE_HANDLE messages[] = { TEST_MESSAGE_HANDLE_1, TEST_MESSAGE_HANDLE_2 };
+    MESSAGE_SENDER_HANDLE message_sender = messagesender_create(TEST_LINK_HANDLE, test_on_message_sender_state_changed, NULL);
+    (void)messagesender_send_batch(message_sender, messages, 2, test_on_message_batch_send_complete, TEST_CONTEXT_1);
+    (void)messagesender_open(message_sender);
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ATTACHED, LINK_STATE_DETACHED);
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(int, 0x02, (int)transferred_bytes[1][0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 1, batch_send_complete_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)batch_send_results[0]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)batch_send_results[1]);
+}
+
+/* messagesender_send_encoded */
+
+TEST_FUNCTION(messagesender_send_encoded_with_NULL_message_encoded_fails)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    int result = messagesender_send_encoded(message_sender, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messagesender_send_encoded_sends_the_encoded_bytes_and_releases_its_reference)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    int result = messagesender_send_encoded(message_sender, TEST_MESSAGE_ENCODED_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 1, transferred_length[0]);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(size_t, 1, message_encoded_clone_count);
+    ASSERT_ARE_EQUAL(size_t, 1, message_encoded_destroy_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(the_same_encoded_message_can_be_sent_on_two_message_senders)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender_1 = create_open_message_sender();
+    MESSAGE_SENDER_HANDLE message_sender_2 = create_open_message_sender();
+
+    // act
+    int result_1 = messagesender_send_encoded(message_sender_1, TEST_MESSAGE_ENCODED_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    int result_2 = messagesender_send_encoded(message_sender_2, TEST_MESSAGE_ENCODED_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result_1);
+    ASSERT_ARE_EQUAL(int, 0, result_2);
+    ASSERT_ARE_EQUAL(size_t, 2, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[1][0]);
+    ASSERT_ARE_EQUAL(size_t, 2, message_encoded_clone_count);
+    ASSERT_ARE_EQUAL(size_t, 2, message_encoded_destroy_count);
+
+    // cleanup
+    messagesender_destroy(message_sender_1);
+    messagesender_destroy(message_sender_2);
+}
+
+TEST_FUNCTION(an_encoded_message_the_link_is_busy_for_is_kept_until_the_link_flows_again)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_link_credit = 0;
+    (void)messagesender_send_encoded(message_sender, TEST_MESSAGE_ENCODED_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    ASSERT_ARE_EQUAL(size_t, 0, message_encoded_destroy_count);
+    test_link_credit = 1000;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(size_t, 1, message_encoded_destroy_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(an_encoded_message_still_pending_is_released_when_the_sender_is_destroyed)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_link_credit = 0;
+    (void)messagesender_send_encoded(message_sender, TEST_MESSAGE_ENCODED_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // act
+    messagesender_destroy(message_sender);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, message_encoded_destroy_count);
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)send_complete_results[0]);
+}
+
+/* messagesender_send_streamed */
+
+TEST_FUNCTION(messagesender_send_streamed_with_NULL_chunk_callback_fails)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    int result = messagesender_send_streamed(message_sender, TEST_STREAMED_MESSAGE_HANDLE, NULL, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messagesender_send_streamed_with_a_message_that_has_a_body_fails)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    int result = messagesender_send_streamed(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_body_chunk_requested, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, chunk_request_count);
+    ASSERT_ARE_EQUAL(size_t, 0, link_transfer_chunk_call_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messagesender_send_streamed_sends_the_body_as_data_sections_of_one_delivery)
+{
+    // arrange
+    static const unsigned char body[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    static const unsigned char first_chunk[] = { 0xAA, 0x00, 0x53, 0x75, 0xA0, 0x04, '0', '1', '2', '3' };
+    static const unsigned char second_chunk[] = { 0x00, 0x53, 0x75, 0xA0, 0x04, '4', '5', '6', '7' };
+    static const unsigned char last_chunk[] = { 0x00, 0x53, 0x75, 0xA0, 0x02, '8', '9' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_set_max_stream_chunk_size(message_sender, 4);
+    set_stream_body(body, sizeof(body));
+    test_complete_chunks_synchronously = true;
+
+    // act
+    int result = messagesender_send_streamed(message_sender, TEST_STREAMED_MESSAGE_HANDLE, test_on_message_body_chunk_requested, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 3, chunk_count);
+    ASSERT_ARE_EQUAL(size_t, 2, chunk_payload_count[0]);
+    ASSERT_ARE_EQUAL(size_t, sizeof(first_chunk), chunk_length[0]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(chunk_bytes[0], first_chunk, sizeof(first_chunk)));
+    ASSERT_IS_TRUE(chunk_more[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, chunk_payload_count[1]);
+    ASSERT_ARE_EQUAL(size_t, sizeof(second_chunk), chunk_length[1]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(chunk_bytes[1], second_chunk, sizeof(second_chunk)));
+    ASSERT_IS_TRUE(chunk_more[1]);
+    ASSERT_ARE_EQUAL(size_t, sizeof(last_chunk), chunk_length[2]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(chunk_bytes[2], last_chunk, sizeof(last_chunk)));
+    ASSERT_IS_FALSE(chunk_more[2]);
+    ASSERT_ARE_EQUAL(size_t, 0, send_complete_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_streamed_message_completes_when_its_delivery_is_settled)
+{
+    // arrange
+    static const unsigned char body[] = { '0', '1', '2', '3', '4', '5' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_set_max_stream_chunk_size(message_sender, 4);
+    set_stream_body(body, sizeof(body));
+    test_complete_chunks_synchronously = true;
+    (void)messagesender_send_streamed(message_sender, TEST_STREAMED_MESSAGE_HANDLE, test_on_message_body_chunk_requested, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // act
+    settle_delivery(0, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, delivery_count);
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)send_complete_results[0]);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT_1, send_complete_contexts[0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(the_next_body_chunk_is_only_pulled_once_the_previous_one_was_sent)
+{
+    // arrange
+    static const unsigned char body[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_set_max_stream_chunk_size(message_sender, 4);
+    set_stream_body(body, sizeof(body));
+    (void)messagesender_send_streamed(message_sender, TEST_STREAMED_MESSAGE_HANDLE, test_on_message_body_chunk_requested, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+    ASSERT_ARE_EQUAL(size_t, 1, chunk_request_count);
+    ASSERT_ARE_EQUAL(size_t, 1, chunk_count);
+
+    // act
+    saved_on_chunk_sent(saved_on_chunk_sent_context, IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, chunk_request_count);
+    ASSERT_ARE_EQUAL(size_t, 2, chunk_count);
+    ASSERT_IS_TRUE(chunk_more[1]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_body_chunk_the_link_is_busy_for_is_sent_once_the_link_flows_again)
+{
+    // arrange
+    static const unsigned char body[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    static const unsigned char first_chunk[] = { 0xAA, 0x00, 0x53, 0x75, 0xA0, 0x04, '0', '1', '2', '3' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_set_max_stream_chunk_size(message_sender, 4);
+    set_stream_body(body, sizeof(body));
+    test_link_transfer_chunk_result = LINK_TRANSFER_BUSY;
+    (void)messagesender_send_streamed(message_sender, TEST_STREAMED_MESSAGE_HANDLE, test_on_message_body_chunk_requested, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+    test_link_transfer_chunk_result = LINK_TRANSFER_OK;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, link_transfer_chunk_call_count);
+    ASSERT_ARE_EQUAL(size_t, 1, chunk_request_count);
+    ASSERT_ARE_EQUAL(size_t, 1, chunk_count);
+    ASSERT_ARE_EQUAL(size_t, sizeof(first_chunk), chunk_length[0]);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(chunk_bytes[0], first_chunk, sizeof(first_chunk)));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_body_chunk_that_fails_to_be_sent_aborts_the_delivery)
+{
+    // arrange
+    static const unsigned char body[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_set_max_stream_chunk_size(message_sender, 4);
+    set_stream_body(body, sizeof(body));
+    (void)messagesender_send_streamed(message_sender, TEST_STREAMED_MESSAGE_HANDLE, test_on_message_body_chunk_requested, NULL, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // act
+    saved_on_chunk_sent(saved_on_chunk_sent_context, IO_SEND_ERROR);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, link_abort_chunked_transfer_call_count);
+    ASSERT_ARE_EQUAL(size_t, 1, chunk_request_count);
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)send_complete_results[0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+}
+
+/* messagesender_enqueue */
+
+TEST_FUNCTION(messagesender_enqueue_without_a_send_queue_fails)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    MESSAGE_ENQUEUE_RESULT result = messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_ENQUEUE_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messagesender_enqueue_requests_a_dowork_only_once_until_the_queue_is_drained)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_enable_send_queue(message_sender, 4, test_on_work_queued, NULL);
+
+    // act
+    MESSAGE_ENQUEUE_RESULT result_1 = messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    MESSAGE_ENQUEUE_RESULT result_2 = messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_2, test_on_message_send_complete, TEST_CONTEXT_2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_ENQUEUE_OK, (int)result_1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_ENQUEUE_OK, (int)result_2);
+    ASSERT_ARE_EQUAL(size_t, 2, message_encode_count);
+    ASSERT_ARE_EQUAL(size_t, 1, link_request_dowork_call_count);
+    ASSERT_ARE_EQUAL(size_t, 1, work_queued_count);
+    ASSERT_ARE_EQUAL(size_t, 0, transfer_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_message_enqueued_on_an_idle_connection_gets_sent_on_the_requested_dowork)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_enable_send_queue(message_sender, 4, test_on_work_queued, NULL);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    ASSERT_ARE_EQUAL(size_t, 1, link_request_dowork_call_count);
+
+    // act
+    saved_on_link_dowork(saved_link_callback_context);
+    settle_delivery(0, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT_1, send_complete_contexts[0]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)send_complete_results[0]);
+    ASSERT_ARE_EQUAL(size_t, message_encode_count + message_encoded_clone_count, message_encoded_destroy_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_message_enqueued_after_the_queue_was_drained_requests_a_dowork_again)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_enable_send_queue(message_sender, 4, test_on_work_queued, NULL);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    saved_on_link_dowork(saved_link_callback_context);
+
+    // act
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_2, test_on_message_send_complete, TEST_CONTEXT_2);
+    saved_on_link_dowork(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, link_request_dowork_call_count);
+    ASSERT_ARE_EQUAL(size_t, 2, work_queued_count);
+    ASSERT_ARE_EQUAL(size_t, 2, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x02, (int)transferred_bytes[1][0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messages_enqueued_before_the_sender_is_opened_go_out_once_the_link_flows)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = messagesender_create(TEST_LINK_HANDLE, test_on_message_sender_state_changed, NULL);
+    (void)messagesender_enable_send_queue(message_sender, 4, NULL, NULL);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_2, test_on_message_send_complete, TEST_CONTEXT_2);
+    (void)messagesender_open(message_sender);
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ATTACHED, LINK_STATE_DETACHED);
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, transfer_count);
+    ASSERT_ARE_EQUAL(int, 0x01, (int)transferred_bytes[0][0]);
+    ASSERT_ARE_EQUAL(int, 0x02, (int)transferred_bytes[1][0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messagesender_enqueue_on_a_full_send_queue_returns_FULL)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_enable_send_queue(message_sender, 2, NULL, NULL);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_2, test_on_message_send_complete, TEST_CONTEXT_2);
+
+    // act
+    MESSAGE_ENQUEUE_RESULT result = messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_3, test_on_message_send_complete, TEST_CONTEXT_3);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_ENQUEUE_FULL, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 2, message_encode_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messagesender_destroy_completes_the_messages_still_enqueued_with_an_error)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_enable_send_queue(message_sender, 4, NULL, NULL);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+
+    // act
+    messagesender_destroy(message_sender);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT_1, send_complete_contexts[0]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)send_complete_results[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, message_encoded_destroy_count);
+}
+
+TEST_FUNCTION(completions_of_enqueued_messages_go_through_the_completion_executor)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    (void)messagesender_enable_send_queue(message_sender, 4, NULL, NULL);
+    (void)messagesender_set_completion_executor(message_sender, test_completion_executor, NULL);
+    (void)messagesender_enqueue(message_sender, TEST_MESSAGE_HANDLE_1, test_on_message_send_complete, TEST_CONTEXT_1);
+    saved_on_link_dowork(saved_link_callback_context);
+
+    // act
+    settle_delivery(0, TEST_ACCEPTED_STATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, executed_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 1, send_complete_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT_1, send_complete_contexts[0]);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)send_complete_results[0]);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+END_TEST_SUITE(message_sender_ut)
@@ -4,12 +4,15 @@
 #ifdef __cplusplus
 #include <cstdlib>
 #include <cstddef>
+#include <cstring>
 #else
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #endif
 #include "testrunnerswitcher.h"
 #include "umock_c.h"
+#include "umocktypes_stdint.h"
 
 static void* my_gballoc_malloc(size_t size)
 {
@@ -48,6 +51,348 @@ static const AMQP_VALUE cloned_application_properties = (AMQP_VALUE)0x4250;
 static const AMQP_VALUE custom_footer = (AMQP_VALUE)0x4251;
 static const AMQP_VALUE cloned_footer = (AMQP_VALUE)0x4252;
 static const AMQP_VALUE test_cloned_amqp_value = (AMQP_VALUE)0x4300;
+static const HEADER_HANDLE test_cloned_header = (HEADER_HANDLE)0x4301;
+static const AMQP_VALUE test_header_amqp_value = (AMQP_VALUE)0x4302;
+static const AMQP_VALUE test_application_properties_amqp_value = (AMQP_VALUE)0x4303;
+static const AMQP_VALUE test_message_id_amqp_value = (AMQP_VALUE)0x4304;
+
+/* what amqpvalue_encode produces for the sections used by the encoding tests */
+static const unsigned char test_encoded_header[] = { 0x00, 0x53, 0x70, 0xC0, 0x02, 0x01, 0x41 };
+static const unsigned char test_encoded_message_annotations[] = { 0x00, 0x53, 0x72, 0xC1, 0x0A, 0x02, 0xA3, 0x05, 'x', '-', 'o', 'p', 't', 0x54, 0x2A };
+static const unsigned char test_encoded_application_properties[] = { 0x00, 0x53, 0x74, 0xC1, 0x07, 0x02, 0xA1, 0x01, 'k', 0xA1, 0x01, 'v' };
+
+/* offsets of the message-id and creation-time values in the encoded properties */
+#define TEST_PROPERTIES_MESSAGE_ID_OFFSET       7
+#define TEST_PROPERTIES_CREATION_TIME_OFFSET    24
+
+typedef enum TEST_MESSAGE_ID_ENCODING_TAG
+{
+    TEST_MESSAGE_ID_ENCODING_ULONG,
+    TEST_MESSAGE_ID_ENCODING_UINT,
+    TEST_MESSAGE_ID_ENCODING_STRING
+} TEST_MESSAGE_ID_ENCODING;
+
+/* properties handles given to the message are fakes that only hold the fields a template patches */
+typedef struct TEST_PROPERTIES_TAG
+{
+    uint64_t message_id;
+    timestamp creation_time;
+} TEST_PROPERTIES;
+
+static TEST_PROPERTIES test_properties[8];
+static size_t test_properties_count;
+static uint64_t test_created_message_id;
+static TEST_MESSAGE_ID_ENCODING test_message_id_encoding;
+
+static PROPERTIES_HANDLE my_properties_clone(PROPERTIES_HANDLE value)
+{
+    TEST_PROPERTIES* result = &test_properties[test_properties_count++];
+    *result = *(TEST_PROPERTIES*)value;
+    return (PROPERTIES_HANDLE)result;
+}
+
+static AMQP_VALUE my_amqpvalue_create_properties(PROPERTIES_HANDLE properties)
+{
+    return (AMQP_VALUE)properties;
+}
+
+static AMQP_VALUE my_amqpvalue_create_message_id_ulong(message_id_ulong value)
+{
+    test_created_message_id = value;
+    return test_message_id_amqp_value;
+}
+
+static int my_properties_set_message_id(PROPERTIES_HANDLE properties, AMQP_VALUE message_id_value)
+{
+    (void)message_id_value;
+    ((TEST_PROPERTIES*)properties)->message_id = test_created_message_id;
+    return 0;
+}
+
+static int my_properties_set_creation_time(PROPERTIES_HANDLE properties, timestamp creation_time_value)
+{
+    ((TEST_PROPERTIES*)properties)->creation_time = creation_time_value;
+    return 0;
+}
+
+static AMQP_VALUE my_amqpvalue_clone(AMQP_VALUE value)
+{
+    AMQP_VALUE result;
+
+    if (value == custom_message_annotations)
+    {
+        result = cloned_message_annotations;
+    }
+    else if (value == custom_application_properties)
+    {
+        result = cloned_application_properties;
+    }
+    else
+    {
+        result = test_cloned_amqp_value;
+    }
+
+    return result;
+}
+
+static void put_big_endian(unsigned char* position, uint64_t value, size_t size)
+{
+    size_t i;
+
+    for (i = size; i > 0; i--)
+    {
+        position[i - 1] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+/* message-id, the 8 fields up to absolute-expiry-time left empty, then creation-time */
+static size_t get_test_properties_encoding(const TEST_PROPERTIES* properties, unsigned char* buffer)
+{
+    size_t length = 0;
+    size_t i;
+
+    buffer[length++] = 0x00;
+    buffer[length++] = 0x53;
+    buffer[length++] = 0x73;
+    buffer[length++] = 0xC0;
+    length++;
+    buffer[length++] = 0x0A;
+
+    switch (test_message_id_encoding)
+    {
+    default:
+    case TEST_MESSAGE_ID_ENCODING_ULONG:
+        buffer[length++] = 0x80;
+        put_big_endian(buffer + length, properties->message_id, 8);
+        length += 8;
+        break;
+    case TEST_MESSAGE_ID_ENCODING_UINT:
+        buffer[length++] = 0x70;
+        put_big_endian(buffer + length, properties->message_id, 4);
+        length += 4;
+        break;
+    case TEST_MESSAGE_ID_ENCODING_STRING:
+        buffer[length++] = 0xA1;
+        buffer[length] = (unsigned char)sprintf((char*)buffer + length + 1, "%llu", (unsigned long long)properties->message_id);
+        length += 1 + buffer[length];
+        break;
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        buffer[length++] = 0x40;
+    }
+
+    buffer[length++] = 0x83;
+    put_big_endian(buffer + length, (uint64_t)properties->creation_time, 8);
+    length += 8;
+
+    buffer[4] = (unsigned char)(length - 5);
+    return length;
+}
+
+static size_t get_test_encoding(AMQP_VALUE value, unsigned char* buffer)
+{
+    size_t result;
+
+    if (value == test_header_amqp_value)
+    {
+        (void)memcpy(buffer, test_encoded_header, sizeof(test_encoded_header));
+        result = sizeof(test_encoded_header);
+    }
+    else if (value == cloned_message_annotations)
+    {
+        (void)memcpy(buffer, test_encoded_message_annotations, sizeof(test_encoded_message_annotations));
+        result = sizeof(test_encoded_message_annotations);
+    }
+    else if (value == test_application_properties_amqp_value)
+    {
+        (void)memcpy(buffer, test_encoded_application_properties, sizeof(test_encoded_application_properties));
+        result = sizeof(test_encoded_application_properties);
+    }
+    else if (((const TEST_PROPERTIES*)value >= test_properties) &&
+        ((const TEST_PROPERTIES*)value < test_properties + sizeof(test_properties) / sizeof(test_properties[0])))
+    {
+        result = get_test_properties_encoding((const TEST_PROPERTIES*)value, buffer);
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static int my_amqpvalue_get_encoded_size(AMQP_VALUE value, size_t* encoded_size)
+{
+    unsigned char buffer[64];
+    int result;
+
+    *encoded_size = get_test_encoding(value, buffer);
+    if (*encoded_size == 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static int my_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+    unsigned char buffer[64];
+    size_t length = get_test_encoding(value, buffer);
+    int result;
+
+    if (length == 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        result = encoder_output(context, buffer, length);
+    }
+
+    return result;
+}
+
+/* enough of amqpvalue_get_encoded_value_length for the payloads of the lazy decoding tests */
+static int my_amqpvalue_get_encoded_value_length(const unsigned char* bytes, size_t length, size_t* value_length)
+{
+    int result;
+
+    if (length == 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+
+        switch (bytes[0])
+        {
+        default:
+            result = __LINE__;
+            break;
+        case 0x00:
+        {
+            size_t descriptor_length;
+            size_t described_length;
+
+            if ((my_amqpvalue_get_encoded_value_length(bytes + 1, length - 1, &descriptor_length) != 0) ||
+                (my_amqpvalue_get_encoded_value_length(bytes + 1 + descriptor_length, length - 1 - descriptor_length, &described_length) != 0))
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *value_length = 1 + descriptor_length + described_length;
+            }
+            break;
+        }
+        case 0x40:
+        case 0x41:
+        case 0x42:
+        case 0x44:
+        case 0x45:
+            *value_length = 1;
+            break;
+        case 0x53:
+        case 0x54:
+            *value_length = 2;
+            break;
+        case 0x70:
+            *value_length = 5;
+            break;
+        case 0x80:
+        case 0x83:
+            *value_length = 9;
+            break;
+        case 0xA0:
+        case 0xA1:
+        case 0xA3:
+        case 0xC0:
+        case 0xC1:
+            if (length < 2)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *value_length = 2 + bytes[1];
+            }
+            break;
+        case 0xB0:
+        case 0xB1:
+        case 0xB3:
+        case 0xD0:
+        case 0xD1:
+            if (length < 5)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *value_length = 5 + (((size_t)bytes[1] << 24) | ((size_t)bytes[2] << 16) | ((size_t)bytes[3] << 8) | (size_t)bytes[4]);
+            }
+            break;
+        }
+
+        if ((result == 0) &&
+            (*value_length > length))
+        {
+            result = __LINE__;
+        }
+    }
+
+    return result;
+}
+
+/* a message with a header, message annotations, properties and application properties */
+static MESSAGE_HANDLE create_message_with_sections(uint64_t message_id, timestamp creation_time)
+{
+    MESSAGE_HANDLE message = message_create();
+    TEST_PROPERTIES properties;
+
+    properties.message_id = message_id;
+    properties.creation_time = creation_time;
+    (void)message_set_header(message, custom_message_header);
+    (void)message_set_message_annotations(message, custom_message_annotations);
+    (void)message_set_properties(message, (PROPERTIES_HANDLE)&properties);
+    (void)message_set_application_properties(message, custom_application_properties);
+
+    return message;
+}
+
+/* the sections of create_message_with_sections encoded one by one, the way the sender used to encode them */
+static size_t get_expected_sections_encoding(uint64_t message_id, timestamp creation_time, unsigned char* buffer)
+{
+    TEST_PROPERTIES properties;
+    size_t length = 0;
+
+    properties.message_id = message_id;
+    properties.creation_time = creation_time;
+
+    (void)memcpy(buffer + length, test_encoded_header, sizeof(test_encoded_header));
+    length += sizeof(test_encoded_header);
+    (void)memcpy(buffer + length, test_encoded_message_annotations, sizeof(test_encoded_message_annotations));
+    length += sizeof(test_encoded_message_annotations);
+    length += get_test_properties_encoding(&properties, buffer + length);
+    (void)memcpy(buffer + length, test_encoded_application_properties, sizeof(test_encoded_application_properties));
+    length += sizeof(test_encoded_application_properties);
+
+    return length;
+}
+
+static size_t append_expected_bytes(unsigned char* buffer, size_t length, const unsigned char* bytes, size_t count)
+{
+    (void)memcpy(buffer + length, bytes, count);
+    return length + count;
+}
 
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -65,16 +410,38 @@ BEGIN_TEST_SUITE(message_ut)
 
 TEST_SUITE_INITIALIZE(suite_init)
 {
+    int result;
+
     TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
     g_testByTest = TEST_MUTEX_CREATE();
     ASSERT_IS_NOT_NULL(g_testByTest);
 
     umock_c_init(on_umock_c_error);
 
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Failed registering stdint types");
+
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_RETURN(header_clone, test_cloned_header);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_header, test_header_amqp_value);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_application_properties, test_application_properties_amqp_value);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_clone, my_amqpvalue_clone);
+    REGISTER_GLOBAL_MOCK_HOOK(properties_clone, my_properties_clone);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_create_properties, my_amqpvalue_create_properties);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_create_message_id_ulong, my_amqpvalue_create_message_id_ulong);
+    REGISTER_GLOBAL_MOCK_HOOK(properties_set_message_id, my_properties_set_message_id);
+    REGISTER_GLOBAL_MOCK_HOOK(properties_set_creation_time, my_properties_set_creation_time);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_encoded_size, my_amqpvalue_get_encoded_size);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, my_amqpvalue_encode);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_encoded_value_length, my_amqpvalue_get_encoded_value_length);
     REGISTER_UMOCK_ALIAS_TYPE(HEADER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PROPERTIES_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(message_id_ulong, uint64_t);
+    REGISTER_UMOCK_ALIAS_TYPE(timestamp, int64_t);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -93,6 +460,9 @@ TEST_FUNCTION_INITIALIZE(test_init)
     }
 
     umock_c_reset_all_calls();
+    test_properties_count = 0;
+    test_created_message_id = 0;
+    test_message_id_encoding = TEST_MESSAGE_ID_ENCODING_ULONG;
 }
 
 TEST_FUNCTION_CLEANUP(test_cleanup)
@@ -250,4 +620,460 @@ TEST_FUNCTION(when_allocating_memory_fails_then_message_clone_fails)
 	message_destroy(source_message);
 }
 
+/* message_encode */
+
+TEST_FUNCTION(message_encode_produces_the_same_bytes_as_encoding_each_section_and_each_data_body_chunk_with_amqpvalue_encode)
+{
+	// arrange
+	MESSAGE_HANDLE message = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	static const unsigned char vbin8_1_prefix[] = { 0x00, 0x53, 0x75, 0xA0, 0x01 };
+	static const unsigned char vbin8_255_prefix[] = { 0x00, 0x53, 0x75, 0xA0, 0xFF };
+	static const unsigned char vbin32_256_prefix[] = { 0x00, 0x53, 0x75, 0xB0, 0x00, 0x00, 0x01, 0x00 };
+	unsigned char chunk[256];
+	unsigned char expected[1024];
+	size_t expected_length;
+	BINARY_DATA binary_data;
+	const unsigned char* bytes;
+	size_t length;
+	size_t i;
+
+	for (i = 0; i < sizeof(chunk); i++)
+	{
+		chunk[i] = (unsigned char)i;
+	}
+
+	binary_data.bytes = chunk;
+	binary_data.length = 1;
+	(void)message_add_body_amqp_data(message, binary_data);
+	binary_data.length = 255;
+	(void)message_add_body_amqp_data(message, binary_data);
+	binary_data.length = 256;
+	(void)message_add_body_amqp_data(message, binary_data);
+
+	/* data sections as amqpvalue_create_data and amqpvalue_encode framed them, vbin8 up to 255 bytes and vbin32 above */
+	expected_length = get_expected_sections_encoding(0x0102030405060708ULL, 0x1112131415161718LL, expected);
+	expected_length = append_expected_bytes(expected, expected_length, vbin8_1_prefix, sizeof(vbin8_1_prefix));
+	expected_length = append_expected_bytes(expected, expected_length, chunk, 1);
+	expected_length = append_expected_bytes(expected, expected_length, vbin8_255_prefix, sizeof(vbin8_255_prefix));
+	expected_length = append_expected_bytes(expected, expected_length, chunk, 255);
+	expected_length = append_expected_bytes(expected, expected_length, vbin32_256_prefix, sizeof(vbin32_256_prefix));
+	expected_length = append_expected_bytes(expected, expected_length, chunk, 256);
+
+	// act
+	MESSAGE_ENCODED_HANDLE message_encoded = message_encode(message);
+
+	// assert
+	ASSERT_IS_NOT_NULL(message_encoded);
+	ASSERT_ARE_EQUAL(int, 0, message_encoded_get_bytes(message_encoded, &bytes, &length));
+	ASSERT_ARE_EQUAL(size_t, expected_length, length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected, bytes, length));
+
+	// cleanup
+	message_encoded_destroy(message_encoded);
+	message_destroy(message);
+}
+
+TEST_FUNCTION(message_encode_append_appends_the_same_bytes_as_message_encode)
+{
+	// arrange
+	MESSAGE_HANDLE message = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	unsigned char body[3] = { 0x42, 0x43, 0x44 };
+	BINARY_DATA binary_data = { body, sizeof(body) };
+	MESSAGE_ENCODED_HANDLE message_encoded;
+	unsigned char* buffer = NULL;
+	size_t buffer_size = 0;
+	size_t buffer_length = 0;
+	const unsigned char* bytes;
+	size_t length;
+
+	(void)message_add_body_amqp_data(message, binary_data);
+	message_encoded = message_encode(message);
+	(void)message_encoded_get_bytes(message_encoded, &bytes, &length);
+
+	// act
+	int result1 = message_encode_append(message, &buffer, &buffer_size, &buffer_length);
+	int result2 = message_encode_append(message, &buffer, &buffer_size, &buffer_length);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result1);
+	ASSERT_ARE_EQUAL(int, 0, result2);
+	ASSERT_ARE_EQUAL(size_t, 2 * length, buffer_length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(bytes, buffer, length));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(bytes, buffer + length, length));
+
+	// cleanup
+	free(buffer);
+	message_encoded_destroy(message_encoded);
+	message_destroy(message);
+}
+
+/* message_template_create */
+
+TEST_FUNCTION(message_template_encode_patches_message_id_and_creation_time_at_their_offsets_in_the_properties)
+{
+	// arrange
+	MESSAGE_HANDLE message = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	size_t properties_offset = sizeof(test_encoded_header) + sizeof(test_encoded_message_annotations);
+	static const unsigned char expected_message_id[] = { 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28 };
+	static const unsigned char expected_creation_time[] = { 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38 };
+	unsigned char expected[256];
+	size_t expected_length;
+	const unsigned char* bytes;
+	size_t length;
+
+	expected_length = get_expected_sections_encoding(0x2122232425262728ULL, 0x3132333435363738LL, expected);
+
+	// act
+	MESSAGE_TEMPLATE_HANDLE message_template = message_template_create(message, MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID | MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME);
+	MESSAGE_ENCODED_HANDLE message_encoded = message_template_encode(message_template, 0x2122232425262728ULL, 0x3132333435363738LL, NULL, 0);
+
+	// assert
+	ASSERT_IS_NOT_NULL(message_template);
+	ASSERT_IS_NOT_NULL(message_encoded);
+	(void)message_encoded_get_bytes(message_encoded, &bytes, &length);
+	ASSERT_ARE_EQUAL(size_t, expected_length, length);
+	ASSERT_ARE_EQUAL(uint8_t, 0x80, bytes[properties_offset + TEST_PROPERTIES_MESSAGE_ID_OFFSET - 1]);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected_message_id, bytes + properties_offset + TEST_PROPERTIES_MESSAGE_ID_OFFSET, sizeof(expected_message_id)));
+	ASSERT_ARE_EQUAL(uint8_t, 0x83, bytes[properties_offset + TEST_PROPERTIES_CREATION_TIME_OFFSET - 1]);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected_creation_time, bytes + properties_offset + TEST_PROPERTIES_CREATION_TIME_OFFSET, sizeof(expected_creation_time)));
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected, bytes, length));
+
+	// cleanup
+	message_encoded_destroy(message_encoded);
+	message_template_destroy(message_template);
+	message_destroy(message);
+}
+
+TEST_FUNCTION(message_template_encode_produces_the_same_bytes_as_message_encode_of_a_message_with_the_same_fields_and_body)
+{
+	// arrange
+	MESSAGE_HANDLE prototype = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	MESSAGE_HANDLE message = create_message_with_sections(0x0A0B0C0D0E0F1011ULL, 0x1A1B1C1D1E1F2021LL);
+	unsigned char chunk[300] = { 0 };
+	BINARY_DATA body_data_items[2];
+	MESSAGE_TEMPLATE_HANDLE message_template;
+	MESSAGE_ENCODED_HANDLE expected_encoded;
+	const unsigned char* expected_bytes;
+	size_t expected_length;
+	const unsigned char* bytes;
+	size_t length;
+
+	chunk[0] = 0x42;
+	chunk[299] = 0x43;
+	body_data_items[0].bytes = chunk;
+	body_data_items[0].length = 3;
+	body_data_items[1].bytes = chunk;
+	body_data_items[1].length = sizeof(chunk);
+	(void)message_add_body_amqp_data(message, body_data_items[0]);
+	(void)message_add_body_amqp_data(message, body_data_items[1]);
+	expected_encoded = message_encode(message);
+	(void)message_encoded_get_bytes(expected_encoded, &expected_bytes, &expected_length);
+	message_template = message_template_create(prototype, MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID | MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME);
+
+	// act
+	MESSAGE_ENCODED_HANDLE message_encoded = message_template_encode(message_template, 0x0A0B0C0D0E0F1011ULL, 0x1A1B1C1D1E1F2021LL, body_data_items, 2);
+
+	// assert
+	ASSERT_IS_NOT_NULL(message_encoded);
+	(void)message_encoded_get_bytes(message_encoded, &bytes, &length);
+	ASSERT_ARE_EQUAL(size_t, expected_length, length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected_bytes, bytes, length));
+
+	// cleanup
+	message_encoded_destroy(message_encoded);
+	message_encoded_destroy(expected_encoded);
+	message_template_destroy(message_template);
+	message_destroy(message);
+	message_destroy(prototype);
+}
+
+TEST_FUNCTION(when_only_the_message_id_is_variable_the_template_keeps_the_creation_time_of_the_prototype)
+{
+	// arrange
+	MESSAGE_HANDLE message = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	unsigned char expected[256];
+	size_t expected_length;
+	const unsigned char* bytes;
+	size_t length;
+
+	expected_length = get_expected_sections_encoding(0x2122232425262728ULL, 0x1112131415161718LL, expected);
+
+	// act
+	MESSAGE_TEMPLATE_HANDLE message_template = message_template_create(message, MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID);
+	MESSAGE_ENCODED_HANDLE message_encoded = message_template_encode(message_template, 0x2122232425262728ULL, 0x3132333435363738LL, NULL, 0);
+
+	// assert
+	ASSERT_IS_NOT_NULL(message_encoded);
+	(void)message_encoded_get_bytes(message_encoded, &bytes, &length);
+	ASSERT_ARE_EQUAL(size_t, expected_length, length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected, bytes, length));
+
+	// cleanup
+	message_encoded_destroy(message_encoded);
+	message_template_destroy(message_template);
+	message_destroy(message);
+}
+
+TEST_FUNCTION(when_only_the_creation_time_is_variable_the_template_keeps_the_message_id_of_the_prototype)
+{
+	// arrange
+	MESSAGE_HANDLE message = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	unsigned char expected[256];
+	size_t expected_length;
+	const unsigned char* bytes;
+	size_t length;
+
+	expected_length = get_expected_sections_encoding(0x0102030405060708ULL, 0x3132333435363738LL, expected);
+
+	// act
+	MESSAGE_TEMPLATE_HANDLE message_template = message_template_create(message, MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME);
+	MESSAGE_ENCODED_HANDLE message_encoded = message_template_encode(message_template, 0x2122232425262728ULL, 0x3132333435363738LL, NULL, 0);
+
+	// assert
+	ASSERT_IS_NOT_NULL(message_encoded);
+	(void)message_encoded_get_bytes(message_encoded, &bytes, &length);
+	ASSERT_ARE_EQUAL(size_t, expected_length, length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected, bytes, length));
+
+	// cleanup
+	message_encoded_destroy(message_encoded);
+	message_template_destroy(message_template);
+	message_destroy(message);
+}
+
+TEST_FUNCTION(when_the_placeholders_change_fewer_than_8_bytes_message_template_create_fails_and_message_encode_still_works)
+{
+	// arrange
+	MESSAGE_HANDLE message = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	unsigned char expected[256];
+	size_t expected_length;
+	MESSAGE_ENCODED_HANDLE message_encoded;
+	const unsigned char* bytes;
+	size_t length;
+
+	test_message_id_encoding = TEST_MESSAGE_ID_ENCODING_UINT;
+	expected_length = get_expected_sections_encoding(0x0102030405060708ULL, 0x1112131415161718LL, expected);
+
+	// act
+	MESSAGE_TEMPLATE_HANDLE message_template = message_template_create(message, MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID);
+
+	// assert
+	ASSERT_IS_NULL(message_template);
+	message_encoded = message_encode(message);
+	ASSERT_IS_NOT_NULL(message_encoded);
+	(void)message_encoded_get_bytes(message_encoded, &bytes, &length);
+	ASSERT_ARE_EQUAL(size_t, expected_length, length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected, bytes, length));
+
+	// cleanup
+	message_encoded_destroy(message_encoded);
+	message_destroy(message);
+}
+
+TEST_FUNCTION(when_the_placeholders_change_the_encoded_length_message_template_create_fails_and_message_encode_still_works)
+{
+	// arrange
+	MESSAGE_HANDLE message = create_message_with_sections(0x0102030405060708ULL, 0x1112131415161718LL);
+	unsigned char expected[256];
+	size_t expected_length;
+	MESSAGE_ENCODED_HANDLE message_encoded;
+	const unsigned char* bytes;
+	size_t length;
+
+	test_message_id_encoding = TEST_MESSAGE_ID_ENCODING_STRING;
+	expected_length = get_expected_sections_encoding(0x0102030405060708ULL, 0x1112131415161718LL, expected);
+
+	// act
+	MESSAGE_TEMPLATE_HANDLE message_template = message_template_create(message, MESSAGE_TEMPLATE_VARIABLE_MESSAGE_ID | MESSAGE_TEMPLATE_VARIABLE_CREATION_TIME);
+
+	// assert
+	ASSERT_IS_NULL(message_template);
+	message_encoded = message_encode(message);
+	ASSERT_IS_NOT_NULL(message_encoded);
+	(void)message_encoded_get_bytes(message_encoded, &bytes, &length);
+	ASSERT_ARE_EQUAL(size_t, expected_length, length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected, bytes, length));
+
+	// cleanup
+	message_encoded_destroy(message_encoded);
+	message_destroy(message);
+}
+
+/* message_set_lazy_payload */
+
+TEST_FUNCTION(message_set_lazy_payload_borrows_the_bytes_of_consecutive_data_sections)
+{
+	// arrange
+	MESSAGE_HANDLE message = message_create();
+	static const unsigned char payload[] =
+	{
+		0x00, 0x53, 0x75, 0xA0, 0x02, 0x01, 0x02,
+		0x00, 0x53, 0x75, 0xA0, 0x03, 0x03, 0x04, 0x05
+	};
+	MESSAGE_BODY_TYPE body_type;
+	size_t count;
+	BINARY_DATA binary_data1;
+	BINARY_DATA binary_data2;
+
+	// act
+	int result = message_set_lazy_payload(message, payload, sizeof(payload));
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	(void)message_get_body_type(message, &body_type);
+	ASSERT_ARE_EQUAL(int, (int)MESSAGE_BODY_TYPE_DATA, (int)body_type);
+	ASSERT_ARE_EQUAL(int, 0, message_get_body_amqp_data_count(message, &count));
+	ASSERT_ARE_EQUAL(size_t, 2, count);
+	(void)message_get_body_amqp_data(message, 0, &binary_data1);
+	(void)message_get_body_amqp_data(message, 1, &binary_data2);
+	ASSERT_ARE_EQUAL(void_ptr, payload + 5, binary_data1.bytes);
+	ASSERT_ARE_EQUAL(size_t, 2, binary_data1.length);
+	ASSERT_ARE_EQUAL(void_ptr, payload + 12, binary_data2.bytes);
+	ASSERT_ARE_EQUAL(size_t, 3, binary_data2.length);
+
+	// cleanup
+	message_destroy(message);
+}
+
+TEST_FUNCTION(when_a_section_comes_after_a_section_that_follows_it_message_set_lazy_payload_fails_and_keeps_no_section)
+{
+	// arrange
+	MESSAGE_HANDLE message = message_create();
+	static const unsigned char payload[] =
+	{
+		0x00, 0x53, 0x73, 0x45,
+		0x00, 0x53, 0x70, 0x45
+	};
+	HEADER_HANDLE header;
+	MESSAGE_BODY_TYPE body_type;
+
+	// act
+	int result = message_set_lazy_payload(message, payload, sizeof(payload));
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(int, 0, message_get_header(message, &header));
+	ASSERT_IS_NULL(header);
+	(void)message_get_body_type(message, &body_type);
+	ASSERT_ARE_EQUAL(int, (int)MESSAGE_BODY_TYPE_NONE, (int)body_type);
+
+	// cleanup
+	message_destroy(message);
+}
+
+TEST_FUNCTION(when_a_sequence_section_follows_data_sections_message_set_lazy_payload_fails)
+{
+	// arrange
+	MESSAGE_HANDLE message = message_create();
+	static const unsigned char payload[] =
+	{
+		0x00, 0x53, 0x75, 0xA0, 0x02, 0x01, 0x02,
+		0x00, 0x53, 0x76, 0x45
+	};
+	MESSAGE_BODY_TYPE body_type;
+	size_t count;
+
+	// act
+	int result = message_set_lazy_payload(message, payload, sizeof(payload));
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	(void)message_get_body_type(message, &body_type);
+	ASSERT_ARE_EQUAL(int, (int)MESSAGE_BODY_TYPE_NONE, (int)body_type);
+	(void)message_get_body_amqp_data_count(message, &count);
+	ASSERT_ARE_EQUAL(size_t, 0, count);
+
+	// cleanup
+	message_destroy(message);
+}
+
+TEST_FUNCTION(when_a_section_has_a_symbolic_descriptor_message_set_lazy_payload_fails_so_that_the_full_decoder_is_used)
+{
+	// arrange
+	MESSAGE_HANDLE message = message_create();
+	static const unsigned char payload[] =
+	{
+		0x00, 0xA3, 0x10, 'a', 'm', 'q', 'p', ':', 'h', 'e', 'a', 'd', 'e', 'r', ':', 'l', 'i', 's', 't', 0x45,
+		0x00, 0x53, 0x75, 0xA0, 0x02, 0x01, 0x02
+	};
+	MESSAGE_BODY_TYPE body_type;
+	size_t count;
+
+	// act
+	int result = message_set_lazy_payload(message, payload, sizeof(payload));
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	(void)message_get_body_type(message, &body_type);
+	ASSERT_ARE_EQUAL(int, (int)MESSAGE_BODY_TYPE_NONE, (int)body_type);
+	(void)message_get_body_amqp_data_count(message, &count);
+	ASSERT_ARE_EQUAL(size_t, 0, count);
+
+	// cleanup
+	message_destroy(message);
+}
+
+/* message_retain_body_amqp_data */
+
+TEST_FUNCTION(message_retain_body_amqp_data_copies_borrowed_body_data)
+{
+	// arrange
+	MESSAGE_HANDLE message = message_create();
+	unsigned char borrowed[3] = { 0x42, 0x43, 0x44 };
+	static const unsigned char expected[3] = { 0x42, 0x43, 0x44 };
+	BINARY_DATA binary_data = { borrowed, sizeof(borrowed) };
+
+	(void)message_add_body_amqp_data_borrowed(message, binary_data);
+
+	// act
+	int result = message_retain_body_amqp_data(message);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	(void)memset(borrowed, 0, sizeof(borrowed));
+	(void)message_get_body_amqp_data(message, 0, &binary_data);
+	ASSERT_ARE_NOT_EQUAL(void_ptr, borrowed, binary_data.bytes);
+	ASSERT_ARE_EQUAL(size_t, sizeof(expected), binary_data.length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected, binary_data.bytes, sizeof(expected)));
+
+	// cleanup
+	message_destroy(message);
+}
+
+TEST_FUNCTION(message_retain_body_amqp_data_copies_the_data_sections_of_a_lazy_payload)
+{
+	// arrange
+	MESSAGE_HANDLE message = message_create();
+	unsigned char payload[] =
+	{
+		0x00, 0x53, 0x75, 0xA0, 0x02, 0x01, 0x02,
+		0x00, 0x53, 0x75, 0xA0, 0x03, 0x03, 0x04, 0x05
+	};
+	static const unsigned char expected1[] = { 0x01, 0x02 };
+	static const unsigned char expected2[] = { 0x03, 0x04, 0x05 };
+	BINARY_DATA binary_data1;
+	BINARY_DATA binary_data2;
+	size_t count;
+
+	(void)message_set_lazy_payload(message, payload, sizeof(payload));
+
+	// act
+	int result = message_retain_body_amqp_data(message);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	(void)memset(payload, 0, sizeof(payload));
+	(void)message_get_body_amqp_data_count(message, &count);
+	ASSERT_ARE_EQUAL(size_t, 2, count);
+	(void)message_get_body_amqp_data(message, 0, &binary_data1);
+	(void)message_get_body_amqp_data(message, 1, &binary_data2);
+	ASSERT_ARE_EQUAL(size_t, sizeof(expected1), binary_data1.length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected1, binary_data1.bytes, sizeof(expected1)));
+	ASSERT_ARE_EQUAL(size_t, sizeof(expected2), binary_data2.length);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(expected2, binary_data2.bytes, sizeof(expected2)));
+
+	// cleanup
+	message_destroy(message);
+}
+
 END_TEST_SUITE(message_ut)
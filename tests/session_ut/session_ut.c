@@ -4,13 +4,17 @@
 #ifdef __cplusplus
 #include <cstdlib>
 #include <cstdint>
+#include <cstdbool>
 #else
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #endif
 #include "testrunnerswitcher.h"
 #include "umock_c.h"
 #include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
 
 static void* my_gballoc_malloc(size_t size)
 {
@@ -47,19 +51,34 @@ static void my_gballoc_free(void* ptr)
 #define TEST_CONTEXT					(void*)0x4444
 #define TEST_ATTACH_PERFORMATIVE		(AMQP_VALUE)0x5000
 #define TEST_BEGIN_PERFORMATIVE			(AMQP_VALUE)0x5001
+#define TEST_TRANSFER_PERFORMATIVE		(AMQP_VALUE)0x5002
+#define TEST_MORE_TRANSFER_PERFORMATIVE	(AMQP_VALUE)0x5003
 
 static TRANSFER_HANDLE test_transfer_handle = (TRANSFER_HANDLE)0x6001;
+static BEGIN_HANDLE test_begin_handle = (BEGIN_HANDLE)0x6002;
 static ON_ENDPOINT_FRAME_RECEIVED saved_frame_received_callback;
 static ON_CONNECTION_STATE_CHANGED saved_connection_state_changed_callback;
 static void* saved_callback_context;
+static ON_ENDPOINT_DOWORK saved_on_connection_dowork;
+static ON_ENDPOINT_SEND_BLOCKED_CHANGED saved_on_send_blocked_changed;
+static LINK_ENDPOINT_HANDLE test_link_endpoint_to_destroy;
 static uint32_t some_remote_max_frame_size = 512;
 
 static uint64_t performative_ulong;
 
+/* the transfer frames handed to connection_encode_preencoded_frame */
+static size_t sent_preencoded_frame_count;
+static unsigned char sent_preencoded_frame_more_flags[8];
+static size_t sent_preencoded_frame_payload_counts[8];
+static size_t sent_preencoded_frame_payload_sizes[8];
+static ON_SEND_COMPLETE sent_preencoded_frame_on_send_complete[8];
+
 MOCK_FUNCTION_WITH_CODE(, void, test_frame_received_callback, void*, context, AMQP_VALUE, performative, uint32_t, frame_payload_size, const unsigned char*, payload_bytes)
 MOCK_FUNCTION_END();
 MOCK_FUNCTION_WITH_CODE(, void, test_on_session_state_changed, void*, context, SESSION_STATE, new_session_state, SESSION_STATE, previous_session_state)
 MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, uint64_t, test_on_link_endpoint_dowork, void*, context, uint64_t, current_ms)
+MOCK_FUNCTION_END((uint64_t)-1);
 MOCK_FUNCTION_WITH_CODE(, void, test_on_flow_on, void*, context)
 MOCK_FUNCTION_END();
 MOCK_FUNCTION_WITH_CODE(, void, test_on_send_complete, void*, context, IO_SEND_RESULT, send_result)
@@ -72,6 +91,38 @@ static int my_amqpvalue_get_ulong(AMQP_VALUE value, uint64_t* ulong_value)
     return 0;
 }
 
+/* encodes the transfer as 3 bytes, the middle one holding the more flag */
+static int my_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+    unsigned char encoded_transfer[] = { 0x00, 0x42, 0x00 };
+    if (value == TEST_MORE_TRANSFER_PERFORMATIVE)
+    {
+        encoded_transfer[1] = 0x41;
+    }
+    return encoder_output(context, encoded_transfer, sizeof(encoded_transfer));
+}
+
+static int my_connection_encode_preencoded_frame(ENDPOINT_HANDLE endpoint, const PAYLOAD* payloads, size_t payload_count, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)endpoint;
+    (void)callback_context;
+    if (sent_preencoded_frame_count < sizeof(sent_preencoded_frame_more_flags))
+    {
+        size_t i;
+
+        sent_preencoded_frame_more_flags[sent_preencoded_frame_count] = payloads[0].bytes[1];
+        sent_preencoded_frame_payload_counts[sent_preencoded_frame_count] = payload_count - 1;
+        sent_preencoded_frame_payload_sizes[sent_preencoded_frame_count] = 0;
+        for (i = 1; i < payload_count; i++)
+        {
+            sent_preencoded_frame_payload_sizes[sent_preencoded_frame_count] += payloads[i].length;
+        }
+        sent_preencoded_frame_on_send_complete[sent_preencoded_frame_count] = on_send_complete;
+    }
+    sent_preencoded_frame_count++;
+    return 0;
+}
+
 static int my_connection_start_endpoint(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_FRAME_RECEIVED frame_received_callback, ON_CONNECTION_STATE_CHANGED on_connection_state_changed, void* context)
 {
     (void)endpoint;
@@ -81,6 +132,56 @@ static int my_connection_start_endpoint(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_FR
     return 0;
 }
 
+static int my_connection_endpoint_set_on_dowork(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_DOWORK on_endpoint_dowork)
+{
+    (void)endpoint;
+    saved_on_connection_dowork = on_endpoint_dowork;
+    return 0;
+}
+
+static int my_connection_endpoint_set_on_send_blocked_changed(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_SEND_BLOCKED_CHANGED on_endpoint_send_blocked_changed)
+{
+    (void)endpoint;
+    saved_on_send_blocked_changed = on_endpoint_send_blocked_changed;
+    return 0;
+}
+
+static uint64_t test_on_link_endpoint_dowork_destroying_a_link_endpoint(void* context, uint64_t current_ms)
+{
+    (void)context;
+    (void)current_ms;
+
+    if (test_link_endpoint_to_destroy != NULL)
+    {
+        LINK_ENDPOINT_HANDLE link_endpoint = test_link_endpoint_to_destroy;
+        test_link_endpoint_to_destroy = NULL;
+        session_destroy_link_endpoint(link_endpoint);
+    }
+
+    return (uint64_t)-1;
+}
+
+/* begins the session and runs the BEGIN exchange with a peer that has an incoming window of 100 transfers */
+static SESSION_HANDLE create_mapped_session(void)
+{
+    uint32_t remote_incoming_window = 100;
+    SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+
+    (void)session_begin(session);
+    saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+
+    STRICT_EXPECTED_CALL(is_begin_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(amqpvalue_get_begin(TEST_BEGIN_PERFORMATIVE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &test_begin_handle, sizeof(test_begin_handle));
+    STRICT_EXPECTED_CALL(begin_get_incoming_window(test_begin_handle, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &remote_incoming_window, sizeof(remote_incoming_window));
+    saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
+    umock_c_reset_all_calls();
+
+    return session;
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -107,6 +208,10 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     result = umocktypes_charptr_register_types();
     ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Failed registering stdint types");
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "Failed registering bool types");
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
@@ -123,12 +228,29 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(connection_create_endpoint, TEST_ENDPOINT_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(connection_endpoint_get_incoming_channel, 0);
     REGISTER_GLOBAL_MOCK_RETURN(connection_encode_frame, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(connection_encode_preencoded_frame, my_connection_encode_preencoded_frame);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, my_amqpvalue_encode);
+    REGISTER_GLOBAL_MOCK_HOOK(connection_endpoint_set_on_dowork, my_connection_endpoint_set_on_dowork);
+    REGISTER_GLOBAL_MOCK_HOOK(connection_endpoint_set_on_send_blocked_changed, my_connection_endpoint_set_on_send_blocked_changed);
+    REGISTER_GLOBAL_MOCK_RETURN(begin_create, test_begin_handle);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_begin, TEST_BEGIN_PERFORMATIVE);
     REGISTER_GLOBAL_MOCK_RETURN(connection_get_remote_max_frame_size, 0);
     REGISTER_GLOBAL_MOCK_HOOK(connection_start_endpoint, my_connection_start_endpoint);
 
     REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ENDPOINT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_ENDPOINT_DOWORK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_ENDPOINT_SEND_BLOCKED_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_ENDPOINT_FRAME_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_CONNECTION_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BEGIN_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(handle, uint32_t);
+    REGISTER_UMOCK_ALIAS_TYPE(delivery_number, uint32_t);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -147,6 +269,9 @@ TEST_FUNCTION_INITIALIZE(method_init)
     }
 
     umock_c_reset_all_calls();
+
+    test_link_endpoint_to_destroy = NULL;
+    sent_preencoded_frame_count = 0;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -538,6 +663,318 @@ TEST_FUNCTION(session_transfer_with_NULL_link_endpoint_fails)
 	ASSERT_ARE_NOT_EQUAL(int, 0, result);
 }
 
+/* session_send_transfer */
+
+TEST_FUNCTION(a_transfer_larger_than_the_frame_size_is_split_and_its_header_is_encoded_once)
+{
+	// arrange
+	SESSION_HANDLE session = create_mapped_session();
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	unsigned char payload_bytes[35] = { 0 };
+	PAYLOAD payloads[2];
+	delivery_number delivery_id;
+	size_t transfer_encoded_size = 3;
+	/* 10 bytes of payload per frame */
+	uint32_t remote_max_frame_size = 8 + 3 + 10;
+	umock_c_reset_all_calls();
+
+	payloads[0].bytes = payload_bytes;
+	payloads[0].length = 25;
+	payloads[1].bytes = payload_bytes + 25;
+	payloads[1].length = 10;
+
+	STRICT_EXPECTED_CALL(transfer_set_handle(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(transfer_set_delivery_id(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(transfer_set_more(test_transfer_handle, false));
+	STRICT_EXPECTED_CALL(amqpvalue_create_transfer(test_transfer_handle))
+		.SetReturn(TEST_TRANSFER_PERFORMATIVE);
+	STRICT_EXPECTED_CALL(connection_get_remote_max_frame_size(TEST_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &remote_max_frame_size, sizeof(remote_max_frame_size));
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &transfer_encoded_size, sizeof(transfer_encoded_size));
+	STRICT_EXPECTED_CALL(transfer_set_more(test_transfer_handle, true));
+	STRICT_EXPECTED_CALL(amqpvalue_create_transfer(test_transfer_handle))
+		.SetReturn(TEST_MORE_TRANSFER_PERFORMATIVE);
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_MORE_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &transfer_encoded_size, sizeof(transfer_encoded_size));
+	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_MORE_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(connection_encode_preencoded_frame(TEST_ENDPOINT_HANDLE, IGNORED_PTR_ARG, 2, NULL, NULL));
+	STRICT_EXPECTED_CALL(connection_encode_preencoded_frame(TEST_ENDPOINT_HANDLE, IGNORED_PTR_ARG, 2, NULL, NULL));
+	STRICT_EXPECTED_CALL(connection_encode_preencoded_frame(TEST_ENDPOINT_HANDLE, IGNORED_PTR_ARG, 3, NULL, NULL));
+	STRICT_EXPECTED_CALL(connection_encode_preencoded_frame(TEST_ENDPOINT_HANDLE, IGNORED_PTR_ARG, 2, test_on_send_complete, (void*)0x4242));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_MORE_TRANSFER_PERFORMATIVE));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_TRANSFER_PERFORMATIVE));
+
+	// act
+	SESSION_SEND_TRANSFER_RESULT result = session_send_transfer(link_endpoint, test_transfer_handle, payloads, 2, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 4, sent_preencoded_frame_count);
+	ASSERT_ARE_EQUAL(uint8_t, 0x41, sent_preencoded_frame_more_flags[0]);
+	ASSERT_ARE_EQUAL(uint8_t, 0x41, sent_preencoded_frame_more_flags[1]);
+	ASSERT_ARE_EQUAL(uint8_t, 0x41, sent_preencoded_frame_more_flags[2]);
+	ASSERT_ARE_EQUAL(uint8_t, 0x42, sent_preencoded_frame_more_flags[3]);
+	ASSERT_ARE_EQUAL(size_t, 10, sent_preencoded_frame_payload_sizes[0]);
+	ASSERT_ARE_EQUAL(size_t, 10, sent_preencoded_frame_payload_sizes[2]);
+	ASSERT_ARE_EQUAL(size_t, 5, sent_preencoded_frame_payload_sizes[3]);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(a_chunk_with_more_set_larger_than_the_frame_size_keeps_more_set_on_all_its_frames)
+{
+	// arrange
+	SESSION_HANDLE session = create_mapped_session();
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	unsigned char payload_bytes[25] = { 0 };
+	PAYLOAD payload;
+	delivery_number delivery_id;
+	size_t transfer_encoded_size = 3;
+	uint32_t remote_max_frame_size = 8 + 3 + 10;
+	umock_c_reset_all_calls();
+
+	payload.bytes = payload_bytes;
+	payload.length = sizeof(payload_bytes);
+
+	STRICT_EXPECTED_CALL(transfer_set_handle(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(transfer_set_delivery_id(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(transfer_set_more(test_transfer_handle, true));
+	STRICT_EXPECTED_CALL(amqpvalue_create_transfer(test_transfer_handle))
+		.SetReturn(TEST_MORE_TRANSFER_PERFORMATIVE);
+	STRICT_EXPECTED_CALL(connection_get_remote_max_frame_size(TEST_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &remote_max_frame_size, sizeof(remote_max_frame_size));
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_MORE_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &transfer_encoded_size, sizeof(transfer_encoded_size));
+	STRICT_EXPECTED_CALL(transfer_set_more(test_transfer_handle, true));
+	STRICT_EXPECTED_CALL(amqpvalue_create_transfer(test_transfer_handle))
+		.SetReturn(TEST_MORE_TRANSFER_PERFORMATIVE);
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_MORE_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &transfer_encoded_size, sizeof(transfer_encoded_size));
+	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+	STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_MORE_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(connection_encode_preencoded_frame(TEST_ENDPOINT_HANDLE, IGNORED_PTR_ARG, 2, NULL, NULL));
+	STRICT_EXPECTED_CALL(connection_encode_preencoded_frame(TEST_ENDPOINT_HANDLE, IGNORED_PTR_ARG, 2, NULL, NULL));
+	STRICT_EXPECTED_CALL(connection_encode_preencoded_frame(TEST_ENDPOINT_HANDLE, IGNORED_PTR_ARG, 2, test_on_send_complete, (void*)0x4242));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_MORE_TRANSFER_PERFORMATIVE));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_MORE_TRANSFER_PERFORMATIVE));
+
+	// act
+	SESSION_SEND_TRANSFER_RESULT result = session_send_transfer_chunk(link_endpoint, test_transfer_handle, &payload, 1, true, true, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 3, sent_preencoded_frame_count);
+	ASSERT_ARE_EQUAL(uint8_t, 0x41, sent_preencoded_frame_more_flags[2]);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+/* session_set_link_endpoint_on_dowork */
+
+TEST_FUNCTION(session_set_link_endpoint_on_dowork_with_NULL_link_endpoint_fails)
+{
+	// arrange
+
+	// act
+	int result = session_set_link_endpoint_on_dowork(NULL, test_on_link_endpoint_dowork);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(session_set_link_endpoint_on_dowork_succeeds)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	umock_c_reset_all_calls();
+
+	// act
+	int result = session_set_link_endpoint_on_dowork(link_endpoint, test_on_link_endpoint_dowork);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+/* on_connection_dowork */
+
+TEST_FUNCTION(the_session_dowork_calls_each_link_endpoint_and_returns_the_earliest_time_a_link_needs_its_next_dowork)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint_1 = session_create_link_endpoint(session, "1");
+	LINK_ENDPOINT_HANDLE link_endpoint_2 = session_create_link_endpoint(session, "2");
+	(void)session_start_link_endpoint(link_endpoint_1, test_frame_received_callback, NULL, NULL, (void*)0x01);
+	(void)session_start_link_endpoint(link_endpoint_2, test_frame_received_callback, NULL, NULL, (void*)0x02);
+	(void)session_set_link_endpoint_on_dowork(link_endpoint_1, test_on_link_endpoint_dowork);
+	(void)session_set_link_endpoint_on_dowork(link_endpoint_2, test_on_link_endpoint_dowork);
+	(void)session_begin(session);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(test_on_link_endpoint_dowork((void*)0x01, 1000))
+		.SetReturn(40);
+	STRICT_EXPECTED_CALL(test_on_link_endpoint_dowork((void*)0x02, 1000))
+		.SetReturn(30);
+
+	// act
+	uint64_t result = saved_on_connection_dowork(saved_callback_context, 1000);
+
+	// assert
+	ASSERT_ARE_EQUAL(uint64_t, 30, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint_2);
+	session_destroy_link_endpoint(link_endpoint_1);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(when_a_link_endpoint_is_destroyed_from_a_dowork_callback_the_following_link_endpoints_still_get_their_dowork)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint_1 = session_create_link_endpoint(session, "1");
+	LINK_ENDPOINT_HANDLE link_endpoint_2 = session_create_link_endpoint(session, "2");
+	(void)session_start_link_endpoint(link_endpoint_1, test_frame_received_callback, NULL, NULL, (void*)0x01);
+	(void)session_start_link_endpoint(link_endpoint_2, test_frame_received_callback, NULL, NULL, (void*)0x02);
+	(void)session_set_link_endpoint_on_dowork(link_endpoint_1, test_on_link_endpoint_dowork_destroying_a_link_endpoint);
+	(void)session_set_link_endpoint_on_dowork(link_endpoint_2, test_on_link_endpoint_dowork);
+	(void)session_begin(session);
+	test_link_endpoint_to_destroy = link_endpoint_1;
+	umock_c_reset_all_calls();
+
+	EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(test_on_link_endpoint_dowork((void*)0x02, 1000));
+
+	// act
+	(void)saved_on_connection_dowork(saved_callback_context, 1000);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint_2);
+	session_destroy(session);
+}
+
+/* on_connection_send_blocked_changed */
+
+TEST_FUNCTION(session_send_transfer_returns_BUSY_while_the_connection_is_send_blocked)
+{
+	// arrange
+	SESSION_HANDLE session = create_mapped_session();
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	delivery_number delivery_id;
+	saved_on_send_blocked_changed(saved_callback_context, true);
+	umock_c_reset_all_calls();
+
+	// act
+	SESSION_SEND_TRANSFER_RESULT result = session_send_transfer(link_endpoint, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_BUSY, (int)result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(session_send_transfer_sends_again_once_the_connection_is_no_longer_send_blocked)
+{
+	// arrange
+	SESSION_HANDLE session = create_mapped_session();
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	delivery_number delivery_id;
+	size_t transfer_encoded_size = 10;
+	saved_on_send_blocked_changed(saved_callback_context, true);
+	saved_on_send_blocked_changed(saved_callback_context, false);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(transfer_set_handle(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(transfer_set_delivery_id(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(transfer_set_more(test_transfer_handle, false));
+	STRICT_EXPECTED_CALL(amqpvalue_create_transfer(test_transfer_handle))
+		.SetReturn(TEST_TRANSFER_PERFORMATIVE);
+	STRICT_EXPECTED_CALL(connection_get_remote_max_frame_size(TEST_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &some_remote_max_frame_size, sizeof(some_remote_max_frame_size));
+	STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_TRANSFER_PERFORMATIVE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &transfer_encoded_size, sizeof(transfer_encoded_size));
+	STRICT_EXPECTED_CALL(connection_encode_frame(TEST_ENDPOINT_HANDLE, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_send_complete, (void*)0x4242));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_TRANSFER_PERFORMATIVE));
+
+	// act
+	SESSION_SEND_TRANSFER_RESULT result = session_send_transfer(link_endpoint, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)result);
+	ASSERT_ARE_EQUAL(uint32_t, 0, delivery_id);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(links_are_told_they_can_send_again_when_the_connection_is_no_longer_send_blocked)
+{
+	// arrange
+	SESSION_HANDLE session = create_mapped_session();
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	(void)session_start_link_endpoint(link_endpoint, test_frame_received_callback, NULL, test_on_flow_on, TEST_CONTEXT);
+	saved_on_send_blocked_changed(saved_callback_context, true);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(test_on_flow_on(TEST_CONTEXT));
+
+	// act
+	saved_on_send_blocked_changed(saved_callback_context, false);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(links_are_not_told_they_can_send_when_the_connection_becomes_send_blocked)
+{
+	// arrange
+	SESSION_HANDLE session = create_mapped_session();
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	(void)session_start_link_endpoint(link_endpoint, test_frame_received_callback, NULL, test_on_flow_on, TEST_CONTEXT);
+	umock_c_reset_all_calls();
+
+	// act
+	saved_on_send_blocked_changed(saved_callback_context, true);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
 #if 0
 /* Tests_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
 TEST_FUNCTION(when_transfer_set_delivery_id_fails_then_session_transfer_fails)
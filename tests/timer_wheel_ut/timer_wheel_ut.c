@@ -0,0 +1,493 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/timer_wheel.h"
+
+/* 4 levels of 64 slots of 1 ms */
+#define TEST_TIMER_WHEEL_RANGE ((uint64_t)1 << 24)
+
+static void* test_context_1 = (void*)0x4241;
+static void* test_context_2 = (void*)0x4242;
+
+static TIMER_WHEEL_TIMER_HANDLE test_timer_to_reschedule;
+static uint64_t test_reschedule_deadline;
+static size_t test_reschedule_count;
+static TIMER_WHEEL_TIMER_HANDLE test_timer_to_destroy;
+
+MOCK_FUNCTION_WITH_CODE(, void, test_on_timer_expired, void*, context)
+    if (test_reschedule_count > 0)
+    {
+        test_reschedule_count--;
+        (void)timer_wheel_schedule(test_timer_to_reschedule, test_reschedule_deadline);
+        test_reschedule_deadline += 10;
+    }
+    if (test_timer_to_destroy != NULL)
+    {
+        TIMER_WHEEL_TIMER_HANDLE timer = test_timer_to_destroy;
+        test_timer_to_destroy = NULL;
+        timer_wheel_destroy_timer(timer);
+    }
+MOCK_FUNCTION_END();
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+/* a timer fires at its deadline and not a tick earlier */
+static void assert_timer_fires_at(uint64_t start_ms, uint64_t deadline_ms)
+{
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(start_ms);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    (void)timer_wheel_schedule(timer, deadline_ms);
+    umock_c_reset_all_calls();
+
+    (void)timer_wheel_advance(timer_wheel, deadline_ms - 1);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+    (void)timer_wheel_advance(timer_wheel, deadline_ms);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+BEGIN_TEST_SUITE(timer_wheel_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    test_timer_to_reschedule = NULL;
+    test_reschedule_deadline = 0;
+    test_reschedule_count = 0;
+    test_timer_to_destroy = NULL;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* timer_wheel_create */
+
+TEST_FUNCTION(timer_wheel_create_allocates_the_wheel)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE result;
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    result = timer_wheel_create(1000);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy(result);
+}
+
+TEST_FUNCTION(when_allocating_the_wheel_fails_timer_wheel_create_fails)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE result;
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    result = timer_wheel_create(1000);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* timer_wheel_create_timer */
+
+TEST_FUNCTION(timer_wheel_create_timer_with_NULL_timer_wheel_fails)
+{
+    // arrange
+
+    // act
+    TIMER_WHEEL_TIMER_HANDLE result = timer_wheel_create_timer(NULL, test_on_timer_expired, test_context_1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(timer_wheel_create_timer_with_NULL_callback_fails)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    umock_c_reset_all_calls();
+
+    // act
+    TIMER_WHEEL_TIMER_HANDLE result = timer_wheel_create_timer(timer_wheel, NULL, test_context_1);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy(timer_wheel);
+}
+
+/* timer_wheel_get_next_expiry */
+
+TEST_FUNCTION(timer_wheel_get_next_expiry_with_no_timer_scheduled_returns_UINT64_MAX)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    uint64_t next_expiry = 0;
+    umock_c_reset_all_calls();
+
+    // act
+    int result = timer_wheel_get_next_expiry(timer_wheel, &next_expiry);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint64_t, UINT64_MAX, next_expiry);
+
+    // cleanup
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(timer_wheel_get_next_expiry_returns_the_deadline_of_a_timer_due_within_64_ms)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    uint64_t next_expiry = 0;
+    (void)timer_wheel_schedule(timer, 1042);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = timer_wheel_get_next_expiry(timer_wheel, &next_expiry);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(uint64_t, 1042, next_expiry);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+/* timer_wheel_advance */
+
+TEST_FUNCTION(a_timer_fires_exactly_at_its_deadline)
+{
+    assert_timer_fires_at(1000, 1010);
+}
+
+TEST_FUNCTION(a_timer_with_a_deadline_already_passed_fires_on_the_next_advance)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    (void)timer_wheel_schedule(timer, 900);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+
+    // act
+    int result = timer_wheel_advance(timer_wheel, 1001);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(timers_fire_in_deadline_order_within_one_advance)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer_1 = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    TIMER_WHEEL_TIMER_HANDLE timer_2 = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_2);
+    (void)timer_wheel_schedule(timer_1, 1000 + 5000);
+    (void)timer_wheel_schedule(timer_2, 1000 + 20);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_2));
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+
+    // act
+    int result = timer_wheel_advance(timer_wheel, 1000 + 10000);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy_timer(timer_1);
+    timer_wheel_destroy_timer(timer_2);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_cascaded_at_a_64_ms_boundary_fires_exactly_at_its_deadline)
+{
+    assert_timer_fires_at(0, 64 + 5);
+}
+
+TEST_FUNCTION(a_timer_cascaded_at_a_64_power_2_ms_boundary_fires_exactly_at_its_deadline)
+{
+    assert_timer_fires_at(0, (64 * 64) + 5);
+}
+
+TEST_FUNCTION(a_timer_cascaded_at_a_64_power_3_ms_boundary_fires_exactly_at_its_deadline)
+{
+    assert_timer_fires_at(0, (64 * 64 * 64) + 5);
+}
+
+TEST_FUNCTION(a_timer_due_right_on_a_64_power_2_ms_boundary_fires_exactly_at_its_deadline)
+{
+    assert_timer_fires_at(1, 64 * 64);
+}
+
+TEST_FUNCTION(a_timer_cascaded_while_the_wheel_is_advanced_one_ms_at_a_time_fires_exactly_at_its_deadline)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(4000);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    uint64_t now;
+    (void)timer_wheel_schedule(timer, (64 * 64) + 70);
+    umock_c_reset_all_calls();
+
+    // act
+    for (now = 4001; now < (64 * 64) + 70; now++)
+    {
+        (void)timer_wheel_advance(timer_wheel, now);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+    (void)timer_wheel_advance(timer_wheel, now);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_rescheduled_from_its_callback_fires_again_in_the_same_advance)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    (void)timer_wheel_schedule(timer, 1010);
+    test_timer_to_reschedule = timer;
+    test_reschedule_deadline = 1020;
+    test_reschedule_count = 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+
+    // act
+    int result = timer_wheel_advance(timer_wheel, 1100);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_rescheduled_from_its_callback_fires_at_its_new_deadline)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    (void)timer_wheel_schedule(timer, 1010);
+    test_timer_to_reschedule = timer;
+    test_reschedule_deadline = 1010 + 5000;
+    test_reschedule_count = 1;
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+    (void)timer_wheel_advance(timer_wheel, 1010);
+    umock_c_reset_all_calls();
+
+    // act
+    (void)timer_wheel_advance(timer_wheel, 1010 + 4999);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+    (void)timer_wheel_advance(timer_wheel, 1010 + 5000);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_due_in_the_same_tick_can_be_destroyed_from_the_callback_of_another_timer)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer_1 = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    TIMER_WHEEL_TIMER_HANDLE timer_2 = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_2);
+    (void)timer_wheel_schedule(timer_1, 1010);
+    (void)timer_wheel_schedule(timer_2, 1010);
+    test_timer_to_destroy = timer_2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_timer_expired(test_context_1));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    int result = timer_wheel_advance(timer_wheel, 1010);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy_timer(timer_1);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_cancelled_timer_does_not_fire)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    uint64_t next_expiry = 0;
+    (void)timer_wheel_schedule(timer, 1010);
+    umock_c_reset_all_calls();
+
+    // act
+    (void)timer_wheel_cancel(timer);
+    (void)timer_wheel_advance(timer_wheel, 2000);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    (void)timer_wheel_get_next_expiry(timer_wheel, &next_expiry);
+    ASSERT_ARE_EQUAL(uint64_t, UINT64_MAX, next_expiry);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_with_a_deadline_beyond_the_range_of_the_wheel_fires_exactly_at_its_deadline)
+{
+    assert_timer_fires_at(1000, 1000 + (3 * TEST_TIMER_WHEEL_RANGE) + 7);
+}
+
+TEST_FUNCTION(the_next_expiry_of_a_timer_beyond_the_range_of_the_wheel_is_not_later_than_its_deadline)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(1000);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, test_context_1);
+    uint64_t deadline = 1000 + (2 * TEST_TIMER_WHEEL_RANGE);
+    uint64_t next_expiry = 0;
+    (void)timer_wheel_schedule(timer, deadline);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = timer_wheel_get_next_expiry(timer_wheel, &next_expiry);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(next_expiry > 1000);
+    ASSERT_IS_TRUE(next_expiry <= deadline);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(timer_wheel_advance_with_NULL_timer_wheel_fails)
+{
+    // arrange
+
+    // act
+    int result = timer_wheel_advance(NULL, 1000);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(timer_wheel_ut)